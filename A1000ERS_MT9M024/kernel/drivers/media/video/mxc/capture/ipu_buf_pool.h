@@ -0,0 +1,225 @@
+/*
+ * drivers/media/video/mxc/capture/ipu_buf_pool.h
+ *
+ * Pool of contiguous DMA buffers for the IPU capture paths
+ *
+ * Copyright (C) 2013 Aptina Imaging
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+/*
+ * A buffer given back to the pool stays allocated and serves the next
+ * request of its size class, so a stream restart or a repeated
+ * VIDIOC_REQBUFS does not go through dma_alloc_coherent() again. Sizes are
+ * rounded up to IPU_BUF_POOL_GRANULE, the buffers of one class are
+ * interchangeable. When an allocation fails, the idle buffers are freed and
+ * the allocation is tried once more. The buffers of ipu_buf_pool_reserve()
+ * are kept by ipu_buf_pool_trim() on request; as buffers of a class are
+ * interchangeable, the reserve is a number of buffers of its class rather
+ * than particular buffers.
+ *
+ * All functions may sleep. The functions are static inline, the capture
+ * driver and the encoder drivers each get their own copy.
+ */
+
+#ifndef __IPU_BUF_POOL_H__
+#define __IPU_BUF_POOL_H__
+
+#include <linux/list.h>
+#include <linux/mutex.h>
+#include <linux/slab.h>
+#include <linux/dma-mapping.h>
+
+#define IPU_BUF_POOL_GRANULE	(64 * 1024)	/* size class step */
+
+struct ipu_buf_pool {
+	struct mutex lock;
+	struct list_head idle;	/* idle buffers, oldest first */
+	int count;		/* idle buffers */
+	size_t bytes;		/* idle bytes */
+	unsigned long hits;	/* requests served from the pool */
+	unsigned long misses;	/* requests that allocated */
+	int reserved;		/* buffers of reserve_size kept by trim */
+	size_t reserve_size;
+};
+
+struct ipu_buf_pool_entry {
+	struct list_head list;
+	void *vaddr;
+	dma_addr_t paddr;
+	size_t size;
+};
+
+static inline size_t ipu_buf_pool_class(size_t size)
+{
+	return ALIGN(size, IPU_BUF_POOL_GRANULE);
+}
+
+static inline void ipu_buf_pool_init(struct ipu_buf_pool *pool)
+{
+	mutex_init(&pool->lock);
+	INIT_LIST_HEAD(&pool->idle);
+	pool->count = 0;
+	pool->bytes = 0;
+	pool->hits = 0;
+	pool->misses = 0;
+	pool->reserved = 0;
+	pool->reserve_size = 0;
+}
+
+static inline void __ipu_buf_pool_trim(struct ipu_buf_pool *pool,
+		bool reserve)
+{
+	struct ipu_buf_pool_entry *e, *tmp;
+	int keep = reserve ? pool->reserved : 0;
+
+	list_for_each_entry_safe(e, tmp, &pool->idle, list) {
+		if (keep && e->size == pool->reserve_size) {
+			keep--;
+			continue;
+		}
+		list_del(&e->list);
+		pool->count--;
+		pool->bytes -= e->size;
+		dma_free_coherent(0, e->size, e->vaddr, e->paddr);
+		kfree(e);
+	}
+}
+
+/**
+ * ipu_buf_pool_trim - free idle buffers
+ * @pool: pool
+ * @reserve: keep the buffers of ipu_buf_pool_reserve() that are idle
+ */
+static inline void ipu_buf_pool_trim(struct ipu_buf_pool *pool, bool reserve)
+{
+	mutex_lock(&pool->lock);
+	__ipu_buf_pool_trim(pool, reserve);
+	mutex_unlock(&pool->lock);
+}
+
+/**
+ * ipu_buf_pool_get - get a buffer
+ * @pool: pool
+ * @size: bytes needed
+ * @paddr: returns the bus address
+ * @gfp: flags for dma_alloc_coherent()
+ *
+ * Returns the virtual address of a buffer of ipu_buf_pool_class(size)
+ * bytes, or NULL.
+ */
+static inline void *ipu_buf_pool_get(struct ipu_buf_pool *pool, size_t size,
+		dma_addr_t *paddr, gfp_t gfp)
+{
+	struct ipu_buf_pool_entry *e;
+	void *vaddr;
+
+	size = ipu_buf_pool_class(size);
+
+	mutex_lock(&pool->lock);
+	list_for_each_entry(e, &pool->idle, list) {
+		if (e->size != size)
+			continue;
+		list_del(&e->list);
+		pool->count--;
+		pool->bytes -= size;
+		pool->hits++;
+		mutex_unlock(&pool->lock);
+
+		vaddr = e->vaddr;
+		*paddr = e->paddr;
+		kfree(e);
+		return vaddr;
+	}
+
+	pool->misses++;
+	vaddr = dma_alloc_coherent(0, size, paddr,
+			pool->count ? gfp | __GFP_NOWARN : gfp);
+	if (vaddr == NULL && pool->count) {
+		__ipu_buf_pool_trim(pool, false);
+		vaddr = dma_alloc_coherent(0, size, paddr, gfp);
+	}
+	mutex_unlock(&pool->lock);
+
+	return vaddr;
+}
+
+/**
+ * ipu_buf_pool_put - give a buffer back
+ * @pool: pool
+ * @vaddr: virtual address from ipu_buf_pool_get(), may be NULL
+ * @paddr: bus address
+ * @size: size passed to ipu_buf_pool_get()
+ */
+static inline void ipu_buf_pool_put(struct ipu_buf_pool *pool, void *vaddr,
+		dma_addr_t paddr, size_t size)
+{
+	struct ipu_buf_pool_entry *e;
+
+	if (vaddr == NULL)
+		return;
+
+	size = ipu_buf_pool_class(size);
+	e = kmalloc(sizeof(*e), GFP_KERNEL);
+	if (e == NULL) {
+		dma_free_coherent(0, size, vaddr, paddr);
+		return;
+	}
+	e->vaddr = vaddr;
+	e->paddr = paddr;
+	e->size = size;
+
+	mutex_lock(&pool->lock);
+	list_add_tail(&e->list, &pool->idle);
+	pool->count++;
+	pool->bytes += size;
+	mutex_unlock(&pool->lock);
+}
+
+/**
+ * ipu_buf_pool_reserve - fill the pool
+ * @pool: pool
+ * @count: number of buffers
+ * @size: bytes per buffer
+ *
+ * The buffers added become the reserve of the pool, replacing an earlier
+ * one. Returns the number of buffers added.
+ */
+static inline int ipu_buf_pool_reserve(struct ipu_buf_pool *pool, int count,
+		size_t size)
+{
+	dma_addr_t paddr;
+	void *vaddr;
+	int i;
+
+	size = ipu_buf_pool_class(size);
+	for (i = 0; i < count; i++) {
+		vaddr = dma_alloc_coherent(0, size, &paddr,
+				GFP_DMA | GFP_KERNEL | __GFP_NOWARN);
+		if (vaddr == NULL)
+			break;
+		ipu_buf_pool_put(pool, vaddr, paddr, size);
+	}
+
+	mutex_lock(&pool->lock);
+	pool->reserved = i;
+	pool->reserve_size = size;
+	mutex_unlock(&pool->lock);
+
+	return i;
+}
+
+#endif /* __IPU_BUF_POOL_H__ */
@@ -23,7 +23,7 @@
 #include <linux/dma-mapping.h>
 #include <linux/ipu.h>
 #include <mach/mipi_csi2.h>
-#include "mxc_v4l2_capture.h"
+#include "mxc_capture.h"
 #include "ipu_prp_sw.h"
 
 #define CAMERA_DBG
@@ -127,8 +127,11 @@ static int csi_enc_setup(cam_data *cam)
 		pixel_fmt = IPU_PIX_FMT_RGB32;
 	else if (cam->v2f.fmt.pix.pixelformat == V4L2_PIX_FMT_GREY)
 		pixel_fmt = IPU_PIX_FMT_GENERIC;
-	else if (cam->v2f.fmt.pix.pixelformat == V4L2_PIX_FMT_Y16)
+	else if (cam->v2f.fmt.pix.pixelformat == V4L2_PIX_FMT_Y16 ||
+		 cam->v2f.fmt.pix.pixelformat == V4L2_PIX_FMT_SGRBG10)
 		pixel_fmt = IPU_PIX_FMT_GENERIC_16;
+	else if (cam->v2f.fmt.pix.pixelformat == IPU_PIX_FMT_GENERIC_12P)
+		pixel_fmt = IPU_PIX_FMT_GENERIC_12P;
 	else {
 		printk(KERN_ERR "format not supported\n");
 		return -EINVAL;
@@ -241,7 +244,7 @@ static int csi_enc_enabling_tasks(void *private)
 	int err = 0;
 	CAMERA_TRACE("IPU:In csi_enc_enabling_tasks\n");
 
-	cam->dummy_frame.vaddress = dma_alloc_coherent(0,
+	cam->dummy_frame.vaddress = ipu_buf_pool_get(mxc_capture_pool(cam),
 			       PAGE_ALIGN(cam->v2f.fmt.pix.sizeimage),
 			       &cam->dummy_frame.paddress,
 			       GFP_DMA | GFP_KERNEL);
@@ -293,9 +296,10 @@ static int csi_enc_disabling_tasks(void *private)
 	ipu_uninit_channel(cam->ipu, CSI_MEM);
 
 	if (cam->dummy_frame.vaddress != 0) {
-		dma_free_coherent(0, cam->dummy_frame.buffer.length,
-				  cam->dummy_frame.vaddress,
-				  cam->dummy_frame.paddress);
+		ipu_buf_pool_put(mxc_capture_pool(cam),
+				 cam->dummy_frame.vaddress,
+				 cam->dummy_frame.paddress,
+				 cam->dummy_frame.buffer.length);
 		cam->dummy_frame.vaddress = 0;
 	}
 
@@ -24,7 +24,7 @@
 #include <linux/ipu.h>
 #include <mach/devices-common.h>
 #include <mach/mipi_csi2.h>
-#include "mxc_v4l2_capture.h"
+#include "mxc_capture.h"
 #include "ipu_prp_sw.h"
 
 #ifdef CAMERA_DBG
@@ -181,36 +181,39 @@ static int prp_enc_setup(cam_data *cam)
 
 	grotation = cam->rotation;
 	if (cam->rotation >= IPU_ROTATE_90_RIGHT) {
-		if (cam->rot_enc_bufs_vaddr[0]) {
-			dma_free_coherent(0, cam->rot_enc_buf_size[0],
-					  cam->rot_enc_bufs_vaddr[0],
-					  cam->rot_enc_bufs[0]);
-		}
-		if (cam->rot_enc_bufs_vaddr[1]) {
-			dma_free_coherent(0, cam->rot_enc_buf_size[1],
-					  cam->rot_enc_bufs_vaddr[1],
-					  cam->rot_enc_bufs[1]);
-		}
+		ipu_buf_pool_put(mxc_capture_pool(cam),
+				 cam->rot_enc_bufs_vaddr[0],
+				 cam->rot_enc_bufs[0],
+				 cam->rot_enc_buf_size[0]);
+		ipu_buf_pool_put(mxc_capture_pool(cam),
+				 cam->rot_enc_bufs_vaddr[1],
+				 cam->rot_enc_bufs[1],
+				 cam->rot_enc_buf_size[1]);
 		cam->rot_enc_buf_size[0] =
 		    PAGE_ALIGN(cam->v2f.fmt.pix.sizeimage);
 		cam->rot_enc_bufs_vaddr[0] =
-		    (void *)dma_alloc_coherent(0, cam->rot_enc_buf_size[0],
-					       &cam->rot_enc_bufs[0],
-					       GFP_DMA | GFP_KERNEL);
+		    ipu_buf_pool_get(mxc_capture_pool(cam),
+				     cam->rot_enc_buf_size[0],
+				     &cam->rot_enc_bufs[0],
+				     GFP_DMA | GFP_KERNEL);
 		if (!cam->rot_enc_bufs_vaddr[0]) {
+			cam->rot_enc_bufs_vaddr[1] = NULL;
+			cam->rot_enc_bufs[1] = 0;
 			printk(KERN_ERR "alloc enc_bufs0\n");
 			return -ENOMEM;
 		}
 		cam->rot_enc_buf_size[1] =
 		    PAGE_ALIGN(cam->v2f.fmt.pix.sizeimage);
 		cam->rot_enc_bufs_vaddr[1] =
-		    (void *)dma_alloc_coherent(0, cam->rot_enc_buf_size[1],
-					       &cam->rot_enc_bufs[1],
-					       GFP_DMA | GFP_KERNEL);
+		    ipu_buf_pool_get(mxc_capture_pool(cam),
+				     cam->rot_enc_buf_size[1],
+				     &cam->rot_enc_bufs[1],
+				     GFP_DMA | GFP_KERNEL);
 		if (!cam->rot_enc_bufs_vaddr[1]) {
-			dma_free_coherent(0, cam->rot_enc_buf_size[0],
-					  cam->rot_enc_bufs_vaddr[0],
-					  cam->rot_enc_bufs[0]);
+			ipu_buf_pool_put(mxc_capture_pool(cam),
+					 cam->rot_enc_bufs_vaddr[0],
+					 cam->rot_enc_bufs[0],
+					 cam->rot_enc_buf_size[0]);
 			cam->rot_enc_bufs_vaddr[0] = NULL;
 			cam->rot_enc_bufs[0] = 0;
 			printk(KERN_ERR "alloc enc_bufs1\n");
@@ -386,7 +389,7 @@ static int prp_enc_enabling_tasks(void *private)
 	int err = 0;
 	CAMERA_TRACE("IPU:In prp_enc_enabling_tasks\n");
 
-	cam->dummy_frame.vaddress = dma_alloc_coherent(0,
+	cam->dummy_frame.vaddress = ipu_buf_pool_get(mxc_capture_pool(cam),
 			       PAGE_ALIGN(cam->v2f.fmt.pix.sizeimage),
 			       &cam->dummy_frame.paddress,
 			       GFP_DMA | GFP_KERNEL);
@@ -453,9 +456,10 @@ static int prp_enc_disabling_tasks(void *private)
 	}
 
 	if (cam->dummy_frame.vaddress != 0) {
-		dma_free_coherent(0, cam->dummy_frame.buffer.length,
-				  cam->dummy_frame.vaddress,
-				  cam->dummy_frame.paddress);
+		ipu_buf_pool_put(mxc_capture_pool(cam),
+				 cam->dummy_frame.vaddress,
+				 cam->dummy_frame.paddress,
+				 cam->dummy_frame.buffer.length);
 		cam->dummy_frame.vaddress = 0;
 	}
 
@@ -556,16 +560,18 @@ int prp_enc_deselect(void *private)
 		cam->enc_enable_csi = NULL;
 		cam->enc_disable_csi = NULL;
 		if (cam->rot_enc_bufs_vaddr[0]) {
-			dma_free_coherent(0, cam->rot_enc_buf_size[0],
-					  cam->rot_enc_bufs_vaddr[0],
-					  cam->rot_enc_bufs[0]);
+			ipu_buf_pool_put(mxc_capture_pool(cam),
+					 cam->rot_enc_bufs_vaddr[0],
+					 cam->rot_enc_bufs[0],
+					 cam->rot_enc_buf_size[0]);
 			cam->rot_enc_bufs_vaddr[0] = NULL;
 			cam->rot_enc_bufs[0] = 0;
 		}
 		if (cam->rot_enc_bufs_vaddr[1]) {
-			dma_free_coherent(0, cam->rot_enc_buf_size[1],
-					  cam->rot_enc_bufs_vaddr[1],
-					  cam->rot_enc_bufs[1]);
+			ipu_buf_pool_put(mxc_capture_pool(cam),
+					 cam->rot_enc_bufs_vaddr[1],
+					 cam->rot_enc_bufs[1],
+					 cam->rot_enc_buf_size[1]);
 			cam->rot_enc_bufs_vaddr[1] = NULL;
 			cam->rot_enc_bufs[1] = 0;
 		}
@@ -117,8 +117,11 @@ static int prp_still_start(void *private)
 		pixel_fmt = IPU_PIX_FMT_RGB32;
 	else if (cam->v2f.fmt.pix.pixelformat == V4L2_PIX_FMT_GREY)
 		pixel_fmt = IPU_PIX_FMT_GENERIC;
-	else if (cam->v2f.fmt.pix.pixelformat == V4L2_PIX_FMT_Y16)
+	else if (cam->v2f.fmt.pix.pixelformat == V4L2_PIX_FMT_Y16 ||
+		 cam->v2f.fmt.pix.pixelformat == V4L2_PIX_FMT_SGRBG10)
 		pixel_fmt = IPU_PIX_FMT_GENERIC_16;
+	else if (cam->v2f.fmt.pix.pixelformat == IPU_PIX_FMT_GENERIC_12P)
+		pixel_fmt = IPU_PIX_FMT_GENERIC_12P;
 	else {
 		printk(KERN_ERR "%s: format not supported\n",__FUNCTION__);
 		return -EINVAL;
@@ -132,7 +135,8 @@ static int prp_still_start(void *private)
 	err = ipu_init_channel_buffer(cam->ipu, CSI_MEM, IPU_OUTPUT_BUFFER,
 				      pixel_fmt, cam->v2f.fmt.pix.width,
 				      cam->v2f.fmt.pix.height,
-				      cam->v2f.fmt.pix.width, IPU_ROTATE_NONE,
+				      cam->v2f.fmt.pix.bytesperline,
+				      IPU_ROTATE_NONE,
 				      cam->still_buf[0], cam->still_buf[1], 0,
 				      0, 0);
 	if (err != 0)
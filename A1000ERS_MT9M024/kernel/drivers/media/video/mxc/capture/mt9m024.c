@@ -52,6 +52,12 @@
 #include <linux/ctype.h>
 #include <linux/types.h>
 #include <linux/delay.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/bitmap.h>
+#include <linux/workqueue.h>
+#include <linux/completion.h>
+#include <linux/mutex.h>
 #include <linux/device.h>
 #include <linux/i2c.h>
 #include <linux/regulator/consumer.h>
@@ -60,11 +66,21 @@
 #include "mxc_v4l2_capture.h"
 #include "mt9m024.h"
 #include "mt9m024_pll.h"
+#include "mt9m024_timing.h"
 #include "mt9m024_sequencer.h"
+#include "sensor_i2c_batch.h"
+#include "sensor_i2c_prof.h"
 
 #define pr_Dbg pr_err
 
-/* module parameters */
+/* max. number of phases kept in the bring-up timing trace */
+#define APT_MT9M024_TRACE_PHASES		8
+
+/* register range mirrored by the shadow cache, 16 bit registers only */
+#define APT_MT9M024_SHADOW_FIRST		0x3000
+#define APT_MT9M024_SHADOW_REGS			0x800
+
+/* module parameters, initial values of the mode controls */
 static int testpattern = 0;
 static int autoexposure = 0;
 static int hdrmode = 0;
@@ -73,6 +89,71 @@ static int sensorheight = APT_MT9M024_MAX_Y_RES;
 static int datawidth = 12;
 static int rotate = 0;
 static int binning = 1;
+static int companding = 1;
+
+/*!
+ * Capture modes, selected by the capturemode of VIDIOC_S_PARM and listed
+ * by VIDIOC_ENUM_FRAMESIZES. The full and the preview mode have their own
+ * sensor context, both are loaded when streaming starts. The high speed
+ * modes read less rows and replace the full mode in context A, switching
+ * to or from them stops streaming for a moment.
+ */
+enum mt9m024_mode {
+	mt9m024_mode_MIN = 0,
+	mt9m024_mode_full = 0,		/* context A, sensorwidth x sensorheight */
+	mt9m024_mode_preview = 1,	/* context B, 2x2 binned */
+	mt9m024_mode_skip = 2,		/* full window, 2x2 skipped */
+	mt9m024_mode_skip_binned = 3,	/* full window, skipped and binned */
+	mt9m024_mode_720p = 4,		/* 1280x720 window */
+	mt9m024_mode_roi_vga = 5,	/* 640x480 window */
+	mt9m024_mode_roi_qvga = 6,	/* 320x240 window */
+	mt9m024_mode_MAX = 6,
+};
+
+/*!
+ * Mode parameters. They start out with the module parameters and are
+ * changed through private controls, see ioctl_s_ctrl(). Changes take
+ * effect at the next stream start, see ioctl_apply().
+ */
+struct mt9m024_params {
+	int test_pattern;	/* 0 = off, 1..4 as the testpattern parameter */
+	int auto_exposure;
+	int hdr;
+	int rotate;		/* by 180 degrees */
+	int binning;		/* 2x2 for VGA and smaller sizes */
+	int width;		/* output size of context A */
+	int height;
+	int data_width;		/* bits per pixel on the CSI, 8 or 12 */
+	int companding;		/* HDR data compressed to 12 bits */
+};
+
+/*!
+ * Readout of a high speed mode. Digital binning halves the output size
+ * only, skipping also the rows and columns read.
+ */
+struct mt9m024_readout {
+	int window_width;	/* 0 for the window of the full mode */
+	int window_height;
+	int skip;
+	bool binned;
+};
+
+static const struct mt9m024_readout
+mt9m024_readouts[mt9m024_mode_MAX - mt9m024_mode_skip + 1] = {
+	[mt9m024_mode_skip - mt9m024_mode_skip]		= { 0, 0, 2, false },
+	[mt9m024_mode_skip_binned - mt9m024_mode_skip]	= { 0, 0, 2, true },
+	[mt9m024_mode_720p - mt9m024_mode_skip]		= { 1280, 720, 1, false },
+	[mt9m024_mode_roi_vga - mt9m024_mode_skip]	= { 640, 480, 1, false },
+	[mt9m024_mode_roi_qvga - mt9m024_mode_skip]	= { 320, 240, 1, false },
+};
+
+/*!
+ * One entry of the bring-up timing trace.
+ */
+struct mt9m024_phase {
+	const char *name;
+	s64 us;
+};
 
 /*!
  * Maintains the information on the current state of the sensor.
@@ -83,9 +164,18 @@ struct sensor {
 	struct v4l2_pix_format pix;
 	struct v4l2_captureparm streamcap;
 	bool on;
+	u32 mclk;		/* EXTCLK */
 	int framerate;
-	int height;
-	int width;
+	enum mt9m024_mode mode;
+
+	/* mode parameters in use and as set by the controls */
+	struct mt9m024_params params;
+	struct mt9m024_params next;
+
+	/* readout of each mode, see mt9m024_init_contexts() */
+	struct mt9m024_context context[mt9m024_mode_MAX + 1];
+	bool contexts_loaded;
+	enum mt9m024_mode context_a;	/* mode loaded into context A */
 
 	/* control settings */
 	int brightness;
@@ -98,15 +188,47 @@ struct sensor {
 	int ae_mode;
 
 	int csi;
+
+	/* bring-up timing trace */
+	struct mt9m024_phase trace[APT_MT9M024_TRACE_PHASES];
+	int trace_len;
+	ktime_t trace_stamp;
+
+	/* write-through shadow of the sensor registers */
+	u16 shadow[APT_MT9M024_SHADOW_REGS];
+	DECLARE_BITMAP(shadow_valid, APT_MT9M024_SHADOW_REGS);
+	/* registers written since the last reset, a subset of shadow_valid */
+	DECLARE_BITMAP(shadow_written, APT_MT9M024_SHADOW_REGS);
+	unsigned long i2c_avoided;
+
+	/* shadow contents after the first bring-up, see mt9m024_restore() */
+	u16 snapshot[APT_MT9M024_SHADOW_REGS];
+	DECLARE_BITMAP(snapshot_valid, APT_MT9M024_SHADOW_REGS);
+
+	/* messages of the burst writers, too large for the stack */
+	struct sensor_i2c_batch batch;
+	struct mutex batch_lock;
+
+	/* asynchronous configuration, see mt9m024_init_work() */
+	struct work_struct init_work;
+	struct completion init_done;
+	struct mutex init_lock;
+	int init_ret;
+	bool configured;
+	bool init_pending;
+	bool mode_pending;
 } mt9m024_data;
 
 const struct fsl_mxc_camera_platform_data *camera_plat;
 
+/*! bus time per call site and phase, see sensor_i2c_prof.h */
+static struct sensor_i2c_prof mt9m024_prof;
+
 static int mt9m024_probe(struct i2c_client *adapter,
 				const struct i2c_device_id *device_id);
 static int mt9m024_remove(struct i2c_client *client);
-static s32 mt9m024_read_reg(u16 reg, u16 *val);
-static s32 mt9m024_write_reg(u16 reg, u16 val);
+static noinline s32 mt9m024_read_reg(u16 reg, u16 *val);
+static noinline s32 mt9m024_write_reg(u16 reg, u16 val);
 
 static const struct i2c_device_id mt9m024_id[] = {
 	{"mt9m024", 0},
@@ -125,44 +247,376 @@ static struct i2c_driver mt9m024_i2c_driver = {
 	.id_table = mt9m024_id,
 };
 
-static s32 mt9m024_write_reg(u16 reg, u16 val)
+/*!
+ * Tells whether a register may change without being written by the
+ * driver. Such registers are never served from the shadow cache.
+ */
+static bool mt9m024_reg_volatile(u16 reg)
+{
+	switch (reg) {
+	case APT_MT9M024_COARSE_INTEGRATION_TIME_:	/* auto exposure */
+	case APT_MT9M024_COARSE_INTEGRATION_TIME_CB:
+	case APT_MT9M024_GPI_STATUS:
+	case APT_MT9M024_FRAME_COUNT_:
+	case APT_MT9M024_FRAME_STATUS:
+	case APT_MT9M024_SEQ_DATA_PORT:
+	case APT_MT9M024_SEQ_CTRL_PORT:
+	case APT_MT9M024_TEMPSENS_DATA:
+	case APT_MT9M024_AE_CURRENT_GAINS:
+		return true;
+	}
+	/* auto exposure statistics */
+	return reg >= APT_MT9M024_AE_MEAN_H && reg <= APT_MT9M024_AE_HIST_END_L;
+}
+
+/*!
+ * Returns the shadow cache slot of a register, or -1 if it is not cached.
+ */
+static int mt9m024_shadow_slot(u16 reg)
+{
+	int slot = (reg - APT_MT9M024_SHADOW_FIRST) / 2;
+
+	if (reg < APT_MT9M024_SHADOW_FIRST || (reg & 1) ||
+	    slot >= APT_MT9M024_SHADOW_REGS || mt9m024_reg_volatile(reg))
+		return -1;
+	return slot;
+}
+
+/*!
+ * Drops all cached register values. Must be called whenever the sensor
+ * is reset or powered down.
+ */
+static void mt9m024_shadow_invalidate(void)
+{
+	bitmap_zero(mt9m024_data.shadow_valid, APT_MT9M024_SHADOW_REGS);
+	bitmap_zero(mt9m024_data.shadow_written, APT_MT9M024_SHADOW_REGS);
+}
+
+/*!
+ * Drops the cached value of a single register.
+ */
+static void mt9m024_shadow_invalidate_reg(u16 reg)
+{
+	int slot = mt9m024_shadow_slot(reg);
+
+	if (slot >= 0) {
+		clear_bit(slot, mt9m024_data.shadow_valid);
+		clear_bit(slot, mt9m024_data.shadow_written);
+	}
+}
+
+/*!
+ * Caches the value of a register. With written set, the value was
+ * written by the driver and is part of the next snapshot, else it was
+ * only read back and holds the default of the sensor.
+ */
+static void mt9m024_shadow_store(u16 reg, u16 val, bool written)
+{
+	int slot = mt9m024_shadow_slot(reg);
+
+	if (slot >= 0) {
+		mt9m024_data.shadow[slot] = val;
+		set_bit(slot, mt9m024_data.shadow_valid);
+		if (written)
+			set_bit(slot, mt9m024_data.shadow_written);
+	}
+}
+
+/*!
+ * Writes a register on the bus. The register accessors below are noinline
+ * and pass their _RET_IP_ as ip, so the profile accounts the transaction
+ * to the function calling the accessor.
+ */
+static s32 mt9m024_i2c_write(u16 reg, u16 val, unsigned long ip)
 {
 	u8 au8Buf[4] = {0};
+	ktime_t start;
+	int ret;
 
 	au8Buf[0] = reg >> 8;
 	au8Buf[1] = reg & 0xff;
 	au8Buf[2] = val >> 8;
 	au8Buf[3] = val & 0xff;
 
-	if (i2c_master_send(mt9m024_data.i2c_client, au8Buf, 4) < 0) {
+	start = ktime_get();
+	ret = i2c_master_send(mt9m024_data.i2c_client, au8Buf, 4);
+	sensor_i2c_prof_record(&mt9m024_prof, ip, start, ret < 0);
+	if (ret < 0) {
 		pr_err("%s:write reg error: reg=%04x, val=%04x\n",
 		       __func__, reg, val);
+		mt9m024_shadow_invalidate_reg(reg);
 		return -1;
 	}
 
+	if (reg == APT_MT9M024_RESET_REGISTER &&
+	    (val & APT_MT9M024_RESET_REGISTER_RESET))
+		/* soft reset: all registers return to their defaults */
+		mt9m024_shadow_invalidate();
+	else
+		mt9m024_shadow_store(reg, val, true);
+
 	return 0;
 }
 
-static s32 mt9m024_read_reg(u16 reg, u16 *val)
+static noinline s32 mt9m024_write_reg(u16 reg, u16 val)
+{
+	return mt9m024_i2c_write(reg, val, _RET_IP_);
+}
+
+/*!
+ * Writes a block of 16-bit words in as few I2C transfers as possible.
+ * The register address is sent once per message, followed by up to
+ * APT_MT9M024_BURST_WORDS data words, and the messages are batched into
+ * multi-message transfers. For ordinary registers the sensor
+ * auto-increments the address after every word; port registers (such as
+ * the sequencer data port) keep their address, so every word of the
+ * burst is fed into the port.
+ *
+ * @param reg      first register address
+ * @param vals     data words
+ * @param count    number of data words
+ * @param port     nonzero if reg is a port register
+ * @return number of I2C transfers issued, or -1 on error
+ */
+static noinline int mt9m024_write_burst(u16 reg, const u16 *vals, int count,
+					int port)
+{
+	struct sensor_i2c_batch *batch = &mt9m024_data.batch;
+	u16 first = reg;
+	int i, n;
+
+	mutex_lock(&mt9m024_data.batch_lock);
+	sensor_i2c_batch_init(batch, mt9m024_data.i2c_client, &mt9m024_prof,
+			      _RET_IP_);
+	while (count > 0) {
+		n = min(count, APT_MT9M024_BURST_WORDS);
+
+		if (sensor_i2c_batch_write_words(batch, reg, vals, n, port))
+			goto err;
+
+		if (!port)
+			for (i = 0; i < n; i++)
+				mt9m024_shadow_store(reg + 2 * i, vals[i], true);
+		vals += n;
+		count -= n;
+		if (!port)
+			reg += 2 * n;
+	}
+	if (sensor_i2c_batch_flush(batch))
+		goto err;
+	n = batch->transfers;
+	mutex_unlock(&mt9m024_data.batch_lock);
+
+	return n;
+
+err:
+	mutex_unlock(&mt9m024_data.batch_lock);
+	pr_err("%s:burst write error: reg=%04x\n", __func__, first);
+	if (!port)
+		mt9m024_shadow_invalidate();
+	return -1;
+}
+
+/*!
+ * Reads a register from the bus and refreshes the cached value.
+ */
+static s32 mt9m024_i2c_read(u16 reg, u16 *val, unsigned long ip)
 {
 	u8 regbuf[2] = {0,0};
 	u8 readval[2] = {0,0};
+	ktime_t start;
+	int ret;
 
 	regbuf[0] = reg >> 8;
 	regbuf[1] = reg & 0xff;
 
-	if (2 != i2c_master_send(mt9m024_data.i2c_client, regbuf, 2)) {
+	start = ktime_get();
+	ret = i2c_master_send(mt9m024_data.i2c_client, regbuf, 2);
+	if (2 != ret) {
+		sensor_i2c_prof_record(&mt9m024_prof, ip, start, true);
 		pr_err("%s:write reg error: reg=%x\n",
 		       __func__, reg);
 		return -1;
 	}
 
-	if (2 != i2c_master_recv(mt9m024_data.i2c_client, (char*)&readval, 2)) {
+	ret = i2c_master_recv(mt9m024_data.i2c_client, (char*)&readval, 2);
+	sensor_i2c_prof_record(&mt9m024_prof, ip, start, 2 != ret);
+	if (2 != ret) {
 		pr_err("%s:read reg error: reg=%x\n",
 		       __func__, reg);
 		return -1;
 	}
 	*val = (readval[0] << 8) | readval[1];
+	mt9m024_shadow_store(reg, *val, false);
+
+	return 0;
+}
+
+/*!
+ * Reads a register from the shadow cache if possible, else from the bus.
+ */
+static s32 mt9m024_cached_read(u16 reg, u16 *val, unsigned long ip)
+{
+	int slot = mt9m024_shadow_slot(reg);
+
+	if (slot >= 0 && test_bit(slot, mt9m024_data.shadow_valid)) {
+		*val = mt9m024_data.shadow[slot];
+		/* address write plus data read */
+		mt9m024_data.i2c_avoided += 2;
+		return 0;
+	}
+
+	return mt9m024_i2c_read(reg, val, ip);
+}
+
+/*!
+ * Reads a register from the sensor, bypassing the shadow cache, and
+ * refreshes the cached value. Used for polling status registers.
+ */
+static noinline s32 mt9m024_read_reg_nocache(u16 reg, u16 *val)
+{
+	return mt9m024_i2c_read(reg, val, _RET_IP_);
+}
+
+/*!
+ * Reads a register, from the shadow cache if possible.
+ */
+static noinline s32 mt9m024_read_reg(u16 reg, u16 *val)
+{
+	return mt9m024_cached_read(reg, val, _RET_IP_);
+}
+
+/*!
+ * Read-modify-write of the bits in mask. The read is served from the
+ * shadow cache and the write is skipped if the value does not change.
+ */
+static noinline s32 mt9m024_update_reg(u16 reg, u16 mask, u16 val)
+{
+	u16 oldval, newval;
+
+	if (mt9m024_cached_read(reg, &oldval, _RET_IP_))
+		return -1;
+	newval = (oldval & ~mask) | (val & mask);
+	if (newval == oldval && mt9m024_shadow_slot(reg) >= 0) {
+		mt9m024_data.i2c_avoided++;
+		return 0;
+	}
+
+	return mt9m024_i2c_write(reg, newval, _RET_IP_);
+}
+
+/*!
+ * Starts a new bring-up timing trace.
+ */
+static void mt9m024_trace_start(void)
+{
+	mt9m024_data.trace_len = 0;
+	mt9m024_data.trace_stamp = ktime_get();
+}
+
+/*!
+ * Records the time spent since the previous phase under the given name.
+ */
+static void mt9m024_trace_phase(const char *name)
+{
+	ktime_t now = ktime_get();
+	struct mt9m024_phase *phase;
+
+	if (mt9m024_data.trace_len < APT_MT9M024_TRACE_PHASES) {
+		phase = &mt9m024_data.trace[mt9m024_data.trace_len++];
+		phase->name = name;
+		phase->us = ktime_to_us(ktime_sub(now,
+						  mt9m024_data.trace_stamp));
+	}
+	mt9m024_data.trace_stamp = now;
+}
+
+/*!
+ * Sleeps for one back-off step and doubles the step for the next round,
+ * up to APT_MT9M024_POLL_MAX_US.
+ */
+static void mt9m024_backoff(unsigned long *step)
+{
+	usleep_range(*step, *step * 2);
+	*step = min(*step * 2, (unsigned long)APT_MT9M024_POLL_MAX_US);
+}
+
+/*!
+ * Polls a register until (value & mask) == val. Read errors count as
+ * "not ready", the sensor does not answer while it is in reset.
+ *
+ * @return 0 when ready, -ETIMEDOUT after timeout_ms
+ */
+static int mt9m024_poll_reg(u16 reg, u16 mask, u16 val,
+			    unsigned int timeout_ms)
+{
+	unsigned long timeout = jiffies + msecs_to_jiffies(timeout_ms);
+	unsigned long step = APT_MT9M024_POLL_MIN_US;
+	u16 regval;
+
+	for (;;) {
+		if (!mt9m024_read_reg_nocache(reg, &regval) &&
+		    (regval & mask) == val)
+			return 0;
+		if (time_after(jiffies, timeout))
+			return -ETIMEDOUT;
+		mt9m024_backoff(&step);
+	}
+}
+
+/*!
+ * Waits until the sensor has put out a new frame, i.e. until
+ * APT_MT9M024_FRAME_COUNT_ moves. A new frame proves that the PLL is
+ * locked and the sequencer is running.
+ *
+ * @return 0 when a frame was seen, -ETIMEDOUT after timeout_ms
+ */
+static int mt9m024_wait_frame(unsigned int timeout_ms)
+{
+	unsigned long timeout = jiffies + msecs_to_jiffies(timeout_ms);
+	unsigned long step = APT_MT9M024_POLL_MIN_US;
+	u16 start, regval;
+
+	if (mt9m024_read_reg_nocache(APT_MT9M024_FRAME_COUNT_, &start))
+		return -EIO;
+
+	for (;;) {
+		mt9m024_backoff(&step);
+		if (!mt9m024_read_reg_nocache(APT_MT9M024_FRAME_COUNT_,
+					      &regval) &&
+		    regval != start)
+			return 0;
+		if (time_after(jiffies, timeout))
+			return -ETIMEDOUT;
+	}
+}
+
+/*!
+ * Loads MT9M024sequencerReg[] into the sequencer RAM. The table is streamed
+ * through APT_MT9M024_SEQ_DATA_PORT in burst transfers instead of one
+ * 4-byte transfer per word.
+ *
+ * @return 0 on success, -1 on error
+ */
+static int mt9m024_load_sequencer(void)
+{
+	ktime_t start = ktime_get();
+	int xfers;
+
+	/* enable sequencer ram */
+	if (mt9m024_write_reg(APT_MT9M024_SEQ_CTRL_PORT, 0x8000))
+		return -1;
+
+	/* load sequencer ram */
+	xfers = mt9m024_write_burst(APT_MT9M024_SEQ_DATA_PORT,
+				    MT9M024sequencerReg,
+				    ARRAY_SIZE(MT9M024sequencerReg), 1);
+	if (xfers < 0)
+		return -1;
+
+	pr_info("%s: %zu words in %d transfers, %lld us\n", __func__,
+		ARRAY_SIZE(MT9M024sequencerReg), xfers + 1,
+		ktime_to_us(ktime_sub(ktime_get(), start)));
 
 	return 0;
 }
@@ -197,122 +651,398 @@ static int APTsetPLL(unsigned short pa_ucM, unsigned short pa_ucN,
 		return -1;
 
 	// wait for 1 ms until VCO locked
-	msleep(100);
+	usleep_range(1000, 2000);
 	return 0;
 }
 
-static int mt9m024_init_mode(int frame_rate, int width, int height)
+/*!
+ * Programs a timing from mt9m024_solve_timing(). A new pixel clock is
+ * set in standby, streaming is stopped for it if needed. Row and frame
+ * length are latched at the next frame start. Both contexts read the
+ * same window, context B gets the frame length of context A.
+ *
+ * @return 0 on success, -1 on I2C error
+ */
+static int mt9m024_set_timing(const struct mt9m024_timing *t)
 {
-	u16 regaddr = 0;
-	u16 regval = 0;
-	u16 uc_M, uc_N, uc_P1, uc_P2;
-	int tgtPixClk, realPixClk;
-	int offset_left, offset_top;
-	int sensorWidth, sensorHeight;
+	const struct MT9M024_PLL_ENTRY *pll = &t->pll;
+	const u16 pll_regs[][2] = {
+		{ APT_MT9M024_PRE_PLL_CLK_DIV, pll->n },
+		{ APT_MT9M024_VT_SYS_CLK_DIV, pll->p1 },
+		{ APT_MT9M024_VT_PIX_CLK_DIV, pll->p2 },
+		{ APT_MT9M024_PLL_MULTIPLIER, pll->m },
+	};
+	bool relock = false, streaming;
+	u16 regval;
+	int i;
 
-	if (mt9m024_data.framerate == frame_rate &&
-	    mt9m024_data.width == width &&
-	    mt9m024_data.height == height) {
-		/* values already set, no need to repeat that */
-		return 0;
+	/* the PLL registers are served from the shadow cache */
+	for (i = 0; i < ARRAY_SIZE(pll_regs); i++) {
+		if (mt9m024_read_reg(pll_regs[i][0], &regval))
+			return -1;
+		if (regval != pll_regs[i][1])
+			relock = true;
 	}
+	if (mt9m024_read_reg(APT_MT9M024_RESET_REGISTER, &regval))
+		return -1;
+	streaming = relock && (regval & APT_MT9M024_RESET_REGISTER_STREAM);
 
-	/* streaming off */
-	regaddr = APT_MT9M024_RESET_REGISTER;
-	if (mt9m024_read_reg(regaddr, &regval))
+	if (streaming && mt9m024_update_reg(APT_MT9M024_RESET_REGISTER,
+					    APT_MT9M024_RESET_REGISTER_STREAM,
+					    0))
 		return -1;
-	regval &= ~(1<<2);
-	if (mt9m024_write_reg(regaddr, regval))
+	if (relock && APTsetPLL(pll->m, pll->n, pll->p1, pll->p2))
+		return -1;
+	if (mt9m024_update_reg(APT_MT9M024_LINE_LENGTH_PCK_, 0xffff,
+			       t->line_length) ||
+	    mt9m024_update_reg(APT_MT9M024_FRAME_LENGTH_LINES_, 0xffff,
+			       t->frame_length) ||
+	    mt9m024_update_reg(APT_MT9M024_FRAME_LENGTH_LINES_CB, 0xffff,
+			       t->frame_length))
+		return -1;
+	if (streaming && mt9m024_update_reg(APT_MT9M024_RESET_REGISTER,
+					    APT_MT9M024_RESET_REGISTER_STREAM,
+					    APT_MT9M024_RESET_REGISTER_STREAM))
 		return -1;
-	pr_Dbg("%s: streaming off\n",__func__);
 
-	/* set resolution */
-	if (width <= 640 && height <= 480 && binning) {
-		sensorWidth = width * 2;
-		sensorHeight = height * 2;
-	} else {
-		sensorWidth = width;
-		sensorHeight = height;
+	pr_Dbg("%s: %u Hz, %d x %d, %d fps (max %d)\n", __func__,
+	       t->pixclk, t->line_length, t->frame_length, t->fps,
+	       t->max_fps);
+	return 0;
+}
+
+/*!
+ * Derives the readout of all modes from the mode parameters in use.
+ * The full mode reads the sensor size, binned 2x2 from a window twice as
+ * large for VGA and smaller sizes. The preview mode bins the window of
+ * the full mode, it shows the same field of view at half the size. The
+ * high speed modes follow mt9m024_readouts[], their windows shrink to
+ * an output size the CSI can take.
+ */
+static void mt9m024_init_contexts(void)
+{
+	const struct mt9m024_params *p = &mt9m024_data.params;
+	struct mt9m024_context *a = &mt9m024_data.context[mt9m024_mode_full];
+	struct mt9m024_context *b = &mt9m024_data.context[mt9m024_mode_preview];
+	const struct mt9m024_readout *r;
+	struct mt9m024_context *ctx;
+	int mode, div;
+
+	a->width = p->width;
+	a->height = p->height;
+	a->binned = p->width <= 640 && p->height <= 480 && p->binning;
+	a->window_width = a->binned ? a->width * 2 : a->width;
+	a->window_height = a->binned ? a->height * 2 : a->height;
+	a->skip = 1;
+
+	b->window_width = a->window_width;
+	b->window_height = a->window_height;
+	b->skip = 1;
+	b->binned = true;
+	b->width = b->window_width / 2;
+	b->height = b->window_height / 2;
+
+	for (mode = mt9m024_mode_skip; mode <= mt9m024_mode_MAX; mode++) {
+		r = &mt9m024_readouts[mode - mt9m024_mode_skip];
+		ctx = &mt9m024_data.context[mode];
+		div = r->skip * (r->binned ? 2 : 1);
+
+		ctx->skip = r->skip;
+		ctx->binned = r->binned;
+		ctx->width = (r->window_width ? : a->window_width) / div;
+		ctx->width -= ctx->width % APT_MT9M024_X_RES_STEP;
+		ctx->height = (r->window_height ? : a->window_height) / div;
+		ctx->height -= ctx->height % APT_MT9M024_Y_RES_STEP;
+		ctx->window_width = ctx->width * div;
+		ctx->window_height = ctx->height * div;
 	}
-	offset_left = (APT_MT9M024_MAX_X_RES - sensorWidth) / 2
+}
+
+/*!
+ * Sets up the output format for the mode parameters in use.
+ */
+static void mt9m024_init_format(void)
+{
+	struct mt9m024_context *ctx =
+		&mt9m024_data.context[mt9m024_data.streamcap.capturemode];
+
+	mt9m024_init_contexts();
+	if (mt9m024_data.params.data_width == 12)
+		/* because of the CSI's color extension to 16 bits */
+		mt9m024_data.pix.pixelformat = IPU_PIX_FMT_GENERIC_16;
+	else
+		mt9m024_data.pix.pixelformat = IPU_PIX_FMT_GENERIC;
+	mt9m024_data.pix.width = ctx->width;
+	mt9m024_data.pix.height = ctx->height;
+}
+
+/*!
+ * Programs window, skipping and binning of a mode into its context, B
+ * for the preview mode and A for all others. The four window registers
+ * of a context are consecutive and go out in one burst.
+ *
+ * @return 0 on success, -1 on I2C error
+ */
+static int mt9m024_load_context(enum mt9m024_mode mode)
+{
+	const struct mt9m024_context *ctx = &mt9m024_data.context[mode];
+	int left, top, right, bottom, shift;
+	u16 window[4], odd_inc;
+	u16 reg, x_odd_inc, y_odd_inc;
+
+	left = (APT_MT9M024_MAX_X_RES - ctx->window_width) / 2
 		+ APT_MT9M024_X_ADDR_START_DEFAULT;
-	offset_top = (APT_MT9M024_MAX_Y_RES - sensorHeight) / 2
+	top = (APT_MT9M024_MAX_Y_RES - ctx->window_height) / 2
 		+ APT_MT9M024_Y_ADDR_START_DEFAULT;
-	if (mt9m024_write_reg(APT_MT9M024_X_ADDR_START_, offset_left))
+	right = left + ctx->window_width - 1;
+	bottom = top + ctx->window_height - 1;
+
+	if (mode == mt9m024_mode_preview) {
+		reg = APT_MT9M024_X_ADDR_START_CB;
+		window[0] = left;
+		window[1] = top;
+		window[2] = right;
+		window[3] = bottom;
+		x_odd_inc = APT_MT9M024_X_ODD_INC_CB;
+		y_odd_inc = APT_MT9M024_Y_ODD_INC_CB;
+		shift = APT_MT9M024_DIGITAL_BINNING_CB_SHIFT;
+	} else {
+		reg = APT_MT9M024_Y_ADDR_START_;
+		window[0] = top;
+		window[1] = left;
+		window[2] = bottom;
+		window[3] = right;
+		x_odd_inc = APT_MT9M024_X_ODD_INC_;
+		y_odd_inc = APT_MT9M024_Y_ODD_INC_;
+		shift = 0;
+	}
+	if (mt9m024_write_burst(reg, window, 4, 0) < 0)
+		return -1;
+
+	/* 1 reads every pair of the Bayer pattern, 3 every other one */
+	odd_inc = 2 * ctx->skip - 1;
+	if (mt9m024_update_reg(x_odd_inc, 0xffff, odd_inc) ||
+	    mt9m024_update_reg(y_odd_inc, 0xffff, odd_inc))
+		return -1;
+
+	if (mt9m024_update_reg(APT_MT9M024_DIGITAL_BINNING,
+			       APT_MT9M024_DIGITAL_BINNING_MASK << shift,
+			       (ctx->binned ? APT_MT9M024_DIGITAL_BINNING_2X2 : 0)
+			       << shift))
+		return -1;
+
+	pr_Dbg("%s: context %c %dx%d, window %dx%d at %d,%d, skip %d\n",
+	       __func__, mode == mt9m024_mode_preview ? 'B' : 'A', ctx->width,
+	       ctx->height, ctx->window_width, ctx->window_height, left, top,
+	       ctx->skip);
+	return 0;
+}
+
+/*!
+ * Writes test pattern, auto exposure, HDR mode, companding and readout
+ * direction of the mode parameters in use. Registers that already hold the value are
+ * not written again.
+ *
+ * @return 0 on success, -1 on I2C error
+ */
+static int mt9m024_set_params(void)
+{
+	const struct mt9m024_params *p = &mt9m024_data.params;
+	u16 flip = APT_MT9M024_READ_MODE_VERT_FLIP |
+		   APT_MT9M024_READ_MODE_HORIZ_MIRROR;
+	u16 regval;
+
+	switch (p->test_pattern) {
+	case 1:
+	case 2:
+	case 3:
+		regval = p->test_pattern;
+		break;
+	case 4:
+		regval = APT_MT9M024_TEST_PATTERN_WALKING_1S;
+		break;
+	default:
+		regval = 0;
+		break;
+	}
+	if (mt9m024_update_reg(APT_MT9M024_TEST_PATTERN_MODE_, 0xffff, regval))
+		return -1;
+
+	if (mt9m024_update_reg(APT_MT9M024_AE_CTRL_REG,
+			       APT_MT9M024_AE_CTRL_ENABLE,
+			       p->auto_exposure ?
+			       APT_MT9M024_AE_CTRL_ENABLE : 0))
 		return -1;
-	if (mt9m024_write_reg(APT_MT9M024_X_ADDR_END_,
-				offset_left + sensorWidth - 1))
+
+	if (mt9m024_update_reg(APT_MT9M024_OPERATION_MODE_CTRL,
+			       APT_MT9M024_OPERATION_MODE_LINEAR,
+			       p->hdr ? 0 : APT_MT9M024_OPERATION_MODE_LINEAR))
 		return -1;
-	if (mt9m024_write_reg(APT_MT9M024_Y_ADDR_START_, offset_top))
+
+	/*
+	 * The 8 bit datapath takes the upper 8 of the 12 data lines. With
+	 * companding, they carry the full HDR range, otherwise only the
+	 * upper part of it.
+	 */
+	if (mt9m024_update_reg(APT_MT9M024_HDR_COMP,
+			       APT_MT9M024_HDR_COMP_ENABLE,
+			       p->companding ? APT_MT9M024_HDR_COMP_ENABLE : 0))
 		return -1;
-	if (mt9m024_write_reg(APT_MT9M024_Y_ADDR_END_,
-			      offset_top + sensorHeight - 1))
+
+	if (mt9m024_update_reg(APT_MT9M024_READ_MODE, flip,
+			       p->rotate ? flip : 0))
 		return -1;
-	pr_Dbg("%s: set resolution\n",__func__);
 
-	/* enable digital binning? */
-	if (width <= 640 && height <= 480 && binning) {
-		if (mt9m024_read_reg(APT_MT9M024_DIGITAL_BINNING, &regval))
+	pr_info("%s: test pattern %d, auto exposure %s, %s mode%s, %d bit%s\n",
+		__func__, p->test_pattern, p->auto_exposure ? "on" : "off",
+		p->hdr ? "HDR" : "linear", p->companding ? " companded" : "",
+		p->data_width, p->rotate ? ", rotated by 180°" : "");
+	return 0;
+}
+
+/*!
+ * Registers of context A that context B takes over unchanged, so that
+ * a context switch does not change exposure. The frame length is set by
+ * mt9m024_set_timing(), the skipping by mt9m024_load_context().
+ */
+static const u16 mt9m024_context_b_copy[][2] = {
+	{ APT_MT9M024_OPERATION_MODE_CTRL, APT_MT9M024_OPERATION_MODE_CTRL_CB },
+	{ APT_MT9M024_COARSE_INTEGRATION_TIME_,
+	  APT_MT9M024_COARSE_INTEGRATION_TIME_CB },
+	{ APT_MT9M024_FINE_INTEGRATION_TIME_,
+	  APT_MT9M024_FINE_INTEGRATION_TIME_CB },
+	{ APT_MT9M024_GREEN1_GAIN, APT_MT9M024_GREEN1_GAIN_CB },
+	{ APT_MT9M024_BLUE_GAIN, APT_MT9M024_BLUE_GAIN_CB },
+	{ APT_MT9M024_RED_GAIN, APT_MT9M024_RED_GAIN_CB },
+	{ APT_MT9M024_GREEN2_GAIN, APT_MT9M024_GREEN2_GAIN_CB },
+	{ APT_MT9M024_GLOBAL_GAIN, APT_MT9M024_GLOBAL_GAIN_CB },
+};
+
+/*!
+ * Sets the capture mode. The first call after a (re)configuration stops
+ * streaming, writes the mode parameters and preloads both contexts, so
+ * does a change of the mode in context A. Any other mode change is a
+ * single write of the context select bit, which the sensor latches at
+ * the next frame start, so streaming goes on without a gap.
+ *
+ * @return 0 on success, -1 on I2C error
+ */
+static int mt9m024_init_mode(int frame_rate, enum mt9m024_mode mode)
+{
+	struct mt9m024_timing timing;
+	enum mt9m024_mode context_a;
+	u16 regval;
+	int i;
+
+	if (mt9m024_solve_timing(&mt9m024_data.context[mode], mt9m024_data.mclk,
+				 frame_rate, &timing))
+		return -1;
+
+	if (mode != mt9m024_mode_preview)
+		context_a = mode;
+	else if (mt9m024_data.contexts_loaded)
+		context_a = mt9m024_data.context_a;
+	else
+		context_a = mt9m024_mode_full;
+
+	if (!mt9m024_data.contexts_loaded ||
+	    context_a != mt9m024_data.context_a) {
+		/* streaming off */
+		if (mt9m024_update_reg(APT_MT9M024_RESET_REGISTER,
+				       APT_MT9M024_RESET_REGISTER_STREAM, 0))
 			return -1;
-		regval &= ~(0x3 << 0);
-		regval |= (0x2 << 0);
-		if (mt9m024_write_reg(APT_MT9M024_DIGITAL_BINNING, regval))
+		pr_Dbg("%s: streaming off\n",__func__);
+
+		/* before the copy, context B takes over the operation mode */
+		if (mt9m024_set_params() ||
+		    mt9m024_set_timing(&timing) ||
+		    mt9m024_load_context(context_a) ||
+		    mt9m024_load_context(mt9m024_mode_preview))
 			return -1;
-		pr_Dbg("%s: digital binning on\n",__func__);
-	} else {
-		pr_Dbg("%s: digital binning off\n",__func__);
-	}
+		for (i = 0; i < ARRAY_SIZE(mt9m024_context_b_copy); i++) {
+			if (mt9m024_read_reg(mt9m024_context_b_copy[i][0],
+					     &regval) ||
+			    mt9m024_write_reg(mt9m024_context_b_copy[i][1],
+					      regval))
+				return -1;
+		}
 
-	/* streaming on */
-	if (mt9m024_read_reg(APT_MT9M024_RESET_REGISTER, &regval))
+		/* streaming on */
+		if (mt9m024_update_reg(APT_MT9M024_RESET_REGISTER,
+				       APT_MT9M024_RESET_REGISTER_STREAM,
+				       APT_MT9M024_RESET_REGISTER_STREAM))
+			return -1;
+		pr_Dbg("%s: streaming on\n",__func__);
+		mt9m024_data.contexts_loaded = true;
+		mt9m024_data.context_a = context_a;
+	} else if (mt9m024_set_timing(&timing)) {
 		return -1;
-	regval |= (1<<2);
-	if (mt9m024_write_reg(APT_MT9M024_RESET_REGISTER, regval))
+	}
+
+	/* context switch, takes effect at the next frame start */
+	if (mt9m024_update_reg(APT_MT9M024_DIGITAL_TEST,
+			       APT_MT9M024_DIGITAL_TEST_CONTEXT_B,
+			       mode == mt9m024_mode_preview ?
+			       APT_MT9M024_DIGITAL_TEST_CONTEXT_B : 0))
 		return -1;
-	pr_Dbg("%s: streaming on\n",__func__);
-	pr_info("%s: Mode changed %dx%d at %d fps\n", __func__, width, height,
-		frame_rate);
 
-	mt9m024_data.framerate = frame_rate;
-	mt9m024_data.width = width;
-	mt9m024_data.height = height;
+	if (mt9m024_data.mode != mode || mt9m024_data.framerate != timing.fps)
+		pr_info("%s: Mode changed %dx%d at %d fps\n", __func__,
+			mt9m024_data.context[mode].width,
+			mt9m024_data.context[mode].height, timing.fps);
+
+	mt9m024_data.framerate = timing.fps;
+	mt9m024_data.mode = mode;
+	mt9m024_data.pix.width = mt9m024_data.context[mode].width;
+	mt9m024_data.pix.height = mt9m024_data.context[mode].height;
 
 	return 0;
 }
 
 int mt9m024_config(void)
 {
+	struct mt9m024_timing timing;
 	unsigned short regval;
-	int i;
 
 	pr_Dbg("%s entry\n",__FUNCTION__);
+	mt9m024_trace_start();
+
 	/* Reset HW and SW */
+	mt9m024_shadow_invalidate();
 	if (camera_plat->io_init)
 		camera_plat->io_init();
-	msleep(200);
-	regval = 0x1;
+	if (mt9m024_poll_reg(APT_MT9M024_MODEL_ID_, 0xffff, 0x2400,
+			     APT_MT9M024_READY_TIMEOUT_MS))
+		pr_warning("%s: no answer after hardware reset\n", __func__);
+	regval = APT_MT9M024_RESET_REGISTER_RESET;
 	if (mt9m024_write_reg(APT_MT9M024_RESET_REGISTER, regval))
 		return -1;
-	msleep(200);
+	if (mt9m024_poll_reg(APT_MT9M024_RESET_REGISTER,
+			     APT_MT9M024_RESET_REGISTER_RESET, 0,
+			     APT_MT9M024_READY_TIMEOUT_MS))
+		pr_warning("%s: software reset timed out\n", __func__);
 	regval = 0x10D8;
 	if (mt9m024_write_reg(APT_MT9M024_RESET_REGISTER, regval))
 		return -1;
+	if (mt9m024_poll_reg(APT_MT9M024_FRAME_STATUS,
+			     APT_MT9M024_FRAME_STATUS_STANDBY,
+			     APT_MT9M024_FRAME_STATUS_STANDBY,
+			     APT_MT9M024_READY_TIMEOUT_MS))
+		pr_warning("%s: standby timed out\n", __func__);
+	mt9m024_trace_phase("reset");
 
 	/* A-1000 Hidy and linear sequencer load August 2 2011 */
-	msleep(200);
-	/* enable sequencer ram */
-	regval = 0x8000;
-	if (mt9m024_write_reg(APT_MT9M024_SEQ_CTRL_PORT, regval))
-		return -1;
-	/* load sequencer ram */
-	for (i=0; i<sizeof(MT9M024sequencerReg)/sizeof(unsigned short); i++) {
-		if (mt9m024_write_reg(APT_MT9M024_SEQ_DATA_PORT, MT9M024sequencerReg[i]))
-			return -1;
-	}
-	/* execute sequence */
+	if (mt9m024_load_sequencer())
+		return -1;
+	/*
+	 * execute sequence: sets the address the sequencer starts from at
+	 * the next frame start. The sensor is in standby, nothing runs yet
+	 * and there is nothing to wait for; the frame awaited after the
+	 * presets below shows that the sequencer runs.
+	 */
 	if (mt9m024_write_reg(0x309e, 0x0186))
 		return -1;
-	msleep(200);
+	mt9m024_trace_phase("sequencer");
 
 	/* configuration presets */
 	if (mt9m024_write_reg(APT_MT9M024_RESET_REGISTER, 0x10D8))
@@ -363,19 +1093,20 @@ int mt9m024_config(void)
 	if (mt9m024_write_reg(0x30BA, 0x0008))
 		return -1;
 	/* streaming on */
-	if (mt9m024_read_reg(APT_MT9M024_RESET_REGISTER, &regval))
-		return -1;
-	regval |= (1<<2);
-	if (mt9m024_write_reg(APT_MT9M024_RESET_REGISTER, regval))
+	if (mt9m024_update_reg(APT_MT9M024_RESET_REGISTER,
+			       APT_MT9M024_RESET_REGISTER_STREAM,
+			       APT_MT9M024_RESET_REGISTER_STREAM))
 		return -1;
-	msleep(200);
+	/* let the column retriggering run for one frame */
+	if (mt9m024_wait_frame(APT_MT9M024_READY_TIMEOUT_MS))
+		pr_warning("%s: no frame after presets\n", __func__);
 	/* streaming off */
-	if (mt9m024_read_reg(APT_MT9M024_RESET_REGISTER, &regval))
-		return -1;
-	regval &= ~(1<<2);
-	if (mt9m024_write_reg(APT_MT9M024_RESET_REGISTER, regval))
+	if (mt9m024_update_reg(APT_MT9M024_RESET_REGISTER,
+			       APT_MT9M024_RESET_REGISTER_STREAM, 0))
 		return -1;
+	mt9m024_read_reg(APT_MT9M024_RESET_REGISTER, &regval);
 	pr_Dbg("Reset Register #1 = %x\n", regval);
+	mt9m024_trace_phase("presets");
 	if (mt9m024_write_reg(0x3058, 0x003F))
 		return -1;
 	if (mt9m024_write_reg(0x3012, 0x02A0))
@@ -408,8 +1139,15 @@ int mt9m024_config(void)
 		return -1;
 	if (mt9m024_write_reg(0x30B0, 0x1300))
 		return -1;
-	/* PLL Enabled 27Mhz to 74.25Mhz */
-	if (APTsetPLL(0x2c, 0x2, 0x2, 0x4))
+	/* PLL and timing for the default frame rate */
+	if (mt9m024_solve_timing(&mt9m024_data.context[mt9m024_mode_full],
+				 mt9m024_data.mclk, APT_MT9M024_DEFAULT_FPS,
+				 &timing)) {
+		pr_err("%s: no PLL setting for EXTCLK %u Hz\n", __func__,
+		       mt9m024_data.mclk);
+		return -1;
+	}
+	if (mt9m024_set_timing(&timing))
 		return -1;
 	/* streaming on */
 	if (mt9m024_read_reg(APT_MT9M024_RESET_REGISTER, &regval))
@@ -420,29 +1158,500 @@ int mt9m024_config(void)
 	if (mt9m024_write_reg(APT_MT9M024_RESET_REGISTER, regval))
 		return -1;
 	pr_Dbg("Reset Register #3 = %x\n", regval);
+	mt9m024_trace_phase("pll");
+
+	/* Misc Setup Auto Exposure */
+	if (mt9m024_write_reg(0x3100, 0x1B))
+		return -1;
+	if (mt9m024_write_reg(0x3112, 0x029F))
+		return -1;
+	if (mt9m024_write_reg(0x3114, 0x008C))
+		return -1;
+	if (mt9m024_write_reg(0x3116, 0x02C0))
+		return -1;
+	if (mt9m024_write_reg(0x3118, 0x005B))
+		return -1;
+	if (mt9m024_write_reg(0x3102, 0x0384))
+		return -1;
+	if (mt9m024_write_reg(0x3104, 0x1000))
+		return -1;
+	if (mt9m024_write_reg(0x3126, 0x0080))
+		return -1;
+	if (mt9m024_write_reg(0x311C, 0x03DD))
+		return -1;
+	if (mt9m024_write_reg(0x311E, 0x0003))
+		return -1;
+
+	/* first frame: PLL locked and sensor streaming */
+	if (mt9m024_wait_frame(APT_MT9M024_READY_TIMEOUT_MS))
+		pr_warning("%s: no frame after PLL setup\n", __func__);
+	mt9m024_trace_phase("stream");
+
+	return 0;
+}
+
+/*!
+ * Loads the sequencer and the configuration presets and selects the
+ * parallel interface, test pattern and readout direction. Runs once
+ * from the init work after probe.
+ *
+ * @return  0 on success, -1 on I2C error
+ */
+static int mt9m024_setup(void)
+{
+	u16 regaddr;
+#if 0
+	u16 regval;
+#endif
+
+#if 0
+	/* sw reset */
+	regaddr = APT_MT9M024_RESET_REGISTER;
+	if (mt9m024_read_reg(regaddr, &regval))
+		return -1;
+	// Bit 0 is used to reset the digital logic of the sensor
+	regval |= 0x1;
+#endif
+#if 1
+	/* sequencer ram and configuration presets */
+	if (mt9m024_config()) {
+		pr_err("%s: Loading sequencer failed\n",__func__);
+		return -1;
+	}
+#endif
+
+#if 1
+	/* disable hispi i/f */
+	regaddr = APT_MT9M024_RESET_REGISTER;
+	if (mt9m024_update_reg(regaddr, 1<<12, 1<<12))
+		return -1;
+
+	/* enable parallel i/f */
+	regaddr = APT_MT9M024_RESET_REGISTER;
+	if (mt9m024_update_reg(regaddr, (1<<7)|(1<<6), (1<<7)|(1<<6)))
+		return -1;
+#endif
+
+	/* test pattern, auto exposure, HDR mode and rotation */
+	if (mt9m024_set_params())
+		return -1;
+
+	return 0;
+}
+
+/*!
+ * Keeps the register state reached by mt9m024_setup() as the snapshot
+ * for mt9m024_restore(). Only registers the driver has written are kept,
+ * those only read back still hold their default after a reset.
+ */
+static void mt9m024_snapshot_take(void)
+{
+	memcpy(mt9m024_data.snapshot, mt9m024_data.shadow,
+	       sizeof(mt9m024_data.snapshot));
+	bitmap_copy(mt9m024_data.snapshot_valid, mt9m024_data.shadow_written,
+		    APT_MT9M024_SHADOW_REGS);
+}
+
+/*!
+ * Tells whether the sensor has lost the configuration since the snapshot
+ * was taken, e.g. because its supply was switched off. The reset
+ * register is compared as the bring-up leaves it far from its default.
+ */
+static bool mt9m024_state_lost(void)
+{
+	int slot = mt9m024_shadow_slot(APT_MT9M024_RESET_REGISTER);
+	u16 regval;
+
+	if (mt9m024_read_reg_nocache(APT_MT9M024_RESET_REGISTER, &regval))
+		return true;
+	return ((regval ^ mt9m024_data.snapshot[slot]) &
+		~APT_MT9M024_RESET_REGISTER_STREAM) != 0;
+}
+
+/*!
+ * Returns the snapshot value of a cached register.
+ */
+static u16 mt9m024_snapshot_reg(u16 reg)
+{
+	return mt9m024_data.snapshot[mt9m024_shadow_slot(reg)];
+}
+
+/*!
+ * Tells whether a shadow slot holds one of the PLL registers, which
+ * mt9m024_restore() writes ahead of the other registers.
+ */
+static bool mt9m024_pll_slot(int slot)
+{
+	switch (APT_MT9M024_SHADOW_FIRST + 2 * slot) {
+	case APT_MT9M024_PRE_PLL_CLK_DIV:
+	case APT_MT9M024_VT_SYS_CLK_DIV:
+	case APT_MT9M024_VT_PIX_CLK_DIV:
+	case APT_MT9M024_PLL_MULTIPLIER:
+		return true;
+	}
+	return false;
+}
+
+/*!
+ * Warm bring-up after a power loss. Instead of going through the preset
+ * sequence of mt9m024_config() again, the snapshot is written back in
+ * bursts of consecutive registers. The PLL goes first, while the sensor
+ * is still in standby after the reset, and gets its lock time before the
+ * rest of the configuration is written. The reset register is written
+ * last so that the sensor starts streaming with the complete
+ * configuration. The column retrigger frame of the presets is not
+ * repeated, the first streamed frame retriggers the column correction
+ * anyway.
+ *
+ * @return  0 on success, -1 on I2C error
+ */
+static int mt9m024_restore(void)
+{
+	int reset_slot = mt9m024_shadow_slot(APT_MT9M024_RESET_REGISTER);
+	int model_slot = mt9m024_shadow_slot(APT_MT9M024_MODEL_ID_);
+	struct sensor_i2c_batch *batch = &mt9m024_data.batch;
+	int xfers = 0, regs = 0;
+	int slot, end, n;
+
+	mt9m024_trace_start();
+
+	/* Reset HW and SW, as in mt9m024_config() */
+	mt9m024_shadow_invalidate();
+	if (camera_plat->io_init)
+		camera_plat->io_init();
+	if (mt9m024_poll_reg(APT_MT9M024_MODEL_ID_, 0xffff, 0x2400,
+			     APT_MT9M024_READY_TIMEOUT_MS))
+		pr_warning("%s: no answer after hardware reset\n", __func__);
+	if (mt9m024_write_reg(APT_MT9M024_RESET_REGISTER,
+			      APT_MT9M024_RESET_REGISTER_RESET))
+		return -1;
+	if (mt9m024_poll_reg(APT_MT9M024_RESET_REGISTER,
+			     APT_MT9M024_RESET_REGISTER_RESET, 0,
+			     APT_MT9M024_READY_TIMEOUT_MS))
+		pr_warning("%s: software reset timed out\n", __func__);
+	mt9m024_trace_phase("reset");
+
+	/* the sequencer RAM is not part of the register snapshot */
+	if (mt9m024_load_sequencer())
+		return -1;
+	mt9m024_trace_phase("sequencer");
+
+	/*
+	 * The reset leaves the sensor in standby, as APTsetPLL() expects.
+	 * The snapshot holds all four PLL registers if the bring-up set them.
+	 */
+	if (test_bit(mt9m024_shadow_slot(APT_MT9M024_PLL_MULTIPLIER),
+		     mt9m024_data.snapshot_valid)) {
+		if (APTsetPLL(mt9m024_snapshot_reg(APT_MT9M024_PLL_MULTIPLIER),
+			      mt9m024_snapshot_reg(APT_MT9M024_PRE_PLL_CLK_DIV),
+			      mt9m024_snapshot_reg(APT_MT9M024_VT_SYS_CLK_DIV),
+			      mt9m024_snapshot_reg(APT_MT9M024_VT_PIX_CLK_DIV)))
+			return -1;
+		regs += 4;
+		xfers += 4;
+	}
+	mt9m024_trace_phase("pll");
+
+	/* the other runs go out in a few multi-message transfers */
+	mutex_lock(&mt9m024_data.batch_lock);
+	sensor_i2c_batch_init(batch, mt9m024_data.i2c_client, &mt9m024_prof,
+			      _THIS_IP_);
+	for (slot = 0; slot < APT_MT9M024_SHADOW_REGS; slot = end) {
+		if (!test_bit(slot, mt9m024_data.snapshot_valid) ||
+		    slot == reset_slot || slot == model_slot ||
+		    mt9m024_pll_slot(slot)) {
+			end = slot + 1;
+			continue;
+		}
+		for (end = slot + 1; end < APT_MT9M024_SHADOW_REGS &&
+		     test_bit(end, mt9m024_data.snapshot_valid) &&
+		     end != reset_slot && !mt9m024_pll_slot(end); end++)
+			;
+		for (n = slot; n < end; n += APT_MT9M024_BURST_WORDS) {
+			if (sensor_i2c_batch_write_words(batch,
+					APT_MT9M024_SHADOW_FIRST + 2 * n,
+					&mt9m024_data.snapshot[n],
+					min(end - n, APT_MT9M024_BURST_WORDS),
+					false))
+				goto batch_err;
+		}
+		for (n = slot; n < end; n++)
+			mt9m024_shadow_store(APT_MT9M024_SHADOW_FIRST + 2 * n,
+					     mt9m024_data.snapshot[n], true);
+		regs += end - slot;
+	}
+	if (sensor_i2c_batch_flush(batch))
+		goto batch_err;
+	xfers += batch->transfers;
+	mutex_unlock(&mt9m024_data.batch_lock);
+	mt9m024_trace_phase("replay");
+
+	if (mt9m024_write_reg(APT_MT9M024_RESET_REGISTER,
+			      mt9m024_data.snapshot[reset_slot]))
+		return -1;
+	if (mt9m024_wait_frame(APT_MT9M024_READY_TIMEOUT_MS))
+		pr_warning("%s: no frame after restore\n", __func__);
+	mt9m024_trace_phase("stream");
+
+	pr_info("%s: %d registers in %d transfers\n", __func__, regs, xfers);
+
+	return 0;
+
+batch_err:
+	mutex_unlock(&mt9m024_data.batch_lock);
+	return -1;
+}
+
+/*!
+ * Queues the init work. With mode set, the work also applies the
+ * current mode. Otherwise it only checks that the sensor still holds its
+ * configuration and restores it if not.
+ */
+static void mt9m024_queue_init(struct sensor *sensor, bool mode)
+{
+	mutex_lock(&sensor->init_lock);
+	INIT_COMPLETION(sensor->init_done);
+	sensor->init_pending = true;
+	if (mode)
+		sensor->mode_pending = true;
+	mutex_unlock(&sensor->init_lock);
+	schedule_work(&sensor->init_work);
+}
+
+/*!
+ * Work function for the sensor configuration. Probe queues it to run the
+ * full bring-up, power-up, ioctl_dev_init(), ioctl_apply() and
+ * VIDIOC_S_PARM queue it again through mt9m024_queue_init(). Waiters on
+ * init_done are released only after the last request queued so far has
+ * been handled. The work is the only writer of the sensor registers once
+ * probe has returned.
+ *
+ * @param work  init_work of struct sensor
+ */
+static void mt9m024_init_work(struct work_struct *work)
+{
+	struct sensor *sensor = container_of(work, struct sensor, init_work);
+	struct v4l2_captureparm cap;
+	enum sensor_i2c_phase phase;
+	bool setup, mode;
+	u32 tgt_fps;
+	int ret = 0;
+
+	mutex_lock(&sensor->init_lock);
+	cap = sensor->streamcap;
+	setup = !sensor->configured;
+	mode = sensor->mode_pending;
+	sensor->mode_pending = false;
+	sensor->init_pending = false;
+	mutex_unlock(&sensor->init_lock);
+
+	/* the first run is still part of the bring-up started by probe */
+	phase = sensor_i2c_prof_enter(&mt9m024_prof, setup ?
+			SENSOR_I2C_PHASE_PROBE : SENSOR_I2C_PHASE_DEV_INIT);
+	if (setup) {
+		ret = mt9m024_setup();
+		if (ret)
+			pr_err("%s: Sensor configuration failed\n", __func__);
+		else
+			mt9m024_snapshot_take();
+	} else if (mt9m024_state_lost()) {
+		ret = mt9m024_restore();
+		if (ret)
+			pr_err("%s: Sensor restore failed\n", __func__);
+		/* the mode registers are not in the snapshot */
+		sensor->contexts_loaded = false;
+		mode = true;
+	}
+
+	if (!ret && mode) {
+		/* Default camera frame rate is set in probe */
+		tgt_fps = cap.timeperframe.denominator /
+			  cap.timeperframe.numerator;
+		ret = mt9m024_init_mode(tgt_fps, cap.capturemode);
+	}
+	sensor_i2c_prof_leave(&mt9m024_prof, phase);
+
+	mutex_lock(&sensor->init_lock);
+	if (setup && !ret)
+		sensor->configured = true;
+	sensor->init_ret = ret;
+	if (!sensor->init_pending)
+		complete_all(&sensor->init_done);
+	mutex_unlock(&sensor->init_lock);
+}
+
+/*!
+ * Waits for the init work to finish.
+ *
+ * @return  result of the last configuration run
+ */
+static int mt9m024_wait_init(struct sensor *sensor)
+{
+	wait_for_completion(&sensor->init_done);
+	return sensor->init_ret;
+}
+
+/* --------------------------- sysfs attributes --------------------------- */
+
+static ssize_t show_bringup_trace(struct device *dev,
+				  struct device_attribute *attr, char *buf)
+{
+	ssize_t len = 0;
+	s64 total = 0;
+	int i;
+
+	for (i = 0; i < mt9m024_data.trace_len; i++) {
+		len += sprintf(buf + len, "%-10s %lld us\n",
+			       mt9m024_data.trace[i].name,
+			       mt9m024_data.trace[i].us);
+		total += mt9m024_data.trace[i].us;
+	}
+	len += sprintf(buf + len, "%-10s %lld us\n", "total", total);
+
+	return len;
+}
+static DEVICE_ATTR(bringup_trace, S_IRUGO, show_bringup_trace, NULL);
+
+static ssize_t show_i2c_avoided(struct device *dev,
+				struct device_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%lu\n", mt9m024_data.i2c_avoided);
+}
+static DEVICE_ATTR(i2c_avoided, S_IRUGO, show_i2c_avoided, NULL);
+
+/* ---------------------------- mode controls ----------------------------- */
+
+/*!
+ * Fills in the mode parameters given at module load time.
+ */
+static void mt9m024_params_default(struct mt9m024_params *p)
+{
+	p->test_pattern = testpattern;
+	p->auto_exposure = !!autoexposure;
+	p->hdr = !!hdrmode;
+	p->rotate = !!rotate;
+	p->binning = !!binning;
+	p->width = sensorwidth;
+	p->height = sensorheight;
+	p->data_width = datawidth;
+	p->companding = !!companding;
+}
+
+/*!
+ * Mode controls, sorted by id. The defaults come from the module
+ * parameters, see ioctl_queryctrl().
+ */
+static const struct v4l2_queryctrl mt9m024_qctrl[] = {
+	{
+		.id = V4L2_CID_MT9M024_TEST_PATTERN,
+		.type = V4L2_CTRL_TYPE_INTEGER,
+		.name = "Test Pattern",
+		.minimum = 0,
+		.maximum = 4,
+		.step = 1,
+	}, {
+		.id = V4L2_CID_MT9M024_HDR,
+		.type = V4L2_CTRL_TYPE_BOOLEAN,
+		.name = "HDR Mode",
+		.minimum = 0,
+		.maximum = 1,
+		.step = 1,
+	}, {
+		.id = V4L2_CID_MT9M024_ROTATE,
+		.type = V4L2_CTRL_TYPE_BOOLEAN,
+		.name = "Rotate 180",
+		.minimum = 0,
+		.maximum = 1,
+		.step = 1,
+	}, {
+		.id = V4L2_CID_MT9M024_BINNING,
+		.type = V4L2_CTRL_TYPE_BOOLEAN,
+		.name = "Binning",
+		.minimum = 0,
+		.maximum = 1,
+		.step = 1,
+	}, {
+		.id = V4L2_CID_MT9M024_SENSOR_WIDTH,
+		.type = V4L2_CTRL_TYPE_INTEGER,
+		.name = "Sensor Width",
+		.minimum = APT_MT9M024_MIN_X_RES,
+		.maximum = APT_MT9M024_MAX_X_RES,
+		.step = APT_MT9M024_X_RES_STEP,
+	}, {
+		.id = V4L2_CID_MT9M024_SENSOR_HEIGHT,
+		.type = V4L2_CTRL_TYPE_INTEGER,
+		.name = "Sensor Height",
+		.minimum = APT_MT9M024_MIN_Y_RES,
+		.maximum = APT_MT9M024_MAX_Y_RES,
+		.step = APT_MT9M024_Y_RES_STEP,
+	}, {
+		.id = V4L2_CID_MT9M024_DATA_WIDTH,
+		.type = V4L2_CTRL_TYPE_INTEGER,
+		.name = "Data Width",
+		.minimum = 8,
+		.maximum = 12,
+		.step = 4,
+	}, {
+		.id = V4L2_CID_MT9M024_COMPANDING,
+		.type = V4L2_CTRL_TYPE_BOOLEAN,
+		.name = "HDR Companding",
+		.minimum = 0,
+		.maximum = 1,
+		.step = 1,
+	}, {
+		.id = V4L2_CID_EXPOSURE_AUTO,
+		.type = V4L2_CTRL_TYPE_MENU,
+		.name = "Auto Exposure",
+		.minimum = V4L2_EXPOSURE_AUTO,
+		.maximum = V4L2_EXPOSURE_MANUAL,
+		.step = 1,
+	},
+};
 
-	/* Misc Setup Auto Exposure */
-	if (mt9m024_write_reg(0x3100, 0x1B))
-		return -1;
-	if (mt9m024_write_reg(0x3112, 0x029F))
-		return -1;
-	if (mt9m024_write_reg(0x3114, 0x008C))
-		return -1;
-	if (mt9m024_write_reg(0x3116, 0x02C0))
-		return -1;
-	if (mt9m024_write_reg(0x3118, 0x005B))
-		return -1;
-	if (mt9m024_write_reg(0x3102, 0x0384))
-		return -1;
-	if (mt9m024_write_reg(0x3104, 0x1000))
-		return -1;
-	if (mt9m024_write_reg(0x3126, 0x0080))
-		return -1;
-	if (mt9m024_write_reg(0x311C, 0x03DD))
-		return -1;
-	if (mt9m024_write_reg(0x311E, 0x0003))
-		return -1;
-	return 0;
+/*!
+ * Returns the field of a mode control, or NULL for other controls.
+ */
+static int *mt9m024_param(struct mt9m024_params *p, u32 id)
+{
+	switch (id) {
+	case V4L2_CID_MT9M024_TEST_PATTERN:
+		return &p->test_pattern;
+	case V4L2_CID_MT9M024_HDR:
+		return &p->hdr;
+	case V4L2_CID_MT9M024_ROTATE:
+		return &p->rotate;
+	case V4L2_CID_MT9M024_BINNING:
+		return &p->binning;
+	case V4L2_CID_MT9M024_SENSOR_WIDTH:
+		return &p->width;
+	case V4L2_CID_MT9M024_SENSOR_HEIGHT:
+		return &p->height;
+	case V4L2_CID_MT9M024_DATA_WIDTH:
+		return &p->data_width;
+	case V4L2_CID_MT9M024_COMPANDING:
+		return &p->companding;
+	case V4L2_CID_EXPOSURE_AUTO:
+		return &p->auto_exposure;
+	}
+	return NULL;
+}
+
+/*!
+ * Converts between the auto exposure flag and the V4L2_CID_EXPOSURE_AUTO
+ * menu, all other controls hold their parameter unchanged.
+ */
+static int mt9m024_param_to_ctrl(u32 id, int val)
+{
+	if (id == V4L2_CID_EXPOSURE_AUTO)
+		return val ? V4L2_EXPOSURE_AUTO : V4L2_EXPOSURE_MANUAL;
+	return val;
+}
+
+static int mt9m024_ctrl_to_param(u32 id, int val)
+{
+	if (id == V4L2_CID_EXPOSURE_AUTO)
+		return val == V4L2_EXPOSURE_AUTO;
+	return val;
 }
 
 /* --------------- IOCTL functions from v4l2_int_ioctl_desc --------------- */
@@ -457,14 +1666,14 @@ static int ioctl_g_ifparm(struct v4l2_int_device *s, struct v4l2_ifparm *p)
 	}
 
 	memset(p, 0, sizeof(*p));
-	p->u.bt656.clock_curr = APT_MT9M024_CLOCK;
+	p->u.bt656.clock_curr = mt9m024_data.mclk;
 	p->if_type = V4L2_IF_TYPE_BT656;
-	if (datawidth == 12)
+	if (mt9m024_data.params.data_width == 12)
 		p->u.bt656.mode = V4L2_IF_TYPE_BT656_MODE_NOBT_12BIT;
 	else
 		p->u.bt656.mode = V4L2_IF_TYPE_BT656_MODE_NOBT_8BIT;
-	p->u.bt656.clock_min = us_PllLutMin*1000000;
-	p->u.bt656.clock_max = us_PllLutMax*1000000;
+	p->u.bt656.clock_min = MT9M024_PLL_EXTCLK_MIN;
+	p->u.bt656.clock_max = MT9M024_PLL_EXTCLK_MAX;
 	p->u.bt656.latch_clk_inv = 0;
 	p->u.bt656.nobt_vs_inv = 0;
 	p->u.bt656.nobt_hs_inv = 0;
@@ -502,6 +1711,10 @@ static int ioctl_s_power(struct v4l2_int_device *s, int on)
 	}
 #endif
 
+	if (on && !sensor->on && sensor->configured)
+		/* the supply may have been switched off in the meantime */
+		mt9m024_queue_init(sensor, false);
+
 	sensor->on = on;
 
 	pr_Dbg("%s exit\n",__FUNCTION__);
@@ -556,24 +1769,23 @@ static int ioctl_g_parm(struct v4l2_int_device *s, struct v4l2_streamparm *a)
 	return ret;
 }
 
-/*!
- * ioctl_s_parm - V4L2 sensor interface handler for VIDIOC_S_PARM ioctl
- * @s: pointer to standard V4L2 device structure
- * @a: pointer to standard V4L2 VIDIOC_S_PARM ioctl structure
- *
- * Configures the sensor to use the input parameters, if possible.  If
- * not possible, reverts to the old parameters and returns the
- * appropriate error code.
- */
-static int ioctl_s_parm(struct v4l2_int_device *s, struct v4l2_streamparm *a)
+/*! VIDIOC_S_PARM, see ioctl_s_parm() */
+static int mt9m024_s_parm(struct v4l2_int_device *s, struct v4l2_streamparm *a)
 {
 	struct sensor *sensor = s->priv;
 	struct v4l2_fract *timeperframe = &a->parm.capture.timeperframe;
+	u32 new_mode = a->parm.capture.capturemode;
 	u32 tgt_fps;	/* target frames per secound */
+	struct mt9m024_timing timing;
+	struct v4l2_captureparm old;
 	int ret = 0;
 
 	pr_Dbg("%s entry\n",__FUNCTION__);
 
+	ret = mt9m024_wait_init(sensor);
+	if (ret)
+		return ret;
+
 	/* Make sure power on */
 	if (camera_plat->pwdn)
 		camera_plat->pwdn(0);
@@ -581,6 +1793,13 @@ static int ioctl_s_parm(struct v4l2_int_device *s, struct v4l2_streamparm *a)
 	switch (a->type) {
 	/* This is the only case currently handled. */
 	case V4L2_BUF_TYPE_VIDEO_CAPTURE:
+		if (new_mode > mt9m024_mode_MAX) {
+			pr_err("%s: capture mode %d not supported\n",
+			       __func__, new_mode);
+			ret = -EINVAL;
+			break;
+		}
+
 		/* Check that the new frame rate is allowed. */
 		if ((timeperframe->numerator == 0) ||
 		    (timeperframe->denominator == 0)) {
@@ -591,25 +1810,34 @@ static int ioctl_s_parm(struct v4l2_int_device *s, struct v4l2_streamparm *a)
 		tgt_fps = timeperframe->denominator /
 			  timeperframe->numerator;
 
-		if (tgt_fps > APT_MT9M024_MAX_FPS) {
-			timeperframe->denominator = APT_MT9M024_MAX_FPS;
-			timeperframe->numerator = 1;
-		} else if (tgt_fps < APT_MT9M024_MIN_FPS) {
-			timeperframe->denominator = APT_MT9M024_MIN_FPS;
+		/* the reachable rates depend on the window of the mode */
+		ret = mt9m024_solve_timing(&sensor->context[new_mode],
+					   sensor->mclk, tgt_fps, &timing);
+		if (ret)
+			break;
+		if (timing.fps != tgt_fps) {
+			timeperframe->denominator = timing.fps;
 			timeperframe->numerator = 1;
 		}
 
-		/* Actual frame rate we use */
-		tgt_fps = timeperframe->denominator /
-			  timeperframe->numerator;
-
+		/*
+		 * The mode is programmed by the init work, which owns the
+		 * sensor registers, so that a restore or ioctl_apply() queued
+		 * meanwhile does not run into the middle of it.
+		 */
+		mutex_lock(&sensor->init_lock);
+		old = sensor->streamcap;
 		sensor->streamcap.timeperframe = *timeperframe;
-		sensor->streamcap.capturemode =
-				(u32)a->parm.capture.capturemode;
-
-		ret = mt9m024_init_mode(tgt_fps,
-					sensor->pix.width,
-					sensor->pix.height);
+		sensor->streamcap.capturemode = new_mode;
+		mutex_unlock(&sensor->init_lock);
+
+		mt9m024_queue_init(sensor, true);
+		ret = mt9m024_wait_init(sensor);
+		if (ret) {
+			mutex_lock(&sensor->init_lock);
+			sensor->streamcap = old;
+			mutex_unlock(&sensor->init_lock);
+		}
 		break;
 
 	/* These are all the possible cases. */
@@ -636,6 +1864,26 @@ static int ioctl_s_parm(struct v4l2_int_device *s, struct v4l2_streamparm *a)
 	return ret;
 }
 
+/*!
+ * ioctl_s_parm - V4L2 sensor interface handler for VIDIOC_S_PARM ioctl
+ * @s: pointer to standard V4L2 device structure
+ * @a: pointer to standard V4L2 VIDIOC_S_PARM ioctl structure
+ *
+ * Configures the sensor to use the input parameters, if possible.  If
+ * not possible, reverts to the old parameters and returns the
+ * appropriate error code.
+ */
+static int ioctl_s_parm(struct v4l2_int_device *s, struct v4l2_streamparm *a)
+{
+	enum sensor_i2c_phase phase;
+	int ret;
+
+	phase = sensor_i2c_prof_enter(&mt9m024_prof, SENSOR_I2C_PHASE_S_PARM);
+	ret = mt9m024_s_parm(s, a);
+	sensor_i2c_prof_leave(&mt9m024_prof, phase);
+	return ret;
+}
+
 /*!
  * ioctl_g_fmt_cap - V4L2 sensor interface handler for ioctl_g_fmt_cap
  * @s: pointer to standard V4L2 device structure
@@ -657,6 +1905,100 @@ static int ioctl_g_fmt_cap(struct v4l2_int_device *s, struct v4l2_format *f)
 	return 0;
 }
 
+/*!
+ * Returns the data width for a capture pixel format, or 0 if the format
+ * does not select one.
+ */
+static int mt9m024_fmt_data_width(u32 pixelformat)
+{
+	switch (pixelformat) {
+	case V4L2_PIX_FMT_GREY:
+	case IPU_PIX_FMT_GENERIC:
+		return 8;
+	case V4L2_PIX_FMT_Y16:
+	case IPU_PIX_FMT_GENERIC_16:
+	case IPU_PIX_FMT_GENERIC_12P:
+		return 12;
+	}
+	return 0;
+}
+
+/*!
+ * ioctl_try_fmt_cap - V4L2 sensor interface handler for VIDIOC_TRY_FMT
+ * @s: pointer to standard V4L2 device structure
+ * @f: pointer to standard V4L2 v4l2_format structure
+ *
+ * Returns the sensor format that a capture in the pixel format of f
+ * would use: 8 bit for V4L2_PIX_FMT_GREY, 12 bit for V4L2_PIX_FMT_Y16
+ * and the packed IPU_PIX_FMT_GENERIC_12P.
+ * Other formats keep the current data width.
+ */
+static int ioctl_try_fmt_cap(struct v4l2_int_device *s, struct v4l2_format *f)
+{
+	struct sensor *sensor = s->priv;
+	int width = mt9m024_fmt_data_width(f->fmt.pix.pixelformat);
+
+	if (!width)
+		width = sensor->next.data_width;
+
+	f->fmt.pix = sensor->pix;
+	f->fmt.pix.pixelformat = width == 12 ? IPU_PIX_FMT_GENERIC_16 :
+					       IPU_PIX_FMT_GENERIC;
+	return 0;
+}
+
+/*!
+ * ioctl_s_fmt_cap - V4L2 sensor interface handler for VIDIOC_S_FMT
+ * @s: pointer to standard V4L2 device structure
+ * @f: pointer to standard V4L2 v4l2_format structure
+ *
+ * Selects the data width for the pixel format of f as ioctl_try_fmt_cap()
+ * does. Like the Data Width control, it takes effect with ioctl_apply().
+ */
+static int ioctl_s_fmt_cap(struct v4l2_int_device *s, struct v4l2_format *f)
+{
+	struct sensor *sensor = s->priv;
+	int width = mt9m024_fmt_data_width(f->fmt.pix.pixelformat);
+
+	if (width) {
+		mutex_lock(&sensor->init_lock);
+		sensor->next.data_width = width;
+		mutex_unlock(&sensor->init_lock);
+	}
+	return ioctl_try_fmt_cap(s, f);
+}
+
+/*!
+ * ioctl_queryctrl - V4L2 sensor interface handler for VIDIOC_QUERYCTRL ioctl
+ * @s: pointer to standard V4L2 device structure
+ * @qc: standard V4L2 VIDIOC_QUERYCTRL ioctl structure
+ *
+ * If the requested control is one of the mode controls, returns its
+ * description with the module parameter as default value. Supports
+ * V4L2_CTRL_FLAG_NEXT_CTRL. Otherwise returns -EINVAL.
+ */
+static int ioctl_queryctrl(struct v4l2_int_device *s,
+			   struct v4l2_queryctrl *qc)
+{
+	struct mt9m024_params defaults;
+	u32 id = qc->id & ~V4L2_CTRL_FLAG_NEXT_CTRL;
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(mt9m024_qctrl); i++) {
+		if (qc->id & V4L2_CTRL_FLAG_NEXT_CTRL ?
+		    mt9m024_qctrl[i].id > id : mt9m024_qctrl[i].id == id)
+			break;
+	}
+	if (i == ARRAY_SIZE(mt9m024_qctrl))
+		return -EINVAL;
+
+	*qc = mt9m024_qctrl[i];
+	mt9m024_params_default(&defaults);
+	qc->default_value = mt9m024_param_to_ctrl(qc->id,
+			*mt9m024_param(&defaults, qc->id));
+	return 0;
+}
+
 /*!
  * ioctl_g_ctrl - V4L2 sensor interface handler for VIDIOC_G_CTRL ioctl
  * @s: pointer to standard V4L2 device structure
@@ -668,10 +2010,19 @@ static int ioctl_g_fmt_cap(struct v4l2_int_device *s, struct v4l2_format *f)
  */
 static int ioctl_g_ctrl(struct v4l2_int_device *s, struct v4l2_control *vc)
 {
+	struct sensor *sensor = s->priv;
+	int *param;
 	int ret = 0;
 
 	pr_Dbg("%s entry\n",__FUNCTION__);
 
+	/* mode controls report the value for the next stream start */
+	param = mt9m024_param(&sensor->next, vc->id);
+	if (param) {
+		vc->value = mt9m024_param_to_ctrl(vc->id, *param);
+		return 0;
+	}
+
 	switch (vc->id) {
 	case V4L2_CID_BRIGHTNESS:
 		vc->value = mt9m024_data.brightness;
@@ -703,21 +2054,26 @@ static int ioctl_g_ctrl(struct v4l2_int_device *s, struct v4l2_control *vc)
 	return ret;
 }
 
-/*!
- * ioctl_s_ctrl - V4L2 sensor interface handler for VIDIOC_S_CTRL ioctl
- * @s: pointer to standard V4L2 device structure
- * @vc: standard V4L2 VIDIOC_S_CTRL ioctl structure
- *
- * If the requested control is supported, sets the control's current
- * value in HW (and updates the video_control[] array).  Otherwise,
- * returns -EINVAL if the control is not supported.
- */
-static int ioctl_s_ctrl(struct v4l2_int_device *s, struct v4l2_control *vc)
+static int mt9m024_s_ctrl(struct v4l2_int_device *s, struct v4l2_control *vc)
 {
+	struct sensor *sensor = s->priv;
+	struct v4l2_queryctrl qc = { .id = vc->id };
 	int retval = 0;
 
 	pr_Dbg("%s entry\n",__FUNCTION__);
 
+	/* mode controls are kept until ioctl_apply() */
+	if (!ioctl_queryctrl(s, &qc)) {
+		if (vc->value < qc.minimum || vc->value > qc.maximum ||
+		    (vc->value - qc.minimum) % qc.step)
+			return -ERANGE;
+		mutex_lock(&sensor->init_lock);
+		*mt9m024_param(&sensor->next, vc->id) =
+			mt9m024_ctrl_to_param(vc->id, vc->value);
+		mutex_unlock(&sensor->init_lock);
+		return 0;
+	}
+
 	switch (vc->id) {
 	case V4L2_CID_BRIGHTNESS:
 		break;
@@ -757,28 +2113,94 @@ static int ioctl_s_ctrl(struct v4l2_int_device *s, struct v4l2_control *vc)
 	return retval;
 }
 
+/*!
+ * ioctl_s_ctrl - V4L2 sensor interface handler for VIDIOC_S_CTRL ioctl
+ * @s: pointer to standard V4L2 device structure
+ * @vc: standard V4L2 VIDIOC_S_CTRL ioctl structure
+ *
+ * If the requested control is supported, sets the control's current
+ * value in HW (and updates the video_control[] array).  Otherwise,
+ * returns -EINVAL if the control is not supported.
+ */
+static int ioctl_s_ctrl(struct v4l2_int_device *s, struct v4l2_control *vc)
+{
+	enum sensor_i2c_phase phase;
+	int ret;
+
+	phase = sensor_i2c_prof_enter(&mt9m024_prof, SENSOR_I2C_PHASE_S_CTRL);
+	ret = mt9m024_s_ctrl(s, vc);
+	sensor_i2c_prof_leave(&mt9m024_prof, phase);
+	return ret;
+}
+
 /*!
  * ioctl_enum_framesizes - V4L2 sensor interface handler for
  *			   VIDIOC_ENUM_FRAMESIZES ioctl
  * @s: pointer to standard V4L2 device structure
  * @fsize: standard V4L2 VIDIOC_ENUM_FRAMESIZES ioctl structure
  *
- * Return 0 if successful, otherwise -EINVAL.
+ * The index is the capture mode that gives the size, see enum
+ * mt9m024_mode. Return 0 if successful, otherwise -EINVAL.
  */
 static int ioctl_enum_framesizes(struct v4l2_int_device *s,
 				 struct v4l2_frmsizeenum *fsize)
 {
-	if (fsize->index > 0)
+	if (fsize->index > mt9m024_mode_MAX)
 		return -EINVAL;
 
 	pr_Dbg("%s entry\n",__FUNCTION__);
 	fsize->pixel_format = mt9m024_data.pix.pixelformat;
-	fsize->discrete.width = sensorwidth;
-	fsize->discrete.height = sensorheight;
+	fsize->type = V4L2_FRMSIZE_TYPE_DISCRETE;
+	fsize->discrete.width = mt9m024_data.context[fsize->index].width;
+	fsize->discrete.height = mt9m024_data.context[fsize->index].height;
 	pr_Dbg("%s exit\n",__FUNCTION__);
 	return 0;
 }
 
+/*!
+ * ioctl_enum_frameintervals - V4L2 sensor interface handler for
+ *			       VIDIOC_ENUM_FRAMEINTERVALS ioctl
+ * @s: pointer to standard V4L2 device structure
+ * @fival: standard V4L2 VIDIOC_ENUM_FRAMEINTERVALS ioctl structure
+ *
+ * Any frame rate from APT_MT9M024_MIN_FPS up to the highest one of the
+ * mode with the size of fival can be set. If two modes give the size,
+ * the faster one is reported.
+ *
+ * Return 0 if successful, otherwise -EINVAL.
+ */
+static int ioctl_enum_frameintervals(struct v4l2_int_device *s,
+				     struct v4l2_frmivalenum *fival)
+{
+	struct sensor *sensor = s->priv;
+	struct mt9m024_timing timing;
+	int mode, max_fps = 0;
+
+	if (fival->index > 0)
+		return -EINVAL;
+
+	for (mode = mt9m024_mode_MIN; mode <= mt9m024_mode_MAX; mode++) {
+		if (sensor->context[mode].width != fival->width ||
+		    sensor->context[mode].height != fival->height)
+			continue;
+		if (mt9m024_solve_timing(&sensor->context[mode], sensor->mclk,
+					 APT_MT9M024_MIN_FPS, &timing))
+			continue;
+		max_fps = max(max_fps, timing.max_fps);
+	}
+	if (!max_fps)
+		return -EINVAL;
+
+	fival->type = V4L2_FRMIVAL_TYPE_CONTINUOUS;
+	fival->stepwise.min.numerator = 1;
+	fival->stepwise.min.denominator = max_fps;
+	fival->stepwise.max.numerator = 1;
+	fival->stepwise.max.denominator = APT_MT9M024_MIN_FPS;
+	fival->stepwise.step.numerator = 1;
+	fival->stepwise.step.denominator = 1;
+	return 0;
+}
+
 /*!
  * ioctl_g_chip_ident - V4L2 sensor interface handler for
  *			VIDIOC_DBG_G_CHIP_IDENT ioctl
@@ -833,27 +2255,65 @@ static int ioctl_enum_fmt_cap(struct v4l2_int_device *s,
 static int ioctl_dev_init(struct v4l2_int_device *s)
 {
 	struct sensor *sensor = s->priv;
-	u32 tgt_fps;	/* target frames per second */
-	int retval;
 
 	pr_Dbg("%s entry\n",__FUNCTION__);
 
 	mt9m024_data.on = true;
-	mt9m024_data.framerate = -1;
-	mt9m024_data.width = -1;
-	mt9m024_data.height = -1;
+	mt9m024_data.contexts_loaded = false;
 
-	/* Default camera frame rate is set in probe */
-	tgt_fps = sensor->streamcap.timeperframe.denominator /
-		  sensor->streamcap.timeperframe.numerator;
-
-	retval = mt9m024_init_mode(tgt_fps,
-				   sensor->pix.width,
-				   sensor->pix.height);
+	/* the mode is set by the init work, STREAMON waits for it */
+	mt9m024_queue_init(sensor, true);
 
 	pr_Dbg("%s exit\n",__FUNCTION__);
 
-	return retval;
+	return 0;
+}
+
+/*!
+ * ioctl_wait_init - V4L2 sensor interface handler for vidioc_int_wait_init_num
+ * @s: pointer to standard V4L2 device structure
+ *
+ * Blocks until the asynchronous sensor configuration has finished.
+ */
+static int ioctl_wait_init(struct v4l2_int_device *s)
+{
+	return mt9m024_wait_init(s->priv);
+}
+
+/*!
+ * ioctl_apply - V4L2 sensor interface handler for vidioc_int_apply_num
+ * @s: pointer to standard V4L2 device structure
+ *
+ * Starts using the mode controls set since the last call. The output
+ * format changes right away, the sensor is reprogrammed by the init
+ * work, which STREAMON waits for.
+ *
+ * Return 1 if the output format changed, 0 otherwise.
+ */
+static int ioctl_apply(struct v4l2_int_device *s)
+{
+	struct sensor *sensor = s->priv;
+	struct v4l2_pix_format pix = sensor->pix;
+	bool changed;
+
+	/* the init work must not see the parameters change under it */
+	mt9m024_wait_init(sensor);
+
+	mutex_lock(&sensor->init_lock);
+	changed = memcmp(&sensor->params, &sensor->next,
+			 sizeof(sensor->params)) != 0;
+	sensor->params = sensor->next;
+	mutex_unlock(&sensor->init_lock);
+	if (!changed)
+		return 0;
+
+	mt9m024_init_format();
+	sensor->contexts_loaded = false;
+	mt9m024_queue_init(sensor, true);
+
+	return pix.width != sensor->pix.width ||
+	       pix.height != sensor->pix.height ||
+	       pix.pixelformat != sensor->pix.pixelformat;
 }
 
 /*!
@@ -867,6 +2327,14 @@ static int ioctl_dev_exit(struct v4l2_int_device *s)
 	return 0;
 }
 
+/*!
+ * Private slave ioctl, numbered as in mxc_v4l2_capture.c
+ */
+enum {
+	vidioc_int_wait_init_num = vidioc_int_priv_start_num,
+	vidioc_int_apply_num,
+};
+
 /*!
  * This structure defines all the ioctls for this module and links them to the
  * enumeration.
@@ -882,19 +2350,23 @@ static struct v4l2_int_ioctl_desc mt9m024_ioctl_desc[] = {
 	{vidioc_int_init_num, (v4l2_int_ioctl_func *)ioctl_init},
 	{vidioc_int_enum_fmt_cap_num,
 				(v4l2_int_ioctl_func *)ioctl_enum_fmt_cap},
-/*	{vidioc_int_try_fmt_cap_num,
-				(v4l2_int_ioctl_func *)ioctl_try_fmt_cap}, */
+	{vidioc_int_try_fmt_cap_num,
+				(v4l2_int_ioctl_func *)ioctl_try_fmt_cap},
 	{vidioc_int_g_fmt_cap_num, (v4l2_int_ioctl_func *)ioctl_g_fmt_cap},
-/*	{vidioc_int_s_fmt_cap_num, (v4l2_int_ioctl_func *)ioctl_s_fmt_cap}, */
+	{vidioc_int_s_fmt_cap_num, (v4l2_int_ioctl_func *)ioctl_s_fmt_cap},
 	{vidioc_int_g_parm_num, (v4l2_int_ioctl_func *)ioctl_g_parm},
 	{vidioc_int_s_parm_num, (v4l2_int_ioctl_func *)ioctl_s_parm},
-/*	{vidioc_int_queryctrl_num, (v4l2_int_ioctl_func *)ioctl_queryctrl}, */
+	{vidioc_int_queryctrl_num, (v4l2_int_ioctl_func *)ioctl_queryctrl},
 	{vidioc_int_g_ctrl_num, (v4l2_int_ioctl_func *)ioctl_g_ctrl},
 	{vidioc_int_s_ctrl_num, (v4l2_int_ioctl_func *)ioctl_s_ctrl},
 	{vidioc_int_enum_framesizes_num,
 				(v4l2_int_ioctl_func *)ioctl_enum_framesizes},
+	{vidioc_int_enum_frameintervals_num,
+				(v4l2_int_ioctl_func *)ioctl_enum_frameintervals},
 	{vidioc_int_g_chip_ident_num,
 				(v4l2_int_ioctl_func *)ioctl_g_chip_ident},
+	{vidioc_int_wait_init_num, ioctl_wait_init},
+	{vidioc_int_apply_num, ioctl_apply},
 };
 
 static struct v4l2_int_slave mt9m024_slave = {
@@ -922,22 +2394,25 @@ static int mt9m024_probe(struct i2c_client *client,
 {
 	int retval;
 	struct fsl_mxc_camera_platform_data *plat_data = client->dev.platform_data;
+	enum sensor_i2c_phase phase;
 	u16 regaddr;
 	u16 regval;
+	s32 ret;
 
 	/* Set initial values for the sensor struct. */
 	memset(&mt9m024_data, 0, sizeof(mt9m024_data));
 	mt9m024_data.csi = plat_data->csi;
+	mt9m024_data.mclk = plat_data->mclk ? plat_data->mclk :
+		APT_MT9M024_CLOCK;
+	INIT_WORK(&mt9m024_data.init_work, mt9m024_init_work);
+	init_completion(&mt9m024_data.init_done);
+	mutex_init(&mt9m024_data.init_lock);
+	mutex_init(&mt9m024_data.batch_lock);
 
 	mt9m024_data.i2c_client = client;
-	if (datawidth == 12)
-		/* because of the CSI's color extension to 16 bits */
-		mt9m024_data.pix.pixelformat = IPU_PIX_FMT_GENERIC_16;
-	else
-		mt9m024_data.pix.pixelformat = IPU_PIX_FMT_GENERIC;
-
-	mt9m024_data.pix.width = sensorwidth;
-	mt9m024_data.pix.height = sensorheight;
+	mt9m024_params_default(&mt9m024_data.params);
+	mt9m024_data.next = mt9m024_data.params;
+	mt9m024_init_format();
 	mt9m024_data.streamcap.capability = V4L2_CAP_TIMEPERFRAME;
 	mt9m024_data.streamcap.capturemode = 0;
 	mt9m024_data.streamcap.timeperframe.denominator =
@@ -953,7 +2428,10 @@ static int mt9m024_probe(struct i2c_client *client,
 
 	/* read model id */
 	regaddr = APT_MT9M024_MODEL_ID_;
-	if (mt9m024_read_reg(regaddr, &regval))
+	phase = sensor_i2c_prof_enter(&mt9m024_prof, SENSOR_I2C_PHASE_PROBE);
+	ret = mt9m024_read_reg(regaddr, &regval);
+	sensor_i2c_prof_leave(&mt9m024_prof, phase);
+	if (ret)
 		return -1;
 	if (regval != 0x2400) {
 		pr_err("%s: Camera not found\n", __func__);
@@ -962,99 +2440,25 @@ static int mt9m024_probe(struct i2c_client *client,
 		pr_Dbg("%s: Camera found!\n", __func__);
 	}
 
-#if 0
-	/* sw reset */
-	regaddr = APT_MT9M024_RESET_REGISTER;
-	if (mt9m024_read_reg(regaddr, &regval))
-		return -1;
-	// Bit 0 is used to reset the digital logic of the sensor
-	regval |= 0x1;
-#endif
-#if 1
-	/* sequencer ram and configuration presets */
-	if (mt9m024_config()) {
-		pr_err("%s: Loading sequencer failed\n",__func__);
-		return -1;
-	}
-#endif
-
-#if 1
-	/* disable hispi i/f */
-	regaddr = APT_MT9M024_RESET_REGISTER;
-	if (mt9m024_read_reg(regaddr, &regval))
-		return -1;
-	regval |= (1<<12);
-	if (mt9m024_write_reg(regaddr, regval))
-		return -1;
-
-	/* enable parallel i/f */
-	regaddr = APT_MT9M024_RESET_REGISTER;
-	if (mt9m024_read_reg(regaddr, &regval))
-		return -1;
-	regval |= ((1<<7)|(1<<6));
-	if (mt9m024_write_reg(regaddr, regval))
-		return -1;
-#endif
-
-	/* enable test pattern? */
-	regaddr = APT_MT9M024_TEST_PATTERN_MODE_;
-	switch (testpattern) {
-	case 1:
-	case 2:
-	case 3:
-		regval = testpattern;
-		pr_info("%s: Enabling test pattern %d\n",__func__,testpattern);
-		break;
-	case 4:
-		regval = 256;
-		pr_info("%s: Enabling test pattern %d\n",__func__,testpattern);
-		break;
-	default:
-		regval = 0;
-		break;
-	}
-	if (mt9m024_write_reg(regaddr, regval))
-		return -1;
-
-#if 0
-	/* auto exposure and HDR mode */
-	if (autoexposure) {
-		pr_info("%s: Enabling auto exposure\n",__func__);
-		if (mt9m024_write_reg(APT_MT9M024_AE_CTRL_REG, 0x1b))
-			return -1;
-		if (hdrmode) {
-			pr_info("%s: Enabling HDR mode\n",__func__);
-			if (mt9m024_write_reg(APT_MT9M024_OPERATION_MODE_CTRL,
-						0x28))
-				return -1;
-		}
-	} else {
-		regaddr = APT_MT9M024_AE_CTRL_REG;
-		pr_info("%s: Auto exposure disabled\n",__func__);
-		regval = 0x1a;
-		if (mt9m024_write_reg(regaddr, regval))
-			return -1;
-	}
-#endif
+	/* sequencer, presets and PLL are loaded in the background */
+	schedule_work(&mt9m024_data.init_work);
 
-	/* Rotate */
-	if (rotate) {
-		pr_info("%s: Enabling 180° rotation\n",__func__);
-		regaddr = APT_MT9M024_READ_MODE;
-		if (mt9m024_read_reg(regaddr, &regval))
-			return -1;
-		regval |= (1<<15 | 1<<14);
-		if (mt9m024_write_reg(regaddr, regval))
-			return -1;
-	}
+	if (device_create_file(&client->dev, &dev_attr_bringup_trace))
+		dev_err(&client->dev, "Error on creating sysfs file"
+			" for bringup trace\n");
+	if (device_create_file(&client->dev, &dev_attr_i2c_avoided))
+		dev_err(&client->dev, "Error on creating sysfs file"
+			" for i2c_avoided\n");
 
 	mt9m024_int_device.priv = &mt9m024_data;
 	retval = v4l2_int_device_register(&mt9m024_int_device);
 
-	if (!retval)
+	if (!retval) {
 		pr_info("%s: Successfully probed\n",__func__);
-	else
+	} else {
 		pr_info("%s: Error\n",__func__);
+		cancel_work_sync(&mt9m024_data.init_work);
+	}
 
 
 	return retval;
@@ -1068,6 +2472,9 @@ static int mt9m024_probe(struct i2c_client *client,
  */
 static int mt9m024_remove(struct i2c_client *client)
 {
+	cancel_work_sync(&mt9m024_data.init_work);
+	device_remove_file(&client->dev, &dev_attr_i2c_avoided);
+	device_remove_file(&client->dev, &dev_attr_bringup_trace);
 	v4l2_int_device_unregister(&mt9m024_int_device);
 	return 0;
 }
@@ -1083,10 +2490,13 @@ static __init int mt9m024_init(void)
 	u8 err;
 
 	pr_Dbg("%s:driver registration\n", __func__);
+	sensor_i2c_prof_init(&mt9m024_prof, "mt9m024");
 	err = i2c_add_driver(&mt9m024_i2c_driver);
-	if (err != 0)
+	if (err != 0) {
 		pr_err("%s:driver registration failed, error=%d \n",
 			__func__, err);
+		sensor_i2c_prof_exit(&mt9m024_prof);
+	}
 
 	return err;
 }
@@ -1100,6 +2510,7 @@ static __init int mt9m024_init(void)
 static void __exit mt9m024_clean(void)
 {
 	i2c_del_driver(&mt9m024_i2c_driver);
+	sensor_i2c_prof_exit(&mt9m024_prof);
 }
 
 module_init(mt9m024_init);
@@ -1119,12 +2530,14 @@ module_param(sensorheight, int, 0);
 module_param(datawidth, int, 0);
 module_param(rotate, int, 0);
 module_param(binning, int, 0);
-
-MODULE_PARM_DESC(testpattern, "Test pattern: 0=disable (default), 1=solid color, 2=color bar, 3=fade-to-gray color bar, 4=walking 1s");
-MODULE_PARM_DESC(autoexposure, "Auto exposure: 0=disable, 1=enable (default)");
-MODULE_PARM_DESC(hdrmode, "High dynamic range mode: 0=disable (default), 1=enable");
-MODULE_PARM_DESC(sensorwidth, "Sensor width, default 1280");
-MODULE_PARM_DESC(sensorheight, "Sensor height, default 960");
-MODULE_PARM_DESC(datawidth, "Data width: 8 (default), 12 bits");
-MODULE_PARM_DESC(rotate, "Rotate by 180°, 0=no (default), 1=yes");
-MODULE_PARM_DESC(binning, "Enable digital binning for resolutions of VGA or smaller, 0=no, 1=yes (default)");
+module_param(companding, int, 0);
+
+MODULE_PARM_DESC(testpattern, "Initial test pattern: 0=disable (default), 1=solid color, 2=color bar, 3=fade-to-gray color bar, 4=walking 1s");
+MODULE_PARM_DESC(autoexposure, "Initial auto exposure: 0=disable (default), 1=enable");
+MODULE_PARM_DESC(hdrmode, "Initial high dynamic range mode: 0=disable (default), 1=enable");
+MODULE_PARM_DESC(sensorwidth, "Initial sensor width, default 1280");
+MODULE_PARM_DESC(sensorheight, "Initial sensor height, default 960");
+MODULE_PARM_DESC(datawidth, "Initial data width: 8, 12 bits (default)");
+MODULE_PARM_DESC(rotate, "Initially rotate by 180°, 0=no (default), 1=yes");
+MODULE_PARM_DESC(binning, "Initially enable digital binning for resolutions of VGA or smaller, 0=no, 1=yes (default)");
+MODULE_PARM_DESC(companding, "Initial HDR companding to 12 bits, 0=no, 1=yes (default)");
@@ -21,20 +21,68 @@
 #define APT_MT9M024_DEFAULT_LINES		0x3de
 #define APT_MT9M024_CLOCK			50000000
 #define APT_MT9M024_DEFAULT_LUMA_TARGET         0x666
-#define APT_MT9M024_MAX_FPS                     (us_PllLutMax*1000000/(APT_MT9M024_DEFAULT_PIXEL*APT_MT9M024_DEFAULT_LINES))
-#define APT_MT9M024_MIN_FPS                     (us_PllLutMin*1000000/(APT_MT9M024_DEFAULT_PIXEL*APT_MT9M024_DEFAULT_LINES))
+#define APT_MT9M024_MIN_FPS                     1
 
 
 // max resolution
 #define APT_MT9M024_MAX_X_RES                   1280
 #define APT_MT9M024_MAX_Y_RES                   960
 
+// readout timing limits, the maximum frame rate depends on the window
+#define APT_MT9M024_MAX_PIXCLK                  74250000
+#define APT_MT9M024_MIN_LINE_LENGTH             1388
+#define APT_MT9M024_MIN_HBLANK                  (APT_MT9M024_DEFAULT_PIXEL - APT_MT9M024_MAX_X_RES)
+#define APT_MT9M024_MIN_VBLANK                  (APT_MT9M024_DEFAULT_LINES - APT_MT9M024_MAX_Y_RES)
+#define APT_MT9M024_MAX_FRAME_LENGTH            0xffff
+
+// max. number of data words sent behind one register address
+#define APT_MT9M024_BURST_WORDS                 64
+
+// readiness polling: first back-off step and its upper bound in us
+#define APT_MT9M024_POLL_MIN_US                 100
+#define APT_MT9M024_POLL_MAX_US                 5000
+// upper bound for each readiness wait, the former fixed delay
+#define APT_MT9M024_READY_TIMEOUT_MS            200
+
 // default values for windowing
 #define APT_MT9M024_Y_ADDR_START_DEFAULT        0x2
 #define APT_MT9M024_X_ADDR_START_DEFAULT        0x0
 #define APT_MT9M024_Y_ADDR_END_DEFAULT          0x3C1
 #define APT_MT9M024_X_ADDR_END_DEFAULT          0x4FF
 
+// register bits
+#define APT_MT9M024_RESET_REGISTER_RESET        (1<<0)
+#define APT_MT9M024_RESET_REGISTER_STREAM       (1<<2)
+#define APT_MT9M024_FRAME_STATUS_STANDBY        (1<<1)
+#define APT_MT9M024_DIGITAL_TEST_CONTEXT_B      (1<<13)
+#define APT_MT9M024_DIGITAL_BINNING_MASK        0x3
+#define APT_MT9M024_DIGITAL_BINNING_2X2         0x2
+#define APT_MT9M024_DIGITAL_BINNING_CB_SHIFT    4
+#define APT_MT9M024_READ_MODE_HORIZ_MIRROR      (1<<14)
+#define APT_MT9M024_READ_MODE_VERT_FLIP         (1<<15)
+#define APT_MT9M024_OPERATION_MODE_LINEAR       (1<<0)
+#define APT_MT9M024_AE_CTRL_ENABLE              (1<<0)
+#define APT_MT9M024_TEST_PATTERN_WALKING_1S     256
+#define APT_MT9M024_HDR_COMP_ENABLE             (1<<0)
+
+// private controls, applied at the next stream start. The capture driver
+// uses V4L2_CID_PRIVATE_BASE + 0..6 (mxc_v4l2.h) and + 16 (mxc_capture_buf.h)
+#define APT_MT9M024_CID_BASE                    (V4L2_CID_PRIVATE_BASE + 32)
+#define V4L2_CID_MT9M024_TEST_PATTERN           (APT_MT9M024_CID_BASE + 0)
+#define V4L2_CID_MT9M024_HDR                    (APT_MT9M024_CID_BASE + 1)
+#define V4L2_CID_MT9M024_ROTATE                 (APT_MT9M024_CID_BASE + 2)
+#define V4L2_CID_MT9M024_BINNING                (APT_MT9M024_CID_BASE + 3)
+#define V4L2_CID_MT9M024_SENSOR_WIDTH           (APT_MT9M024_CID_BASE + 4)
+#define V4L2_CID_MT9M024_SENSOR_HEIGHT          (APT_MT9M024_CID_BASE + 5)
+#define V4L2_CID_MT9M024_DATA_WIDTH             (APT_MT9M024_CID_BASE + 6)
+#define V4L2_CID_MT9M024_COMPANDING             (APT_MT9M024_CID_BASE + 7)
+
+// limits of the sensor size controls
+#define APT_MT9M024_MIN_X_RES                   64
+#define APT_MT9M024_MIN_Y_RES                   64
+#define APT_MT9M024_X_RES_STEP                  8
+#define APT_MT9M024_Y_RES_STEP                  2
+
 // register definitions
 #define APT_MT9M024_MODEL_ID_                   0x3000
 #define APT_MT9M024_Y_ADDR_START_               0x3002
@@ -93,6 +141,7 @@
 #define APT_MT9M024_Y_ODD_INC_CB                0x30A8
 #define APT_MT9M024_FRAME_LENGTH_LINES_CB       0x30AA
 #define APT_MT9M024_EXPOSURE_T1                 0x30AC
+#define APT_MT9M024_X_ODD_INC_CB                0x30AE
 #define APT_MT9M024_DIGITAL_TEST                0x30B0
 #define APT_MT9M024_TEMPSENS_DATA               0x30B2
 #define APT_MT9M024_TEMPSENS_CTRL               0x30B4
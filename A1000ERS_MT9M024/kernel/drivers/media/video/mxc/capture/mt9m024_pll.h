@@ -16,6 +16,7 @@
 #ifndef _MT9M024_PLL_H_INCLUDED_
 #define _MT9M024_PLL_H_INCLUDED_
 
+// pixel clock = EXTCLK * m / (n * p1 * p2)
 struct MT9M024_PLL_ENTRY {
     unsigned short m;
     unsigned char n;
@@ -23,213 +24,24 @@ struct MT9M024_PLL_ENTRY {
     unsigned char p2;
 };
 
-// table for EXTCLK = 50MHz
-// index = MHz
-static struct MT9M024_PLL_ENTRY a_PllLUT[] = {
-    {},
-    {},
-    {243, 31, 14, 14},
-    {163, 19, 11, 13},
-    {243, 31, 7, 14},
-    {254, 21, 11, 11},
-    {215, 14, 8, 16},
-    {243, 31, 4, 14},
-    {243, 31, 7, 7},
-    {97, 7, 7, 11},
-    {255, 29, 4, 11},
-    {163, 19, 3, 13},
-    {215, 14, 4, 16},
-    {163, 19, 3, 11},
-    {243, 31, 2, 14},
-    {251, 31, 3, 9},
-    {215, 14, 3, 16},
-    {155, 19, 2, 12},
-    {131, 13, 2, 14},
-    {163, 11, 3, 13},
-    {255, 29, 2, 11},
-    {215, 16, 2, 16},
-    {194, 21, 3, 7},
-    {172, 17, 2, 11},
-    {215, 14, 2, 16},
-    {241, 23, 3, 7},
-    {183, 16, 2, 11},
-    {251, 31, 1, 15},
-    {243, 31, 1, 14},
-    {196, 13, 2, 13},
-    {235, 28, 1, 14},
-    {137, 17, 1, 13},
-    {215, 14, 2, 12},
-    {163, 19, 1, 13},
-    {155, 19, 1, 12},
-    {254, 33, 1, 11},
-    {131, 13, 1, 14},
-    {202, 21, 1, 13},
-    {231, 19, 1, 16},
-    {163, 19, 1, 11},
-    {255, 29, 1, 11},
-    {223, 17, 1, 16},
-    {215, 16, 1, 16},
-    {178, 23, 1, 9},
-    {183, 13, 1, 16},
-    {251, 31, 1, 9},
-    {172, 17, 1, 11},
-    {250, 19, 1, 14},
-    {215, 14, 1, 16},
-    {243, 31, 1, 8},
-    {255, 32, 1, 8},
-    {155, 19, 1, 8},
-    {183, 16, 1, 11},
-    {124, 9, 1, 13},
-    {95, 8, 1, 11},
-    {254, 21, 1, 11},
-    {243, 31, 1, 7},
-    {163, 11, 1, 13},
-    {196, 13, 1, 13},
-    {223, 21, 1, 9},
-    {235, 28, 1, 7},
-    {111, 13, 1, 7},
-    {243, 28, 1, 7},
-    {97, 7, 1, 11},
-    {215, 14, 1, 12},
-    {243, 17, 1, 11},
-    {194, 21, 1, 7},
-    {205, 17, 1, 9},
-    {155, 19, 1, 6},
-    {149, 12, 1, 9},
-    {235, 21, 1, 8},
-    {115, 9, 1, 9},
-    {131, 13, 1, 7},
-    {254, 29, 1, 6},
-    {145, 14, 1, 7},
-    {241, 23, 1, 7},
-    {231, 19, 1, 8},
-    {97, 7, 1, 9},
-    {131, 12, 1, 7},
-    {188, 17, 1, 7},
-    {243, 19, 1, 8},
-    {251, 31, 1, 5},
-    {223, 17, 1, 8},
-    {244, 21, 1, 7},
-    {215, 16, 1, 8},
-    {226, 19, 1, 7},
-    {227, 22, 1, 6},
-    {167, 12, 1, 8},
-    {183, 13, 1, 8},
-    {242, 17, 1, 8},
-    {214, 17, 1, 7},
-    {242, 19, 1, 7},
-    {103, 7, 1, 8},
-    {212, 19, 1, 6},
-    {250, 19, 1, 7},
-    {226, 17, 1, 7},
-    {215, 14, 1, 8},
-    {225, 29, 1, 4},
-    {243, 31, 1, 4},
-    {97, 7, 1, 7},
-    {255, 32, 1, 4},
-    {206, 17, 1, 6},
-    {155, 19, 1, 4},
-    {173, 12, 1, 7},
-    {183, 22, 1, 4},
-    {191, 13, 1, 7},
-    {195, 23, 1, 4},
-    {246, 23, 1, 5},
-    {95, 11, 1, 4},
-    {170, 13, 1, 6},
-    {255, 29, 1, 4},
-    {253, 19, 1, 6},
-    {215, 16, 1, 6},
-    {235, 26, 1, 4},
-    {155, 17, 1, 4},
-    {239, 26, 1, 4},
-    {167, 12, 1, 6},
-    {131, 14, 1, 4},
-    {151, 16, 1, 4},
-    {226, 19, 1, 5},
-    {211, 22, 1, 4},
-    {254, 21, 1, 5},
-    {161, 11, 1, 6},
-    {209, 17, 1, 5},
-    {119, 8, 1, 6},
-    {237, 19, 1, 5},
-    {131, 13, 1, 4},
-    {193, 19, 1, 4},
-    {215, 14, 1, 6},
-    {227, 22, 1, 4},
-    {239, 23, 1, 4},
-    {241, 23, 1, 4},
-    {95, 9, 1, 4},
-    {117, 11, 1, 4},
-    {75, 7, 1, 4},
-    {205, 19, 1, 4},
-    {87, 8, 1, 4},
-    {252, 23, 1, 4},
-    {193, 14, 1, 5},
-    {189, 17, 1, 4},
-    {235, 21, 1, 4},
-    {203, 18, 1, 4},
-    {159, 14, 1, 4},
-    {183, 16, 1, 4},
-    {187, 13, 1, 5},
-    {255, 22, 1, 4},
-    {248, 17, 1, 5},
-    {191, 13, 1, 5},
-    {71, 6, 1, 4},
-    {143, 12, 1, 4},
-    {254, 17, 1, 5},
-    {157, 13, 1, 4},
-    {231, 19, 1, 4},
-    {208, 17, 1, 4},
-    {234, 19, 1, 4},
-    {223, 18, 1, 4},
-    {237, 19, 1, 4},
-    {113, 9, 1, 4},
-    {139, 11, 1, 4},
-    {89, 7, 1, 4},
-    {243, 19, 1, 4},
-    {103, 8, 1, 4},
-    {246, 19, 1, 4},
-    {39, 3, 1, 4},
-    {223, 17, 1, 4},
-    {211, 16, 1, 4},
-    {239, 18, 1, 4},
-    {187, 14, 1, 4},
-    {215, 16, 1, 4},
-    {54, 4, 1, 4},
-    {231, 17, 1, 4},
-    {41, 3, 1, 4},
-    {55, 4, 1, 4},
-    {83, 6, 1, 4},
-    {167, 12, 1, 4},
-    {251, 18, 1, 4},
-    {183, 13, 1, 4},
-    {184, 13, 1, 4},
-    {242, 17, 1, 4},
-    {229, 16, 1, 4},
-    {187, 13, 1, 4},
-    {246, 17, 1, 4},
-    {131, 9, 1, 4},
-    {161, 11, 1, 4},
-    {103, 7, 1, 4},
-    {207, 14, 1, 4},
-    {119, 8, 1, 4},
-    {254, 17, 1, 4},
-    {45, 3, 1, 4},
-    {136, 9, 1, 4},
-    {243, 16, 1, 4},
-    {168, 11, 1, 4},
-    {215, 14, 1, 4},
-    {215, 14, 1, 4},
-    {215, 14, 1, 4},
-    {215, 14, 1, 4},
-    {215, 14, 1, 4},
-    {215, 14, 1, 4},
-    {215, 14, 1, 4},
-    {215, 14, 1, 4},
-    {215, 14, 1, 4},
-};
+// EXTCLK range
+#define MT9M024_PLL_EXTCLK_MIN      6000000
+#define MT9M024_PLL_EXTCLK_MAX      50000000
+
+// PLL input clock (EXTCLK / n)
+#define MT9M024_PLL_IN_MIN          1000000
+#define MT9M024_PLL_IN_MAX          24000000
+
+// VCO clock (PLL input clock * m)
+#define MT9M024_PLL_VCO_MIN         384000000
+#define MT9M024_PLL_VCO_MAX         768000000
 
-static unsigned short us_PllLutMin = 2; // valid: 2 MHz and greater
-static unsigned short us_PllLutMax = sizeof(a_PllLUT)/sizeof(struct MT9M024_PLL_ENTRY);
+// divider and multiplier limits
+#define MT9M024_PLL_M_MIN           32
+#define MT9M024_PLL_M_MAX           255
+#define MT9M024_PLL_N_MAX           63
+#define MT9M024_PLL_P1_MAX          16
+#define MT9M024_PLL_P2_MIN          4
+#define MT9M024_PLL_P2_MAX          16
 
 #endif
@@ -0,0 +1,171 @@
+/*
+ * Copyright (C) 2013 Aptina Imaging
+ */
+
+/*
+ * The code contained herein is licensed under the GNU General Public
+ * License. You may obtain a copy of the GNU General Public License
+ * Version 2 or later at the following locations:
+ *
+ * http://www.opensource.org/licenses/gpl-license.html
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+/*
+ * @file mt9m024_timing.h
+ *
+ * @brief Readout timing solver of the MT9M024 driver
+ *
+ * PLL dividers, row and frame length of a readout window for a frame
+ * rate. The functions touch no hardware and depend on their arguments
+ * only, they are kept apart from mt9m024.c so that test_app/timing_test.c
+ * can check them on a host.
+ */
+
+#ifndef __MT9M024_TIMING_H__
+#define __MT9M024_TIMING_H__
+
+#include <linux/kernel.h>
+#include <linux/math64.h>
+#include "mt9m024.h"
+#include "mt9m024_pll.h"
+
+/*!
+ * Readout of one sensor context.
+ */
+struct mt9m024_context {
+	int width;		/* output size */
+	int height;
+	int window_width;	/* readout window on the pixel array */
+	int window_height;
+	int skip;		/* 1, or 2 to read every other pair of rows
+				   and columns */
+	bool binned;
+};
+
+/*!
+ * Readout timing, see mt9m024_solve_timing().
+ */
+struct mt9m024_timing {
+	struct MT9M024_PLL_ENTRY pll;
+	u32 pixclk;		/* pixel clock in Hz */
+	int line_length;	/* LINE_LENGTH_PCK, pixel clocks per row */
+	int frame_length;	/* FRAME_LENGTH_LINES, rows per frame */
+	int fps;		/* resulting frame rate */
+	int max_fps;		/* highest frame rate of the window */
+};
+
+/*!
+ * Searches PLL dividers for a pixel clock close to target, either the
+ * highest one not above it (below set) or the lowest one not under it.
+ * Only settings within the VCO and divider limits of the sensor and at
+ * most APT_MT9M024_MAX_PIXCLK are considered. Touches no hardware.
+ *
+ * @param extclk  EXTCLK in Hz
+ * @param target  wanted pixel clock in Hz
+ * @param below   search at or below target instead of at or above
+ * @param pll     receives the dividers
+ * @return resulting pixel clock in Hz, 0 if no setting fits
+ */
+static u32 mt9m024_pll_search(u32 extclk, u32 target, bool below,
+			      struct MT9M024_PLL_ENTRY *pll)
+{
+	u32 best = 0, clk, n, p1, p2, div;
+	u64 m, vco;
+
+	if (extclk < MT9M024_PLL_EXTCLK_MIN || extclk > MT9M024_PLL_EXTCLK_MAX)
+		return 0;
+
+	for (p2 = MT9M024_PLL_P2_MIN; p2 <= MT9M024_PLL_P2_MAX; p2++) {
+		for (p1 = 1; p1 <= MT9M024_PLL_P1_MAX; p1++) {
+			div = p1 * p2;
+			for (n = 1; n <= MT9M024_PLL_N_MAX; n++) {
+				if (extclk / n > MT9M024_PLL_IN_MAX)
+					continue;
+				if (extclk / n < MT9M024_PLL_IN_MIN)
+					break;
+
+				/* m rounded towards the side we search */
+				m = (u64)target * n * div;
+				if (!below)
+					m += extclk - 1;
+				m = div_u64(m, extclk);
+				if (m < MT9M024_PLL_M_MIN ||
+				    m > MT9M024_PLL_M_MAX)
+					continue;
+
+				vco = div_u64((u64)extclk * m, n);
+				if (vco < MT9M024_PLL_VCO_MIN ||
+				    vco > MT9M024_PLL_VCO_MAX)
+					continue;
+				clk = div_u64((u64)extclk * m, n * div);
+				if (clk > APT_MT9M024_MAX_PIXCLK)
+					continue;
+
+				if (best && (below ? clk <= best : clk >= best))
+					continue;
+				best = clk;
+				pll->m = m;
+				pll->n = n;
+				pll->p1 = p1;
+				pll->p2 = p2;
+				if (clk == target)
+					return clk;
+			}
+		}
+	}
+
+	return best;
+}
+
+/*!
+ * Computes the readout timing of a window for a target frame rate. Rows
+ * are as short as the window allows and the frame gets the minimum
+ * vertical blanking. The slowest pixel clock that reaches the frame
+ * rate this way is chosen, then the frame is stretched to meet the
+ * rate. Digital binning does not shorten the readout, skipping does:
+ * only the rows and columns read count. Touches no hardware.
+ *
+ * @param ctx     readout window
+ * @param extclk  EXTCLK in Hz
+ * @param fps     target frame rate, clamped to what the window allows
+ * @param t       receives the timing
+ * @return 0 on success, -EINVAL if the PLL cannot run from extclk
+ */
+static int mt9m024_solve_timing(const struct mt9m024_context *ctx,
+				u32 extclk, int fps,
+				struct mt9m024_timing *t)
+{
+	struct MT9M024_PLL_ENTRY pll;
+	u32 min_frame, max_clk;
+
+	t->line_length = max(ctx->window_width / ctx->skip +
+			     APT_MT9M024_MIN_HBLANK,
+			     APT_MT9M024_MIN_LINE_LENGTH);
+	min_frame = ctx->window_height / ctx->skip + APT_MT9M024_MIN_VBLANK;
+
+	/* fastest pixel clock gives the highest frame rate */
+	max_clk = mt9m024_pll_search(extclk, APT_MT9M024_MAX_PIXCLK, true,
+				     &t->pll);
+	t->max_fps = max_clk / (t->line_length * min_frame);
+	if (t->max_fps < APT_MT9M024_MIN_FPS)
+		return -EINVAL;
+	fps = clamp(fps, APT_MT9M024_MIN_FPS, t->max_fps);
+
+	/* slowest pixel clock for fps, max_clk if the limits leave none */
+	pll = t->pll;
+	t->pixclk = mt9m024_pll_search(extclk,
+				       (u32)fps * t->line_length * min_frame,
+				       false, &t->pll);
+	if (!t->pixclk) {
+		t->pixclk = max_clk;
+		t->pll = pll;
+	}
+
+	t->frame_length = min_t(u32, t->pixclk / (fps * t->line_length),
+				APT_MT9M024_MAX_FRAME_LENGTH);
+	t->fps = t->pixclk / (t->line_length * t->frame_length);
+	return 0;
+}
+
+#endif
@@ -0,0 +1,59 @@
+/*
+ * drivers/media/video/mxc/capture/mxc_capture.h
+ *
+ * Capture device state kept next to cam_data
+ *
+ * Copyright (C) 2013 Aptina Imaging
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+/*
+ * cam_data is defined by mxc_v4l2_capture.h of the Freescale BSP. The
+ * capture driver allocates every cam_data inside a struct mxc_capture, so
+ * the encoder drivers reach the rest of the device with to_mxc_capture().
+ */
+
+#ifndef __MXC_CAPTURE_H__
+#define __MXC_CAPTURE_H__
+
+#include <linux/kref.h>
+#include <linux/mxc_capture_buf.h>
+#include "mxc_v4l2_capture.h"
+#include "ipu_buf_pool.h"
+
+struct mxc_capture {
+	cam_data cam;
+	struct kref ref;		/* probe and exported buffers */
+	struct device *dev;		/* platform device, for DMA mappings */
+	struct mxc_v4l_frame *frames;	/* frame table */
+	struct mxc_capture_buf **exports; /* exported buffers of the frames */
+	int frame_slots;		/* entries allocated in frames */
+	int frame_count;		/* entries in use */
+	int cached;			/* MMAP buffers are mapped cacheable */
+	struct ipu_buf_pool pool;	/* coherent frame, dummy, rotation buffers */
+};
+
+static inline struct mxc_capture *to_mxc_capture(cam_data *cam)
+{
+	return container_of(cam, struct mxc_capture, cam);
+}
+
+static inline struct ipu_buf_pool *mxc_capture_pool(cam_data *cam)
+{
+	return &to_mxc_capture(cam)->pool;
+}
+
+#endif /* __MXC_CAPTURE_H__ */
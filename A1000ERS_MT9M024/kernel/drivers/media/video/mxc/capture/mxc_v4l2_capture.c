@@ -34,21 +34,71 @@
 #include <linux/fb.h>
 #include <linux/dma-mapping.h>
 #include <linux/delay.h>
+#include <linux/anon_inodes.h>
+#include <linux/file.h>
+#include <linux/kref.h>
+#include <linux/uaccess.h>
 #include <linux/mxcfb.h>
 #include <media/v4l2-chip-ident.h>
 #include <media/v4l2-ioctl.h>
 #include <media/v4l2-int-device.h>
 #include <linux/fsl_devices.h>
-#include "mxc_v4l2_capture.h"
+#include "mxc_capture.h"
 #include "ipu_prp_sw.h"
 
 #define init_MUTEX(sem)         sema_init(sem, 1)
 #define MXC_SENSOR_NUM 2
 
+/*!
+ * Private slave ioctls. wait_init blocks until the sensor configuration
+ * that the slave runs asynchronously from probe or dev_init has finished
+ * and returns its result. apply starts using the settings the slave has
+ * deferred to the next stream start; it returns 1 if the output format
+ * changed, 0 if not, or a negative error code. Slaves without such
+ * settings or with a synchronous configuration do not implement them.
+ */
+enum {
+	vidioc_int_wait_init_num = vidioc_int_priv_start_num,
+	vidioc_int_apply_num,
+};
+V4L2_INT_WRAPPER_0(wait_init);
+V4L2_INT_WRAPPER_0(apply);
+
 #define pr_Dbg pr_err
 
 static int video_nr = -1;
 
+/*!
+ * Upper bound for the buffers of one VIDIOC_REQBUFS. The count actually
+ * allocated may be lower when contiguous memory runs out, it is returned
+ * in the count of the request.
+ */
+static int frame_max = 32;
+
+/*! Buffers a VIDIOC_REQBUFS has to get at least, one per IPU buffer */
+#define MXC_FRAME_MIN	2
+
+/*!
+ * Buffers of pool_reserve_size bytes put into the buffer pool of every
+ * capture device at probe. They are kept when the device is closed, other
+ * idle buffers of the pool are freed then.
+ */
+static int pool_reserve;
+static int pool_reserve_size;
+
+/*! Idle bytes the buffer pool keeps while the device is closed */
+static size_t mxc_pool_keep(void)
+{
+	if (pool_reserve <= 0 || pool_reserve_size <= 0)
+		return 0;
+	return pool_reserve * ipu_buf_pool_class(pool_reserve_size);
+}
+
+static inline struct mxc_v4l_frame *mxc_frame(cam_data *cam, int index)
+{
+	return &to_mxc_capture(cam)->frames[index];
+}
+
 /*! This data is used for the output to the display. */
 #define MXC_V4L2_CAPTURE_NUM_OUTPUTS	6
 #define MXC_V4L2_CAPTURE_NUM_INPUTS	2
@@ -207,69 +257,348 @@ static struct v4l2_int_master mxc_v4l2_master = {
  * Functions for handling Frame buffers.
  **************************************************************************/
 
+/*!
+ * Allocate the memory of a frame
+ *
+ * Write-combined frames are coherent buffers from the buffer pool. With
+ * V4L2_CID_MXC_CACHED_MMAP set the frames are normal pages with a
+ * streaming DMA mapping, so the user mapping is cacheable like the kernel
+ * linear mapping of the same pages, and mxc_frame_sync() does the cache
+ * maintenance. Those are not pooled. The bus address equals the physical
+ * address on i.MX, mxc_mmap() relies on it.
+ *
+ * @param mc       Structure mxc_capture *
+ * @param size     size_t page aligned size
+ * @param paddr    dma_addr_t * returns the bus address
+ * @param gfp      gfp_t allocation flags
+ *
+ * @return the kernel virtual address, or NULL
+ */
+static void *mxc_frame_mem_alloc(struct mxc_capture *mc, size_t size,
+				 dma_addr_t *paddr, gfp_t gfp)
+{
+	void *vaddr;
+
+	if (!mc->cached)
+		return ipu_buf_pool_get(&mc->pool, size, paddr, gfp);
+
+	vaddr = alloc_pages_exact(size, gfp);
+	if (vaddr == NULL)
+		return NULL;
+	*paddr = dma_map_single(mc->dev, vaddr, size, DMA_FROM_DEVICE);
+	if (dma_mapping_error(mc->dev, *paddr)) {
+		free_pages_exact(vaddr, size);
+		return NULL;
+	}
+	return vaddr;
+}
+
+/*!
+ * Free the pages of a cacheable frame
+ *
+ * @param dev      struct device * the pages are mapped for
+ * @param vaddr    void * from mxc_frame_mem_alloc()
+ * @param paddr    dma_addr_t bus address
+ * @param size     size_t size passed to mxc_frame_mem_alloc()
+ */
+static void mxc_frame_pages_free(struct device *dev, void *vaddr,
+				 dma_addr_t paddr, size_t size)
+{
+	dma_unmap_single(dev, paddr, size, DMA_FROM_DEVICE);
+	free_pages_exact(vaddr, size);
+}
+
+/*!
+ * Free the device data after the last exported buffer
+ *
+ * @param ref      struct kref * of struct mxc_capture
+ */
+static void mxc_capture_release(struct kref *ref)
+{
+	struct mxc_capture *mc = container_of(ref, struct mxc_capture, ref);
+
+	ipu_buf_pool_trim(&mc->pool, false);
+	put_device(mc->dev);
+	kfree(mc->exports);
+	kfree(mc->frames);
+	kfree(mc);
+}
+
+/*!
+ * Exported frame buffer. The frame table holds one reference as long as
+ * the buffer belongs to a frame, every exported file and importer another
+ * one. The last reference gives the memory back: the pages of a cacheable
+ * frame are freed, a coherent frame goes to the buffer pool. The files
+ * and the importing modules hold this module, and every buffer holds the
+ * device data with its pool, which mxc_v4l2_remove() leaves to the last
+ * buffer.
+ */
+struct mxc_capture_buf {
+	struct kref ref;
+	void *vaddr;
+	dma_addr_t paddr;
+	size_t size;
+	struct mxc_capture *mc;	/* pool and device of the memory */
+	int cached;		/* from mxc_frame_mem_alloc() in cached mode */
+};
+
+/* may sleep, in the buffer pool */
+static void mxc_capture_buf_release(struct kref *ref)
+{
+	struct mxc_capture_buf *buf =
+	    container_of(ref, struct mxc_capture_buf, ref);
+	struct mxc_capture *mc = buf->mc;
+
+	if (buf->cached)
+		mxc_frame_pages_free(mc->dev, buf->vaddr, buf->paddr,
+				     buf->size);
+	else
+		ipu_buf_pool_put(&mc->pool, buf->vaddr, buf->paddr,
+				 buf->size);
+	kfree(buf);
+	kref_put(&mc->ref, mxc_capture_release);
+}
+
+static int mxc_capture_buf_fop_release(struct inode *inode, struct file *file)
+{
+	struct mxc_capture_buf *buf = file->private_data;
+
+	kref_put(&buf->ref, mxc_capture_buf_release);
+	return 0;
+}
+
+static int mxc_capture_buf_fop_mmap(struct file *file,
+				    struct vm_area_struct *vma)
+{
+	struct mxc_capture_buf *buf = file->private_data;
+	unsigned long size = vma->vm_end - vma->vm_start;
+	unsigned long offset = vma->vm_pgoff << PAGE_SHIFT;
+
+	if (offset >= buf->size || size > buf->size - offset)
+		return -EINVAL;
+
+	/* same attributes as the kernel mapping of the memory */
+	if (!buf->cached)
+		vma->vm_page_prot = pgprot_writecombine(vma->vm_page_prot);
+	if (remap_pfn_range(vma, vma->vm_start,
+			    (buf->paddr + offset) >> PAGE_SHIFT, size,
+			    vma->vm_page_prot)) {
+		pr_err("ERROR: v4l2 capture: exported buffer: "
+			"remap_pfn_range failed\n");
+		return -ENOBUFS;
+	}
+
+	return 0;
+}
+
+static long mxc_capture_buf_fop_ioctl(struct file *file, unsigned int cmd,
+				      unsigned long arg)
+{
+	struct mxc_capture_buf *buf = file->private_data;
+	struct mxc_capture_buf_info info;
+
+	if (cmd != MXC_CAPTURE_BUF_INFO)
+		return -ENOTTY;
+
+	info.paddr = buf->paddr;
+	info.size = buf->size;
+	if (copy_to_user((void __user *)arg, &info, sizeof(info)))
+		return -EFAULT;
+	return 0;
+}
+
+static const struct file_operations mxc_capture_buf_fops = {
+	.owner = THIS_MODULE,
+	.release = mxc_capture_buf_fop_release,
+	.mmap = mxc_capture_buf_fop_mmap,
+	.unlocked_ioctl = mxc_capture_buf_fop_ioctl,
+};
+
+/*!
+ * Import an exported capture buffer
+ *
+ * @param fd       int file descriptor from MXC_VIDIOC_EXPBUF
+ * @param paddr    dma_addr_t * returns the bus address
+ * @param size     size_t * returns the size in bytes
+ *
+ * @return the buffer, released with mxc_capture_buf_put(), or ERR_PTR.
+ */
+struct mxc_capture_buf *mxc_capture_buf_get(int fd, dma_addr_t *paddr,
+					    size_t *size)
+{
+	struct mxc_capture_buf *buf;
+	struct file *file;
+
+	file = fget(fd);
+	if (file == NULL)
+		return ERR_PTR(-EBADF);
+	if (file->f_op != &mxc_capture_buf_fops) {
+		fput(file);
+		return ERR_PTR(-EINVAL);
+	}
+
+	buf = file->private_data;
+	kref_get(&buf->ref);
+	fput(file);
+
+	*paddr = buf->paddr;
+	*size = buf->size;
+	return buf;
+}
+EXPORT_SYMBOL(mxc_capture_buf_get);
+
+/*!
+ * Release an imported capture buffer, may sleep
+ *
+ * @param buf      struct mxc_capture_buf * from mxc_capture_buf_get()
+ */
+void mxc_capture_buf_put(struct mxc_capture_buf *buf)
+{
+	kref_put(&buf->ref, mxc_capture_buf_release);
+}
+EXPORT_SYMBOL(mxc_capture_buf_put);
+
 /*!
  * Free frame buffers
  *
+ * The buffers go back to the buffer pool of the device. An exported buffer
+ * drops the reference of its frame and goes back with the last one, when
+ * its files and importers are done with it. Called with busy_lock held, so
+ * no new export can come in meanwhile.
+ *
  * @param cam      Structure cam_data *
  *
  * @return status  0 success.
  */
 static int mxc_free_frame_buf(cam_data *cam)
 {
+	struct mxc_capture *mc = to_mxc_capture(cam);
+	struct mxc_v4l_frame *frame;
+	struct mxc_capture_buf *buf;
 	int i;
 
 	pr_Dbg("MVC: In mxc_free_frame_buf\n");
 
-	for (i = 0; i < FRAME_NUM; i++) {
-		if (cam->frame[i].vaddress != 0) {
-			dma_free_coherent(0, cam->frame[i].buffer.length,
-					  cam->frame[i].vaddress,
-					  cam->frame[i].paddress);
-			cam->frame[i].vaddress = 0;
-		}
+	for (i = 0; i < mc->frame_slots; i++) {
+		frame = &mc->frames[i];
+		buf = mc->exports[i];
+		mc->exports[i] = NULL;
+		if (buf != NULL) {
+			kref_put(&buf->ref, mxc_capture_buf_release);
+			frame->vaddress = 0;
+			continue;
+		}
+		if (frame->vaddress == 0)
+			continue;
+		if (mc->cached)
+			mxc_frame_pages_free(mc->dev, frame->vaddress,
+					     frame->paddress,
+					     frame->buffer.length);
+		else
+			ipu_buf_pool_put(&mc->pool, frame->vaddress,
+					 frame->paddress, frame->buffer.length);
+		frame->vaddress = 0;
 	}
 
 	return 0;
 }
 
+/*!
+ * Size the frame table
+ *
+ * The table only grows, all entries are cleared. The frame buffers have to
+ * be freed and the queues emptied with mxc_free_frames() before.
+ *
+ * @param cam      Structure cam_data *
+ * @param count    int number of frames
+ *
+ * @return status  0 success, -ENOMEM failed.
+ */
+static int mxc_frame_table(cam_data *cam, int count)
+{
+	struct mxc_capture *mc = to_mxc_capture(cam);
+	struct mxc_v4l_frame *frames;
+	struct mxc_capture_buf **exports;
+
+	if (count > mc->frame_slots) {
+		frames = kcalloc(count, sizeof(*frames), GFP_KERNEL);
+		exports = kcalloc(count, sizeof(*exports), GFP_KERNEL);
+		if (frames == NULL || exports == NULL) {
+			pr_err("ERROR: v4l2 capture: "
+				"no memory for %d frames\n", count);
+			kfree(frames);
+			kfree(exports);
+			memset(mc->frames, 0, mc->frame_slots * sizeof(*frames));
+			mc->frame_count = 0;
+			return -ENOMEM;
+		}
+		kfree(mc->frames);
+		kfree(mc->exports);
+		mc->frames = frames;
+		mc->exports = exports;
+		mc->frame_slots = count;
+	} else if (mc->frame_slots) {
+		memset(mc->frames, 0, mc->frame_slots * sizeof(*frames));
+	}
+
+	mc->frame_count = count;
+	return 0;
+}
+
 /*!
  * Allocate frame buffers
  *
  * @param cam      Structure cam_data*
  * @param count    int number of buffer need to allocated
  *
- * @return status  -0 Successfully allocated a buffer, -ENOBUFS	failed.
+ * Buffers past MXC_FRAME_MIN are optional: when contiguous memory runs out
+ * the frame table is cut down to the buffers allocated so far.
+ *
+ * @return status  number of buffers allocated, -ENOBUFS failed.
  */
 static int mxc_allocate_frame_buf(cam_data *cam, int count)
 {
+	struct mxc_capture *mc = to_mxc_capture(cam);
+	struct mxc_v4l_frame *frame;
+	gfp_t gfp;
 	int i;
 
 	pr_Dbg("In MVC:mxc_allocate_frame_buf - size=%d\n",
 		cam->v2f.fmt.pix.sizeimage);
 
 	for (i = 0; i < count; i++) {
-		cam->frame[i].vaddress =
-		    dma_alloc_coherent(0,
-				       PAGE_ALIGN(cam->v2f.fmt.pix.sizeimage),
-				       &cam->frame[i].paddress,
-				       GFP_DMA | GFP_KERNEL);
-		if (cam->frame[i].vaddress == 0) {
+		frame = &mc->frames[i];
+		gfp = GFP_DMA | GFP_KERNEL;
+		if (i >= MXC_FRAME_MIN)
+			gfp |= __GFP_NOWARN;
+		frame->vaddress =
+		    mxc_frame_mem_alloc(mc,
+					PAGE_ALIGN(cam->v2f.fmt.pix.sizeimage),
+					&frame->paddress, gfp);
+		if (frame->vaddress == 0) {
+			if (i >= MXC_FRAME_MIN) {
+				pr_info("v4l2 capture: contiguous memory for "
+					"%d of %d buffers\n", i, count);
+				break;
+			}
 			pr_err("ERROR: v4l2 capture: "
 				"mxc_allocate_frame_buf failed.\n");
 			mxc_free_frame_buf(cam);
+			mc->frame_count = 0;
 			return -ENOBUFS;
 		}
-		cam->frame[i].buffer.index = i;
-		cam->frame[i].buffer.flags = V4L2_BUF_FLAG_MAPPED;
-		cam->frame[i].buffer.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-		cam->frame[i].buffer.length =
+		frame->buffer.index = i;
+		frame->buffer.flags = V4L2_BUF_FLAG_MAPPED;
+		frame->buffer.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+		frame->buffer.length =
 		    PAGE_ALIGN(cam->v2f.fmt.pix.sizeimage);
-		cam->frame[i].buffer.memory = V4L2_MEMORY_MMAP;
-		cam->frame[i].buffer.m.offset = cam->frame[i].paddress;
-		cam->frame[i].index = i;
+		frame->buffer.memory = V4L2_MEMORY_MMAP;
+		frame->buffer.m.offset = frame->paddress;
+		frame->index = i;
 	}
 
-	return 0;
+	mc->frame_count = i;
+	return i;
 }
 
 /*!
@@ -281,12 +610,13 @@ static int mxc_allocate_frame_buf(cam_data *cam, int count)
  */
 static void mxc_free_frames(cam_data *cam)
 {
+	struct mxc_capture *mc = to_mxc_capture(cam);
 	int i;
 
 	pr_Dbg("In MVC:mxc_free_frames\n");
 
-	for (i = 0; i < FRAME_NUM; i++) {
-		cam->frame[i].buffer.flags = V4L2_BUF_FLAG_MAPPED;
+	for (i = 0; i < mc->frame_count; i++) {
+		mc->frames[i].buffer.flags = V4L2_BUF_FLAG_MAPPED;
 	}
 
 	cam->enc_counter = 0;
@@ -307,13 +637,119 @@ static int mxc_v4l2_buffer_status(cam_data *cam, struct v4l2_buffer *buf)
 {
 	pr_Dbg("In MVC:mxc_v4l2_buffer_status\n");
 
-	if (buf->index < 0 || buf->index >= FRAME_NUM) {
+	if (buf->index < 0 || buf->index >= to_mxc_capture(cam)->frame_count) {
 		pr_err("ERROR: v4l2 capture: mxc_v4l2_buffer_status buffers "
 		       "not allocated\n");
 		return -EINVAL;
 	}
 
-	memcpy(buf, &(cam->frame[buf->index].buffer), sizeof(*buf));
+	memcpy(buf, &(mxc_frame(cam, buf->index)->buffer), sizeof(*buf));
+	return 0;
+}
+
+/*!
+ * Check for MMAP frame buffers
+ *
+ * @param cam      Structure cam_data *
+ *
+ * @return true if any frame has a buffer allocated by the driver.
+ */
+static bool mxc_frames_allocated(cam_data *cam)
+{
+	struct mxc_capture *mc = to_mxc_capture(cam);
+	int i;
+
+	for (i = 0; i < mc->frame_slots; i++)
+		if (mc->frames[i].vaddress != 0)
+			return true;
+	return false;
+}
+
+/*!
+ * Cache maintenance of a frame in a cacheable mapping
+ *
+ * The streaming mapping of the frame is handed to the IPU before it writes
+ * the frame, so that no dirty line is written back over the new frame, and
+ * back to the CPU before it reads the frame, for lines fetched meanwhile.
+ *
+ * @param cam        Structure cam_data *
+ * @param frame      Structure mxc_v4l_frame *
+ * @param for_device true before the IPU, false before the CPU
+ */
+static void mxc_frame_sync(cam_data *cam, struct mxc_v4l_frame *frame,
+			   bool for_device)
+{
+	if (!to_mxc_capture(cam)->cached ||
+	    frame->buffer.memory != V4L2_MEMORY_MMAP || frame->vaddress == 0)
+		return;
+
+	if (for_device)
+		dma_sync_single_for_device(to_mxc_capture(cam)->dev,
+					   frame->paddress,
+					   frame->buffer.length,
+					   DMA_FROM_DEVICE);
+	else
+		dma_sync_single_for_cpu(to_mxc_capture(cam)->dev,
+					frame->paddress,
+					frame->buffer.length, DMA_FROM_DEVICE);
+}
+
+/*!
+ * Export a frame buffer as a file descriptor
+ *
+ * @param cam      Structure cam_data *
+ * @param eb       Structure mxc_v4l2_exportbuffer *
+ *
+ * @return status  0 success, EINVAL or ENOMEM failed.
+ */
+static int mxc_v4l2_expbuf(cam_data *cam, struct mxc_v4l2_exportbuffer *eb)
+{
+	struct mxc_capture *mc = to_mxc_capture(cam);
+	struct mxc_v4l_frame *frame;
+	struct mxc_capture_buf *buf;
+	int fd;
+
+	pr_Dbg("In MVC:mxc_v4l2_expbuf\n");
+
+	if (eb->type != V4L2_BUF_TYPE_VIDEO_CAPTURE ||
+	    eb->index >= mc->frame_count || (eb->flags & ~O_CLOEXEC)) {
+		pr_err("ERROR: v4l2 capture: mxc_v4l2_expbuf invalid "
+			"buffer %d\n", eb->index);
+		return -EINVAL;
+	}
+
+	frame = &mc->frames[eb->index];
+	if (frame->buffer.memory != V4L2_MEMORY_MMAP ||
+	    frame->vaddress == 0) {
+		pr_err("ERROR: v4l2 capture: mxc_v4l2_expbuf buffer %d "
+			"not allocated\n", eb->index);
+		return -EINVAL;
+	}
+
+	buf = mc->exports[eb->index];
+	if (buf == NULL) {
+		buf = kmalloc(sizeof(*buf), GFP_KERNEL);
+		if (buf == NULL)
+			return -ENOMEM;
+		kref_init(&buf->ref);	/* reference of the frame */
+		buf->vaddr = frame->vaddress;
+		buf->paddr = frame->paddress;
+		buf->size = frame->buffer.length;
+		buf->mc = mc;
+		buf->cached = mc->cached;
+		kref_get(&mc->ref);
+		mc->exports[eb->index] = buf;
+	}
+
+	kref_get(&buf->ref);
+	fd = anon_inode_getfd("mxc_capture_buf", &mxc_capture_buf_fops, buf,
+			      O_RDWR | (eb->flags & O_CLOEXEC));
+	if (fd < 0) {
+		kref_put(&buf->ref, mxc_capture_buf_release);
+		return fd;
+	}
+
+	eb->fd = fd;
 	return 0;
 }
 
@@ -325,24 +761,26 @@ static int mxc_v4l2_release_bufs(cam_data *cam)
 
 static int mxc_v4l2_prepare_bufs(cam_data *cam, struct v4l2_buffer *buf)
 {
+	struct mxc_v4l_frame *frame;
+
 	pr_Dbg("In MVC:mxc_v4l2_prepare_bufs\n");
 
-	if (buf->index < 0 || buf->index >= FRAME_NUM || buf->length <
-			PAGE_ALIGN(cam->v2f.fmt.pix.sizeimage)) {
+	if (buf->index < 0 || buf->index >= to_mxc_capture(cam)->frame_count ||
+			buf->length < PAGE_ALIGN(cam->v2f.fmt.pix.sizeimage)) {
 		pr_err("ERROR: v4l2 capture: mxc_v4l2_prepare_bufs buffers "
 			"not allocated,index=%d, length=%d\n", buf->index,
 			buf->length);
 		return -EINVAL;
 	}
 
-	cam->frame[buf->index].buffer.index = buf->index;
-	cam->frame[buf->index].buffer.flags = V4L2_BUF_FLAG_MAPPED;
-	cam->frame[buf->index].buffer.length = buf->length;
-	cam->frame[buf->index].buffer.m.offset = cam->frame[buf->index].paddress
-		= buf->m.offset;
-	cam->frame[buf->index].buffer.type = buf->type;
-	cam->frame[buf->index].buffer.memory = V4L2_MEMORY_USERPTR;
-	cam->frame[buf->index].index = buf->index;
+	frame = mxc_frame(cam, buf->index);
+	frame->buffer.index = buf->index;
+	frame->buffer.flags = V4L2_BUF_FLAG_MAPPED;
+	frame->buffer.length = buf->length;
+	frame->buffer.m.offset = frame->paddress = buf->m.offset;
+	frame->buffer.type = buf->type;
+	frame->buffer.memory = V4L2_MEMORY_USERPTR;
+	frame->index = buf->index;
 
 	return 0;
 }
@@ -372,7 +810,135 @@ static inline int valid_mode(u32 palette)
 		(palette == V4L2_PIX_FMT_YVU420) ||
 		(palette == V4L2_PIX_FMT_NV12) ||
 		(palette == V4L2_PIX_FMT_GREY) ||
-		(palette == V4L2_PIX_FMT_Y16));
+		(palette == V4L2_PIX_FMT_Y16) ||
+		(palette == IPU_PIX_FMT_GENERIC_12P));
+}
+
+/*!
+ * Indicates whether the CSI packs the sensor data tightly, i.e. two 12 bit
+ * pixels in three bytes instead of one pixel per 16 bit word.
+ *
+ * @param cam      structure cam_data *
+ *
+ * @return 1 for a packed capture format, 0 otherwise
+ */
+static inline unsigned mxc_v4l2_pack_tight(cam_data *cam)
+{
+	return cam->v2f.fmt.pix.pixelformat == IPU_PIX_FMT_GENERIC_12P;
+}
+
+/*!
+ * Programs the CSI for the current output of the sensor: data width,
+ * sync polarities, pixel format and size. The current crop size follows
+ * the new bounds.
+ *
+ * @param cam      structure cam_data *
+ */
+static void mxc_v4l2_csi_update(cam_data *cam)
+{
+	struct v4l2_ifparm ifparm;
+	struct v4l2_format cam_fmt;
+	ipu_csi_signal_cfg_t csi_param;
+
+	/* Get new values. */
+	vidioc_int_g_ifparm(cam->sensor, &ifparm);
+
+	csi_param.data_width = 0;
+	csi_param.clk_mode = 0;
+	csi_param.ext_vsync = 0;
+	csi_param.Vsync_pol = 0;
+	csi_param.Hsync_pol = 0;
+	csi_param.pixclk_pol = 0;
+	csi_param.data_pol = 0;
+	csi_param.sens_clksrc = 0;
+	csi_param.pack_tight = mxc_v4l2_pack_tight(cam);
+	csi_param.force_eof = 0;
+	csi_param.data_en_pol = 0;
+	csi_param.data_fmt = 0;
+	csi_param.csi = cam->csi;
+	csi_param.mclk = 0;
+
+	pr_Dbg("   clock_curr=mclk=%d\n", ifparm.u.bt656.clock_curr);
+	if (ifparm.u.bt656.clock_curr == 0)
+		csi_param.clk_mode = IPU_CSI_CLK_MODE_CCIR656_INTERLACED;
+	else
+		csi_param.clk_mode = IPU_CSI_CLK_MODE_GATED_CLK;
+
+	csi_param.pixclk_pol = ifparm.u.bt656.latch_clk_inv;
+
+	if (ifparm.u.bt656.mode == V4L2_IF_TYPE_BT656_MODE_NOBT_8BIT)
+		csi_param.data_width = IPU_CSI_DATA_WIDTH_8;
+	else if (ifparm.u.bt656.mode == V4L2_IF_TYPE_BT656_MODE_NOBT_12BIT)
+		csi_param.data_width = IPU_CSI_DATA_WIDTH_12;
+	else
+		csi_param.data_width = IPU_CSI_DATA_WIDTH_8;
+
+	csi_param.Vsync_pol = ifparm.u.bt656.nobt_vs_inv;
+	csi_param.Hsync_pol = ifparm.u.bt656.nobt_hs_inv;
+	csi_param.ext_vsync = ifparm.u.bt656.bt_sync_correct;
+
+	/* if the capturemode changed, the size bounds will have changed. */
+	cam_fmt.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+	vidioc_int_g_fmt_cap(cam->sensor, &cam_fmt);
+	pr_Dbg("   g_fmt_cap returns widthxheight of input as %d x %d\n",
+			cam_fmt.fmt.pix.width, cam_fmt.fmt.pix.height);
+
+	csi_param.data_fmt = cam_fmt.fmt.pix.pixelformat;
+
+	cam->crop_bounds.top = cam->crop_bounds.left = 0;
+	cam->crop_bounds.width = cam_fmt.fmt.pix.width;
+	cam->crop_bounds.height = cam_fmt.fmt.pix.height;
+
+	/*
+	 * Set the default current cropped resolution to be the same with
+	 * the cropping boundary(except for tvin module).
+	 */
+	if (cam->device_type != 1) {
+		cam->crop_current.width = cam->crop_bounds.width;
+		cam->crop_current.height = cam->crop_bounds.height;
+	}
+
+	/* This essentially loses the data at the left and bottom of the image
+	 * giving a digital zoom image, if crop_current is less than the full
+	 * size of the image. */
+	ipu_csi_set_window_size(cam->ipu, cam->crop_current.width,
+				cam->crop_current.height, cam->csi);
+	ipu_csi_set_window_pos(cam->ipu, cam->crop_current.left,
+			       cam->crop_current.top,
+			       cam->csi);
+	ipu_csi_init_interface(cam->ipu, cam->crop_bounds.width,
+			       cam->crop_bounds.height,
+			       cam_fmt.fmt.pix.pixelformat, csi_param);
+}
+
+/*!
+ * Lets the sensor apply the settings it has deferred to the next stream
+ * start, such as private mode controls. If the output format of the
+ * sensor changes, the CSI and the crop rectangles follow it.
+ *
+ * @param cam      structure cam_data *
+ *
+ * @return status  1 if the format changed, 0 if not, negative error code
+ *                 of the sensor otherwise
+ */
+static int mxc_v4l2_sensor_apply(cam_data *cam)
+{
+	int err;
+
+	err = vidioc_int_apply(cam->sensor);
+	if (err == -ENOIOCTLCMD)
+		return 0;
+	if (err <= 0)
+		return err;
+
+	/* the sensor output format changed */
+	cam->crop_current.top = cam->crop_current.left = 0;
+	mxc_v4l2_csi_update(cam);
+	cam->crop_defrect = cam->crop_bounds;
+	pr_Dbg("   sensor output is now %d x %d\n",
+	       cam->crop_bounds.width, cam->crop_bounds.height);
+
+	return 1;
 }
 
 /*!
@@ -401,6 +967,29 @@ static int mxc_streamon(cam_data *cam)
 		return -1;
 	}
 
+	/* settings deferred by the sensor take effect now */
+	err = mxc_v4l2_sensor_apply(cam);
+	if (err < 0) {
+		pr_err("ERROR: v4l2 capture: sensor settings not applied\n");
+		return err;
+	}
+	if (err > 0 && strcmp(mxc_capture_inputs[cam->current_input].name,
+			      "CSI MEM") == 0 &&
+	    (cam->v2f.fmt.pix.width != cam->crop_current.width ||
+	     cam->v2f.fmt.pix.height != cam->crop_current.height)) {
+		pr_err("ERROR: v4l2 capture: sensor output changed, "
+		       "VIDIOC_S_FMT needed\n");
+		return -EINVAL;
+	}
+
+	/* the sensor may still be running its initialization */
+	err = vidioc_int_wait_init(cam->sensor);
+	if (err && err != -ENOIOCTLCMD) {
+		pr_err("ERROR: v4l2 capture: sensor initialization failed\n");
+		return err;
+	}
+	err = 0;
+
 	if (list_empty(&cam->ready_q)) {
 		pr_err("ERROR: v4l2 capture: mxc_streamon buffer has not been "
 			"queued yet\n");
@@ -502,6 +1091,9 @@ static int mxc_streamoff(cam_data *cam)
 	mxc_free_frames(cam);
 	mxc_capture_inputs[cam->current_input].status |= V4L2_IN_ST_NO_POWER;
 	cam->capture_on = false;
+
+	/* pollers see the stream going off */
+	wake_up_interruptible(&cam->enc_queue);
 	return err;
 }
 
@@ -806,6 +1398,32 @@ static int mxc_v4l2_s_fmt(cam_data *cam, struct v4l2_format *f)
 			return -EINVAL;
 		}
 
+		/*
+		 * The pixel format may select the sensor datapath, e.g. 8
+		 * bit for V4L2_PIX_FMT_GREY. Pending sensor modes change the
+		 * input size. The CSI is reprogrammed if only the packing
+		 * changes.
+		 */
+		if (!cam->capture_on) {
+			struct v4l2_format cam_fmt = *f;
+			unsigned pack_tight = mxc_v4l2_pack_tight(cam);
+
+			retval = vidioc_int_s_fmt_cap(cam->sensor, &cam_fmt);
+			if (retval && retval != -ENOIOCTLCMD)
+				return retval;
+			cam->v2f.fmt.pix.pixelformat = f->fmt.pix.pixelformat;
+			retval = mxc_v4l2_sensor_apply(cam);
+			if (retval < 0)
+				return retval;
+			if (retval == 0 &&
+			    pack_tight != mxc_v4l2_pack_tight(cam)) {
+				cam->crop_current.top = 0;
+				cam->crop_current.left = 0;
+				mxc_v4l2_csi_update(cam);
+			}
+			retval = 0;
+		}
+
 		/*
 		 * Force the capture window resolution to be crop bounds
 		 * for CSI MEM input mode.
@@ -905,6 +1523,11 @@ static int mxc_v4l2_s_fmt(cam_data *cam, struct v4l2_format *f)
 			size = f->fmt.pix.width * f->fmt.pix.height*2;
 			bytesperline = f->fmt.pix.width*2;
 			break;
+		case IPU_PIX_FMT_GENERIC_12P:
+			pr_Dbg("###########format=IPU_PIX_FMT_GENERIC_12P\n");
+			size = f->fmt.pix.width * f->fmt.pix.height * 3 / 2;
+			bytesperline = f->fmt.pix.width * 3 / 2;
+			break;
 		default:
 			break;
 		}
@@ -1059,8 +1682,19 @@ static int mxc_v4l2_g_ctrl(cam_data *cam, struct v4l2_control *c)
 			status = -ENODEV;
 		}
 		break;
+	case V4L2_CID_MXC_CACHED_MMAP:
+		c->value = to_mxc_capture(cam)->cached;
+		break;
 	default:
-		pr_err("ERROR: v4l2 capture: unsupported ioctrl!\n");
+		/* private controls of the sensor */
+		if (cam->sensor)
+			status = vidioc_int_g_ctrl(cam->sensor, c);
+		else
+			status = -ENODEV;
+		if (status == -ENOIOCTLCMD)
+			status = -EINVAL;
+		if (status)
+			pr_err("ERROR: v4l2 capture: unsupported ioctrl!\n");
 	}
 
 	return status;
@@ -1257,9 +1891,25 @@ static int mxc_v4l2_s_ctrl(cam_data *cam, struct v4l2_control *c)
 			vidioc_int_dev_init(cam->sensor);
 		}
 		break;
+	case V4L2_CID_MXC_CACHED_MMAP:
+		/* the mappings of allocated buffers would not match */
+		if (mxc_frames_allocated(cam)) {
+			pr_err("ERROR: v4l2 capture: cached mmap can not "
+				"change with buffers allocated\n");
+			ret = -EBUSY;
+			break;
+		}
+		to_mxc_capture(cam)->cached = c->value ? 1 : 0;
+		break;
 	default:
 		pr_Dbg("   default case\n");
-		ret = -EINVAL;
+		/* private controls of the sensor */
+		if (cam->sensor)
+			ret = vidioc_int_s_ctrl(cam->sensor, c);
+		else
+			ret = -ENODEV;
+		if (ret == -ENOIOCTLCMD)
+			ret = -EINVAL;
 		break;
 	}
 
@@ -1277,10 +1927,7 @@ static int mxc_v4l2_s_ctrl(cam_data *cam, struct v4l2_control *c)
  */
 static int mxc_v4l2_s_param(cam_data *cam, struct v4l2_streamparm *parm)
 {
-	struct v4l2_ifparm ifparm;
-	struct v4l2_format cam_fmt;
 	struct v4l2_streamparm currentparm;
-	ipu_csi_signal_cfg_t csi_param;
 	u32 current_fps, parm_fps;
 	int err = 0;
 
@@ -1328,75 +1975,7 @@ static int mxc_v4l2_s_param(cam_data *cam, struct v4l2_streamparm *parm)
 	}
 
 	/* If resolution changed, need to re-program the CSI */
-	/* Get new values. */
-	vidioc_int_g_ifparm(cam->sensor, &ifparm);
-
-	csi_param.data_width = 0;
-	csi_param.clk_mode = 0;
-	csi_param.ext_vsync = 0;
-	csi_param.Vsync_pol = 0;
-	csi_param.Hsync_pol = 0;
-	csi_param.pixclk_pol = 0;
-	csi_param.data_pol = 0;
-	csi_param.sens_clksrc = 0;
-	csi_param.pack_tight = 0;
-	csi_param.force_eof = 0;
-	csi_param.data_en_pol = 0;
-	csi_param.data_fmt = 0;
-	csi_param.csi = cam->csi;
-	csi_param.mclk = 0;
-
-	pr_Dbg("   clock_curr=mclk=%d\n", ifparm.u.bt656.clock_curr);
-	if (ifparm.u.bt656.clock_curr == 0)
-		csi_param.clk_mode = IPU_CSI_CLK_MODE_CCIR656_INTERLACED;
-	else
-		csi_param.clk_mode = IPU_CSI_CLK_MODE_GATED_CLK;
-
-	csi_param.pixclk_pol = ifparm.u.bt656.latch_clk_inv;
-
-	if (ifparm.u.bt656.mode == V4L2_IF_TYPE_BT656_MODE_NOBT_8BIT)
-		csi_param.data_width = IPU_CSI_DATA_WIDTH_8;
-	else if (ifparm.u.bt656.mode == V4L2_IF_TYPE_BT656_MODE_NOBT_12BIT)
-		csi_param.data_width = IPU_CSI_DATA_WIDTH_12;
-	else
-		csi_param.data_width = IPU_CSI_DATA_WIDTH_8;
-
-	csi_param.Vsync_pol = ifparm.u.bt656.nobt_vs_inv;
-	csi_param.Hsync_pol = ifparm.u.bt656.nobt_hs_inv;
-	csi_param.ext_vsync = ifparm.u.bt656.bt_sync_correct;
-
-	/* if the capturemode changed, the size bounds will have changed. */
-	cam_fmt.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-	vidioc_int_g_fmt_cap(cam->sensor, &cam_fmt);
-	pr_Dbg("   g_fmt_cap returns widthxheight of input as %d x %d\n",
-			cam_fmt.fmt.pix.width, cam_fmt.fmt.pix.height);
-
-	csi_param.data_fmt = cam_fmt.fmt.pix.pixelformat;
-
-	cam->crop_bounds.top = cam->crop_bounds.left = 0;
-	cam->crop_bounds.width = cam_fmt.fmt.pix.width;
-	cam->crop_bounds.height = cam_fmt.fmt.pix.height;
-
-	/*
-	 * Set the default current cropped resolution to be the same with
-	 * the cropping boundary(except for tvin module).
-	 */
-	if (cam->device_type != 1) {
-		cam->crop_current.width = cam->crop_bounds.width;
-		cam->crop_current.height = cam->crop_bounds.height;
-	}
-
-	/* This essentially loses the data at the left and bottom of the image
-	 * giving a digital zoom image, if crop_current is less than the full
-	 * size of the image. */
-	ipu_csi_set_window_size(cam->ipu, cam->crop_current.width,
-				cam->crop_current.height, cam->csi);
-	ipu_csi_set_window_pos(cam->ipu, cam->crop_current.left,
-			       cam->crop_current.top,
-			       cam->csi);
-	ipu_csi_init_interface(cam->ipu, cam->crop_bounds.width,
-			       cam->crop_bounds.height,
-			       cam_fmt.fmt.pix.pixelformat, csi_param);
+	mxc_v4l2_csi_update(cam);
 
 
 exit:
@@ -1542,10 +2121,14 @@ static int mxc_v4l_dqueue(cam_data *cam, struct v4l2_buffer *buf)
 	buf->bytesused = cam->v2f.fmt.pix.sizeimage;
 	buf->index = frame->index;
 	buf->flags = frame->buffer.flags;
-	buf->m = cam->frame[frame->index].buffer.m;
-	buf->timestamp = cam->frame[frame->index].buffer.timestamp;
+	buf->m = frame->buffer.m;
+	buf->timestamp = frame->buffer.timestamp;
 	spin_unlock_irqrestore(&cam->dqueue_int_lock, lock_flags);
 
+	if (retval == 0 &&
+	    !(frame->buffer.flags & V4L2_BUF_FLAG_NO_CACHE_INVALIDATE))
+		mxc_frame_sync(cam, frame, false);
+
 	up(&cam->busy_lock);
 	return retval;
 }
@@ -1616,7 +2199,7 @@ static int mxc_v4l_open(struct file *file)
 		csi_param.data_pol = 0;
 		csi_param.ext_vsync = 0;
 
-		csi_param.pack_tight = 0;
+		csi_param.pack_tight = mxc_v4l2_pack_tight(cam);
 		csi_param.force_eof = 0;
 		csi_param.data_en_pol = 0;
 
@@ -1760,6 +2343,8 @@ static int mxc_v4l_close(struct file *file)
 		}
 
 		mxc_free_frame_buf(cam);
+		ipu_buf_pool_trim(mxc_capture_pool(cam), true);
+		to_mxc_capture(cam)->cached = 0;
 		file->private_data = NULL;
 
 		/* capture off */
@@ -1934,12 +2519,13 @@ static long mxc_v4l_do_ioctl(struct file *file,
 	 */
 	case VIDIOC_REQBUFS: {
 		struct v4l2_requestbuffers *req = arg;
+		int count_max = max(frame_max, 1);
 		pr_Dbg("   case VIDIOC_REQBUFS\n");
 
-		if (req->count > FRAME_NUM) {
+		if (req->count > count_max) {
 			pr_err("ERROR: v4l2 capture: VIDIOC_REQBUFS: "
-			       "not enough buffers\n");
-			req->count = FRAME_NUM;
+			       "limited to %d buffers\n", count_max);
+			req->count = count_max;
 		}
 
 		if ((req->type != V4L2_BUF_TYPE_VIDEO_CAPTURE)) {
@@ -1949,10 +2535,23 @@ static long mxc_v4l_do_ioctl(struct file *file,
 			break;
 		}
 
-		mxc_streamoff(cam);
-		if (req->memory & V4L2_MEMORY_MMAP) {
-			mxc_free_frame_buf(cam);
+		/* the IPU must not write into frames that go away */
+		retval = mxc_streamoff(cam);
+		if (retval)
+			break;
+		/*
+		 * Frames queued without STREAMON are still linked in
+		 * ready_q, mxc_streamoff() left it alone.
+		 */
+		mxc_free_frames(cam);
+		mxc_free_frame_buf(cam);
+		retval = mxc_frame_table(cam, req->count);
+		if (retval == 0 && (req->memory & V4L2_MEMORY_MMAP)) {
 			retval = mxc_allocate_frame_buf(cam, req->count);
+			if (retval >= 0) {
+				req->count = retval;
+				retval = 0;
+			}
 		}
 		break;
 	}
@@ -1996,36 +2595,57 @@ static long mxc_v4l_do_ioctl(struct file *file,
 	case VIDIOC_QBUF: {
 		struct v4l2_buffer *buf = arg;
 		int index = buf->index;
+		struct mxc_v4l_frame *frame;
 		//pr_Dbg("   case VIDIOC_QBUF\n");
 
+		if (index < 0 || index >= to_mxc_capture(cam)->frame_count) {
+			pr_err("ERROR: v4l2 capture: VIDIOC_QBUF: "
+			       "invalid index %d\n", index);
+			retval = -EINVAL;
+			break;
+		}
+		frame = mxc_frame(cam, index);
+
+		/* the buffer is not queued yet, the IPU can not write it */
+		if ((frame->buffer.flags & 0x7) == V4L2_BUF_FLAG_MAPPED &&
+		    !(buf->flags & V4L2_BUF_FLAG_NO_CACHE_CLEAN))
+			mxc_frame_sync(cam, frame, true);
+
 		spin_lock_irqsave(&cam->queue_int_lock, lock_flags);
-		if ((cam->frame[index].buffer.flags & 0x7) ==
-		    V4L2_BUF_FLAG_MAPPED) {
-			cam->frame[index].buffer.flags |=
-			    V4L2_BUF_FLAG_QUEUED;
-			list_add_tail(&cam->frame[index].queue,
-				      &cam->ready_q);
-		} else if (cam->frame[index].buffer.
-			   flags & V4L2_BUF_FLAG_QUEUED) {
+		if ((frame->buffer.flags & 0x7) == V4L2_BUF_FLAG_MAPPED) {
+			frame->buffer.flags &= ~(V4L2_BUF_FLAG_NO_CACHE_CLEAN |
+					V4L2_BUF_FLAG_NO_CACHE_INVALIDATE);
+			frame->buffer.flags |= V4L2_BUF_FLAG_QUEUED |
+				(buf->flags & (V4L2_BUF_FLAG_NO_CACHE_CLEAN |
+					V4L2_BUF_FLAG_NO_CACHE_INVALIDATE));
+			list_add_tail(&frame->queue, &cam->ready_q);
+		} else if (frame->buffer.flags & V4L2_BUF_FLAG_QUEUED) {
 			pr_err("ERROR: v4l2 capture: VIDIOC_QBUF: "
 			       "buffer already queued\n");
 			retval = -EINVAL;
-		} else if (cam->frame[index].buffer.
-			   flags & V4L2_BUF_FLAG_DONE) {
+		} else if (frame->buffer.flags & V4L2_BUF_FLAG_DONE) {
 			pr_err("ERROR: v4l2 capture: VIDIOC_QBUF: "
 			       "overwrite done buffer.\n");
-			cam->frame[index].buffer.flags &=
-			    ~V4L2_BUF_FLAG_DONE;
-			cam->frame[index].buffer.flags |=
-			    V4L2_BUF_FLAG_QUEUED;
+			frame->buffer.flags &= ~V4L2_BUF_FLAG_DONE;
+			frame->buffer.flags |= V4L2_BUF_FLAG_QUEUED;
 			retval = -EINVAL;
 		}
 
-		buf->flags = cam->frame[index].buffer.flags;
+		buf->flags = frame->buffer.flags;
 		spin_unlock_irqrestore(&cam->queue_int_lock, lock_flags);
 		break;
 	}
 
+	/*!
+	 * Export of a buffer as a file descriptor
+	 */
+	case MXC_VIDIOC_EXPBUF: {
+		struct mxc_v4l2_exportbuffer *eb = arg;
+		pr_Dbg("   case MXC_VIDIOC_EXPBUF\n");
+		retval = mxc_v4l2_expbuf(cam, eb);
+		break;
+	}
+
 	/*!
 	 * V4l2 VIDIOC_DQBUF ioctl
 	 */
@@ -2354,6 +2974,17 @@ static long mxc_v4l_do_ioctl(struct file *file,
 		}
 		break;
 	}
+	case VIDIOC_ENUM_FRAMEINTERVALS: {
+		struct v4l2_frmivalenum *fival = arg;
+		if (cam->sensor)
+			retval = vidioc_int_enum_frameintervals(cam->sensor,
+								fival);
+		else {
+			pr_err("ERROR: v4l2 capture: slave not found!\n");
+			retval = -ENODEV;
+		}
+		break;
+	}
 	case VIDIOC_DBG_G_CHIP_IDENT: {
 		struct v4l2_dbg_chip_ident *p = arg;
 		p->ident = V4L2_IDENT_NONE;
@@ -2366,8 +2997,27 @@ static long mxc_v4l_do_ioctl(struct file *file,
 		}
 		break;
 	}
+	case VIDIOC_QUERYCTRL: {
+		struct v4l2_queryctrl *qc = arg;
+		pr_Dbg("   case VIDIOC_QUERYCTRL\n");
+		if (qc->id == V4L2_CID_MXC_CACHED_MMAP) {
+			memset(qc, 0, sizeof(*qc));
+			qc->id = V4L2_CID_MXC_CACHED_MMAP;
+			qc->type = V4L2_CTRL_TYPE_BOOLEAN;
+			strcpy(qc->name, "Cached Mmap");
+			qc->maximum = 1;
+			qc->step = 1;
+		} else if (cam->sensor) {
+			retval = vidioc_int_queryctrl(cam->sensor, qc);
+			if (retval == -ENOIOCTLCMD)
+				retval = -EINVAL;
+		} else {
+			pr_err("ERROR: v4l2 capture: slave not found!\n");
+			retval = -ENODEV;
+		}
+		break;
+	}
 	case VIDIOC_TRY_FMT:
-	case VIDIOC_QUERYCTRL:
 	case VIDIOC_G_TUNER:
 	case VIDIOC_S_TUNER:
 	case VIDIOC_G_FREQUENCY:
@@ -2398,6 +3048,9 @@ static long mxc_v4l_ioctl(struct file *file, unsigned int cmd,
 /*!
  * V4L interface - mmap function
  *
+ * The mapping is write-combined, or cacheable with V4L2_CID_MXC_CACHED_MMAP
+ * set.
+ *
  * @param file        structure file *
  *
  * @param vma         structure vm_area_struct *
@@ -2420,7 +3073,8 @@ static int mxc_mmap(struct file *file, struct vm_area_struct *vma)
 		return -EINTR;
 
 	size = vma->vm_end - vma->vm_start;
-	vma->vm_page_prot = pgprot_writecombine(vma->vm_page_prot);
+	if (!to_mxc_capture(cam)->cached)
+		vma->vm_page_prot = pgprot_writecombine(vma->vm_page_prot);
 
 	if (remap_pfn_range(vma, vma->vm_start,
 			    vma->vm_pgoff, size, vma->vm_page_prot)) {
@@ -2444,24 +3098,29 @@ static int mxc_mmap(struct file *file, struct vm_area_struct *vma)
  *
  * @param wait       structure poll_table_struct *
  *
- * @return  status   POLLIN | POLLRDNORM
+ * Readable once a frame has completed, POLLERR while the stream is off.
+ * The camera callback wakes the queue once per completed frame. Does not
+ * take busy_lock, so a poll never waits for an ioctl in progress.
+ *
+ * @return  status   POLLIN | POLLRDNORM, POLLERR or 0
  */
 static unsigned int mxc_poll(struct file *file, struct poll_table_struct *wait)
 {
 	struct video_device *dev = video_devdata(file);
 	cam_data *cam = video_get_drvdata(dev);
-	wait_queue_head_t *queue = NULL;
-	int res = POLLIN | POLLRDNORM;
+	unsigned long lock_flags;
+	unsigned int res = 0;
 
 	pr_Dbg("In MVC:mxc_poll\n");
 
-	if (down_interruptible(&cam->busy_lock))
-		return -EINTR;
-
-	queue = &cam->enc_queue;
-	poll_wait(file, queue, wait);
+	poll_wait(file, &cam->enc_queue, wait);
 
-	up(&cam->busy_lock);
+	spin_lock_irqsave(&cam->dqueue_int_lock, lock_flags);
+	if (cam->enc_counter > 0)
+		res = POLLIN | POLLRDNORM;
+	else if (!cam->capture_on)
+		res = POLLERR;
+	spin_unlock_irqrestore(&cam->dqueue_int_lock, lock_flags);
 
 	return res;
 }
@@ -2703,6 +3362,25 @@ static ssize_t show_csi(struct device *dev,
 }
 static DEVICE_ATTR(fsl_csi_property, S_IRUGO, show_csi, NULL);
 
+static ssize_t show_pool(struct device *dev,
+			struct device_attribute *attr, char *buf)
+{
+	struct video_device *video_dev = container_of(dev,
+						struct video_device, dev);
+	cam_data *cam = video_get_drvdata(video_dev);
+	struct ipu_buf_pool *pool = mxc_capture_pool(cam);
+	ssize_t len;
+
+	mutex_lock(&pool->lock);
+	len = sprintf(buf, "idle %d bytes %zu hits %lu misses %lu "
+		      "reserved %d\n", pool->count, pool->bytes, pool->hits,
+		      pool->misses, pool->reserved);
+	mutex_unlock(&pool->lock);
+
+	return len;
+}
+static DEVICE_ATTR(fsl_buf_pool_property, S_IRUGO, show_pool, NULL);
+
 /*!
  * This function is called to probe the devices if registered.
  *
@@ -2714,13 +3392,31 @@ static DEVICE_ATTR(fsl_csi_property, S_IRUGO, show_csi, NULL);
 static int mxc_v4l2_probe(struct platform_device *pdev)
 {
 	/* Create cam and initialize it. */
-	cam_data *cam = kmalloc(sizeof(cam_data), GFP_KERNEL);
-	if (cam == NULL) {
+	struct mxc_capture *mc = kzalloc(sizeof(*mc), GFP_KERNEL);
+	cam_data *cam;
+
+	if (mc == NULL) {
 		pr_err("ERROR: v4l2 capture: failed to register camera\n");
 		return -1;
 	}
+	cam = &mc->cam;
+	kref_init(&mc->ref);
+	mc->dev = &pdev->dev;
 
 	init_camera_struct(cam, pdev);
+	/* USERPTR users may skip VIDIOC_REQBUFS */
+	if (mxc_frame_table(cam, FRAME_NUM)) {
+		kfree(mc);
+		return -1;
+	}
+
+	ipu_buf_pool_init(&mc->pool);
+	if (mxc_pool_keep()) {
+		int n = ipu_buf_pool_reserve(&mc->pool, pool_reserve,
+					     pool_reserve_size);
+		pr_info("v4l2 capture: reserved %d of %d buffers of %d bytes\n",
+			n, pool_reserve, pool_reserve_size);
+	}
 	pdev->dev.release = camera_platform_release;
 
 	/* Set up the v4l2 device and register it*/
@@ -2730,7 +3426,10 @@ static int mxc_v4l2_probe(struct platform_device *pdev)
 	/* register v4l video device */
 	if (video_register_device(cam->video_dev, VFL_TYPE_GRABBER, video_nr)
 	    == -1) {
-		kfree(cam);
+		ipu_buf_pool_trim(&mc->pool, false);
+		kfree(mc->exports);
+		kfree(mc->frames);
+		kfree(mc);
 		cam = NULL;
 		pr_err("ERROR: v4l2 capture: video_register_device failed\n");
 		return -1;
@@ -2753,6 +3452,11 @@ static int mxc_v4l2_probe(struct platform_device *pdev)
 		dev_err(&pdev->dev, "Error on creating sysfs file"
 			" for csi number\n");
 
+	if (device_create_file(&cam->video_dev->dev,
+			&dev_attr_fsl_buf_pool_property))
+		dev_err(&pdev->dev, "Error on creating sysfs file"
+			" for buffer pool\n");
+
 	return 0;
 }
 
@@ -2778,13 +3482,20 @@ static int mxc_v4l2_remove(struct platform_device *pdev)
 			&dev_attr_fsl_v4l2_overlay_property);
 		device_remove_file(&cam->video_dev->dev,
 			&dev_attr_fsl_csi_property);
+		device_remove_file(&cam->video_dev->dev,
+			&dev_attr_fsl_buf_pool_property);
 
 		pr_info("V4L2 freeing image input device\n");
 		v4l2_int_device_unregister(cam->self);
 		video_unregister_device(cam->video_dev);
 
+		/*
+		 * Exported buffers keep the pool and the device for their
+		 * DMA mappings until they go back.
+		 */
 		mxc_free_frame_buf(cam);
-		kfree(cam);
+		get_device(&pdev->dev);
+		kref_put(&to_mxc_capture(cam)->ref, mxc_capture_release);
 	}
 
 	pr_info("V4L2 unregistering video\n");
@@ -3038,6 +3749,12 @@ module_init(camera_init);
 module_exit(camera_exit);
 
 module_param(video_nr, int, 0444);
+module_param(frame_max, int, 0644);
+MODULE_PARM_DESC(frame_max, "Maximum number of capture buffers");
+module_param(pool_reserve, int, 0444);
+MODULE_PARM_DESC(pool_reserve, "Buffers reserved at probe");
+module_param(pool_reserve_size, int, 0444);
+MODULE_PARM_DESC(pool_reserve_size, "Bytes per reserved buffer");
 MODULE_AUTHOR("Freescale Semiconductor, Inc.");
 MODULE_DESCRIPTION("V4L2 capture driver for Mxc based cameras");
 MODULE_LICENSE("GPL");
@@ -1170,6 +1170,9 @@ int32_t ipu_init_channel_buffer(struct ipu_soc *ipu, ipu_channel_t channel,
 			((_ipu_ch_param_get_bpp(ipu, dma_chan) == 5) ||
 			(_ipu_ch_param_get_bpp(ipu, dma_chan) == 3)))
 			burst_size = burst_size >> 4;
+		else if (pixel_fmt == IPU_PIX_FMT_GENERIC_12P)
+			/* 12 bits per pixel, in 128 bit words */
+			burst_size = burst_size * 3 / 32;
 		else
 			burst_size = burst_size >> 2;
 		_ipu_smfc_set_burst_size(ipu, channel, burst_size-1);
@@ -291,6 +291,13 @@ static inline void _ipu_ch_param_init(struct ipu_soc *ipu, int ch,
 		ipu_ch_param_set_field(&params, 1, 85, 4, 6);   /* pix format */
 		ipu_ch_param_set_field(&params, 1, 78, 7, 7);   /* burst size */
 
+		break;
+	case IPU_PIX_FMT_GENERIC_12P:
+		/*Represents 12-bit Generic data, 2 pixels in 3 bytes */
+		ipu_ch_param_set_field(&params, 0, 107, 3, 4);	/* bits/pixel */
+		ipu_ch_param_set_field(&params, 1, 85, 4, 6);	/* pix format */
+		ipu_ch_param_set_field(&params, 1, 78, 7, 31);	/* burst size */
+
 		break;
 	case IPU_PIX_FMT_GENERIC_32:
 		/*Represents 32-bit Generic data */
@@ -703,6 +710,7 @@ static inline void _ipu_ch_offset_update(struct ipu_soc *ipu,
 	switch (pixel_fmt) {
 	case IPU_PIX_FMT_GENERIC:
 	case IPU_PIX_FMT_GENERIC_16:
+	case IPU_PIX_FMT_GENERIC_12P:
 	case IPU_PIX_FMT_GENERIC_32:
 	case IPU_PIX_FMT_RGB565:
 	case IPU_PIX_FMT_BGR24:
@@ -0,0 +1,84 @@
+/*
+ * include/linux/mxc_capture_buf.h
+ *
+ * Buffer export and cache control of the i.MX V4L2 capture driver
+ *
+ * Copyright (C) 2013 Aptina Imaging
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+/*
+ * The ioctls, controls and buffer flags of drivers/media/video/mxc/capture
+ * that user space uses. Installed with make headers_install, the line
+ * header-y += mxc_capture_buf.h goes into include/linux/Kbuild.
+ */
+
+#ifndef __LINUX_MXC_CAPTURE_BUF_H__
+#define __LINUX_MXC_CAPTURE_BUF_H__
+
+#include <linux/types.h>
+#include <linux/ioctl.h>
+#include <linux/videodev2.h>
+
+/*
+ * Export of a MMAP buffer as a file descriptor, like VIDIOC_EXPBUF of later
+ * kernels. The descriptor can be mapped, passed to another process and
+ * asked for the bus address with MXC_CAPTURE_BUF_INFO. The buffer stays
+ * allocated as long as a descriptor or an importer holds it, also after
+ * VIDIOC_REQBUFS or close of the capture device.
+ */
+struct mxc_v4l2_exportbuffer {
+	__u32 type;		/* V4L2_BUF_TYPE_VIDEO_CAPTURE */
+	__u32 index;
+	__u32 flags;		/* O_CLOEXEC */
+	__s32 fd;		/* returned */
+	__u32 reserved[4];
+};
+
+struct mxc_capture_buf_info {
+	__u32 paddr;
+	__u32 size;
+};
+
+#define MXC_VIDIOC_EXPBUF	_IOWR('V', BASE_VIDIOC_PRIVATE + 0, \
+				      struct mxc_v4l2_exportbuffer)
+#define MXC_CAPTURE_BUF_INFO	_IOR('V', BASE_VIDIOC_PRIVATE + 1, \
+				     struct mxc_capture_buf_info)
+
+/*
+ * With the control set, the MMAP buffers are allocated as normal pages and
+ * mmap() of the capture device maps them cacheable. The driver invalidates
+ * the cache for a buffer on VIDIOC_QBUF and again on VIDIOC_DQBUF. The
+ * flags below, given to VIDIOC_QBUF, skip one or both for that buffer. The
+ * control can only change while no MMAP buffers are allocated, and is
+ * cleared on close.
+ */
+#define V4L2_CID_MXC_CACHED_MMAP	(V4L2_CID_PRIVATE_BASE + 16)
+
+/* the values of later kernels */
+#ifndef V4L2_BUF_FLAG_NO_CACHE_INVALIDATE
+#define V4L2_BUF_FLAG_NO_CACHE_INVALIDATE	0x0800	/* on VIDIOC_DQBUF */
+#endif
+#ifndef V4L2_BUF_FLAG_NO_CACHE_CLEAN
+#define V4L2_BUF_FLAG_NO_CACHE_CLEAN		0x1000	/* on VIDIOC_QBUF */
+#endif
+
+#ifdef __KERNEL__
+/* exported buffer, for importers in the kernel */
+struct mxc_capture_buf;
+
+struct mxc_capture_buf *mxc_capture_buf_get(int fd, dma_addr_t *paddr,
+					    size_t *size);
+void mxc_capture_buf_put(struct mxc_capture_buf *buf);
+#endif
+
+#endif /* __LINUX_MXC_CAPTURE_BUF_H__ */
@@ -0,0 +1,427 @@
+/*
+ * Copyright (C) 2013 Aptina Imaging
+ */
+
+/*
+ * The code contained herein is licensed under the GNU General Public
+ * License. You may obtain a copy of the GNU General Public License
+ * Version 2 or later at the following locations:
+ *
+ * http://www.opensource.org/licenses/gpl-license.html
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+/*
+ * @file bringup_poll_test.c
+ *
+ * @brief Host test of the MT9M024 readiness polling
+ *
+ * Runs the waits of mt9m024_config() against a fake sensor with a model of
+ * the hardware reset, the soft reset, the standby and the frame counter,
+ * once with the fixed sleeps the driver had before and once with the
+ * polling of mt9m024_poll_reg() and mt9m024_wait_frame(). Checks that every
+ * wait ends within one back-off step of the event it waits for, that a
+ * frame wait costs a bounded number of reads and that a sensor which never
+ * answers times out after APT_MT9M024_READY_TIMEOUT_MS. Build on the host
+ * with
+ *
+ * gcc -Wall -Wextra -Ihost -I../kernel/drivers/media/video/mxc/capture
+ *	bringup_poll_test.c -o bringup_poll_test
+ */
+
+#include "kernel_host.h"
+#include "fake_i2c.h"
+KERNEL_HOST_BEGIN
+#include "sensor_i2c_batch.h"
+KERNEL_HOST_END
+#include "mt9m024.h"
+#include "mt9m024_sequencer.h"
+
+/* sensor timing of the model */
+#define MODEL_POWERUP_NS	6000000ULL	/* 160000 EXTCLK cycles */
+#define MODEL_SOFT_RESET_NS	1000000ULL
+#define MODEL_PLL_LOCK_NS	1000000ULL
+#define MODEL_FRAME_NS		22222222ULL	/* 45 fps */
+
+struct sensor_model {
+	bool streaming;
+	u64 reset_done_ns;	/* soft reset bit clears */
+	u64 standby_ns;		/* standby reached, when not streaming */
+	u64 pll_lock_ns;
+	u64 first_frame_ns;	/* end of the first frame of the stream */
+	u16 frames;		/* frames of earlier streams */
+	u64 event_ns;		/* last event a wait may be waiting for */
+};
+
+static struct fake_sensor *g_sensor;
+static struct sensor_model g_model;
+static unsigned int g_reads;
+static int g_failed;
+
+#define CHECK(cond)							\
+	do {								\
+		if (!(cond)) {						\
+			printf("%s:%d: check failed: %s\n",		\
+			       __FILE__, __LINE__, #cond);		\
+			g_failed = 1;					\
+		}							\
+	} while (0)
+
+static u16 model_frames(struct sensor_model *sm)
+{
+	if (!sm->streaming || host_now_ns < sm->first_frame_ns)
+		return sm->frames;
+	return sm->frames +
+		(host_now_ns - sm->first_frame_ns) / MODEL_FRAME_NS + 1;
+}
+
+static void model_written(struct fake_sensor *fs, u16 reg, int len)
+{
+	struct sensor_model *sm = fs->priv;
+	u16 val;
+
+	if (len != 2)
+		return;
+	val = fake_sensor_get16(fs, reg);
+
+	if (reg == APT_MT9M024_PLL_MULTIPLIER) {
+		sm->pll_lock_ns = host_now_ns + MODEL_PLL_LOCK_NS;
+		return;
+	}
+	if (reg != APT_MT9M024_RESET_REGISTER)
+		return;
+
+	if (val & APT_MT9M024_RESET_REGISTER_RESET) {
+		sm->streaming = false;
+		sm->reset_done_ns = host_now_ns + MODEL_SOFT_RESET_NS;
+		sm->standby_ns = sm->reset_done_ns;
+		sm->event_ns = sm->reset_done_ns;
+	} else if ((val & APT_MT9M024_RESET_REGISTER_STREAM) &&
+		   !sm->streaming) {
+		sm->streaming = true;
+		sm->first_frame_ns = max(host_now_ns, sm->pll_lock_ns) +
+			MODEL_FRAME_NS;
+		sm->event_ns = sm->first_frame_ns;
+	} else if (!(val & APT_MT9M024_RESET_REGISTER_STREAM) &&
+		   sm->streaming) {
+		/* the frame being read out is finished first */
+		sm->frames = model_frames(sm);
+		sm->streaming = false;
+		sm->standby_ns = host_now_ns < sm->first_frame_ns ?
+			sm->first_frame_ns : host_now_ns + MODEL_FRAME_NS -
+			(host_now_ns - sm->first_frame_ns) % MODEL_FRAME_NS;
+		sm->event_ns = sm->standby_ns;
+	}
+}
+
+static void model_reading(struct fake_sensor *fs, u16 reg, int len)
+{
+	struct sensor_model *sm = fs->priv;
+	u16 val;
+
+	(void)len;
+	g_reads++;
+	switch (reg) {
+	case APT_MT9M024_RESET_REGISTER:
+		val = fake_sensor_get16(fs, reg);
+		if (host_now_ns >= sm->reset_done_ns)
+			val &= ~APT_MT9M024_RESET_REGISTER_RESET;
+		fake_sensor_set16(fs, reg, val);
+		break;
+	case APT_MT9M024_FRAME_STATUS:
+		fake_sensor_set16(fs, reg, !sm->streaming &&
+				  host_now_ns >= sm->standby_ns ?
+				  APT_MT9M024_FRAME_STATUS_STANDBY : 0);
+		break;
+	case APT_MT9M024_FRAME_COUNT_:
+		fake_sensor_set16(fs, reg, model_frames(sm));
+		break;
+	}
+}
+
+/* camera_plat->io_init: the reset line, the sensor answers after power up */
+static void model_hw_reset(void)
+{
+	memset(&g_model, 0, sizeof(g_model));
+	memset(g_sensor->mem, 0, sizeof(g_sensor->mem));
+	fake_sensor_set16(g_sensor, APT_MT9M024_MODEL_ID_, 0x2400);
+	fake_sensor_set16(g_sensor, APT_MT9M024_RESET_REGISTER, 0x10D8);
+	g_sensor->nak_until_ns = host_now_ns + MODEL_POWERUP_NS;
+	g_model.standby_ns = g_sensor->nak_until_ns;
+	g_model.event_ns = g_sensor->nak_until_ns;
+}
+
+/* the accessors, as in mt9m024.c without the shadow cache */
+static int mt9m024_write_reg(u16 reg, u16 val)
+{
+	u8 buf[4] = { reg >> 8, reg & 0xff, val >> 8, val & 0xff };
+
+	return i2c_master_send(&g_sensor->client, (char *)buf, 4) == 4 ?
+		0 : -1;
+}
+
+static int mt9m024_read_reg_nocache(u16 reg, u16 *val)
+{
+	u8 regbuf[2] = { reg >> 8, reg & 0xff };
+	u8 readval[2];
+
+	if (i2c_master_send(&g_sensor->client, (char *)regbuf, 2) != 2 ||
+	    i2c_master_recv(&g_sensor->client, (char *)readval, 2) != 2)
+		return -1;
+	*val = (readval[0] << 8) | readval[1];
+	return 0;
+}
+
+static int mt9m024_update_reg(u16 reg, u16 mask, u16 val)
+{
+	u16 regval;
+
+	if (mt9m024_read_reg_nocache(reg, &regval))
+		return -1;
+	return mt9m024_write_reg(reg, (regval & ~mask) | (val & mask));
+}
+
+/* the waits, as in mt9m024.c */
+static void mt9m024_backoff(unsigned long *step)
+{
+	usleep_range(*step, *step * 2);
+	*step = min(*step * 2, (unsigned long)APT_MT9M024_POLL_MAX_US);
+}
+
+static int mt9m024_poll_reg(u16 reg, u16 mask, u16 val,
+			    unsigned int timeout_ms)
+{
+	unsigned long timeout = jiffies + msecs_to_jiffies(timeout_ms);
+	unsigned long step = APT_MT9M024_POLL_MIN_US;
+	u16 regval;
+
+	for (;;) {
+		if (!mt9m024_read_reg_nocache(reg, &regval) &&
+		    (regval & mask) == val)
+			return 0;
+		if (time_after(jiffies, timeout))
+			return -ETIMEDOUT;
+		mt9m024_backoff(&step);
+	}
+}
+
+static int mt9m024_wait_frame(unsigned int timeout_ms)
+{
+	unsigned long timeout = jiffies + msecs_to_jiffies(timeout_ms);
+	unsigned long step = APT_MT9M024_POLL_MIN_US;
+	u16 start, regval;
+
+	if (mt9m024_read_reg_nocache(APT_MT9M024_FRAME_COUNT_, &start))
+		return -EIO;
+
+	for (;;) {
+		mt9m024_backoff(&step);
+		if (!mt9m024_read_reg_nocache(APT_MT9M024_FRAME_COUNT_,
+					      &regval) &&
+		    regval != start)
+			return 0;
+		if (time_after(jiffies, timeout))
+			return -ETIMEDOUT;
+	}
+}
+
+static int load_sequencer(void)
+{
+	struct sensor_i2c_batch batch;
+	const u16 *vals = MT9M024sequencerReg;
+	int count = ARRAY_SIZE(MT9M024sequencerReg);
+	int n;
+
+	if (mt9m024_write_reg(APT_MT9M024_SEQ_CTRL_PORT, 0x8000))
+		return -1;
+	sensor_i2c_batch_init(&batch, &g_sensor->client, NULL, 0);
+	while (count > 0) {
+		n = min(count, APT_MT9M024_BURST_WORDS);
+		if (sensor_i2c_batch_write_words(&batch,
+				APT_MT9M024_SEQ_DATA_PORT, vals, n, true))
+			return -1;
+		vals += n;
+		count -= n;
+	}
+	return sensor_i2c_batch_flush(&batch);
+}
+
+/*
+ * One read and the last back-off step after the event at most. A wait
+ * that did not succeed fails the test.
+ */
+static void check_wait(int ret, const char *what)
+{
+	/* address write and two data bytes, plus a NAK in reset */
+	u64 read_ns = 2 * g_sensor->wakeup_ns +
+		(19 + 28) * 1000000000ULL / g_sensor->bus_hz;
+
+	if (ret) {
+		printf("%s: wait failed\n", what);
+		g_failed = 1;
+		return;
+	}
+	if (host_now_ns < g_model.event_ns ||
+	    host_now_ns - g_model.event_ns >
+	    APT_MT9M024_POLL_MAX_US * 1000ULL + 2 * read_ns) {
+		printf("%s: ready after %lld us\n", what,
+		       (long long)(host_now_ns - g_model.event_ns) / 1000);
+		g_failed = 1;
+	}
+}
+
+static void phase(const char *name, u64 *stamp)
+{
+	printf("  %-10s %7llu us\n", name,
+	       (unsigned long long)(host_now_ns - *stamp) / 1000);
+	*stamp = host_now_ns;
+}
+
+/* the waits of mt9m024_config(), fixed sleeps or polled */
+static int bringup(bool polled)
+{
+	u64 stamp = host_now_ns;
+	unsigned int reads;
+
+	model_hw_reset();
+	if (polled)
+		check_wait(mt9m024_poll_reg(APT_MT9M024_MODEL_ID_, 0xffff,
+				0x2400, APT_MT9M024_READY_TIMEOUT_MS),
+			   "hardware reset");
+	else
+		msleep(200);
+	if (mt9m024_write_reg(APT_MT9M024_RESET_REGISTER,
+			      APT_MT9M024_RESET_REGISTER_RESET))
+		return -1;
+	if (polled)
+		check_wait(mt9m024_poll_reg(APT_MT9M024_RESET_REGISTER,
+				APT_MT9M024_RESET_REGISTER_RESET, 0,
+				APT_MT9M024_READY_TIMEOUT_MS),
+			   "soft reset");
+	else
+		msleep(200);
+	if (mt9m024_write_reg(APT_MT9M024_RESET_REGISTER, 0x10D8))
+		return -1;
+	if (polled)
+		check_wait(mt9m024_poll_reg(APT_MT9M024_FRAME_STATUS,
+				APT_MT9M024_FRAME_STATUS_STANDBY,
+				APT_MT9M024_FRAME_STATUS_STANDBY,
+				APT_MT9M024_READY_TIMEOUT_MS),
+			   "standby");
+	else
+		msleep(200);
+	phase("reset", &stamp);
+
+	if (load_sequencer() || mt9m024_write_reg(0x309e, 0x0186))
+		return -1;
+	if (!polled)
+		msleep(200);
+	phase("sequencer", &stamp);
+
+	if (mt9m024_update_reg(APT_MT9M024_RESET_REGISTER,
+			       APT_MT9M024_RESET_REGISTER_STREAM,
+			       APT_MT9M024_RESET_REGISTER_STREAM))
+		return -1;
+	reads = g_reads;
+	if (polled) {
+		check_wait(mt9m024_wait_frame(APT_MT9M024_READY_TIMEOUT_MS),
+			   "presets frame");
+		/* ramp up to the longest step, then one per step */
+		CHECK(g_reads - reads <= 2 + (unsigned int)fls(
+			APT_MT9M024_POLL_MAX_US / APT_MT9M024_POLL_MIN_US) +
+			MODEL_FRAME_NS / (APT_MT9M024_POLL_MAX_US * 1000));
+	} else {
+		msleep(200);
+	}
+	if (mt9m024_update_reg(APT_MT9M024_RESET_REGISTER,
+			       APT_MT9M024_RESET_REGISTER_STREAM, 0))
+		return -1;
+	phase("presets", &stamp);
+
+	/* APTsetPLL() */
+	if (mt9m024_write_reg(APT_MT9M024_PRE_PLL_CLK_DIV, 2) ||
+	    mt9m024_write_reg(APT_MT9M024_VT_SYS_CLK_DIV, 1) ||
+	    mt9m024_write_reg(APT_MT9M024_VT_PIX_CLK_DIV, 8) ||
+	    mt9m024_write_reg(APT_MT9M024_PLL_MULTIPLIER, 44))
+		return -1;
+	if (polled)
+		usleep_range(1000, 2000);
+	else
+		msleep(100);
+	if (mt9m024_write_reg(APT_MT9M024_RESET_REGISTER, 0x10DC))
+		return -1;
+	phase("pll", &stamp);
+
+	if (polled)
+		check_wait(mt9m024_wait_frame(APT_MT9M024_READY_TIMEOUT_MS),
+			   "first frame");
+	phase("stream", &stamp);
+	return 0;
+}
+
+static u64 run(bool polled)
+{
+	u64 start = host_now_ns;
+
+	printf("%s:\n", polled ? "polled" : "fixed sleeps");
+	g_reads = 0;
+	fake_sensor_clear_stats(g_sensor);
+	if (bringup(polled)) {
+		printf("bring-up failed\n");
+		g_failed = 1;
+	}
+	printf("  %-10s %7llu us, %u transfers, %u reads\n", "total",
+	       (unsigned long long)(host_now_ns - start) / 1000,
+	       g_sensor->transfers, g_reads);
+	return host_now_ns - start;
+}
+
+/* a sensor that never leaves reset */
+static void test_timeout(void)
+{
+	u64 start, elapsed;
+	int ret;
+
+	model_hw_reset();
+	g_sensor->nak_until_ns = ~0ULL;
+	start = host_now_ns;
+	ret = mt9m024_poll_reg(APT_MT9M024_MODEL_ID_, 0xffff, 0x2400,
+			       APT_MT9M024_READY_TIMEOUT_MS);
+	elapsed = host_now_ns - start;
+	printf("no sensor: %d after %llu us\n", ret,
+	       (unsigned long long)elapsed / 1000);
+
+	CHECK(ret == -ETIMEDOUT);
+	/* the jiffy rounding on both ends and one step more */
+	CHECK(elapsed >= APT_MT9M024_READY_TIMEOUT_MS * 1000000ULL);
+	CHECK(elapsed <= (APT_MT9M024_READY_TIMEOUT_MS + 2 * 1000 / HZ) *
+		1000000ULL + APT_MT9M024_POLL_MAX_US * 1000ULL);
+	g_sensor->nak_until_ns = 0;
+}
+
+int main(void)
+{
+	u64 fixed, polled;
+
+	g_sensor = fake_sensor_new(0x10);
+	if (g_sensor == NULL) {
+		printf("out of memory\n");
+		return -1;
+	}
+	fake_sensor_add_port(g_sensor, APT_MT9M024_SEQ_DATA_PORT);
+	g_sensor->written = model_written;
+	g_sensor->reading = model_reading;
+	g_sensor->priv = &g_model;
+
+	fixed = run(false);
+	polled = run(true);
+	/* the fixed sleeps alone are 1.1 s */
+	CHECK(fixed >= 1100000000ULL);
+	CHECK(5 * polled < fixed);
+
+	test_timeout();
+	free(g_sensor);
+
+	printf("%s\n", g_failed ? "FAILED" : "passed");
+	return g_failed ? -1 : 0;
+}
@@ -0,0 +1,572 @@
+/*
+ * Copyright (C) 2013 Aptina Imaging
+ */
+
+/*
+ * The code contained herein is licensed under the GNU General Public
+ * License. You may obtain a copy of the GNU General Public License
+ * Version 2 or later at the following locations:
+ *
+ * http://www.opensource.org/licenses/gpl-license.html
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+/*
+ * @file export_lifetime_test.c
+ *
+ * @brief Host test of the lifetime of exported capture buffers
+ *
+ * Runs the buffer export of mxc_v4l2_capture.c with ipu_buf_pool.h
+ * unchanged: frames are allocated, exported to files, imported by a
+ * software importer and freed with VIDIOC_REQBUFS while they are queued,
+ * held by the application or streaming. Checks that
+ *  - an exported buffer keeps its memory and contents until the last of
+ *    the frame, its files and its importers lets go of it, in any order,
+ *  - the memory then goes back exactly once, coherent frames to the
+ *    buffer pool and cacheable frames to the page allocator,
+ *  - new frames never get memory that is still exported,
+ *  - a failed export leaves no reference behind,
+ *  - closing the device keeps the boot reservation of the pool however
+ *    the reserved buffers moved through the idle list,
+ *  - removing the device leaves the pool to exported buffers and frees it
+ *    after the last one,
+ * and that nothing is left allocated at the end. Build on the host with
+ *
+ * gcc -Wall -Wextra -Ihost -I../kernel/drivers/media/video/mxc/capture
+ *	export_lifetime_test.c -o export_lifetime_test
+ */
+
+#include "kernel_host.h"
+KERNEL_HOST_BEGIN
+#include "ipu_buf_pool.h"
+KERNEL_HOST_END
+
+#define ERR_PTR(err)		((void *)(long)(err))
+
+/* as in videodev2.h */
+#define V4L2_MEMORY_MMAP	1
+#define V4L2_BUF_FLAG_MAPPED	0x0001
+#define V4L2_BUF_FLAG_QUEUED	0x0002
+#define V4L2_BUF_FLAG_DONE	0x0004
+
+#define MODEL_FRAMES		4
+#define MODEL_FRAME_SIZE	(1280 * 960 * 2)	/* Y16 */
+
+struct mxc_v4l_frame {
+	struct {
+		u32 flags;
+		u32 length;
+		int memory;
+	} buffer;
+	void *vaddress;
+	dma_addr_t paddress;
+};
+
+/* the part of struct mxc_capture the buffers use */
+struct mxc_capture {
+	struct kref ref;
+	struct device *dev;
+	struct mxc_v4l_frame frames[MODEL_FRAMES];
+	struct mxc_capture_buf *exports[MODEL_FRAMES];
+	int frame_slots;
+	int frame_count;
+	int cached;
+	struct ipu_buf_pool pool;
+};
+
+static struct device g_dev = { "mxc_v4l2_capture" };
+static struct mxc_capture g_mc;
+static unsigned int g_releases;		/* of exported buffers */
+static unsigned int g_removed;		/* device data freed */
+static bool g_fail_getfd;
+static int g_failed;
+
+#define CHECK(cond)							\
+	do {								\
+		if (!(cond)) {						\
+			printf("%s:%d: check failed: %s\n",		\
+			       __FILE__, __LINE__, #cond);		\
+			g_failed = 1;					\
+		}							\
+	} while (0)
+
+/* as in mxc_v4l2_capture.c */
+static void *mxc_frame_mem_alloc(struct mxc_capture *mc, size_t size,
+				 dma_addr_t *paddr, gfp_t gfp)
+{
+	void *vaddr;
+
+	if (!mc->cached)
+		return ipu_buf_pool_get(&mc->pool, size, paddr, gfp);
+
+	vaddr = alloc_pages_exact(size, gfp);
+	if (vaddr == NULL)
+		return NULL;
+	*paddr = dma_map_single(mc->dev, vaddr, size, DMA_FROM_DEVICE);
+	if (dma_mapping_error(mc->dev, *paddr)) {
+		free_pages_exact(vaddr, size);
+		return NULL;
+	}
+	return vaddr;
+}
+
+static void mxc_frame_pages_free(struct device *dev, void *vaddr,
+				 dma_addr_t paddr, size_t size)
+{
+	dma_unmap_single(dev, paddr, size, DMA_FROM_DEVICE);
+	free_pages_exact(vaddr, size);
+}
+
+/* g_mc is static, the pool is checked in place of kfree() */
+static void mxc_capture_release(struct kref *ref)
+{
+	struct mxc_capture *mc = container_of(ref, struct mxc_capture, ref);
+
+	ipu_buf_pool_trim(&mc->pool, false);
+	g_removed++;
+}
+
+struct mxc_capture_buf {
+	struct kref ref;
+	void *vaddr;
+	dma_addr_t paddr;
+	size_t size;
+	struct mxc_capture *mc;
+	int cached;
+};
+
+static void mxc_capture_buf_release(struct kref *ref)
+{
+	struct mxc_capture_buf *buf =
+	    container_of(ref, struct mxc_capture_buf, ref);
+	struct mxc_capture *mc = buf->mc;
+
+	g_releases++;
+	if (buf->cached)
+		mxc_frame_pages_free(mc->dev, buf->vaddr, buf->paddr,
+				     buf->size);
+	else
+		ipu_buf_pool_put(&mc->pool, buf->vaddr, buf->paddr,
+				 buf->size);
+	kfree(buf);
+	kref_put(&mc->ref, mxc_capture_release);
+}
+
+/* close of the last descriptor of an exported file */
+static void buf_file_close(struct file *file)
+{
+	struct mxc_capture_buf *buf = file->private_data;
+
+	kref_put(&buf->ref, mxc_capture_buf_release);
+	free(file);
+}
+
+/* mxc_capture_buf_get() of the file behind the descriptor */
+static struct mxc_capture_buf *mxc_capture_buf_get(struct file *file,
+		dma_addr_t *paddr, size_t *size)
+{
+	struct mxc_capture_buf *buf = file->private_data;
+
+	kref_get(&buf->ref);
+	*paddr = buf->paddr;
+	*size = buf->size;
+	return buf;
+}
+
+static void mxc_capture_buf_put(struct mxc_capture_buf *buf)
+{
+	kref_put(&buf->ref, mxc_capture_buf_release);
+}
+
+static int mxc_free_frame_buf(struct mxc_capture *mc)
+{
+	struct mxc_v4l_frame *frame;
+	struct mxc_capture_buf *buf;
+	int i;
+
+	for (i = 0; i < mc->frame_slots; i++) {
+		frame = &mc->frames[i];
+		buf = mc->exports[i];
+		mc->exports[i] = NULL;
+		if (buf != NULL) {
+			kref_put(&buf->ref, mxc_capture_buf_release);
+			frame->vaddress = 0;
+			continue;
+		}
+		if (frame->vaddress == 0)
+			continue;
+		if (mc->cached)
+			mxc_frame_pages_free(mc->dev, frame->vaddress,
+					     frame->paddress,
+					     frame->buffer.length);
+		else
+			ipu_buf_pool_put(&mc->pool, frame->vaddress,
+					 frame->paddress, frame->buffer.length);
+		frame->vaddress = 0;
+	}
+
+	return 0;
+}
+
+/* MXC_VIDIOC_EXPBUF, the file in place of the descriptor */
+static struct file *mxc_v4l2_expbuf(struct mxc_capture *mc, int index)
+{
+	struct mxc_v4l_frame *frame;
+	struct mxc_capture_buf *buf;
+	struct file *file;
+
+	if (index >= mc->frame_count)
+		return ERR_PTR(-EINVAL);
+	frame = &mc->frames[index];
+	if (frame->buffer.memory != V4L2_MEMORY_MMAP ||
+	    frame->vaddress == 0)
+		return ERR_PTR(-EINVAL);
+
+	buf = mc->exports[index];
+	if (buf == NULL) {
+		buf = kmalloc(sizeof(*buf), GFP_KERNEL);
+		if (buf == NULL)
+			return ERR_PTR(-ENOMEM);
+		kref_init(&buf->ref);	/* reference of the frame */
+		buf->vaddr = frame->vaddress;
+		buf->paddr = frame->paddress;
+		buf->size = frame->buffer.length;
+		buf->mc = mc;
+		buf->cached = mc->cached;
+		kref_get(&mc->ref);
+		mc->exports[index] = buf;
+	}
+
+	kref_get(&buf->ref);
+	/* anon_inode_getfd() */
+	file = g_fail_getfd ? NULL : malloc(sizeof(*file));
+	if (file == NULL) {
+		kref_put(&buf->ref, mxc_capture_buf_release);
+		return ERR_PTR(-EMFILE);
+	}
+	file->private_data = buf;
+	return file;
+}
+
+static bool is_err(const void *p)
+{
+	return (unsigned long)p >= (unsigned long)-4095;
+}
+
+/* VIDIOC_REQBUFS with count frames, 0 frees them */
+static void reqbufs(struct mxc_capture *mc, int count)
+{
+	struct mxc_v4l_frame *frame;
+	int i;
+
+	mxc_free_frame_buf(mc);
+	memset(mc->frames, 0, sizeof(mc->frames));
+	mc->frame_count = count;
+	for (i = 0; i < count; i++) {
+		frame = &mc->frames[i];
+		frame->buffer.length = PAGE_ALIGN(MODEL_FRAME_SIZE);
+		frame->buffer.memory = V4L2_MEMORY_MMAP;
+		frame->buffer.flags = V4L2_BUF_FLAG_MAPPED;
+		frame->vaddress = mxc_frame_mem_alloc(mc,
+				frame->buffer.length, &frame->paddress,
+				GFP_DMA | GFP_KERNEL);
+		CHECK(frame->vaddress != NULL);
+	}
+}
+
+/* the IPU writes every frame */
+static void capture_all(struct mxc_capture *mc)
+{
+	int i;
+
+	for (i = 0; i < mc->frame_count; i++) {
+		memset(mc->frames[i].vaddress, 0xaa, mc->frames[i].buffer.length);
+		mc->frames[i].buffer.flags |= V4L2_BUF_FLAG_DONE;
+	}
+}
+
+static void open_device(int cached)
+{
+	memset(&g_mc, 0, sizeof(g_mc));
+	kref_init(&g_mc.ref);
+	g_mc.dev = &g_dev;
+	g_mc.frame_slots = MODEL_FRAMES;
+	g_mc.cached = cached;
+	ipu_buf_pool_init(&g_mc.pool);
+	g_releases = 0;
+	g_removed = 0;
+	g_fail_getfd = false;
+}
+
+static void close_device(void)
+{
+	mxc_free_frame_buf(&g_mc);
+	ipu_buf_pool_trim(&g_mc.pool, false);
+	CHECK(g_mc.pool.count == 0);
+}
+
+/*
+ * An exported buffer stays intact over VIDIOC_REQBUFS, and new frames do
+ * not get its memory while a file or an importer holds it.
+ */
+static void test_reqbufs(int cached)
+{
+	struct mxc_capture_buf *imported;
+	struct file *f1, *f2;
+	dma_addr_t paddr;
+	size_t size;
+	u8 *p1, *p2;
+	int i;
+
+	open_device(cached);
+	reqbufs(&g_mc, MODEL_FRAMES);
+
+	/* frame 1 queued, frame 2 held by the application */
+	g_mc.frames[1].buffer.flags |= V4L2_BUF_FLAG_QUEUED;
+	g_mc.frames[2].buffer.flags |= V4L2_BUF_FLAG_DONE;
+	f1 = mxc_v4l2_expbuf(&g_mc, 1);
+	f2 = mxc_v4l2_expbuf(&g_mc, 2);
+	CHECK(!is_err(f1) && !is_err(f2));
+	imported = mxc_capture_buf_get(f2, &paddr, &size);
+	CHECK(paddr == g_mc.frames[2].paddress);
+	CHECK(size == g_mc.frames[2].buffer.length);
+	CHECK(imported->ref.refcount.counter == 3);
+	p1 = g_mc.frames[1].vaddress;
+	p2 = g_mc.frames[2].vaddress;
+	memset(p1, 0x11, size);
+	memset(p2, 0x22, size);
+
+	/* REQBUFS(0): frames 0 and 3 are idle again, 1 and 2 are held */
+	reqbufs(&g_mc, 0);
+	CHECK(g_releases == 0);
+	if (!cached)
+		CHECK(g_mc.pool.count == 2);
+	else
+		CHECK(host_pages_used == 2 * size);
+
+	/* new frames, all captured into */
+	reqbufs(&g_mc, MODEL_FRAMES);
+	for (i = 0; i < MODEL_FRAMES; i++) {
+		CHECK(g_mc.frames[i].vaddress != p1);
+		CHECK(g_mc.frames[i].vaddress != p2);
+	}
+	capture_all(&g_mc);
+	CHECK(p1[0] == 0x11 && p1[size - 1] == 0x11);
+	CHECK(p2[0] == 0x22 && p2[size - 1] == 0x22);
+
+	/* the file of frame 1 is the last holder */
+	buf_file_close(f1);
+	CHECK(g_releases == 1);
+	buf_file_close(f2);
+	CHECK(g_releases == 1);
+	CHECK(p2[0] == 0x22);
+	mxc_capture_buf_put(imported);
+	CHECK(g_releases == 2);
+
+	if (!cached)
+		CHECK(g_mc.pool.count == 2);
+	close_device();
+	printf("%s: reqbufs with exported frames passed\n",
+	       cached ? "cached" : "coherent");
+}
+
+/*
+ * The frame, the file and the importer let go of a buffer in every order,
+ * the memory goes back with the last one, exactly once.
+ */
+static void test_orders(int cached)
+{
+	static const int orders[6][3] = {
+		{ 0, 1, 2 }, { 0, 2, 1 }, { 1, 0, 2 },
+		{ 1, 2, 0 }, { 2, 0, 1 }, { 2, 1, 0 },
+	};
+	struct mxc_capture_buf *imported;
+	struct file *file;
+	dma_addr_t paddr;
+	size_t size;
+	int i, j, idle;
+
+	for (i = 0; i < 6; i++) {
+		open_device(cached);
+		reqbufs(&g_mc, MODEL_FRAMES);
+		file = mxc_v4l2_expbuf(&g_mc, 0);
+		CHECK(!is_err(file));
+		imported = mxc_capture_buf_get(file, &paddr, &size);
+
+		for (j = 0; j < 3; j++) {
+			idle = g_mc.pool.count;
+			switch (orders[i][j]) {
+			case 0:
+				reqbufs(&g_mc, 0);
+				idle += MODEL_FRAMES - 1;
+				break;
+			case 1:
+				buf_file_close(file);
+				break;
+			case 2:
+				mxc_capture_buf_put(imported);
+				break;
+			}
+			CHECK(g_releases == (j == 2));
+			if (!cached)
+				CHECK(g_mc.pool.count == idle + (j == 2));
+		}
+
+		if (!cached)
+			CHECK(g_mc.pool.count == MODEL_FRAMES);
+		else
+			CHECK(host_pages_used == 0 && host_dma_mapped == 0);
+		close_device();
+	}
+	printf("%s: release orders passed\n", cached ? "cached" : "coherent");
+}
+
+/* a frame exported twice shares the buffer, a failed export drops out */
+static void test_export_errors(void)
+{
+	struct file *f1, *f2, *f3;
+
+	open_device(0);
+	reqbufs(&g_mc, MODEL_FRAMES);
+
+	f1 = mxc_v4l2_expbuf(&g_mc, 3);
+	f2 = mxc_v4l2_expbuf(&g_mc, 3);
+	CHECK(!is_err(f1) && !is_err(f2));
+	CHECK(f1->private_data == f2->private_data);
+	CHECK(g_mc.exports[3]->ref.refcount.counter == 3);
+
+	g_fail_getfd = true;
+	f3 = mxc_v4l2_expbuf(&g_mc, 3);
+	CHECK(is_err(f3));
+	CHECK(g_mc.exports[3]->ref.refcount.counter == 3);
+	f3 = mxc_v4l2_expbuf(&g_mc, 0);
+	CHECK(is_err(f3));
+	CHECK(g_mc.exports[0]->ref.refcount.counter == 1);
+	g_fail_getfd = false;
+
+	CHECK(is_err(mxc_v4l2_expbuf(&g_mc, MODEL_FRAMES)));
+
+	/* frame 0 has only its own reference, frame 3 two files */
+	reqbufs(&g_mc, 0);
+	CHECK(g_releases == 1);
+	CHECK(g_mc.pool.count == MODEL_FRAMES - 1);
+	buf_file_close(f1);
+	buf_file_close(f2);
+	CHECK(g_releases == 2);
+	CHECK(g_mc.pool.count == MODEL_FRAMES);
+
+	/* no buffer of the device left */
+	CHECK(is_err(mxc_v4l2_expbuf(&g_mc, 0)));
+	close_device();
+	printf("export errors passed\n");
+}
+
+/*
+ * The reserved buffers stay when the device is closed, ahead of newer
+ * buffers of another size and also after they were in use.
+ */
+static void test_reserve(void)
+{
+	size_t size = 2 * IPU_BUF_POOL_GRANULE;
+	struct ipu_buf_pool_entry *e;
+	dma_addr_t paddr[3];
+	void *vaddr[3];
+	int n;
+
+	open_device(0);
+	CHECK(ipu_buf_pool_reserve(&g_mc.pool, 2, size) == 2);
+
+	/* a stream of another size goes behind the reserve */
+	reqbufs(&g_mc, MODEL_FRAMES);
+	mxc_free_frame_buf(&g_mc);
+	CHECK(g_mc.pool.count == MODEL_FRAMES + 2);
+	ipu_buf_pool_trim(&g_mc.pool, true);
+	CHECK(g_mc.pool.count == 2 && g_mc.pool.bytes == 2 * size);
+
+	/* a stream of the reserve size, one buffer more than reserved */
+	for (n = 0; n < 3; n++)
+		vaddr[n] = ipu_buf_pool_get(&g_mc.pool, size, &paddr[n],
+					    GFP_KERNEL);
+	CHECK(g_mc.pool.hits == 2 && g_mc.pool.count == 0);
+	for (n = 0; n < 3; n++)
+		ipu_buf_pool_put(&g_mc.pool, vaddr[n], paddr[n], size);
+	ipu_buf_pool_trim(&g_mc.pool, true);
+	CHECK(g_mc.pool.count == 2 && g_mc.pool.bytes == 2 * size);
+	list_for_each_entry(e, &g_mc.pool.idle, list)
+		CHECK(e->size == size);
+
+	close_device();
+	printf("reserve passed\n");
+}
+
+/* mxc_v4l2_remove() */
+static void remove_device(void)
+{
+	mxc_free_frame_buf(&g_mc);
+	kref_put(&g_mc.ref, mxc_capture_release);
+}
+
+/*
+ * The device goes away while a file and an importer still hold buffers,
+ * the pool stays until the last of them is released.
+ */
+static void test_remove(int cached)
+{
+	struct mxc_capture_buf *imported;
+	struct file *f1, *f2;
+	dma_addr_t paddr;
+	size_t size;
+	u8 *p1;
+
+	open_device(cached);
+	reqbufs(&g_mc, MODEL_FRAMES);
+	f1 = mxc_v4l2_expbuf(&g_mc, 1);
+	f2 = mxc_v4l2_expbuf(&g_mc, 2);
+	CHECK(!is_err(f1) && !is_err(f2));
+	imported = mxc_capture_buf_get(f2, &paddr, &size);
+	buf_file_close(f2);
+	p1 = g_mc.frames[1].vaddress;
+	memset(p1, 0x11, size);
+
+	remove_device();
+	CHECK(g_removed == 0);
+	CHECK(g_releases == 0);
+	CHECK(p1[0] == 0x11 && p1[size - 1] == 0x11);
+	if (!cached)
+		CHECK(g_mc.pool.count == MODEL_FRAMES - 2);
+
+	buf_file_close(f1);
+	CHECK(g_releases == 1 && g_removed == 0);
+	mxc_capture_buf_put(imported);
+	CHECK(g_releases == 2 && g_removed == 1);
+	CHECK(g_mc.pool.count == 0);
+	CHECK(host_pages_used == 0 && host_dma_mapped == 0);
+
+	/* nothing exported, the device data goes right away */
+	open_device(cached);
+	reqbufs(&g_mc, MODEL_FRAMES);
+	remove_device();
+	CHECK(g_removed == 1);
+	CHECK(g_mc.pool.count == 0);
+	printf("%s: remove with exported frames passed\n",
+	       cached ? "cached" : "coherent");
+}
+
+int main(void)
+{
+	test_reqbufs(0);
+	test_reqbufs(1);
+	test_orders(0);
+	test_orders(1);
+	test_export_errors();
+	test_reserve();
+	test_remove(0);
+	test_remove(1);
+
+	CHECK(host_dma_used == 0);
+	CHECK(host_pages_used == 0);
+	CHECK(host_dma_mapped == 0);
+
+	printf("%s\n", g_failed ? "FAILED" : "passed");
+	return g_failed ? -1 : 0;
+}
@@ -0,0 +1,233 @@
+/*
+ * Copyright (C) 2013 Aptina Imaging
+ */
+
+/*
+ * The code contained herein is licensed under the GNU General Public
+ * License. You may obtain a copy of the GNU General Public License
+ * Version 2 or later at the following locations:
+ *
+ * http://www.opensource.org/licenses/gpl-license.html
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+/*
+ * @file fake_i2c.h
+ *
+ * @brief I2C adapter with a sensor register model, for host tests
+ *
+ * The sensor has 16-bit register addresses and a byte memory behind them.
+ * A write message sets the address from its first two bytes and stores the
+ * rest with auto-increment, a read message continues at the address. Data
+ * written to a port register does not go to memory but into the port log,
+ * without incrementing the address, like the MT9M024 sequencer data port.
+ * The model hooks see every register write and every read before it is
+ * served, so a test can play status bits, doorbells and ready latencies.
+ * A sensor in reset does not acknowledge its address until nak_until_ns.
+ *
+ * Every transfer advances host_now_ns by its time on the bus: the adapter
+ * wakeup, one START and address byte per message and nine clocks per byte.
+ */
+
+#ifndef __FAKE_I2C_H__
+#define __FAKE_I2C_H__
+
+#include "kernel_host.h"
+
+#define I2C_M_RD		0x0001
+#define I2C_M_TEN		0x0010
+
+#define FAKE_I2C_PORTS		4	/* port registers */
+#define FAKE_I2C_PORT_LOG	(64 * 1024)	/* bytes */
+
+struct i2c_msg {
+	u16 addr;
+	u16 flags;
+	u16 len;
+	u8 *buf;
+};
+
+struct i2c_adapter;
+
+struct i2c_client {
+	unsigned short flags;
+	unsigned short addr;
+	struct i2c_adapter *adapter;
+	struct device dev;
+};
+
+struct fake_sensor;
+
+struct i2c_adapter {
+	struct fake_sensor *sensor;
+};
+
+struct fake_sensor {
+	struct i2c_adapter adapter;
+	struct i2c_client client;
+	u8 mem[0x10000];
+	u16 ptr;			/* address of the next access */
+
+	u16 ports[FAKE_I2C_PORTS];
+	int nports;
+	u8 port_log[FAKE_I2C_PORT_LOG];
+	int port_len;
+
+	/* model hooks, may be NULL */
+	void (*written)(struct fake_sensor *fs, u16 reg, int len);
+	void (*reading)(struct fake_sensor *fs, u16 reg, int len);
+	void *priv;
+
+	unsigned int bus_hz;		/* SCL, 100 kHz by default */
+	unsigned int wakeup_ns;		/* adapter cost per transfer */
+	int fail_transfer;		/* transfer number to fail, or -1 */
+	u64 nak_until_ns;		/* held in reset until then */
+
+	/* statistics */
+	unsigned int transfers;
+	unsigned int msgs;
+	unsigned long bytes;
+};
+
+static inline u16 fake_sensor_get16(struct fake_sensor *fs, u16 reg)
+{
+	return (fs->mem[reg] << 8) | fs->mem[(u16)(reg + 1)];
+}
+
+static inline void fake_sensor_set16(struct fake_sensor *fs, u16 reg, u16 val)
+{
+	fs->mem[reg] = val >> 8;
+	fs->mem[(u16)(reg + 1)] = val & 0xff;
+}
+
+static inline bool fake_sensor_is_port(struct fake_sensor *fs, u16 reg)
+{
+	int i;
+
+	for (i = 0; i < fs->nports; i++)
+		if (fs->ports[i] == reg)
+			return true;
+	return false;
+}
+
+static inline void fake_sensor_msg(struct fake_sensor *fs, struct i2c_msg *msg)
+{
+	u16 reg;
+	int i;
+
+	if (msg->flags & I2C_M_RD) {
+		if (fs->reading)
+			fs->reading(fs, fs->ptr, msg->len);
+		for (i = 0; i < msg->len; i++)
+			msg->buf[i] = fs->mem[fs->ptr++];
+		return;
+	}
+
+	if (msg->len < 2)
+		return;
+	reg = (msg->buf[0] << 8) | msg->buf[1];
+	fs->ptr = reg;
+	if (msg->len == 2)
+		return;		/* address for a following read */
+
+	if (fake_sensor_is_port(fs, reg)) {
+		for (i = 2; i < msg->len; i++)
+			if (fs->port_len < FAKE_I2C_PORT_LOG)
+				fs->port_log[fs->port_len++] = msg->buf[i];
+	} else {
+		for (i = 2; i < msg->len; i++)
+			fs->mem[fs->ptr++] = msg->buf[i];
+	}
+	if (fs->written)
+		fs->written(fs, reg, msg->len - 2);
+}
+
+static inline int i2c_transfer(struct i2c_adapter *adap, struct i2c_msg *msgs,
+		int num)
+{
+	struct fake_sensor *fs = adap->sensor;
+	u64 clocks = 0;
+	int i;
+
+	host_now_ns += fs->wakeup_ns;
+	if ((int)fs->transfers++ == fs->fail_transfer ||
+	    host_now_ns < fs->nak_until_ns) {
+		/* NAK of the address byte of the first message */
+		host_now_ns += 10ULL * 1000000000 / fs->bus_hz;
+		return -EIO;
+	}
+
+	for (i = 0; i < num; i++) {
+		fake_sensor_msg(fs, &msgs[i]);
+		clocks += 1 + 9 * (1 + msgs[i].len);
+		fs->bytes += msgs[i].len;
+	}
+	fs->msgs += num;
+	host_now_ns += clocks * 1000000000 / fs->bus_hz;
+	return num;
+}
+
+static inline int i2c_master_send(struct i2c_client *client, const char *buf,
+		int count)
+{
+	struct i2c_msg msg = {
+		.addr = client->addr,
+		.flags = client->flags & I2C_M_TEN,
+		.len = count,
+		.buf = (u8 *)buf,
+	};
+	int ret = i2c_transfer(client->adapter, &msg, 1);
+
+	return ret == 1 ? count : ret;
+}
+
+static inline int i2c_master_recv(struct i2c_client *client, char *buf,
+		int count)
+{
+	struct i2c_msg msg = {
+		.addr = client->addr,
+		.flags = (client->flags & I2C_M_TEN) | I2C_M_RD,
+		.len = count,
+		.buf = (u8 *)buf,
+	};
+	int ret = i2c_transfer(client->adapter, &msg, 1);
+
+	return ret == 1 ? count : ret;
+}
+
+/**
+ * fake_sensor_new - sensor with empty memory on a 100 kHz bus
+ * @addr: 7-bit slave address
+ *
+ * Returns the sensor, freed with free().
+ */
+static inline struct fake_sensor *fake_sensor_new(unsigned short addr)
+{
+	struct fake_sensor *fs = calloc(1, sizeof(*fs));
+
+	if (fs == NULL)
+		return NULL;
+	fs->adapter.sensor = fs;
+	fs->client.addr = addr;
+	fs->client.adapter = &fs->adapter;
+	fs->bus_hz = 100000;
+	fs->wakeup_ns = 20000;
+	fs->fail_transfer = -1;
+	return fs;
+}
+
+static inline void fake_sensor_add_port(struct fake_sensor *fs, u16 reg)
+{
+	if (fs->nports < FAKE_I2C_PORTS)
+		fs->ports[fs->nports++] = reg;
+}
+
+/* back to zero statistics, memory and port log are kept */
+static inline void fake_sensor_clear_stats(struct fake_sensor *fs)
+{
+	fs->transfers = 0;
+	fs->msgs = 0;
+	fs->bytes = 0;
+}
+
+#endif /* __FAKE_I2C_H__ */
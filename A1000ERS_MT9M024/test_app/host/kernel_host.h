@@ -0,0 +1,610 @@
+/*
+ * Copyright (C) 2013 Aptina Imaging
+ */
+
+/*
+ * The code contained herein is licensed under the GNU General Public
+ * License. You may obtain a copy of the GNU General Public License
+ * Version 2 or later at the following locations:
+ *
+ * http://www.opensource.org/licenses/gpl-license.html
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+/*
+ * @file kernel_host.h
+ *
+ * @brief The kernel interfaces used by the driver headers, for host tests
+ *
+ * The header-only parts of the drivers (sensor_i2c_prof.h,
+ * sensor_i2c_batch.h, ipu_buf_pool.h, mt9m024_timing.h,
+ * mt9v129_doorbell.h) are built unchanged against this file: the test adds
+ * -Ihost to the include path and the <linux/...> and <media/...> headers
+ * in host include this file. Kernel callbacks leave parameters unused, the
+ * tests include the driver headers between KERNEL_HOST_BEGIN and
+ * KERNEL_HOST_END to build clean with -Wextra.
+ *
+ * Everything runs in one thread. Time is simulated: ktime_get() returns
+ * host_now_ns, which the tests and the fake adapter of fake_i2c.h advance.
+ * current is host_current, tests switch it to play several tasks.
+ */
+
+#ifndef __KERNEL_HOST_H__
+#define __KERNEL_HOST_H__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#define KERNEL_HOST_BEGIN \
+	_Pragma("GCC diagnostic push") \
+	_Pragma("GCC diagnostic ignored \"-Wunused-parameter\"")
+#define KERNEL_HOST_END \
+	_Pragma("GCC diagnostic pop")
+
+typedef uint8_t u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef uint64_t u64;
+typedef int32_t s32;
+typedef int64_t s64;
+typedef uint8_t __u8;
+typedef uint16_t __u16;
+typedef uint32_t __u32;
+typedef int32_t __s32;
+typedef unsigned int gfp_t;
+typedef unsigned long dma_addr_t;
+
+#define __user
+#define __packed		__attribute__((packed))
+#define noinline		__attribute__((noinline))
+#define __maybe_unused		__attribute__((unused))
+#define _RET_IP_		((unsigned long)__builtin_return_address(0))
+#define THIS_MODULE		NULL
+#define S_IRUGO			(S_IRUSR | S_IRGRP | S_IROTH)
+
+#define min(a, b)		((a) < (b) ? (a) : (b))
+#define max(a, b)		((a) > (b) ? (a) : (b))
+#define min_t(type, a, b)	min((type)(a), (type)(b))
+#define clamp(val, lo, hi)	min(max(val, lo), hi)
+#define ALIGN(x, a)		(((x) + (a) - 1) & ~((size_t)(a) - 1))
+#define ARRAY_SIZE(a)		(sizeof(a) / sizeof((a)[0]))
+#define container_of(ptr, type, member) \
+	((type *)((char *)(ptr) - offsetof(type, member)))
+#define IS_ERR_OR_NULL(p)	((p) == NULL)
+
+static inline int fls(unsigned int x)
+{
+	return x ? 32 - __builtin_clz(x) : 0;
+}
+
+static inline u64 div_u64(u64 dividend, u32 divisor)
+{
+	return dividend / divisor;
+}
+
+/* time */
+typedef s64 ktime_t;
+
+static u64 host_now_ns __maybe_unused;
+
+static inline ktime_t ktime_get(void)
+{
+	return host_now_ns;
+}
+
+static inline ktime_t ktime_sub(ktime_t a, ktime_t b)
+{
+	return a - b;
+}
+
+static inline s64 ktime_to_ns(ktime_t t)
+{
+	return t;
+}
+
+static inline s64 ktime_to_us(ktime_t t)
+{
+	return t / 1000;
+}
+
+static inline s64 ktime_us_delta(ktime_t later, ktime_t earlier)
+{
+	return ktime_to_us(ktime_sub(later, earlier));
+}
+
+/* sleeping advances the clock, by the lower bound */
+#define HZ			100
+#define jiffies			((unsigned long)(host_now_ns / (1000000000 / HZ)))
+#define time_after(a, b)	((long)((b) - (a)) < 0)
+
+static inline unsigned long msecs_to_jiffies(unsigned int ms)
+{
+	return (ms * HZ + 999) / 1000;
+}
+
+static inline void usleep_range(unsigned long min_us, unsigned long max_us)
+{
+	(void)max_us;
+	host_now_ns += (u64)min_us * 1000;
+}
+
+static inline void msleep(unsigned int ms)
+{
+	host_now_ns += (u64)ms * 1000000;
+}
+
+/* busy waits advance the clock and the CPU time burnt in them */
+static u64 host_busy_ns __maybe_unused;
+
+static inline void mdelay(unsigned int ms)
+{
+	host_now_ns += (u64)ms * 1000000;
+	host_busy_ns += (u64)ms * 1000000;
+}
+
+struct file;
+
+/* tasks and locks, one thread */
+struct task_struct {
+	const char *comm;
+};
+
+static struct task_struct host_init_task = { "init" };
+static struct task_struct *host_current __maybe_unused = &host_init_task;
+#define current host_current
+
+typedef struct {
+	int locked;
+} spinlock_t;
+
+static inline void spin_lock_init(spinlock_t *lock)
+{
+	lock->locked = 0;
+}
+
+static inline void spin_lock(spinlock_t *lock)
+{
+	if (lock->locked++) {
+		fprintf(stderr, "spinlock taken twice\n");
+		abort();
+	}
+}
+
+static inline void spin_unlock(spinlock_t *lock)
+{
+	lock->locked--;
+}
+
+#define spin_lock_irqsave(lock, flags) \
+	do { (flags) = 0; spin_lock(lock); } while (0)
+#define spin_unlock_irqrestore(lock, flags) \
+	do { (void)(flags); spin_unlock(lock); } while (0)
+
+struct mutex {
+	int locked;
+};
+
+static inline void mutex_init(struct mutex *lock)
+{
+	lock->locked = 0;
+}
+
+static inline void mutex_lock(struct mutex *lock)
+{
+	if (lock->locked++) {
+		fprintf(stderr, "mutex taken twice\n");
+		abort();
+	}
+}
+
+static inline void mutex_unlock(struct mutex *lock)
+{
+	lock->locked--;
+}
+
+struct semaphore {
+	int count;
+	unsigned int blocked;	/* downs that would have slept */
+};
+
+static inline void sema_init(struct semaphore *sem, int val)
+{
+	sem->count = val;
+	sem->blocked = 0;
+}
+
+/* nobody else runs to release it, so a sleep is reported as a signal */
+static inline int down_interruptible(struct semaphore *sem)
+{
+	if (sem->count <= 0) {
+		sem->blocked++;
+		return -EINTR;
+	}
+	sem->count--;
+	return 0;
+}
+
+static inline void up(struct semaphore *sem)
+{
+	sem->count++;
+}
+
+/*
+ * Wait queues count their wake-ups. A poll table entry stays on the queue
+ * it was added to until the test takes it off, like a sleeping poll().
+ */
+typedef struct {
+	unsigned int wakeups;
+	unsigned int waiters;
+} wait_queue_head_t;
+
+typedef struct poll_table_struct {
+	wait_queue_head_t *queue;
+} poll_table;
+
+static inline void init_waitqueue_head(wait_queue_head_t *q)
+{
+	q->wakeups = 0;
+	q->waiters = 0;
+}
+
+static inline void wake_up_interruptible(wait_queue_head_t *q)
+{
+	q->wakeups++;
+}
+
+static inline void poll_wait(struct file *filp, wait_queue_head_t *q,
+		poll_table *p)
+{
+	(void)filp;
+	if (p && !p->queue) {
+		p->queue = q;
+		q->waiters++;
+	}
+}
+
+static inline void poll_freewait(poll_table *p)
+{
+	if (p->queue)
+		p->queue->waiters--;
+	p->queue = NULL;
+}
+
+/* memory */
+#define GFP_KERNEL	0x01u
+#define GFP_DMA		0x02u
+#define __GFP_NOWARN	0x04u
+
+static inline void *kmalloc(size_t size, gfp_t gfp)
+{
+	(void)gfp;
+	return malloc(size);
+}
+
+static inline void *kzalloc(size_t size, gfp_t gfp)
+{
+	(void)gfp;
+	return calloc(1, size);
+}
+
+static inline void *kcalloc(size_t n, size_t size, gfp_t gfp)
+{
+	(void)gfp;
+	return calloc(n, size);
+}
+
+static inline void kfree(const void *p)
+{
+	free((void *)p);
+}
+
+/*
+ * Contiguous memory of host_dma_limit bytes. The bus address is the
+ * address of the host allocation, unique as long as the buffer lives.
+ */
+static size_t host_dma_limit __maybe_unused = (size_t)-1;
+static size_t host_dma_used __maybe_unused;
+static unsigned long host_dma_allocs __maybe_unused;
+
+struct device {
+	const char *name;
+};
+
+static inline void *dma_alloc_coherent(struct device *dev, size_t size,
+		dma_addr_t *paddr, gfp_t gfp)
+{
+	void *p;
+
+	(void)dev;
+	(void)gfp;
+	if (size > host_dma_limit - host_dma_used)
+		return NULL;
+	p = malloc(size);
+	if (p == NULL)
+		return NULL;
+	host_dma_used += size;
+	host_dma_allocs++;
+	*paddr = (dma_addr_t)p;
+	return p;
+}
+
+static inline void dma_free_coherent(struct device *dev, size_t size,
+		void *vaddr, dma_addr_t paddr)
+{
+	(void)dev;
+	if (vaddr == NULL || (dma_addr_t)vaddr != paddr) {
+		fprintf(stderr, "dma_free_coherent of a bad buffer\n");
+		abort();
+	}
+	host_dma_used -= size;
+	free(vaddr);
+}
+
+/*
+ * Pages and their streaming mappings. Page allocations count in
+ * host_pages_used, mappings in host_dma_mapped.
+ */
+#define PAGE_SIZE		4096UL
+#define PAGE_ALIGN(x)		ALIGN(x, PAGE_SIZE)
+
+enum dma_data_direction {
+	DMA_BIDIRECTIONAL = 0,
+	DMA_TO_DEVICE = 1,
+	DMA_FROM_DEVICE = 2,
+};
+
+static size_t host_pages_used __maybe_unused;
+static unsigned long host_dma_mapped __maybe_unused;
+
+static inline void *alloc_pages_exact(size_t size, gfp_t gfp)
+{
+	void *p;
+
+	(void)gfp;
+	p = malloc(PAGE_ALIGN(size));
+	if (p != NULL)
+		host_pages_used += PAGE_ALIGN(size);
+	return p;
+}
+
+static inline void free_pages_exact(void *virt, size_t size)
+{
+	host_pages_used -= PAGE_ALIGN(size);
+	free(virt);
+}
+
+static inline dma_addr_t dma_map_single(struct device *dev, void *ptr,
+		size_t size, enum dma_data_direction dir)
+{
+	(void)dev;
+	(void)size;
+	(void)dir;
+	host_dma_mapped++;
+	return (dma_addr_t)ptr;
+}
+
+static inline void dma_unmap_single(struct device *dev, dma_addr_t addr,
+		size_t size, enum dma_data_direction dir)
+{
+	(void)dev;
+	(void)addr;
+	(void)size;
+	(void)dir;
+	host_dma_mapped--;
+}
+
+static inline int dma_mapping_error(struct device *dev, dma_addr_t addr)
+{
+	(void)dev;
+	return addr == 0;
+}
+
+/* lists */
+struct list_head {
+	struct list_head *next, *prev;
+};
+
+static inline void INIT_LIST_HEAD(struct list_head *list)
+{
+	list->next = list;
+	list->prev = list;
+}
+
+static inline void list_add_tail(struct list_head *entry,
+		struct list_head *head)
+{
+	entry->prev = head->prev;
+	entry->next = head;
+	head->prev->next = entry;
+	head->prev = entry;
+}
+
+static inline void list_del(struct list_head *entry)
+{
+	entry->prev->next = entry->next;
+	entry->next->prev = entry->prev;
+	entry->next = NULL;
+	entry->prev = NULL;
+}
+
+static inline int list_empty(const struct list_head *head)
+{
+	return head->next == head;
+}
+
+#define list_entry(ptr, type, member)	container_of(ptr, type, member)
+
+#define list_for_each_entry(pos, head, member)				\
+	for (pos = list_entry((head)->next, __typeof__(*pos), member);	\
+	     &pos->member != (head);					\
+	     pos = list_entry(pos->member.next, __typeof__(*pos), member))
+
+#define list_for_each_entry_safe(pos, n, head, member)			\
+	for (pos = list_entry((head)->next, __typeof__(*pos), member),	\
+	     n = list_entry(pos->member.next, __typeof__(*pos), member);\
+	     &pos->member != (head);					\
+	     pos = n, n = list_entry(n->member.next, __typeof__(*n), member))
+
+/* reference counts */
+typedef struct {
+	int counter;
+} atomic_t;
+
+struct kref {
+	atomic_t refcount;
+};
+
+static inline void kref_init(struct kref *kref)
+{
+	kref->refcount.counter = 1;
+}
+
+static inline void kref_get(struct kref *kref)
+{
+	if (kref->refcount.counter <= 0) {
+		fprintf(stderr, "kref_get of a released object\n");
+		abort();
+	}
+	kref->refcount.counter++;
+}
+
+static inline int kref_put(struct kref *kref,
+		void (*release)(struct kref *kref))
+{
+	if (kref->refcount.counter <= 0) {
+		fprintf(stderr, "kref_put of a released object\n");
+		abort();
+	}
+	if (--kref->refcount.counter == 0) {
+		release(kref);
+		return 1;
+	}
+	return 0;
+}
+
+/* debugfs and seq_file, the files are not created */
+struct dentry {
+	int unused;
+};
+
+struct inode {
+	void *i_private;
+};
+
+struct seq_file {
+	FILE *out;
+	void *private;
+};
+
+struct file {
+	void *private_data;
+};
+
+struct module;
+
+struct file_operations {
+	struct module *owner;
+	int (*open)(struct inode *, struct file *);
+	ssize_t (*read)(struct file *, char __user *, size_t, loff_t *);
+	ssize_t (*write)(struct file *, const char __user *, size_t,
+			 loff_t *);
+	loff_t (*llseek)(struct file *, loff_t, int);
+	int (*release)(struct inode *, struct file *);
+};
+
+static inline struct dentry *debugfs_create_dir(const char *name,
+		struct dentry *parent)
+{
+	(void)name;
+	(void)parent;
+	return NULL;
+}
+
+static inline struct dentry *debugfs_create_file(const char *name,
+		mode_t mode, struct dentry *parent, void *data,
+		const struct file_operations *fops)
+{
+	(void)name;
+	(void)mode;
+	(void)parent;
+	(void)data;
+	(void)fops;
+	return NULL;
+}
+
+static inline void debugfs_remove_recursive(struct dentry *dentry)
+{
+	(void)dentry;
+}
+
+/* %pS prints the address only */
+static inline int seq_printf(struct seq_file *m, const char *fmt, ...)
+{
+	char host_fmt[256];
+	const char *p;
+	size_t n = 0;
+	va_list ap;
+	int ret;
+
+	for (p = fmt; *p && n < sizeof(host_fmt) - 1; p++) {
+		host_fmt[n++] = *p;
+		if (p[0] == '%' && p[1] == 'p' && p[2] == 'S') {
+			host_fmt[n++] = 'p';
+			p += 2;
+		}
+	}
+	host_fmt[n] = 0;
+
+	va_start(ap, fmt);
+	ret = vfprintf(m->out, host_fmt, ap);
+	va_end(ap);
+	return ret;
+}
+
+static inline int single_open(struct file *file,
+		int (*show)(struct seq_file *, void *), void *data)
+{
+	(void)file;
+	(void)show;
+	(void)data;
+	return -ENODEV;
+}
+
+static inline int single_release(struct inode *inode, struct file *file)
+{
+	(void)inode;
+	(void)file;
+	return 0;
+}
+
+static inline ssize_t seq_read(struct file *file, char __user *buf,
+		size_t size, loff_t *ppos)
+{
+	(void)file;
+	(void)buf;
+	(void)size;
+	(void)ppos;
+	return -ENODEV;
+}
+
+static inline loff_t seq_lseek(struct file *file, loff_t offset, int whence)
+{
+	(void)file;
+	(void)offset;
+	(void)whence;
+	return -ENODEV;
+}
+
+#define dev_err(dev, ...)	((void)(dev), fprintf(stderr, __VA_ARGS__))
+#define dev_dbg(dev, ...)	((void)(dev))
+
+#endif /* __KERNEL_HOST_H__ */
@@ -0,0 +1,2 @@
+/* host build, see ../fake_i2c.h */
+#include "../fake_i2c.h"
@@ -0,0 +1,2 @@
+/* host build, see ../kernel_host.h */
+#include "../kernel_host.h"
@@ -0,0 +1,4 @@
+/* host build, see ../kernel_host.h */
+#include "../kernel_host.h"
+
+#define v4l_err(client, ...)	((void)(client), fprintf(stderr, __VA_ARGS__))
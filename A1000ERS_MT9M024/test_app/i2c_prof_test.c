@@ -0,0 +1,331 @@
+/*
+ * Copyright (C) 2013 Aptina Imaging
+ */
+
+/*
+ * The code contained herein is licensed under the GNU General Public
+ * License. You may obtain a copy of the GNU General Public License
+ * Version 2 or later at the following locations:
+ *
+ * http://www.opensource.org/licenses/gpl-license.html
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+/*
+ * @file i2c_prof_test.c
+ *
+ * @brief Host test of the sensor I2C profiler against a fake adapter
+ *
+ * Builds sensor_i2c_prof.h and sensor_i2c_batch.h of the kernel tree
+ * unchanged and drives them with register accessors written like the ones
+ * of the drivers. Checks the accounting per call site, per task phase,
+ * the latency histogram, the error and drop counts and the clear, then
+ * prints the profile as debugfs would. Build on the host with
+ *
+ * gcc -Wall -Wextra -Ihost -I../kernel/drivers/media/video/mxc/capture
+ *	i2c_prof_test.c -o i2c_prof_test
+ */
+
+#include "kernel_host.h"
+#include "fake_i2c.h"
+KERNEL_HOST_BEGIN
+#include "sensor_i2c_batch.h"
+KERNEL_HOST_END
+
+static struct sensor_i2c_prof g_prof;
+static struct fake_sensor *g_sensor;
+static int g_failed;
+
+#define CHECK(cond)							\
+	do {								\
+		if (!(cond)) {						\
+			printf("%s:%d: check failed: %s\n",		\
+			       __FILE__, __LINE__, #cond);		\
+			g_failed = 1;					\
+		}							\
+	} while (0)
+
+/* the accessors, as in the drivers */
+static noinline int test_write_reg(u16 reg, u16 val)
+{
+	u8 buf[4] = { reg >> 8, reg & 0xff, val >> 8, val & 0xff };
+	ktime_t start = ktime_get();
+	int ret;
+
+	ret = i2c_master_send(&g_sensor->client, (char *)buf, 4);
+	sensor_i2c_prof_record(&g_prof, _RET_IP_, start, ret < 0);
+	return ret < 0 ? -1 : 0;
+}
+
+static noinline int test_read_reg(u16 reg, u16 *val)
+{
+	u8 regbuf[2] = { reg >> 8, reg & 0xff };
+	u8 readval[2];
+	ktime_t start = ktime_get();
+	int ret;
+
+	ret = i2c_master_send(&g_sensor->client, (char *)regbuf, 2);
+	if (ret != 2) {
+		sensor_i2c_prof_record(&g_prof, _RET_IP_, start, true);
+		return -1;
+	}
+	ret = i2c_master_recv(&g_sensor->client, (char *)readval, 2);
+	sensor_i2c_prof_record(&g_prof, _RET_IP_, start, ret != 2);
+	if (ret != 2)
+		return -1;
+	*val = (readval[0] << 8) | readval[1];
+	return 0;
+}
+
+static noinline int test_write_table(const u16 *vals, int count)
+{
+	struct sensor_i2c_batch batch;
+	int i;
+
+	sensor_i2c_batch_init(&batch, &g_sensor->client, &g_prof, _RET_IP_);
+	for (i = 0; i < count; i++)
+		if (sensor_i2c_batch_write(&batch, 0x3000 + 2 * i, vals[i], 2))
+			return -1;
+	return sensor_i2c_batch_flush(&batch);
+}
+
+/* two call sites of the same accessor */
+static noinline void site_a(void)
+{
+	test_write_reg(0x301a, 0x10d8);
+}
+
+static noinline void site_b(void)
+{
+	test_write_reg(0x301a, 0x10dc);
+}
+
+static struct sensor_i2c_prof_site *find_site(enum sensor_i2c_phase phase,
+		unsigned int count)
+{
+	int i;
+
+	for (i = 0; i < g_prof.nsites; i++)
+		if (g_prof.sites[i].phase == phase &&
+		    g_prof.sites[i].count == count)
+			return &g_prof.sites[i];
+	return NULL;
+}
+
+/* transactions of a phase, or of all phases for SENSOR_I2C_PHASE_NUM */
+static unsigned int phase_count(enum sensor_i2c_phase phase)
+{
+	unsigned int n = 0;
+	int i;
+
+	for (i = 0; i < g_prof.nsites; i++)
+		if (phase == SENSOR_I2C_PHASE_NUM ||
+		    g_prof.sites[i].phase == phase)
+			n += g_prof.sites[i].count;
+	return n;
+}
+
+static void clear_profile(void)
+{
+	struct seq_file m = { stdout, &g_prof };
+	struct file file = { &m };
+
+	sensor_i2c_prof_clear(&file, NULL, 1, NULL);
+}
+
+static void test_call_sites(void)
+{
+	struct sensor_i2c_prof_site *a, *b;
+	/* START, address and four bytes, 9 clocks each, plus the wakeup */
+	u32 write_ns = 46 * 10000 + g_sensor->wakeup_ns;
+
+	clear_profile();
+	site_a();
+	site_a();
+	site_b();
+
+	CHECK(g_prof.nsites == 2);
+	a = find_site(SENSOR_I2C_PHASE_OTHER, 2);
+	b = find_site(SENSOR_I2C_PHASE_OTHER, 1);
+	CHECK(a && b && a->ip != b->ip);
+	if (a) {
+		CHECK(a->max_ns == write_ns);
+		CHECK(a->total_ns == 2 * write_ns);
+		CHECK(a->hist[fls(write_ns / (SENSOR_I2C_PROF_BUCKET0_US *
+					      1000))] == 2);
+	}
+}
+
+static void test_task_phases(void)
+{
+	struct task_struct worker = { "kworker" };
+	struct task_struct ioctl = { "capture" };
+	struct task_struct other = { "other" };
+	enum sensor_i2c_phase w_old, i_old;
+	u16 vals[8] = { 0 };
+	u16 val;
+
+	clear_profile();
+
+	/* the init work runs, an s_ctrl comes in meanwhile */
+	current = &worker;
+	w_old = sensor_i2c_prof_enter(&g_prof, SENSOR_I2C_PHASE_DEV_INIT);
+	test_write_table(vals, 8);
+
+	current = &ioctl;
+	i_old = sensor_i2c_prof_enter(&g_prof, SENSOR_I2C_PHASE_S_CTRL);
+	test_read_reg(0x3012, &val);
+	test_read_reg(0x3012, &val);
+
+	current = &worker;
+	test_write_table(vals, 8);
+	test_read_reg(0x3000, &val);
+
+	current = &other;
+	test_read_reg(0x3000, &val);
+
+	current = &ioctl;
+	sensor_i2c_prof_leave(&g_prof, i_old);
+	current = &worker;
+	sensor_i2c_prof_leave(&g_prof, w_old);
+	test_read_reg(0x3000, &val);
+
+	CHECK(w_old == SENSOR_I2C_PHASE_OTHER && i_old == SENSOR_I2C_PHASE_OTHER);
+	/* two tables of one transfer each and a read */
+	CHECK(phase_count(SENSOR_I2C_PHASE_DEV_INIT) == 3);
+	CHECK(phase_count(SENSOR_I2C_PHASE_S_CTRL) == 2);
+	/* the task without a phase, and the worker after leaving */
+	CHECK(phase_count(SENSOR_I2C_PHASE_OTHER) == 2);
+
+	/* all slots free again */
+	CHECK(g_prof.tasks[0].task == NULL && g_prof.tasks[1].task == NULL);
+	current = &host_init_task;
+}
+
+static void test_nesting_and_slots(void)
+{
+	struct task_struct tasks[SENSOR_I2C_PROF_TASKS + 1];
+	enum sensor_i2c_phase old[SENSOR_I2C_PROF_TASKS + 1];
+	enum sensor_i2c_phase probe, init;
+	u16 val;
+	int i;
+
+	clear_profile();
+
+	/* probe runs the first init in the same task */
+	probe = sensor_i2c_prof_enter(&g_prof, SENSOR_I2C_PHASE_PROBE);
+	init = sensor_i2c_prof_enter(&g_prof, SENSOR_I2C_PHASE_DEV_INIT);
+	test_read_reg(0x3000, &val);
+	sensor_i2c_prof_leave(&g_prof, init);
+	test_read_reg(0x3000, &val);
+	sensor_i2c_prof_leave(&g_prof, probe);
+	CHECK(init == SENSOR_I2C_PHASE_PROBE);
+	CHECK(phase_count(SENSOR_I2C_PHASE_DEV_INIT) == 1);
+	CHECK(phase_count(SENSOR_I2C_PHASE_PROBE) == 1);
+
+	/* one task more than slots, it is accounted to "other" */
+	clear_profile();
+	for (i = 0; i <= SENSOR_I2C_PROF_TASKS; i++) {
+		tasks[i].comm = "task";
+		current = &tasks[i];
+		old[i] = sensor_i2c_prof_enter(&g_prof, SENSOR_I2C_PHASE_S_PARM);
+		test_read_reg(0x3000, &val);
+	}
+	for (i = 0; i <= SENSOR_I2C_PROF_TASKS; i++) {
+		current = &tasks[i];
+		sensor_i2c_prof_leave(&g_prof, old[i]);
+	}
+	current = &host_init_task;
+	CHECK(phase_count(SENSOR_I2C_PHASE_S_PARM) == SENSOR_I2C_PROF_TASKS);
+	CHECK(phase_count(SENSOR_I2C_PHASE_OTHER) == 1);
+	for (i = 0; i < SENSOR_I2C_PROF_TASKS; i++)
+		CHECK(g_prof.tasks[i].task == NULL);
+}
+
+static void test_errors_and_drops(void)
+{
+	struct sensor_i2c_prof_site *site;
+	int i;
+
+	clear_profile();
+	g_sensor->fail_transfer = g_sensor->transfers + 1;
+	site_a();
+	site_a();
+	site_a();
+	g_sensor->fail_transfer = -1;
+
+	site = find_site(SENSOR_I2C_PHASE_OTHER, 3);
+	CHECK(site && site->errors == 1);
+
+	clear_profile();
+	for (i = 0; i < SENSOR_I2C_PROF_SITES + 10; i++)
+		sensor_i2c_prof_record(&g_prof, 0x1000 + i, ktime_get(), false);
+	CHECK(g_prof.nsites == SENSOR_I2C_PROF_SITES);
+	CHECK(g_prof.dropped == 10);
+	CHECK(phase_count(SENSOR_I2C_PHASE_NUM) == SENSOR_I2C_PROF_SITES);
+}
+
+/* a transaction stuck for longer than 2^32 ns keeps its time */
+static void test_long_transaction(void)
+{
+	struct sensor_i2c_prof_site *site;
+	ktime_t start;
+
+	clear_profile();
+	start = ktime_get();
+	host_now_ns += 5000000000ULL;
+	sensor_i2c_prof_record(&g_prof, 0x2000, start, true);
+	start = ktime_get();
+	host_now_ns += 100000;
+	sensor_i2c_prof_record(&g_prof, 0x2000, start, false);
+
+	site = find_site(SENSOR_I2C_PHASE_OTHER, 2);
+	CHECK(site != NULL);
+	if (site == NULL)
+		return;
+	CHECK(site->max_ns == 5000000000ULL);
+	CHECK(site->total_ns == 5000100000ULL);
+	CHECK(site->hist[SENSOR_I2C_PROF_BUCKETS - 1] == 1);
+	CHECK(site->hist[1] == 1);
+}
+
+int main(void)
+{
+	struct seq_file m = { stdout, &g_prof };
+	enum sensor_i2c_phase phase;
+	u16 vals[32];
+	int i;
+
+	g_sensor = fake_sensor_new(0x10);
+	if (g_sensor == NULL) {
+		printf("out of memory\n");
+		return -1;
+	}
+	sensor_i2c_prof_init(&g_prof, "i2c_prof_test");
+
+	test_call_sites();
+	test_task_phases();
+	test_nesting_and_slots();
+	test_errors_and_drops();
+	test_long_transaction();
+
+	/* a profile to look at */
+	clear_profile();
+	for (i = 0; i < 32; i++)
+		vals[i] = i;
+	phase = sensor_i2c_prof_enter(&g_prof, SENSOR_I2C_PHASE_DEV_INIT);
+	test_write_table(vals, 32);
+	for (i = 0; i < 10; i++)
+		site_a();
+	g_sensor->bus_hz = 400000;
+	for (i = 0; i < 10; i++)
+		site_b();
+	sensor_i2c_prof_leave(&g_prof, phase);
+	sensor_i2c_prof_show(&m, NULL);
+
+	sensor_i2c_prof_exit(&g_prof);
+	free(g_sensor);
+
+	printf("%s\n", g_failed ? "FAILED" : "passed");
+	return g_failed ? -1 : 0;
+}
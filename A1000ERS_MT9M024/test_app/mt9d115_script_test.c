@@ -0,0 +1,474 @@
+/*
+ * Copyright (C) 2013 Aptina Imaging
+ */
+
+/*
+ * The code contained herein is licensed under the GNU General Public
+ * License. You may obtain a copy of the GNU General Public License
+ * Version 2 or later at the following locations:
+ *
+ * http://www.opensource.org/licenses/gpl-license.html
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+/*
+ * @file mt9d115_script_test.c
+ *
+ * @brief Host benchmark of the MT9D115 register script executor
+ *
+ * Runs the cold init of mt9d115_mipi.c (reset, PLL, init script, patch
+ * upload, preview) from the tables of mt9d115_script.h against a fake
+ * sensor with a model of the MCU variables, the MCU standby, the patch
+ * loader and the sequencer. Once with the executor of the driver, which
+ * batches the writes and sleeps in polls and delays, and once unrolled as
+ * the driver did before: one transfer per write and mdelay(10) busy waits.
+ * Checks that both leave the sensor in the same state and compares the
+ * transfers, the init time and the CPU time burnt in busy waits. Build on
+ * the host with
+ *
+ * gcc -Wall -Wextra -Ihost -I../../MT9D115_SOC2031
+ *	mt9d115_script_test.c -o mt9d115_script_test
+ */
+
+#include "kernel_host.h"
+#include "fake_i2c.h"
+KERNEL_HOST_BEGIN
+#include "sensor_i2c_batch.h"
+KERNEL_HOST_END
+#include "mt9d115_script.h"
+
+/* firmware timing of the model */
+#define MODEL_STANDBY_NS	3000000ULL	/* MCU leaves standby */
+#define MODEL_PATCH_NS		5000000ULL	/* patch initialization */
+#define MODEL_PREVIEW_NS	40000000ULL	/* first preview frames */
+#define MODEL_NEVER		(~0ULL)
+
+#define MODEL_PATCH_ID		0x0106
+#define MODEL_STATE_INIT	2		/* SEQ_STATE before preview */
+
+struct soc_model {
+	u16 mcu_addr;
+	u16 vars[0x10000];		/* by MCU_ADDRESS */
+	u64 standby_done_ns;
+	u64 patch_done_ns;
+	u64 preview_ns;
+	bool patch_hangs;		/* the patch never reports its id */
+};
+
+static struct fake_sensor *g_sensor;
+static struct soc_model g_model;
+static int g_failed;
+
+#define CHECK(cond)							\
+	do {								\
+		if (!(cond)) {						\
+			printf("%s:%d: check failed: %s\n",		\
+			       __FILE__, __LINE__, #cond);		\
+			g_failed = 1;					\
+		}							\
+	} while (0)
+
+/* 8-bit variables are one byte apart, 16-bit variables and RAM words two */
+static u16 model_var_addr(u16 var, int port)
+{
+	return var + ((var & 0x8000) ? 1 : 2) * port;
+}
+
+static void model_var_written(struct soc_model *sm, u16 var, u16 val)
+{
+	sm->vars[var] = val;
+	if (var == 0xA005 && val == 1 && !sm->patch_hangs)
+		sm->patch_done_ns = host_now_ns + MODEL_PATCH_NS;
+}
+
+static void model_written(struct fake_sensor *fs, u16 reg, int len)
+{
+	struct soc_model *sm = fs->priv;
+	u16 r, val;
+	int i;
+
+	for (i = 0; i + 1 < len; i += 2) {
+		r = reg + i;
+		val = fake_sensor_get16(fs, r);
+		if (r == MT9D115_MCU_ADDRESS) {
+			sm->mcu_addr = val;
+		} else if (r >= MT9D115_MCU_DATA_0 && r <= MT9D115_MCU_DATA_7) {
+			model_var_written(sm, model_var_addr(sm->mcu_addr,
+					  (r - MT9D115_MCU_DATA_0) / 2), val);
+		} else if (r == MT9D115_CTRL_STATUS) {
+			/* GO: the MCU leaves standby */
+			if (!(val & 0x0001) &&
+			    sm->standby_done_ns == MODEL_NEVER)
+				sm->standby_done_ns =
+					host_now_ns + MODEL_STANDBY_NS;
+			/* powerup stop cleared: the sequencer starts */
+			if (!(val & 0x0004) && sm->preview_ns == MODEL_NEVER &&
+			    host_now_ns >= sm->standby_done_ns)
+				sm->preview_ns = host_now_ns + MODEL_PREVIEW_NS;
+		}
+	}
+}
+
+static u16 model_var(struct soc_model *sm, u16 var)
+{
+	switch (var) {
+	case MT9D115_VAR_MON_PATCH_ID_0:
+		return host_now_ns >= sm->patch_done_ns ? MODEL_PATCH_ID : 0;
+	case MT9D115_VAR_SEQ_STATE:
+		return host_now_ns >= sm->preview_ns ?
+			MT9D115_SEQ_STATE_PREVIEW : MODEL_STATE_INIT;
+	}
+	return sm->vars[var];
+}
+
+static void model_reading(struct fake_sensor *fs, u16 reg, int len)
+{
+	struct soc_model *sm = fs->priv;
+	u16 val;
+
+	(void)len;
+	if (reg == MT9D115_CTRL_STATUS) {
+		val = fake_sensor_get16(fs, reg) & ~0x4000;
+		if (host_now_ns < sm->standby_done_ns)
+			val |= 0x4000;
+		fake_sensor_set16(fs, reg, val);
+	} else if (reg == MT9D115_MCU_DATA_0) {
+		fake_sensor_set16(fs, reg, model_var(sm, sm->mcu_addr));
+	}
+}
+
+/* power on: MCU in standby, the firmware not started */
+static void model_power_on(bool patch_hangs)
+{
+	memset(&g_model, 0, sizeof(g_model));
+	memset(g_sensor->mem, 0, sizeof(g_sensor->mem));
+	g_model.standby_done_ns = MODEL_NEVER;
+	g_model.patch_done_ns = MODEL_NEVER;
+	g_model.preview_ns = MODEL_NEVER;
+	g_model.patch_hangs = patch_hangs;
+	fake_sensor_set16(g_sensor, MT9D115_CHIP_ID_REG, MT9D115_CHIP_ID);
+	fake_sensor_set16(g_sensor, MT9D115_CTRL_STATUS, 0x4001);
+}
+
+/* the accessors, as in mt9d115_mipi.c without profile and debug output */
+static int mt9d115_read_reg(u16 u16Reg, u16 *u16Val)
+{
+	u8 u8RegBuf[2] = { u16Reg >> 8, u16Reg & 0xff };
+	u8 u8RdVal[2];
+
+	if (i2c_master_send(&g_sensor->client, (char *)u8RegBuf, 2) != 2 ||
+	    i2c_master_recv(&g_sensor->client, (char *)u8RdVal, 2) != 2)
+		return -1;
+	*u16Val = (u8RdVal[0] << 8) | u8RdVal[1];
+	return 0;
+}
+
+static int mt9d115_write_reg(u16 u16Reg, u16 u16Val)
+{
+	u8 u8Buf[4] = { u16Reg >> 8, u16Reg & 0xff, u16Val >> 8, u16Val & 0xff };
+
+	return i2c_master_send(&g_sensor->client, (char *)u8Buf, 4) < 0 ? -1 : 0;
+}
+
+/* the executor, as mt9d115_script_poll() and mt9d115_run_script() */
+static int mt9d115_script_poll(const MT9D115_SCRIPT_T *cmd)
+{
+	unsigned long timeout = jiffies + msecs_to_jiffies(MT9D115_POLL_TIMEOUT_MS);
+	u16 u16Reg = cmd->u16Reg;
+	u16 readVal = 0;
+	bool match;
+
+	if (cmd->u8Op != MT9D115_OP_POLL) {
+		if (mt9d115_write_reg(MT9D115_MCU_ADDRESS, cmd->u16Reg) < 0)
+			return -1;
+		u16Reg = MT9D115_MCU_DATA_0;
+	}
+
+	for (;;) {
+		if (mt9d115_read_reg(u16Reg, &readVal) < 0)
+			return -1;
+		match = (readVal & cmd->u16Mask) == cmd->u16Val;
+		if (cmd->u8Op == MT9D115_OP_POLL_VAR_NOT)
+			match = !match;
+		if (match)
+			return 0;
+		if (time_after(jiffies, timeout))
+			return 0;
+		usleep_range(MT9D115_POLL_US, 2 * MT9D115_POLL_US);
+	}
+}
+
+static int mt9d115_run_script(const MT9D115_SCRIPT_T *script, int len)
+{
+	struct sensor_i2c_batch batch;
+	const MT9D115_SCRIPT_T *cmd;
+	u16 readVal = 0;
+	int count;
+
+	sensor_i2c_batch_init(&batch, &g_sensor->client, NULL, 0);
+
+	for (count = 0; count < len; count++) {
+		cmd = &script[count];
+		switch (cmd->u8Op) {
+		case MT9D115_OP_WRITE:
+			if (sensor_i2c_batch_write(&batch, cmd->u16Reg, cmd->u16Val, 2) < 0)
+				return -1;
+			break;
+		case MT9D115_OP_VAR:
+			if (sensor_i2c_batch_write(&batch, MT9D115_MCU_ADDRESS, cmd->u16Reg, 2) < 0 ||
+			    sensor_i2c_batch_write(&batch, MT9D115_MCU_DATA_0, cmd->u16Val, 2) < 0)
+				return -1;
+			break;
+		case MT9D115_OP_RMW:
+			if (sensor_i2c_batch_flush(&batch) < 0)
+				return -1;
+			if (mt9d115_read_reg(cmd->u16Reg, &readVal) < 0)
+				return -1;
+			readVal = (readVal & ~cmd->u16Mask) | cmd->u16Val;
+			if (mt9d115_write_reg(cmd->u16Reg, readVal) < 0)
+				return -1;
+			break;
+		case MT9D115_OP_POLL:
+		case MT9D115_OP_POLL_VAR:
+		case MT9D115_OP_POLL_VAR_NOT:
+			if (sensor_i2c_batch_flush(&batch) < 0)
+				return -1;
+			if (mt9d115_script_poll(cmd) < 0)
+				return -1;
+			break;
+		case MT9D115_OP_DELAY:
+			if (sensor_i2c_batch_flush(&batch) < 0)
+				return -1;
+			if (cmd->u16Val < 20)
+				usleep_range(cmd->u16Val * 1000, cmd->u16Val * 1000 + 1000);
+			else
+				msleep(cmd->u16Val);
+			break;
+		}
+	}
+	return sensor_i2c_batch_flush(&batch) < 0 ? -1 : 0;
+}
+
+/* as mt9d115_write_vars() */
+static int mt9d115_write_vars(u16 u16Var, const u16 *pu16Val, int count)
+{
+	struct sensor_i2c_batch batch;
+	int step = (u16Var & 0x8000) ? 1 : 2;
+	int len;
+
+	sensor_i2c_batch_init(&batch, &g_sensor->client, NULL, 0);
+	while (count > 0) {
+		len = min(count, MT9D115_MCU_DATA_PORTS);
+		if (sensor_i2c_batch_write(&batch, MT9D115_MCU_ADDRESS, u16Var, 2) < 0 ||
+		    sensor_i2c_batch_write_words(&batch, MT9D115_MCU_DATA_0, pu16Val, len, false) < 0)
+			return -1;
+		u16Var += step * len;
+		pu16Val += len;
+		count -= len;
+	}
+	return sensor_i2c_batch_flush(&batch) < 0 ? -1 : 0;
+}
+
+/*
+ * The same scripts as the driver executed them before: every write its
+ * own transfer, every poll read followed by mdelay(10), at most ten reads
+ * (POLL_FIELD DELAY=10, TIMEOUT=100), delays as mdelay().
+ */
+static int run_unrolled(const MT9D115_SCRIPT_T *script, int len)
+{
+	const MT9D115_SCRIPT_T *cmd;
+	u16 u16Reg, readVal = 0;
+	bool match;
+	int i, count;
+
+	for (i = 0; i < len; i++) {
+		cmd = &script[i];
+		switch (cmd->u8Op) {
+		case MT9D115_OP_WRITE:
+			if (mt9d115_write_reg(cmd->u16Reg, cmd->u16Val) < 0)
+				return -1;
+			break;
+		case MT9D115_OP_VAR:
+			if (mt9d115_write_reg(MT9D115_MCU_ADDRESS, cmd->u16Reg) < 0 ||
+			    mt9d115_write_reg(MT9D115_MCU_DATA_0, cmd->u16Val) < 0)
+				return -1;
+			break;
+		case MT9D115_OP_RMW:
+			if (mt9d115_read_reg(cmd->u16Reg, &readVal) < 0 ||
+			    mt9d115_write_reg(cmd->u16Reg,
+					(readVal & ~cmd->u16Mask) | cmd->u16Val) < 0)
+				return -1;
+			break;
+		case MT9D115_OP_POLL:
+		case MT9D115_OP_POLL_VAR:
+		case MT9D115_OP_POLL_VAR_NOT:
+			u16Reg = cmd->u16Reg;
+			if (cmd->u8Op != MT9D115_OP_POLL) {
+				if (mt9d115_write_reg(MT9D115_MCU_ADDRESS, cmd->u16Reg) < 0)
+					return -1;
+				u16Reg = MT9D115_MCU_DATA_0;
+			}
+			count = 0;
+			do {
+				if (mt9d115_read_reg(u16Reg, &readVal) < 0)
+					return -1;
+				mdelay(10);
+				count++;
+				match = (readVal & cmd->u16Mask) == cmd->u16Val;
+				if (cmd->u8Op == MT9D115_OP_POLL_VAR_NOT)
+					match = !match;
+			} while (count < 10 && !match);
+			break;
+		case MT9D115_OP_DELAY:
+			mdelay(cmd->u16Val);
+			break;
+		}
+	}
+	return 0;
+}
+
+/* patch upload of eight words per MCU_ADDRESS, one transfer per write */
+static int write_vars_unrolled(u16 u16Var, const u16 *pu16Val, int count)
+{
+	int i;
+
+	for (i = 0; i < count; i++) {
+		if (i % MT9D115_MCU_DATA_PORTS == 0 &&
+		    mt9d115_write_reg(MT9D115_MCU_ADDRESS, u16Var + 2 * i) < 0)
+			return -1;
+		if (mt9d115_write_reg(MT9D115_MCU_DATA_0 +
+				      2 * (i % MT9D115_MCU_DATA_PORTS), pu16Val[i]) < 0)
+			return -1;
+	}
+	return 0;
+}
+
+struct init_result {
+	unsigned int transfers;
+	unsigned int msgs;
+	u64 ns;
+	u64 busy_ns;
+};
+
+#define RUN(script)	run(script, ARRAY_SIZE(script))
+#define RUN_BATCHED(script) \
+	mt9d115_run_script(script, ARRAY_SIZE(script))
+
+/* the cold init of mt9d115_v4l2_dev_init() for YUV 4:2:2 */
+static int cold_init(int (*run)(const MT9D115_SCRIPT_T *, int),
+		     int (*write_vars)(u16, const u16 *, int))
+{
+	u16 readVal;
+
+	if (RUN(mt9d115_reset_script) < 0)
+		return -1;
+	/* mt9d115_interfaceMode(MT9D115_MIPI_MODE) */
+	if (mt9d115_read_reg(MT9D115_RST_CTRL_REG, &readVal) < 0 ||
+	    mt9d115_write_reg(MT9D115_RST_CTRL_REG,
+			      (readVal & 0xFDFF) | 0x0008) < 0)
+		return -1;
+	if (RUN(mt9d115_pll_yuv422_script) < 0 ||
+	    RUN(mt9d115_init_script) < 0)
+		return -1;
+	/* mt9d115_patch() */
+	if (write_vars(MT9D115_PATCH_ADDRESS, mt9d115_patch_code,
+		       ARRAY_SIZE(mt9d115_patch_code)) < 0 ||
+	    RUN(mt9d115_patch_script) < 0 ||
+	    RUN(mt9d115_preview_script) < 0)
+		return -1;
+	return 0;
+}
+
+static struct soc_model g_unrolled_state;
+static u8 g_unrolled_mem[0x10000];
+
+static int run_init(bool batched, const char *name, struct init_result *res)
+{
+	u64 start = host_now_ns, busy = host_busy_ns;
+	int ret;
+
+	model_power_on(false);
+	fake_sensor_clear_stats(g_sensor);
+	if (batched)
+		ret = cold_init(mt9d115_run_script, mt9d115_write_vars);
+	else
+		ret = cold_init(run_unrolled, write_vars_unrolled);
+	res->ns = host_now_ns - start;
+	res->busy_ns = host_busy_ns - busy;
+	res->transfers = g_sensor->transfers;
+	res->msgs = g_sensor->msgs;
+
+	printf("%-8s %5u transfers, %5u messages, init %6llu us, "
+	       "busy waiting %6llu us\n", name, res->transfers, res->msgs,
+	       (unsigned long long)res->ns / 1000,
+	       (unsigned long long)res->busy_ns / 1000);
+	if (ret < 0) {
+		printf("%s: init failed\n", name);
+		return -1;
+	}
+	CHECK(model_var(&g_model, MT9D115_VAR_MON_PATCH_ID_0) == MODEL_PATCH_ID);
+	CHECK(model_var(&g_model, MT9D115_VAR_SEQ_STATE) ==
+	      MT9D115_SEQ_STATE_PREVIEW);
+	return 0;
+}
+
+/* a POLL_FIELD timeout is not an error, the init goes on */
+static void test_poll_timeout(void)
+{
+	u64 start, elapsed;
+	int ret;
+
+	model_power_on(true);
+	ret = RUN_BATCHED(mt9d115_init_script);
+	start = host_now_ns;
+	if (!ret)
+		ret = RUN_BATCHED(mt9d115_patch_script);
+	elapsed = host_now_ns - start;
+	if (!ret)
+		ret = RUN_BATCHED(mt9d115_preview_script);
+	printf("patch hangs: %d, patch poll gave up after %llu us\n", ret,
+	       (unsigned long long)elapsed / 1000);
+
+	CHECK(ret == 0);
+	CHECK(elapsed >= MT9D115_POLL_TIMEOUT_MS * 1000000ULL);
+	CHECK(elapsed <= (MT9D115_POLL_TIMEOUT_MS + 2 * 1000 / HZ) *
+	      1000000ULL + 2 * MT9D115_POLL_US * 1000ULL);
+	CHECK(model_var(&g_model, MT9D115_VAR_SEQ_STATE) ==
+	      MT9D115_SEQ_STATE_PREVIEW);
+}
+
+int main(void)
+{
+	struct init_result unrolled, batched;
+
+	g_sensor = fake_sensor_new(MT9D115_I2C_ADDR);
+	if (g_sensor == NULL) {
+		printf("out of memory\n");
+		return -1;
+	}
+	g_sensor->written = model_written;
+	g_sensor->reading = model_reading;
+	g_sensor->priv = &g_model;
+
+	if (run_init(false, "unrolled", &unrolled) < 0)
+		g_failed = 1;
+	g_unrolled_state = g_model;
+	memcpy(g_unrolled_mem, g_sensor->mem, sizeof(g_unrolled_mem));
+	if (run_init(true, "batched", &batched) < 0)
+		g_failed = 1;
+
+	/* the same variables and registers, in time */
+	CHECK(memcmp(g_unrolled_state.vars, g_model.vars,
+		     sizeof(g_model.vars)) == 0);
+	CHECK(memcmp(g_unrolled_mem, g_sensor->mem, sizeof(g_unrolled_mem)) == 0);
+	CHECK(batched.msgs <= unrolled.msgs);
+	CHECK(4 * batched.transfers < unrolled.transfers);
+	CHECK(batched.busy_ns == 0 && unrolled.busy_ns > 0);
+	CHECK(batched.ns < unrolled.ns);
+
+	test_poll_timeout();
+	free(g_sensor);
+
+	printf("%s\n", g_failed ? "FAILED" : "passed");
+	return g_failed ? -1 : 0;
+}
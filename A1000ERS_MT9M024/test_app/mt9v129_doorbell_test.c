@@ -0,0 +1,477 @@
+/*
+ * Copyright (C) 2013 Aptina Imaging
+ */
+
+/*
+ * The code contained herein is licensed under the GNU General Public
+ * License. You may obtain a copy of the GNU General Public License
+ * Version 2 or later at the following locations:
+ *
+ * http://www.opensource.org/licenses/gpl-license.html
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+/*
+ * @file mt9v129_doorbell_test.c
+ *
+ * @brief Host test of the MT9V129 host command doorbell
+ *
+ * Runs mt9v129_doorbell() of mt9v129_doorbell.h against a fake sensor with
+ * a model of the firmware: a command written with the doorbell bit set
+ * runs for a latency that depends on the command and the requested state,
+ * then the firmware clears the bit and leaves the result status in the
+ * command register. Checks that every command is seen complete within one
+ * back-off step, that the number of polls stays logarithmic for short
+ * commands and linear in POLL_MAX for long ones, that the statistics add
+ * up, and the busy, error, hang and bus failure paths. A mode change is
+ * also timed against the fixed 10 ms polls the driver had before. Build on
+ * the host with
+ *
+ * gcc -Wall -Wextra -Ihost -I../../MT9V129_SOC361
+ *	mt9v129_doorbell_test.c -o mt9v129_doorbell_test
+ */
+
+#include "kernel_host.h"
+#include "fake_i2c.h"
+#include "mt9v129_doorbell.h"
+
+/* as in mt9v129.c */
+#define MT9V129_SYSMGR_NEXT_STATE		0xFC00
+#define MT9V129_SYS_STATE_ENTER_CONFIG_CHANGE	0x28
+#define MT9V129_SYS_STATE_STREAMING		0x31
+#define MT9V129_SYS_STATE_START_STREAMING	0x34
+#define MT9V129_SYS_STATE_ENTER_SUSPEND		0x40
+#define MT9V129_SYS_STATE_SUSPENDED		0x41
+
+/* firmware timing of the model */
+#define MODEL_GET_STATE_NS	150000ULL
+#define MODEL_START_NS		3000000ULL	/* start streaming */
+#define MODEL_FRAME_NS		33366700ULL	/* NTSC, 29.97 fps */
+
+struct firmware_model {
+	bool busy;
+	bool hang;		/* never completes a command */
+	s64 fixed_ns;		/* latency of every command, if >= 0 */
+	u16 command;
+	u64 done_ns;
+	u8 state;
+	u64 latency_ns;		/* of the last command */
+	unsigned int commands;
+};
+
+static struct fake_sensor *g_sensor;
+static struct firmware_model g_fw;
+static int g_failed;
+
+#define CHECK(cond)							\
+	do {								\
+		if (!(cond)) {						\
+			printf("%s:%d: check failed: %s\n",		\
+			       __FILE__, __LINE__, #cond);		\
+			g_failed = 1;					\
+		}							\
+	} while (0)
+
+/* a config change or a suspend waits for the end of the current frame */
+static u64 model_latency(struct firmware_model *fw, u8 next_state)
+{
+	if (fw->fixed_ns >= 0)
+		return fw->fixed_ns;
+	if (fw->command == MT9V129_COMMAND_REGISTER_GET_STATE)
+		return MODEL_GET_STATE_NS;
+	if (next_state == MT9V129_SYS_STATE_START_STREAMING)
+		return MODEL_START_NS;
+	return MODEL_FRAME_NS - host_now_ns % MODEL_FRAME_NS + 500000;
+}
+
+static void model_written(struct fake_sensor *fs, u16 reg, int len)
+{
+	struct firmware_model *fw = fs->priv;
+	u16 val = fake_sensor_get16(fs, MT9V129_COMMAND_REGISTER);
+
+	if (reg != MT9V129_COMMAND_REGISTER || len != 2 ||
+	    !(val & MT9V129_COMMAND_REGISTER_DOORBELL_MASK))
+		return;
+	CHECK(!fw->busy);
+	fw->busy = true;
+	fw->command = val;
+	fw->latency_ns = model_latency(fw, fs->mem[MT9V129_SYSMGR_NEXT_STATE]);
+	fw->done_ns = host_now_ns + fw->latency_ns;
+	fw->commands++;
+}
+
+static void model_complete(struct fake_sensor *fs, struct firmware_model *fw)
+{
+	u8 next = fs->mem[MT9V129_SYSMGR_NEXT_STATE];
+	u16 status = MT9V129_ENOERR;
+
+	if (fw->command == MT9V129_COMMAND_REGISTER_GET_STATE) {
+		fs->mem[MT9V129_SYSMGR_NEXT_STATE] = fw->state;
+	} else if (fw->command != MT9V129_COMMAND_REGISTER_SET_STATE) {
+		status = MT9V129_ENOSYS;
+	} else if (next == MT9V129_SYS_STATE_ENTER_CONFIG_CHANGE ||
+		   next == MT9V129_SYS_STATE_START_STREAMING) {
+		fw->state = MT9V129_SYS_STATE_STREAMING;
+	} else if (next == MT9V129_SYS_STATE_ENTER_SUSPEND) {
+		fw->state = MT9V129_SYS_STATE_SUSPENDED;
+	} else {
+		status = MT9V129_EINVAL;
+	}
+	fake_sensor_set16(fs, MT9V129_COMMAND_REGISTER, status);
+	fw->busy = false;
+}
+
+static void model_reading(struct fake_sensor *fs, u16 reg, int len)
+{
+	struct firmware_model *fw = fs->priv;
+
+	(void)len;
+	if (reg == MT9V129_COMMAND_REGISTER && fw->busy && !fw->hang &&
+	    host_now_ns >= fw->done_ns)
+		model_complete(fs, fw);
+}
+
+/* the register accessors of mt9v129.c, without the profiling */
+static int mt9v129_read8(struct i2c_client *client, u16 reg, u8 *val)
+{
+	u8 buf[2] = { reg >> 8, reg & 0xff };
+	struct i2c_msg msg[] = {
+		{ client->addr, 0, 2, buf },
+		{ client->addr, I2C_M_RD, 1, val },
+	};
+	int ret = i2c_transfer(client->adapter, msg, 2);
+
+	return ret < 0 ? ret : 0;
+}
+
+static int mt9v129_write8(struct i2c_client *client, u16 reg, u8 val)
+{
+	u8 buf[3] = { reg >> 8, reg & 0xff, val };
+	struct i2c_msg msg = { client->addr, 0, 3, buf };
+	int ret = i2c_transfer(client->adapter, &msg, 1);
+
+	return ret < 0 ? ret : 0;
+}
+
+static int mt9v129_read16(struct i2c_client *client, u16 reg, u16 *val)
+{
+	u8 buf[2] = { reg >> 8, reg & 0xff }, rval[2];
+	struct i2c_msg msg[] = {
+		{ client->addr, 0, 2, buf },
+		{ client->addr, I2C_M_RD, 2, rval },
+	};
+	int ret = i2c_transfer(client->adapter, msg, 2);
+
+	if (ret < 0)
+		return ret;
+	*val = (rval[0] << 8) | rval[1];
+	return 0;
+}
+
+static int mt9v129_write16(struct i2c_client *client, u16 reg, u16 val)
+{
+	u8 buf[4] = { reg >> 8, reg & 0xff, val >> 8, val & 0xff };
+	struct i2c_msg msg = { client->addr, 0, 4, buf };
+	int ret = i2c_transfer(client->adapter, &msg, 1);
+
+	return ret < 0 ? ret : 0;
+}
+
+/* as in mt9v129.c */
+static int mt9v129_set_state(struct i2c_client *client, u8 next_state)
+{
+	int ret;
+
+	ret = mt9v129_write8(client, MT9V129_SYSMGR_NEXT_STATE, next_state);
+	if (ret < 0)
+		return ret;
+	ret = mt9v129_doorbell(client, MT9V129_CMD_SET_STATE);
+	if (ret < 0)
+		return ret;
+	return ret ? -EFAULT : 0;
+}
+
+static int mt9v129_get_state(struct i2c_client *client)
+{
+	int ret;
+	u8 state;
+
+	ret = mt9v129_doorbell(client, MT9V129_CMD_GET_STATE);
+	if (ret < 0)
+		return ret;
+	if (ret)
+		return -EFAULT;
+	ret = mt9v129_read8(client, MT9V129_SYSMGR_NEXT_STATE, &state);
+	if (ret < 0)
+		return ret;
+	return state;
+}
+
+/* the command wait of the driver before the doorbell back-off */
+static int old_command(struct i2c_client *client, u16 command)
+{
+	int timeout = 100, ret;
+	u16 val;
+
+	ret = mt9v129_read16(client, MT9V129_COMMAND_REGISTER, &val);
+	if (ret < 0)
+		return ret;
+	if (val & MT9V129_COMMAND_REGISTER_DOORBELL_MASK)
+		return -EAGAIN;
+	ret = mt9v129_write16(client, MT9V129_COMMAND_REGISTER, command);
+	if (ret < 0)
+		return ret;
+	while (timeout) {
+		ret = mt9v129_read16(client, MT9V129_COMMAND_REGISTER, &val);
+		if (ret < 0)
+			return ret;
+		if (!(val & MT9V129_COMMAND_REGISTER_DOORBELL_MASK))
+			break;
+		msleep(10);
+		timeout--;
+	}
+	if (!timeout)
+		return -ETIMEDOUT;
+	ret = mt9v129_read16(client, MT9V129_COMMAND_REGISTER, &val);
+	if (ret < 0)
+		return ret;
+	return val & ~MT9V129_COMMAND_REGISTER_DOORBELL_MASK;
+}
+
+static void reset(void)
+{
+	memset(&g_fw, 0, sizeof(g_fw));
+	g_fw.fixed_ns = -1;
+	g_fw.state = MT9V129_SYS_STATE_STREAMING;
+	memset(g_sensor->mem, 0, sizeof(g_sensor->mem));
+	memset(mt9v129_stats, 0, sizeof(mt9v129_stats));
+	fake_sensor_clear_stats(g_sensor);
+	g_sensor->fail_transfer = -1;
+}
+
+/* time of one poll of the command register on the bus */
+static u64 poll_ns(void)
+{
+	u64 start = host_now_ns;
+	u16 val;
+
+	mt9v129_read16(&g_sensor->client, MT9V129_COMMAND_REGISTER, &val);
+	return host_now_ns - start;
+}
+
+/*
+ * A command is seen complete at most one sleep and one poll after the
+ * firmware finished. Every sleep is at most the time already waited plus
+ * POLL_MIN, and at most POLL_MAX.
+ */
+static void test_latency(void)
+{
+	static const unsigned int latencies_us[] = {
+		0, 40, 100, 150, 400, 1000, 3000, 10000, 33000, 100000, 600000
+	};
+	const struct mt9v129_cmd_stats *stats =
+		&mt9v129_stats[MT9V129_CMD_SET_STATE];
+	unsigned int poll, polls, max_polls, bound, l;
+	u64 total = 0;
+	u32 max = 0;
+	size_t i;
+	int ret;
+
+	reset();
+	poll = poll_ns() / 1000 + 1;
+	printf("latency, %u us per poll:\n", poll);
+	for (i = 0; i < ARRAY_SIZE(latencies_us); i++) {
+		l = latencies_us[i];
+		g_fw.fixed_ns = l * 1000ULL;
+		polls = stats->polls;
+		ret = mt9v129_set_state(&g_sensor->client,
+				MT9V129_SYS_STATE_START_STREAMING);
+		polls = stats->polls - polls;
+		printf("  %6u us: seen after %6u us, %3u polls\n",
+		       l, stats->last_us, polls);
+		CHECK(ret == 0);
+
+		bound = min(2 * l, l + MT9V129_DOORBELL_POLL_MAX_US) +
+			MT9V129_DOORBELL_POLL_MIN_US + 2 * poll;
+		CHECK(stats->last_us >= l);
+		CHECK(stats->last_us <= bound);
+		max_polls = 2 + fls(l / MT9V129_DOORBELL_POLL_MIN_US) +
+			l / MT9V129_DOORBELL_POLL_MAX_US;
+		CHECK(polls <= max_polls);
+
+		total += stats->last_us;
+		max = max(max, stats->last_us);
+	}
+	CHECK(stats->count == ARRAY_SIZE(latencies_us));
+	CHECK(stats->total_us == total);
+	CHECK(stats->max_us == max);
+	CHECK(stats->timeouts == 0);
+	CHECK(g_fw.commands == ARRAY_SIZE(latencies_us));
+}
+
+/* set_state and get_state of a mode change and of power on and off */
+static void test_mode_change(void)
+{
+	static const u8 states[] = {
+		MT9V129_SYS_STATE_ENTER_CONFIG_CHANGE,
+		MT9V129_SYS_STATE_ENTER_SUSPEND,
+		MT9V129_SYS_STATE_START_STREAMING,
+	};
+	static const u8 reached[] = {
+		MT9V129_SYS_STATE_STREAMING,
+		MT9V129_SYS_STATE_SUSPENDED,
+		MT9V129_SYS_STATE_STREAMING,
+	};
+	struct i2c_client *client = &g_sensor->client;
+	u64 start, fw_ns, new_ns, old_ns;
+	size_t i;
+	int ret;
+
+	reset();
+	for (i = 0; i < ARRAY_SIZE(states); i++) {
+		/* the same point of the frame for both */
+		host_now_ns += MODEL_FRAME_NS - host_now_ns % MODEL_FRAME_NS;
+		start = host_now_ns;
+		ret = mt9v129_set_state(client, states[i]);
+		CHECK(ret == 0);
+		fw_ns = g_fw.latency_ns;
+		ret = mt9v129_get_state(client);
+		CHECK(ret == reached[i]);
+		fw_ns += g_fw.latency_ns;
+		new_ns = host_now_ns - start;
+
+		host_now_ns += MODEL_FRAME_NS - host_now_ns % MODEL_FRAME_NS;
+		start = host_now_ns;
+		ret = mt9v129_write8(client, MT9V129_SYSMGR_NEXT_STATE,
+				states[i]);
+		CHECK(ret == 0);
+		ret = old_command(client, MT9V129_COMMAND_REGISTER_SET_STATE);
+		CHECK(ret == MT9V129_ENOERR);
+		ret = old_command(client, MT9V129_COMMAND_REGISTER_GET_STATE);
+		CHECK(ret == MT9V129_ENOERR);
+		CHECK(g_sensor->mem[MT9V129_SYSMGR_NEXT_STATE] == reached[i]);
+		old_ns = host_now_ns - start;
+
+		printf("state 0x%02x: firmware %5llu us, doorbell %5llu us, "
+		       "10 ms polls %5llu us\n", states[i],
+		       (unsigned long long)fw_ns / 1000,
+		       (unsigned long long)new_ns / 1000,
+		       (unsigned long long)old_ns / 1000);
+		CHECK(new_ns < old_ns);
+		CHECK(new_ns <= fw_ns + fw_ns / 2 + 2000000);
+		CHECK(old_ns >= 20000000);
+	}
+	CHECK(mt9v129_stats[MT9V129_CMD_GET_STATE].count == ARRAY_SIZE(states));
+	CHECK(mt9v129_stats[MT9V129_CMD_GET_STATE].max_us < 1000);
+}
+
+/* a command issued while the firmware is still busy is refused */
+static void test_busy(void)
+{
+	int ret;
+
+	reset();
+	fake_sensor_set16(g_sensor, MT9V129_COMMAND_REGISTER,
+			MT9V129_COMMAND_REGISTER_DOORBELL_MASK |
+			MT9V129_COMMAND_REGISTER_SET_STATE);
+	ret = mt9v129_get_state(&g_sensor->client);
+	CHECK(ret == -EAGAIN);
+	CHECK(g_fw.commands == 0);
+	CHECK(g_sensor->transfers == 1);
+	CHECK(mt9v129_stats[MT9V129_CMD_GET_STATE].count == 0);
+	CHECK(mt9v129_stats[MT9V129_CMD_GET_STATE].polls == 0);
+}
+
+/* a nonzero result status is an error of set_state */
+static void test_error_response(void)
+{
+	int ret;
+
+	reset();
+	ret = mt9v129_set_state(&g_sensor->client, 0x77);
+	CHECK(ret == -EFAULT);
+	CHECK(fake_sensor_get16(g_sensor, MT9V129_COMMAND_REGISTER) ==
+	      MT9V129_EINVAL);
+	CHECK(g_fw.state == MT9V129_SYS_STATE_STREAMING);
+	CHECK(mt9v129_stats[MT9V129_CMD_SET_STATE].count == 1);
+	CHECK(mt9v129_stats[MT9V129_CMD_SET_STATE].timeouts == 0);
+
+	/* the firmware is idle again */
+	ret = mt9v129_get_state(&g_sensor->client);
+	CHECK(ret == MT9V129_SYS_STATE_STREAMING);
+}
+
+/*
+ * Firmware that never clears the doorbell: the wait gives up after the
+ * timeout of the command, with polls every POLL_MAX once backed off.
+ */
+static void test_hang(void)
+{
+	const struct mt9v129_cmd_stats *stats;
+	unsigned int timeout_us, max_polls;
+	u64 start, waited_us;
+	int i, ret;
+
+	for (i = 0; i < MT9V129_CMD_NUM; i++) {
+		reset();
+		g_fw.hang = true;
+		stats = &mt9v129_stats[i];
+		timeout_us = mt9v129_cmds[i].timeout_ms * 1000;
+		start = host_now_ns;
+		ret = mt9v129_doorbell(&g_sensor->client, i);
+		waited_us = (host_now_ns - start) / 1000;
+		printf("%s hangs: %d after %llu us, %u polls\n",
+		       mt9v129_cmds[i].name, ret,
+		       (unsigned long long)waited_us, stats->polls);
+		CHECK(ret == -ETIMEDOUT);
+		CHECK(stats->timeouts == 1);
+		CHECK(stats->count == 0);
+		CHECK(waited_us > timeout_us);
+		CHECK(waited_us <= timeout_us + 2 * MT9V129_DOORBELL_POLL_MAX_US);
+		max_polls = 2 + fls(MT9V129_DOORBELL_POLL_MAX_US /
+				    MT9V129_DOORBELL_POLL_MIN_US) +
+			timeout_us / MT9V129_DOORBELL_POLL_MAX_US;
+		CHECK(stats->polls <= max_polls);
+	}
+}
+
+/* a failed transfer ends the command with its error */
+static void test_bus_error(void)
+{
+	int n, ret;
+
+	/* the busy check, the command write and the first poll */
+	for (n = 0; n < 3; n++) {
+		reset();
+		g_fw.fixed_ns = 1000000;
+		g_sensor->fail_transfer = n;
+		ret = mt9v129_doorbell(&g_sensor->client,
+				MT9V129_CMD_GET_STATE);
+		CHECK(ret == -EIO);
+		CHECK(g_fw.commands == (n > 1));
+		CHECK(mt9v129_stats[MT9V129_CMD_GET_STATE].count == 0);
+		CHECK(mt9v129_stats[MT9V129_CMD_GET_STATE].timeouts == 0);
+	}
+}
+
+int main(void)
+{
+	g_sensor = fake_sensor_new(0x48);
+	if (g_sensor == NULL)
+		return -1;
+	g_sensor->bus_hz = 400000;	/* the camera bus runs in fast mode */
+	g_sensor->written = model_written;
+	g_sensor->reading = model_reading;
+	g_sensor->priv = &g_fw;
+
+	test_latency();
+	test_mode_change();
+	test_busy();
+	test_error_response();
+	test_hang();
+	test_bus_error();
+
+	free(g_sensor);
+	printf("%s\n", g_failed ? "FAILED" : "passed");
+	return g_failed ? -1 : 0;
+}
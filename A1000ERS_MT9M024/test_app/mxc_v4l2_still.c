@@ -39,6 +39,7 @@ extern "C"{
 #include <sys/mman.h>
 #include <string.h>
 #include <malloc.h>
+#include "raw_unpack.h"
 
 #define ipu_fourcc(a,b,c,d)\
         (((__u32)(a)<<0)|((__u32)(b)<<8)|((__u32)(c)<<16)|((__u32)(d)<<24))
@@ -60,8 +61,10 @@ extern "C"{
 #define IPU_PIX_FMT_ABGR32  ipu_fourcc('A','B','G','R') /*!< 32 ABGR-8-8-8-8 */
 #define V4L2_PIX_FMT_GREY   ipu_fourcc('G','R','E','Y')	/*!< 8 Greyscale */
 #define V4L2_PIX_FMT_Y16    ipu_fourcc('Y','1','6',' ') /*!< 16 Greyscale */
+#define IPU_PIX_FMT_GENERIC_12P ipu_fourcc('I','P','U','3') /*!< 12 Greyscale, packed */
 
 static int g_convert = 0;
+static int g_unpack = 0;
 static int g_width = 640;
 static int g_height = 480;
 static int g_top = 0;
@@ -83,6 +86,7 @@ void usage(void)
                 "-f    Image pixel format, YUV420, YUV422P, YUYV (default), UYVY or YUV444\n"
                 "-c    Convert to YUV420P. This option is valid for interleaved pixel\n"
                 "      formats only - YUYV, UYVY, YUV444\n"
+		"-u    Unpack Y12P to 16 bit words before saving\n"
 		"-m    Capture mode, 0-low resolution(default), 1-high resolution \n"
 		"-d    camera select, /dev/video0, /dev/video1 \n"
 		"-fr   Capture frame rate, 30fps by default\n"
@@ -211,6 +215,8 @@ int v4l_capture_setup(int * fd_v4l)
         fmt.fmt.pix.height = g_height;
         fmt.fmt.pix.sizeimage = fmt.fmt.pix.width * fmt.fmt.pix.height * g_bpp / 8;
         fmt.fmt.pix.bytesperline = g_width * bytes_per_pixel(g_pixelformat);
+	if (g_pixelformat == IPU_PIX_FMT_GENERIC_12P)
+		fmt.fmt.pix.bytesperline = RAW_PACKED12_LINE(g_width);
 
         if ((ret = ioctl(*fd_v4l, VIDIOC_S_FMT, &fmt)) < 0)
         {
@@ -262,7 +268,17 @@ int v4l_capture_test(int fd_v4l)
                 goto exit0;
         }
 
-        if ((g_convert == 1) && (g_pixelformat != IPU_PIX_FMT_YUV422P)
+        if ((g_unpack == 1) && (g_pixelformat == IPU_PIX_FMT_GENERIC_12P)) {
+		free(buf2);
+		buf2 = (char *)malloc(fmt.fmt.pix.width * fmt.fmt.pix.height * 2);
+		if (!buf2)
+			goto exit0;
+		raw_unpack12((uint16_t *)buf2, (uint8_t *)buf1,
+			     fmt.fmt.pix.width, fmt.fmt.pix.height,
+			     fmt.fmt.pix.bytesperline);
+                write(fd_still, buf2, fmt.fmt.pix.width * fmt.fmt.pix.height * 2);
+	}
+        else if ((g_convert == 1) && (g_pixelformat != IPU_PIX_FMT_YUV422P)
 		&& (g_pixelformat != IPU_PIX_FMT_YUV420P2)) {
                 fmt_convert(buf2, buf1, fmt);
                 write(fd_still, buf2, fmt.fmt.pix.width * fmt.fmt.pix.height * 3 / 2);
@@ -303,6 +319,9 @@ int main(int argc, char **argv)
                 else if (strcmp(argv[i], "-c") == 0) {
                         g_convert = 1;
                 }
+		else if (strcmp(argv[i], "-u") == 0) {
+			g_unpack = 1;
+		}
 		else if (strcmp(argv[i], "-m") == 0) {
 			g_capture_mode = atoi(argv[++i]);
 		}
@@ -350,6 +369,10 @@ int main(int argc, char **argv)
                                 g_pixelformat = V4L2_PIX_FMT_GREY;
                                 g_bpp = 8;
                         }
+			else if (strcmp(argv[i], "Y12P") == 0) {
+				g_pixelformat = IPU_PIX_FMT_GENERIC_12P;
+				g_bpp = 12;
+			}
                         else {
                                 printf("Pixel format not supported.\n");
                                 usage();
@@ -0,0 +1,600 @@
+/*
+ * Copyright (C) 2013 Aptina Imaging
+ */
+
+/*
+ * The code contained herein is licensed under the GNU General Public
+ * License. You may obtain a copy of the GNU General Public License
+ * Version 2 or later at the following locations:
+ *
+ * http://www.opensource.org/licenses/gpl-license.html
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+/*
+ * @file poll_wakeup_test.c
+ *
+ * @brief Host test of the capture poll against the done queue
+ *
+ * Runs the buffer queues of mxc_v4l2_capture.c (REQBUFS, QBUF, STREAMON,
+ * the camera callback, non-blocking DQBUF, STREAMOFF) under an application
+ * loop that
+ * polls, dequeues and queues the buffer back, as a select or epoll loop
+ * does. Frames complete every MODEL_FRAME_NS and the application spends a
+ * given time on each frame. Checks for the poll of the driver that
+ *  - the queue is woken exactly once per completed frame,
+ *  - poll is readable exactly when a frame waits in the done queue, so no
+ *    DQBUF returns EAGAIN and the loop sleeps between frames,
+ *  - poll does not wait for busy_lock,
+ *  - STREAMOFF wakes a sleeping poller, which then sees POLLERR,
+ *  - REQBUFS after QBUF without STREAMON leaves no queue linked to the
+ *    frame table it frees or clears,
+ * and compares the loop with the poll the driver had before, which was
+ * always readable. Build on the host with
+ *
+ * gcc -Wall -Wextra -Ihost poll_wakeup_test.c -o poll_wakeup_test
+ */
+
+#include <poll.h>
+#include "kernel_host.h"
+
+/* as in videodev2.h */
+#define V4L2_BUF_FLAG_MAPPED	0x0001
+#define V4L2_BUF_FLAG_QUEUED	0x0002
+#define V4L2_BUF_FLAG_DONE	0x0004
+
+#define MODEL_FRAME_NS		22222222ULL	/* 45 fps */
+#define MODEL_SYSCALL_NS	2000ULL		/* one poll or ioctl */
+#define MODEL_FRAMES		64
+#define MODEL_BUFFERS		4
+
+struct mxc_v4l_frame {
+	struct {
+		u32 flags;
+		u32 offset;
+	} buffer;
+	struct list_head queue;
+	int index;
+	int ipu_buf_num;
+};
+
+/* the part of cam_data the queues use */
+typedef struct {
+	spinlock_t queue_int_lock;
+	spinlock_t dqueue_int_lock;
+	struct semaphore busy_lock;
+	struct list_head ready_q;
+	struct list_head working_q;
+	struct list_head done_q;
+	wait_queue_head_t enc_queue;
+	int enc_counter;
+	bool capture_on;
+	int ping_pong_csi;
+	int local_buf_num;
+	struct mxc_v4l_frame *frames;	/* of struct mxc_capture */
+	int frame_slots;
+	int frame_count;
+	struct mxc_v4l_frame dummy_frame;
+} cam_data;
+
+/* what the application loop saw */
+struct loop_stats {
+	unsigned int completed;		/* frames moved to the done queue */
+	unsigned int dequeued;
+	unsigned int polls;
+	unsigned int readable;
+	unsigned int eagain;
+	unsigned int sleeps;		/* poll found nothing to do */
+	unsigned int wakeups;		/* of the sleeping loop */
+	unsigned int errors;		/* POLLERR */
+};
+
+static cam_data g_cam;
+static int g_failed;
+
+#define CHECK(cond)							\
+	do {								\
+		if (!(cond)) {						\
+			printf("%s:%d: check failed: %s\n",		\
+			       __FILE__, __LINE__, #cond);		\
+			g_failed = 1;					\
+		}							\
+	} while (0)
+
+/* the IPU takes the buffer address for the other ping-pong buffer */
+static int enc_update_eba(u32 eba, int *buffer_num)
+{
+	(void)eba;
+	*buffer_num = (*buffer_num == 0) ? 1 : 0;
+	return 0;
+}
+
+static int list_count(struct list_head *head)
+{
+	struct list_head *p;
+	int n = 0;
+
+	for (p = head->next; p != head; p = p->next)
+		n++;
+	return n;
+}
+
+/* as in mxc_v4l2_capture.c */
+static void camera_callback(cam_data *cam)
+{
+	struct mxc_v4l_frame *done_frame;
+	struct mxc_v4l_frame *ready_frame;
+
+	spin_lock(&cam->queue_int_lock);
+	spin_lock(&cam->dqueue_int_lock);
+	if (!list_empty(&cam->working_q)) {
+		done_frame = list_entry(cam->working_q.next,
+					struct mxc_v4l_frame, queue);
+
+		if (done_frame->ipu_buf_num != cam->local_buf_num)
+			goto next;
+
+		if (done_frame->buffer.flags & V4L2_BUF_FLAG_QUEUED) {
+			done_frame->buffer.flags |= V4L2_BUF_FLAG_DONE;
+			done_frame->buffer.flags &= ~V4L2_BUF_FLAG_QUEUED;
+
+			list_del(cam->working_q.next);
+			list_add_tail(&done_frame->queue, &cam->done_q);
+
+			cam->enc_counter++;
+			wake_up_interruptible(&cam->enc_queue);
+		}
+	}
+
+next:
+	if (!list_empty(&cam->ready_q)) {
+		ready_frame = list_entry(cam->ready_q.next,
+					 struct mxc_v4l_frame, queue);
+		if (enc_update_eba(ready_frame->buffer.offset,
+				   &cam->ping_pong_csi) == 0) {
+			list_del(cam->ready_q.next);
+			list_add_tail(&ready_frame->queue, &cam->working_q);
+			ready_frame->ipu_buf_num = cam->local_buf_num;
+		}
+	} else {
+		enc_update_eba(cam->dummy_frame.buffer.offset,
+			       &cam->ping_pong_csi);
+	}
+
+	cam->local_buf_num = (cam->local_buf_num == 0) ? 1 : 0;
+	spin_unlock(&cam->dqueue_int_lock);
+	spin_unlock(&cam->queue_int_lock);
+}
+
+static unsigned int mxc_poll(cam_data *cam, poll_table *wait)
+{
+	unsigned long lock_flags;
+	unsigned int res = 0;
+
+	poll_wait(NULL, &cam->enc_queue, wait);
+
+	spin_lock_irqsave(&cam->dqueue_int_lock, lock_flags);
+	if (cam->enc_counter > 0)
+		res = POLLIN | POLLRDNORM;
+	else if (!cam->capture_on)
+		res = POLLERR;
+	spin_unlock_irqrestore(&cam->dqueue_int_lock, lock_flags);
+
+	return res;
+}
+
+/* the poll of the driver before */
+static unsigned int old_poll(cam_data *cam, poll_table *wait)
+{
+	if (down_interruptible(&cam->busy_lock))
+		return -EINTR;
+
+	poll_wait(NULL, &cam->enc_queue, wait);
+
+	up(&cam->busy_lock);
+	return POLLIN | POLLRDNORM;
+}
+
+/* VIDIOC_DQBUF with O_NONBLOCK, the wait of mxc_v4l_dqueue() not taken */
+static int dqbuf(cam_data *cam, int *index)
+{
+	struct mxc_v4l_frame *frame;
+	unsigned long lock_flags;
+
+	if (cam->enc_counter == 0)
+		return -EAGAIN;
+
+	if (down_interruptible(&cam->busy_lock))
+		return -EBUSY;
+
+	spin_lock_irqsave(&cam->dqueue_int_lock, lock_flags);
+	cam->enc_counter--;
+	frame = list_entry(cam->done_q.next, struct mxc_v4l_frame, queue);
+	list_del(cam->done_q.next);
+	CHECK(frame->buffer.flags & V4L2_BUF_FLAG_DONE);
+	frame->buffer.flags &= ~V4L2_BUF_FLAG_DONE;
+	*index = frame->index;
+	spin_unlock_irqrestore(&cam->dqueue_int_lock, lock_flags);
+
+	up(&cam->busy_lock);
+	return 0;
+}
+
+static int qbuf(cam_data *cam, int index)
+{
+	struct mxc_v4l_frame *frame = &cam->frames[index];
+	unsigned long lock_flags;
+	int retval = 0;
+
+	spin_lock_irqsave(&cam->queue_int_lock, lock_flags);
+	if ((frame->buffer.flags & 0x7) == V4L2_BUF_FLAG_MAPPED) {
+		frame->buffer.flags |= V4L2_BUF_FLAG_QUEUED;
+		list_add_tail(&frame->queue, &cam->ready_q);
+	} else {
+		retval = -EINVAL;
+	}
+	spin_unlock_irqrestore(&cam->queue_int_lock, lock_flags);
+	return retval;
+}
+
+static void streamon(cam_data *cam)
+{
+	struct mxc_v4l_frame *frame;
+	unsigned long lock_flags;
+	int i;
+
+	spin_lock_irqsave(&cam->queue_int_lock, lock_flags);
+	cam->ping_pong_csi = 0;
+	cam->local_buf_num = 0;
+	for (i = 0; i < 2; i++) {
+		frame = list_entry(cam->ready_q.next, struct mxc_v4l_frame,
+				   queue);
+		list_del(cam->ready_q.next);
+		list_add_tail(&frame->queue, &cam->working_q);
+		frame->ipu_buf_num = cam->ping_pong_csi;
+		enc_update_eba(frame->buffer.offset, &cam->ping_pong_csi);
+	}
+	spin_unlock_irqrestore(&cam->queue_int_lock, lock_flags);
+
+	cam->capture_on = true;
+}
+
+/* as in mxc_v4l2_capture.c */
+static void mxc_free_frames(cam_data *cam)
+{
+	int i;
+
+	for (i = 0; i < cam->frame_count; i++)
+		cam->frames[i].buffer.flags = V4L2_BUF_FLAG_MAPPED;
+
+	cam->enc_counter = 0;
+	INIT_LIST_HEAD(&cam->ready_q);
+	INIT_LIST_HEAD(&cam->working_q);
+	INIT_LIST_HEAD(&cam->done_q);
+}
+
+static int mxc_streamoff(cam_data *cam)
+{
+	if (cam->capture_on == false)
+		return 0;
+
+	mxc_free_frames(cam);
+	cam->capture_on = false;
+
+	wake_up_interruptible(&cam->enc_queue);
+	return 0;
+}
+
+/* without the export table */
+static int mxc_frame_table(cam_data *cam, int count)
+{
+	struct mxc_v4l_frame *frames;
+
+	if (count > cam->frame_slots) {
+		frames = kcalloc(count, sizeof(*frames), GFP_KERNEL);
+		if (frames == NULL) {
+			memset(cam->frames, 0,
+			       cam->frame_slots * sizeof(*frames));
+			cam->frame_count = 0;
+			return -ENOMEM;
+		}
+		kfree(cam->frames);
+		cam->frames = frames;
+		cam->frame_slots = count;
+	} else if (cam->frame_slots) {
+		memset(cam->frames, 0, cam->frame_slots * sizeof(*frames));
+	}
+
+	cam->frame_count = count;
+	return 0;
+}
+
+/* VIDIOC_REQBUFS, the frame buffers at fixed bus addresses */
+static int reqbufs(cam_data *cam, int count)
+{
+	int retval, i;
+
+	retval = mxc_streamoff(cam);
+	if (retval)
+		return retval;
+	mxc_free_frames(cam);
+	retval = mxc_frame_table(cam, count);
+	if (retval)
+		return retval;
+	for (i = 0; i < count; i++) {
+		cam->frames[i].index = i;
+		cam->frames[i].buffer.offset = 0x10000000 + i * 0x100000;
+		cam->frames[i].buffer.flags = V4L2_BUF_FLAG_MAPPED;
+	}
+	return 0;
+}
+
+static void open_device(cam_data *cam)
+{
+	kfree(cam->frames);
+	memset(cam, 0, sizeof(*cam));
+	spin_lock_init(&cam->queue_int_lock);
+	spin_lock_init(&cam->dqueue_int_lock);
+	sema_init(&cam->busy_lock, 1);
+	INIT_LIST_HEAD(&cam->ready_q);
+	INIT_LIST_HEAD(&cam->working_q);
+	INIT_LIST_HEAD(&cam->done_q);
+	init_waitqueue_head(&cam->enc_queue);
+}
+
+/* REQBUFS, every buffer queued and STREAMON */
+static void start(cam_data *cam)
+{
+	int i;
+
+	open_device(cam);
+	CHECK(reqbufs(cam, MODEL_BUFFERS) == 0);
+	for (i = 0; i < MODEL_BUFFERS; i++)
+		CHECK(qbuf(cam, i) == 0);
+	streamon(cam);
+}
+
+static u64 g_next_frame_ns;
+
+/* the frames completing until now */
+static void run_camera(cam_data *cam, struct loop_stats *st)
+{
+	int counter;
+
+	while (g_next_frame_ns <= host_now_ns) {
+		counter = cam->enc_counter;
+		camera_callback(cam);
+		st->completed += cam->enc_counter - counter;
+		g_next_frame_ns += MODEL_FRAME_NS;
+	}
+}
+
+/*
+ * The application: poll, dequeue and queue back when readable, otherwise
+ * sleep in poll until the queue is woken. Each frame costs work_ns.
+ */
+static void run_loop(cam_data *cam, unsigned int (*poll)(cam_data *,
+		poll_table *), u64 work_ns, unsigned int frames,
+		struct loop_stats *st)
+{
+	poll_table table = { NULL };
+	unsigned int res, wakeups;
+	int index;
+
+	memset(st, 0, sizeof(*st));
+	g_next_frame_ns = host_now_ns + MODEL_FRAME_NS;
+	while (st->completed < frames) {
+		run_camera(cam, st);
+
+		res = poll(cam, &table);
+		st->polls++;
+		host_now_ns += MODEL_SYSCALL_NS;
+		if (poll == mxc_poll) {
+			CHECK(cam->enc_counter == list_count(&cam->done_q));
+			CHECK(!!(res & POLLIN) == (cam->enc_counter > 0));
+		}
+
+		if (res & POLLERR) {
+			st->errors++;
+			break;
+		}
+		if (res & POLLIN) {
+			/* the readable poll returns without sleeping */
+			poll_freewait(&table);
+			st->readable++;
+			host_now_ns += MODEL_SYSCALL_NS;
+			if (dqbuf(cam, &index) < 0) {
+				st->eagain++;
+				continue;
+			}
+			st->dequeued++;
+			host_now_ns += work_ns;
+			run_camera(cam, st);
+			CHECK(qbuf(cam, index) == 0);
+			host_now_ns += MODEL_SYSCALL_NS;
+			continue;
+		}
+
+		/* asleep in poll() until the next wake-up of the queue */
+		st->sleeps++;
+		wakeups = cam->enc_queue.wakeups;
+		while (cam->enc_queue.wakeups == wakeups) {
+			host_now_ns = g_next_frame_ns;
+			run_camera(cam, st);
+		}
+		st->wakeups++;
+		poll_freewait(&table);
+	}
+}
+
+static void print_stats(const char *name, const struct loop_stats *st)
+{
+	printf("%-28s %3u frames: %3u dequeued, %6u polls, %3u sleeps, "
+	       "%6u EAGAIN\n", name, st->completed, st->dequeued, st->polls,
+	       st->sleeps, st->eagain);
+}
+
+/* a loop faster than the frame rate sleeps between the frames */
+static void test_fast_loop(void)
+{
+	struct loop_stats st;
+	unsigned int wakeups;
+
+	start(&g_cam);
+	wakeups = g_cam.enc_queue.wakeups;
+	run_loop(&g_cam, mxc_poll, 1000000, MODEL_FRAMES, &st);
+	print_stats("poll, 1 ms per frame", &st);
+	CHECK(g_cam.enc_queue.wakeups - wakeups == st.completed);
+	CHECK(st.dequeued + g_cam.enc_counter == st.completed);
+	CHECK(st.eagain == 0);
+	CHECK(st.readable == st.dequeued);
+	CHECK(st.wakeups == st.sleeps);
+	/* one poll to find the frame and one to go to sleep */
+	CHECK(st.polls <= 2 * st.completed + 1);
+	CHECK(st.sleeps >= st.dequeued - 1);
+}
+
+/* a loop slower than the frame rate finds frames waiting, no sleep */
+static void test_slow_loop(void)
+{
+	struct loop_stats st;
+	unsigned int wakeups;
+
+	start(&g_cam);
+	wakeups = g_cam.enc_queue.wakeups;
+	run_loop(&g_cam, mxc_poll, MODEL_FRAME_NS + MODEL_FRAME_NS / 2,
+		 MODEL_FRAMES, &st);
+	print_stats("poll, 1.5 frames per frame", &st);
+	CHECK(g_cam.enc_queue.wakeups - wakeups == st.completed);
+	CHECK(st.dequeued + g_cam.enc_counter == st.completed);
+	CHECK(st.eagain == 0);
+	CHECK(st.readable == st.dequeued);
+	CHECK(st.sleeps <= 1);
+}
+
+/* the poll before was always readable, the loop spun on EAGAIN */
+static void test_old_poll(void)
+{
+	struct loop_stats st, old;
+
+	start(&g_cam);
+	run_loop(&g_cam, mxc_poll, 1000000, MODEL_FRAMES, &st);
+	start(&g_cam);
+	run_loop(&g_cam, old_poll, 1000000, MODEL_FRAMES, &old);
+	print_stats("poll before, 1 ms per frame", &old);
+	CHECK(old.sleeps == 0);
+	CHECK(old.eagain > 1000 * old.completed);
+	CHECK(old.polls > 100 * st.polls);
+}
+
+/* poll while an ioctl holds busy_lock */
+static void test_busy_lock(void)
+{
+	poll_table table = { NULL };
+	unsigned int res;
+
+	start(&g_cam);
+	CHECK(down_interruptible(&g_cam.busy_lock) == 0);
+	res = mxc_poll(&g_cam, &table);
+	CHECK(res == 0);
+	CHECK(g_cam.busy_lock.blocked == 0);
+	poll_freewait(&table);
+
+	host_now_ns += MODEL_FRAME_NS;
+	camera_callback(&g_cam);
+	res = mxc_poll(&g_cam, &table);
+	CHECK(res == (POLLIN | POLLRDNORM));
+	CHECK(g_cam.busy_lock.blocked == 0);
+	poll_freewait(&table);
+
+	old_poll(&g_cam, &table);
+	CHECK(g_cam.busy_lock.blocked == 1);
+	up(&g_cam.busy_lock);
+}
+
+/* STREAMOFF wakes a sleeping poller, which sees POLLERR */
+static void test_streamoff(void)
+{
+	poll_table table = { NULL };
+	unsigned int wakeups;
+	unsigned int res;
+
+	start(&g_cam);
+	res = mxc_poll(&g_cam, &table);
+	CHECK(res == 0);
+	CHECK(g_cam.enc_queue.waiters == 1);
+	wakeups = g_cam.enc_queue.wakeups;
+	mxc_streamoff(&g_cam);
+	CHECK(g_cam.enc_queue.wakeups == wakeups + 1);
+	poll_freewait(&table);
+	res = mxc_poll(&g_cam, &table);
+	CHECK(res == POLLERR);
+	poll_freewait(&table);
+	CHECK(g_cam.enc_queue.waiters == 0);
+
+	/* a frame completed before STREAMOFF is gone with it */
+	start(&g_cam);
+	camera_callback(&g_cam);
+	CHECK(mxc_poll(&g_cam, NULL) == (POLLIN | POLLRDNORM));
+	mxc_streamoff(&g_cam);
+	CHECK(mxc_poll(&g_cam, NULL) == POLLERR);
+}
+
+/*
+ * Buffers queued but never streamed, then REQBUFS again: the queues must
+ * not keep pointing into the frame table, whether it is reallocated for
+ * more frames or cleared for the same number.
+ */
+static void test_reqbufs_queued(void)
+{
+	int i;
+
+	open_device(&g_cam);
+	CHECK(reqbufs(&g_cam, MODEL_BUFFERS) == 0);
+	for (i = 0; i < MODEL_BUFFERS; i++)
+		CHECK(qbuf(&g_cam, i) == 0);
+
+	/* more frames, the old table is freed */
+	CHECK(reqbufs(&g_cam, 2 * MODEL_BUFFERS) == 0);
+	CHECK(list_empty(&g_cam.ready_q));
+	CHECK(list_empty(&g_cam.working_q));
+	CHECK(list_empty(&g_cam.done_q));
+	for (i = 0; i < 2 * MODEL_BUFFERS; i++)
+		CHECK(qbuf(&g_cam, i) == 0);
+	CHECK(list_count(&g_cam.ready_q) == 2 * MODEL_BUFFERS);
+
+	/* as many frames again, the table is cleared in place */
+	CHECK(reqbufs(&g_cam, 2 * MODEL_BUFFERS) == 0);
+	CHECK(list_empty(&g_cam.ready_q));
+	for (i = 0; i < 2 * MODEL_BUFFERS; i++)
+		CHECK(qbuf(&g_cam, i) == 0);
+	CHECK(list_count(&g_cam.ready_q) == 2 * MODEL_BUFFERS);
+
+	/* the queued frames stream as usual */
+	streamon(&g_cam);
+	camera_callback(&g_cam);
+	CHECK(g_cam.enc_counter == 1);
+	CHECK(list_count(&g_cam.ready_q) == 2 * MODEL_BUFFERS - 3);
+
+	/* fewer frames while streaming */
+	CHECK(reqbufs(&g_cam, MODEL_BUFFERS) == 0);
+	CHECK(!g_cam.capture_on && g_cam.enc_counter == 0);
+	CHECK(list_empty(&g_cam.ready_q) && list_empty(&g_cam.done_q));
+
+	kfree(g_cam.frames);
+	g_cam.frames = NULL;
+	printf("reqbufs after qbuf passed\n");
+}
+
+int main(void)
+{
+	test_fast_loop();
+	test_slow_loop();
+	test_old_poll();
+	test_busy_lock();
+	test_streamoff();
+	test_reqbufs_queued();
+
+	printf("%s\n", g_failed ? "FAILED" : "passed");
+	return g_failed ? -1 : 0;
+}
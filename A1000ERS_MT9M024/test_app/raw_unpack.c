@@ -0,0 +1,154 @@
+/*
+ * Copyright (C) 2013 Aptina Imaging
+ */
+
+/*
+ * The code contained herein is licensed under the GNU General Public
+ * License. You may obtain a copy of the GNU General Public License
+ * Version 2 or later at the following locations:
+ *
+ * http://www.opensource.org/licenses/gpl-license.html
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+/*
+ * @file raw_unpack.c
+ *
+ * @brief Conversion of tightly packed raw sensor data to 16 bit words
+ *
+ * The line functions take 8 pixels per step out of one 64 bit load and
+ * one smaller load, so they never read past the packed line. The rest of
+ * a line goes through the reference code.
+ */
+
+#include <string.h>
+#include "raw_unpack.h"
+
+static inline uint64_t load_le64(const uint8_t *p)
+{
+	uint64_t v;
+
+	memcpy(&v, p, sizeof(v));
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+	v = __builtin_bswap64(v);
+#endif
+	return v;
+}
+
+static inline uint32_t load_le32(const uint8_t *p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline uint32_t load_le16(const uint8_t *p)
+{
+	return p[0] | (p[1] << 8);
+}
+
+void raw_unpack12_ref(uint16_t *dst, const uint8_t *src, int width)
+{
+	int x;
+
+	for (x = 0; x + 1 < width; x += 2, src += 3) {
+		dst[x] = src[0] | ((src[1] & 0x0f) << 8);
+		dst[x + 1] = (src[1] >> 4) | (src[2] << 4);
+	}
+}
+
+void raw_unpack10_ref(uint16_t *dst, const uint8_t *src, int width)
+{
+	int x;
+
+	for (x = 0; x + 3 < width; x += 4, src += 5) {
+		dst[x] = src[0] | ((src[1] & 0x03) << 8);
+		dst[x + 1] = (src[1] >> 2) | ((src[2] & 0x0f) << 6);
+		dst[x + 2] = (src[2] >> 4) | ((src[3] & 0x3f) << 4);
+		dst[x + 3] = (src[3] >> 6) | (src[4] << 2);
+	}
+}
+
+void raw_unpack12_line(uint16_t *dst, const uint8_t *src, int width)
+{
+	uint64_t a;
+	uint32_t b;
+	int x;
+
+	/* 8 pixels in 12 bytes */
+	for (x = 0; x + 8 <= width; x += 8, src += 12, dst += 8) {
+		a = load_le64(src);
+		b = load_le32(src + 8);
+		dst[0] = a & 0xfff;
+		dst[1] = (a >> 12) & 0xfff;
+		dst[2] = (a >> 24) & 0xfff;
+		dst[3] = (a >> 36) & 0xfff;
+		dst[4] = (a >> 48) & 0xfff;
+		dst[5] = ((a >> 60) | (b << 4)) & 0xfff;
+		dst[6] = (b >> 8) & 0xfff;
+		dst[7] = (b >> 20) & 0xfff;
+	}
+	raw_unpack12_ref(dst, src, width - x);
+}
+
+void raw_unpack10_line(uint16_t *dst, const uint8_t *src, int width)
+{
+	uint64_t a;
+	uint32_t b;
+	int x;
+
+	/* 8 pixels in 10 bytes */
+	for (x = 0; x + 8 <= width; x += 8, src += 10, dst += 8) {
+		a = load_le64(src);
+		b = load_le16(src + 8);
+		dst[0] = a & 0x3ff;
+		dst[1] = (a >> 10) & 0x3ff;
+		dst[2] = (a >> 20) & 0x3ff;
+		dst[3] = (a >> 30) & 0x3ff;
+		dst[4] = (a >> 40) & 0x3ff;
+		dst[5] = (a >> 50) & 0x3ff;
+		dst[6] = ((a >> 60) | (b << 4)) & 0x3ff;
+		dst[7] = (b >> 6) & 0x3ff;
+	}
+	raw_unpack10_ref(dst, src, width - x);
+}
+
+void raw_pack12_line(uint8_t *dst, const uint16_t *src, int width)
+{
+	int x;
+
+	for (x = 0; x + 1 < width; x += 2, dst += 3) {
+		dst[0] = src[x] & 0xff;
+		dst[1] = ((src[x] >> 8) & 0x0f) | ((src[x + 1] & 0x0f) << 4);
+		dst[2] = (src[x + 1] >> 4) & 0xff;
+	}
+}
+
+void raw_pack10_line(uint8_t *dst, const uint16_t *src, int width)
+{
+	int x;
+
+	for (x = 0; x + 3 < width; x += 4, dst += 5) {
+		dst[0] = src[x] & 0xff;
+		dst[1] = ((src[x] >> 8) & 0x03) | ((src[x + 1] & 0x3f) << 2);
+		dst[2] = ((src[x + 1] >> 6) & 0x0f) | ((src[x + 2] & 0x0f) << 4);
+		dst[3] = ((src[x + 2] >> 4) & 0x3f) | ((src[x + 3] & 0x03) << 6);
+		dst[4] = (src[x + 3] >> 2) & 0xff;
+	}
+}
+
+void raw_unpack12(uint16_t *dst, const uint8_t *src, int width, int height,
+		  size_t stride)
+{
+	int y;
+
+	for (y = 0; y < height; y++, src += stride, dst += width)
+		raw_unpack12_line(dst, src, width);
+}
+
+void raw_unpack10(uint16_t *dst, const uint8_t *src, int width, int height,
+		  size_t stride)
+{
+	int y;
+
+	for (y = 0; y < height; y++, src += stride, dst += width)
+		raw_unpack10_line(dst, src, width);
+}
@@ -0,0 +1,66 @@
+/*
+ * Copyright (C) 2013 Aptina Imaging
+ */
+
+/*
+ * The code contained herein is licensed under the GNU General Public
+ * License. You may obtain a copy of the GNU General Public License
+ * Version 2 or later at the following locations:
+ *
+ * http://www.opensource.org/licenses/gpl-license.html
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+/*
+ * @file raw_unpack.h
+ *
+ * @brief Conversion of tightly packed raw sensor data to 16 bit words
+ *
+ * The packed formats are a little endian bit stream: the first pixel takes
+ * the low bits of the first byte, every pixel continues at the next free
+ * bit. 12 bit data keeps two pixels in three bytes, 10 bit data four pixels
+ * in five bytes. The 16 bit words hold the pixel in the low bits, the same
+ * as V4L2_PIX_FMT_Y16 from the capture driver.
+ *
+ * Every line is converted separately, the stride of the packed data may
+ * include padding. The width has to be a multiple of 2 (12 bit) or 4
+ * (10 bit) pixels.
+ */
+
+#ifndef __RAW_UNPACK_H__
+#define __RAW_UNPACK_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+/* bytes of one packed line of width pixels */
+#define RAW_PACKED12_LINE(width)	((width) * 3 / 2)
+#define RAW_PACKED10_LINE(width)	((width) * 5 / 4)
+
+/* one pixel at a time, the reference for the fast versions */
+void raw_unpack12_ref(uint16_t *dst, const uint8_t *src, int width);
+void raw_unpack10_ref(uint16_t *dst, const uint8_t *src, int width);
+
+/* one line, 64 bit loads */
+void raw_unpack12_line(uint16_t *dst, const uint8_t *src, int width);
+void raw_unpack10_line(uint16_t *dst, const uint8_t *src, int width);
+
+/* packing, for tests and for writing packed files */
+void raw_pack12_line(uint8_t *dst, const uint16_t *src, int width);
+void raw_pack10_line(uint8_t *dst, const uint16_t *src, int width);
+
+/* whole frames, stride is the bytes per packed line */
+void raw_unpack12(uint16_t *dst, const uint8_t *src, int width, int height,
+		  size_t stride);
+void raw_unpack10(uint16_t *dst, const uint8_t *src, int width, int height,
+		  size_t stride);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __RAW_UNPACK_H__ */
@@ -0,0 +1,174 @@
+/*
+ * Copyright (C) 2013 Aptina Imaging
+ */
+
+/*
+ * The code contained herein is licensed under the GNU General Public
+ * License. You may obtain a copy of the GNU General Public License
+ * Version 2 or later at the following locations:
+ *
+ * http://www.opensource.org/licenses/gpl-license.html
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+/*
+ * @file raw_unpack_bench.c
+ *
+ * @brief Check and time the raw unpack functions
+ *
+ * Packs a random frame, unpacks it with the reference and the line
+ * functions and compares both against the input. Then reports the unpack
+ * throughput in packed megabytes per second. Runs on the board as well as
+ * on a build host.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "raw_unpack.h"
+
+static int g_width = 1280;
+static int g_height = 960;
+static int g_loops = 50;
+
+typedef void (*unpack_fn)(uint16_t *dst, const uint8_t *src, int width);
+typedef void (*pack_fn)(uint8_t *dst, const uint16_t *src, int width);
+
+struct unpack_test {
+	const char *name;
+	int bits;
+	int line;		/* packed bytes per line */
+	pack_fn pack;
+	unpack_fn ref;
+	unpack_fn fast;
+};
+
+void usage(void)
+{
+	printf("Usage: raw_unpack_bench.out [-w width] [-h height] [-n loops]\n"
+		"-w    Frame width, 1280 by default, multiple of 4\n"
+		"-h    Frame height, 960 by default\n"
+		"-n    Frames per measurement, 50 by default\n");
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static double time_unpack(unpack_fn fn, uint16_t *dst, const uint8_t *src,
+			  int line)
+{
+	double start = now();
+	int i, y;
+
+	for (i = 0; i < g_loops; i++)
+		for (y = 0; y < g_height; y++)
+			fn(dst + y * g_width, src + y * line, g_width);
+	return now() - start;
+}
+
+static int run_test(const struct unpack_test *t)
+{
+	size_t pixels = (size_t)g_width * g_height;
+	size_t packed = (size_t)t->line * g_height;
+	uint16_t *in, *out;
+	uint8_t *raw;
+	double t_ref, t_fast;
+	size_t i;
+	int y, ret = 0;
+
+	in = malloc(pixels * sizeof(*in));
+	out = malloc(pixels * sizeof(*out));
+	raw = malloc(packed);
+	if (!in || !out || !raw) {
+		printf("out of memory\n");
+		ret = -1;
+		goto exit0;
+	}
+
+	for (i = 0; i < pixels; i++)
+		in[i] = rand() & ((1 << t->bits) - 1);
+	for (y = 0; y < g_height; y++)
+		t->pack(raw + y * t->line, in + y * g_width, g_width);
+
+	memset(out, 0xff, pixels * sizeof(*out));
+	for (y = 0; y < g_height; y++)
+		t->ref(out + y * g_width, raw + y * t->line, g_width);
+	if (memcmp(in, out, pixels * sizeof(*out))) {
+		printf("%s: reference unpack differs\n", t->name);
+		ret = -1;
+		goto exit0;
+	}
+
+	memset(out, 0xff, pixels * sizeof(*out));
+	for (y = 0; y < g_height; y++)
+		t->fast(out + y * g_width, raw + y * t->line, g_width);
+	if (memcmp(in, out, pixels * sizeof(*out))) {
+		printf("%s: line unpack differs\n", t->name);
+		ret = -1;
+		goto exit0;
+	}
+
+	t_ref = time_unpack(t->ref, out, raw, t->line);
+	t_fast = time_unpack(t->fast, out, raw, t->line);
+	printf("%s %dx%d: reference %.1f MB/s, line %.1f MB/s, %.2f ms/frame\n",
+		t->name, g_width, g_height,
+		packed * g_loops / t_ref / 1e6,
+		packed * g_loops / t_fast / 1e6,
+		t_fast * 1e3 / g_loops);
+
+exit0:
+	free(in);
+	free(out);
+	free(raw);
+	return ret;
+}
+
+int main(int argc, char **argv)
+{
+	struct unpack_test tests[2];
+	int i, ret = 0;
+
+	for (i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-w") == 0 && i + 1 < argc)
+			g_width = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-h") == 0 && i + 1 < argc)
+			g_height = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+			g_loops = atoi(argv[++i]);
+		else {
+			usage();
+			return -1;
+		}
+	}
+	if (g_width <= 0 || g_width % 4 || g_height <= 0 || g_loops <= 0) {
+		usage();
+		return -1;
+	}
+
+	tests[0].name = "raw12";
+	tests[0].bits = 12;
+	tests[0].line = RAW_PACKED12_LINE(g_width);
+	tests[0].pack = raw_pack12_line;
+	tests[0].ref = raw_unpack12_ref;
+	tests[0].fast = raw_unpack12_line;
+
+	tests[1].name = "raw10";
+	tests[1].bits = 10;
+	tests[1].line = RAW_PACKED10_LINE(g_width);
+	tests[1].pack = raw_pack10_line;
+	tests[1].ref = raw_unpack10_ref;
+	tests[1].fast = raw_unpack10_line;
+
+	srand(1);
+	for (i = 0; i < 2; i++)
+		if (run_test(&tests[i]))
+			ret = -1;
+
+	return ret;
+}
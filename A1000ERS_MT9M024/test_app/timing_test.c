@@ -0,0 +1,210 @@
+/*
+ * Copyright (C) 2013 Aptina Imaging
+ */
+
+/*
+ * The code contained herein is licensed under the GNU General Public
+ * License. You may obtain a copy of the GNU General Public License
+ * Version 2 or later at the following locations:
+ *
+ * http://www.opensource.org/licenses/gpl-license.html
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+/*
+ * @file timing_test.c
+ *
+ * @brief Host test of the MT9M024 readout timing solver
+ *
+ * Runs mt9m024_solve_timing() of mt9m024_timing.h over a table of readout
+ * windows, EXTCLK frequencies and requested frame rates and compares row
+ * length, maximum and resulting frame rate with the table. Every result is
+ * also checked against the sensor limits, and its pixel clock against a
+ * plain search over all PLL settings. Build on the host with
+ *
+ * gcc -Wall -Wextra -Ihost -I../kernel/drivers/media/video/mxc/capture
+ *	timing_test.c -o timing_test
+ */
+
+#include "kernel_host.h"
+#include "mt9m024_timing.h"
+
+#define MHZ(f)		((u32)((f) * 1000000))
+
+struct timing_case {
+	const char *name;
+	u32 extclk;
+	int window_width;
+	int window_height;
+	int skip;
+	int fps;		/* requested */
+	int ret;
+	int line_length;
+	int max_fps;
+	int result_fps;
+};
+
+/*
+ * Row length is the window width read plus the horizontal blanking, at
+ * least APT_MT9M024_MIN_LINE_LENGTH; the shortest frame is the rows read
+ * plus the vertical blanking. The maximum frame rate follows from the
+ * 74.25 MHz pixel clock, which all three EXTCLKs reach or come close to.
+ */
+static const struct timing_case cases[] = {
+	/* the modes of mt9m024_init_contexts() at the board's 24 MHz */
+	{ "full",	MHZ(24), 1280, 960, 1,  45, 0, 1650,  45,  45 },
+	{ "full",	MHZ(24), 1280, 960, 1,  30, 0, 1650,  45,  30 },
+	{ "full",	MHZ(24), 1280, 960, 1,  15, 0, 1650,  45,  15 },
+	{ "full",	MHZ(24), 1280, 960, 1,   1, 0, 1650,  45,   1 },
+	{ "full",	MHZ(24), 1280, 960, 1, 100, 0, 1650,  45,  45 },
+	{ "full",	MHZ(24), 1280, 960, 1,   0, 0, 1650,  45,   1 },
+	{ "preview",	MHZ(24), 1280, 960, 1,  45, 0, 1650,  45,  45 },
+	{ "skip",	MHZ(24), 1280, 960, 2, 104, 0, 1388, 104, 104 },
+	{ "skip",	MHZ(24), 1280, 960, 2,  60, 0, 1388, 104,  60 },
+	{ "720p",	MHZ(24), 1280, 720, 1,  60, 0, 1650,  60,  60 },
+	{ "720p",	MHZ(24), 1280, 720, 1,  50, 0, 1650,  60,  50 },
+	{ "roi vga",	MHZ(24),  640, 480, 1, 104, 0, 1388, 104, 104 },
+	{ "roi qvga",	MHZ(24),  320, 240, 1, 198, 0, 1388, 198, 198 },
+	{ "roi qvga",	MHZ(24),  320, 240, 1, 120, 0, 1388, 198, 120 },
+	{ "roi qvga",	MHZ(24),  320, 240, 1, 500, 0, 1388, 198, 198 },
+	/* sensorwidth=640 sensorheight=480 binning=0 */
+	{ "640x480",	MHZ(24),  640, 480, 1,  30, 0, 1388, 104,  30 },
+	/* other EXTCLKs */
+	{ "full",	MHZ(27), 1280, 960, 1,  45, 0, 1650,  45,  45 },
+	{ "roi qvga",	MHZ(27),  320, 240, 1, 198, 0, 1388, 198, 198 },
+	{ "full",	MHZ(50), 1280, 960, 1,  45, 0, 1650,  45,  45 },
+	{ "full",	MHZ(50), 1280, 960, 1,  25, 0, 1650,  45,  25 },
+	/* the PLL cannot run from these */
+	{ "full",	MHZ(5),  1280, 960, 1,  45, -EINVAL, 0, 0, 0 },
+	{ "full",	MHZ(60), 1280, 960, 1,  45, -EINVAL, 0, 0, 0 },
+};
+
+static int g_failed;
+
+#define CHECK(c, cond)							\
+	do {								\
+		if (!(cond)) {						\
+			printf("%s %u Hz %d fps: check failed: %s\n",	\
+			       (c)->name, (c)->extclk, (c)->fps, #cond);\
+			g_failed = 1;					\
+		}							\
+	} while (0)
+
+static bool pll_valid(u32 extclk, const struct MT9M024_PLL_ENTRY *pll)
+{
+	u64 vco;
+
+	if (pll->n == 0 || pll->n > MT9M024_PLL_N_MAX ||
+	    pll->p1 == 0 || pll->p1 > MT9M024_PLL_P1_MAX ||
+	    pll->p2 < MT9M024_PLL_P2_MIN || pll->p2 > MT9M024_PLL_P2_MAX ||
+	    pll->m < MT9M024_PLL_M_MIN || pll->m > MT9M024_PLL_M_MAX)
+		return false;
+	if (extclk / pll->n < MT9M024_PLL_IN_MIN ||
+	    extclk / pll->n > MT9M024_PLL_IN_MAX)
+		return false;
+	vco = (u64)extclk * pll->m / pll->n;
+	return vco >= MT9M024_PLL_VCO_MIN && vco <= MT9M024_PLL_VCO_MAX;
+}
+
+/* lowest valid pixel clock at or above target, by trying all settings */
+static u32 pll_reference(u32 extclk, u32 target)
+{
+	struct MT9M024_PLL_ENTRY pll;
+	u32 best = 0, clk;
+	unsigned int m, n, p1, p2;
+
+	for (n = 1; n <= MT9M024_PLL_N_MAX; n++)
+		for (p1 = 1; p1 <= MT9M024_PLL_P1_MAX; p1++)
+			for (p2 = MT9M024_PLL_P2_MIN; p2 <= MT9M024_PLL_P2_MAX;
+			     p2++)
+				for (m = MT9M024_PLL_M_MIN;
+				     m <= MT9M024_PLL_M_MAX; m++) {
+					pll.m = m;
+					pll.n = n;
+					pll.p1 = p1;
+					pll.p2 = p2;
+					if (!pll_valid(extclk, &pll))
+						continue;
+					clk = (u64)extclk * m / (n * p1 * p2);
+					if (clk < target ||
+					    clk > APT_MT9M024_MAX_PIXCLK)
+						continue;
+					if (!best || clk < best)
+						best = clk;
+				}
+	return best;
+}
+
+static void check_case(const struct timing_case *c)
+{
+	struct mt9m024_context ctx = {
+		.window_width = c->window_width,
+		.window_height = c->window_height,
+		.skip = c->skip,
+	};
+	struct mt9m024_timing t, again;
+	int min_frame = c->window_height / c->skip + APT_MT9M024_MIN_VBLANK;
+	int fps = clamp(c->fps, APT_MT9M024_MIN_FPS, c->max_fps);
+	const struct MT9M024_PLL_ENTRY *pll = &t.pll;
+	int ret;
+
+	memset(&t, 0, sizeof(t));
+	ret = mt9m024_solve_timing(&ctx, c->extclk, c->fps, &t);
+	printf("%-9s %2u MHz %4dx%-4d /%d %3d fps: ", c->name,
+	       c->extclk / 1000000, c->window_width, c->window_height,
+	       c->skip, c->fps);
+	if (ret) {
+		printf("%d\n", ret);
+		CHECK(c, ret == c->ret);
+		return;
+	}
+	printf("%3d fps (max %3d), %8u Hz m %3u n %2u p1 %2u p2 %2u, "
+	       "%4d x %5d\n", t.fps, t.max_fps, t.pixclk, pll->m, pll->n,
+	       pll->p1, pll->p2, t.line_length, t.frame_length);
+	CHECK(c, c->ret == 0);
+	if (c->ret)
+		return;
+
+	/* the table */
+	CHECK(c, t.line_length == c->line_length);
+	CHECK(c, t.max_fps == c->max_fps);
+	CHECK(c, t.fps == c->result_fps);
+
+	/* the sensor limits */
+	CHECK(c, pll_valid(c->extclk, pll));
+	CHECK(c, t.pixclk == (u64)c->extclk * pll->m /
+	      (pll->n * pll->p1 * pll->p2));
+	CHECK(c, t.pixclk <= APT_MT9M024_MAX_PIXCLK);
+	CHECK(c, t.line_length >= APT_MT9M024_MIN_LINE_LENGTH);
+	CHECK(c, t.line_length >= c->window_width / c->skip +
+	      APT_MT9M024_MIN_HBLANK);
+	CHECK(c, t.frame_length >= min_frame);
+	CHECK(c, t.frame_length <= APT_MT9M024_MAX_FRAME_LENGTH);
+
+	/* the rate: reached, and the frame as long as it allows */
+	CHECK(c, t.fps == (int)(t.pixclk / ((u32)t.line_length *
+					    t.frame_length)));
+	CHECK(c, t.fps >= fps);
+	CHECK(c, t.pixclk / ((u32)t.line_length * (t.frame_length + 1)) <
+	      (u32)fps);
+
+	/* the slowest pixel clock for it */
+	CHECK(c, t.pixclk == pll_reference(c->extclk, (u32)fps *
+					   t.line_length * min_frame));
+
+	/* a pure function */
+	memset(&again, 0, sizeof(again));
+	mt9m024_solve_timing(&ctx, c->extclk, c->fps, &again);
+	CHECK(c, memcmp(&t, &again, sizeof(t)) == 0);
+}
+
+int main(void)
+{
+	size_t i;
+
+	for (i = 0; i < ARRAY_SIZE(cases); i++)
+		check_case(&cases[i]);
+
+	printf("%s\n", g_failed ? "FAILED" : "passed");
+	return g_failed ? -1 : 0;
+}
@@ -14,13 +14,18 @@
  */
 
 #include <linux/delay.h>
+#include <linux/jiffies.h>
 #include <linux/i2c.h>
 #include <linux/init.h>
 #include <linux/module.h>
 #include <linux/slab.h>
 #include <linux/kernel.h>
+#include <linux/ctype.h>
 #include <linux/videodev2.h>
 #include <linux/sysfs.h>
+#include <linux/mutex.h>
+#include <linux/workqueue.h>
+#include <linux/completion.h>
 
 #include <linux/fsl_devices.h>
  #include <mach/mipi_csi2.h>
@@ -28,12 +33,13 @@
 #include <media/v4l2-chip-ident.h>
 #include "mxc_v4l2_capture.h"
 #include "mt9d115_mipi.h"
+#include "mt9d115_script.h"
+#include "sensor_i2c_batch.h"
+#include "sensor_i2c_prof.h"
 
-#define MT9D115_PREVIEW_WIDTH			800
-#define MT9D115_PREVIEW_HEIGHT			600
-#define MT9D115_CAPTURE_WIDTH			1600
-#define MT9D115_CAPTURE_HEIGHT			1200
 #define MT9D115_DEFAULT_PIXEL_FORMAT    V4L2_PIX_FMT_YUYV
+#define MT9D115_MODE_PREVIEW			0		// capturemode, context A
+#define MT9D115_MODE_CAPTURE			1		// capturemode, context B
 
 #define	MT9D115_ROW_START_MIN			0
 #define	MT9D115_ROW_START_MAX			MT9D115_PREVIEW_HEIGHT
@@ -56,6 +62,11 @@
 #define MT9D115_XCLK_MIN 				6000000
 #define MT9D115_XCLK_MAX 				24000000
 #define I2C_BYTE_ACCESS					2
+#define MT9D115_GAMMA_KNEES				19
+#define MT9D115_CCM_COEFS				22
+#define MT9D115_TUNING_GAMMA			(1 << 0)
+#define MT9D115_TUNING_CCM				(1 << 1)
+#define MT9D115_SNAPSHOT_VARS			128		// tuning variables kept for a warm init
 
 //#define I2C_FUNCTION_DEBUG
 //#define FUNCTION_DEBUG
@@ -88,475 +99,73 @@ typedef enum pll_setting_t {
 		MT9D115_PLL_MIPI_BAYER10 = 1
 } PLL_SETTING_T;
 
-typedef struct mt9d115_firmware_reg_t {
-	unsigned short u16OffsetAddr 	: 8;	// 
-	unsigned short u16VarAddr 	 	: 5;	//
-	unsigned short u16Access 	 	: 2;	// 01 : logical access
-	unsigned short u16BitLength 	: 1;	// 1: 8-bit access; 0: 16-bit access
-} MT9D115_FIRMWARE_REG_T;
-
-typedef union mt9d115_reg_t {
-	MT9D115_FIRMWARE_REG_T stRegAccess;
-	unsigned short u16RegAddr;
-} MT9D115_REG_T;
-
-typedef struct mt9d115_reg_access_t {
-	MT9D115_REG_T stAddr;
-	unsigned short u16Val;
-} MT9D115_REG_ACCESS_T;
-
-static MT9D115_REG_ACCESS_T mt9d115_gamma_data[] = {
-	{{{0x4F, 0x0B, 0x01, 0x1}}, 0},
-	{{{0x50, 0x0B, 0x01, 0x1}}, 19},
-	{{{0x51, 0x0B, 0x01, 0x1}}, 39},
-	{{{0x52, 0x0B, 0x01, 0x1}}, 67},
-	{{{0x53, 0x0B, 0x01, 0x1}}, 104},
-	{{{0x54, 0x0B, 0x01, 0x1}}, 129},
-	{{{0x55, 0x0B, 0x01, 0x1}}, 147},
-	{{{0x56, 0x0B, 0x01, 0x1}}, 163},
-	{{{0x57, 0x0B, 0x01, 0x1}}, 176},
-	{{{0x58, 0x0B, 0x01, 0x1}}, 188},
-	{{{0x59, 0x0B, 0x01, 0x1}}, 199},
-	{{{0x5A, 0x0B, 0x01, 0x1}}, 209},
-	{{{0x5B, 0x0B, 0x01, 0x1}}, 218},
-	{{{0x5C, 0x0B, 0x01, 0x1}}, 226},
-	{{{0x5D, 0x0B, 0x01, 0x1}}, 233},
-	{{{0x5E, 0x0B, 0x01, 0x1}}, 239},
-	{{{0x5F, 0x0B, 0x01, 0x1}}, 244},
-	{{{0x60, 0x0B, 0x01, 0x1}}, 250},
-	{{{0x61, 0x0B, 0x01, 0x1}}, 255}
+// gamma knees 0..18, VAR8(0x0B,0x4F..0x61); loaded through sysfs
+static u16 mt9d115_gamma_knees[MT9D115_GAMMA_KNEES] = {
+	0, 19, 39, 67, 104, 129, 147, 163, 176, 188,
+	199, 209, 218, 226, 233, 239, 244, 250, 255
 };
 
-static MT9D115_REG_ACCESS_T mt9d115_CCM_data[] = {
-	{{{0x06, 0x03, 0x01, 0x0}}, 0x01D6}, // AWB_CCM_L_0
-	{{{0x08, 0x03, 0x01, 0x0}}, 0xFF89}, // AWB_CCM_L_1
-	{{{0x0A, 0x03, 0x01, 0x0}}, 0xFFA1}, // AWB_CCM_L_2	
-	{{{0x0C, 0x03, 0x01, 0x0}}, 0xFF73}, // AWB_CCM_L_3
-	{{{0x0E, 0x03, 0x01, 0x0}}, 0x019C}, // AWB_CCM_L_4
-	{{{0x10, 0x03, 0x01, 0x0}}, 0xFFF1}, // AWB_CCM_L_5
-	{{{0x12, 0x03, 0x01, 0x0}}, 0xFFB0}, // AWB_CCM_L_6
-	{{{0x14, 0x03, 0x01, 0x0}}, 0xFF2D}, // AWB_CCM_L_7
-	{{{0x16, 0x03, 0x01, 0x0}}, 0x0223}, // AWB_CCM_L_8
-	{{{0x18, 0x03, 0x01, 0x0}}, 0x001C}, //AWB_CCM_L_9
-	{{{0x1A, 0x03, 0x01, 0x0}}, 0x0048}, //AWB_CCM_L_10
-	{{{0x18, 0x03, 0x01, 0x0}}, 0x001C}, //AWB_CCM_L_9
-	{{{0x1A, 0x03, 0x01, 0x0}}, 0x0038}, //AWB_CCM_L_10
-	{{{0x18, 0x03, 0x01, 0x0}}, 0x001E}, //AWB_CCM_L_9
-	{{{0x1A, 0x03, 0x01, 0x0}}, 0x0038}, //AWB_CCM_L_10
-	{{{0x18, 0x03, 0x01, 0x0}}, 0x0022}, //AWB_CCM_L_9
-	{{{0x1A, 0x03, 0x01, 0x0}}, 0x0038}, //AWB_CCM_L_10
-	{{{0x18, 0x03, 0x01, 0x0}}, 0x002C}, //AWB_CCM_L_9
-	{{{0x1A, 0x03, 0x01, 0x0}}, 0x0038}, //AWB_CCM_L_10
-	{{{0x18, 0x03, 0x01, 0x0}}, 0x0024}, //AWB_CCM_L_9
-	{{{0x1A, 0x03, 0x01, 0x0}}, 0x0038}, //AWB_CCM_L_10
-	{{{0x1C, 0x03, 0x01, 0x0}}, 0xFFCD}, // AWB_CCM_RL_0
-	{{{0x1E, 0x03, 0x01, 0x0}}, 0x0023}, // AWB_CCM_RL_1
-	{{{0x20, 0x03, 0x01, 0x0}}, 0x0010}, // AWB_CCM_RL_2
-	{{{0x22, 0x03, 0x01, 0x0}}, 0x0026}, // AWB_CCM_RL_3
-	{{{0x24, 0x03, 0x01, 0x0}}, 0xFFE9}, // AWB_CCM_RL_4
-	{{{0x26, 0x03, 0x01, 0x0}}, 0xFFF1}, // AWB_CCM_RL_5
-	{{{0x28, 0x03, 0x01, 0x0}}, 0x003A}, // AWB_CCM_RL_6
-	{{{0x2A, 0x03, 0x01, 0x0}}, 0x005D}, // AWB_CCM_RL_7
-	{{{0x2C, 0x03, 0x01, 0x0}}, 0xFF69}, // AWB_CCM_RL_8
-	{{{0x2E, 0x03, 0x01, 0x0}}, 0x000C}, //AWB_CCM_RL_9
-	{{{0x30, 0x03, 0x01, 0x0}}, 0xFFE4}, //AWB_CCM_RL_10
-	{{{0x2E, 0x03, 0x01, 0x0}}, 0x000C}, //AWB_CCM_RL_9
-	{{{0x30, 0x03, 0x01, 0x0}}, 0xFFF4}, //AWB_CCM_RL_10
-	{{{0x2E, 0x03, 0x01, 0x0}}, 0x000A}, //AWB_CCM_RL_9
-	{{{0x30, 0x03, 0x01, 0x0}}, 0xFFF4}, //AWB_CCM_RL_10
-	{{{0x2E, 0x03, 0x01, 0x0}}, 0x0006}, //AWB_CCM_RL_9
-	{{{0x30, 0x03, 0x01, 0x0}}, 0xFFF4}, //AWB_CCM_RL_10
-	{{{0x2E, 0x03, 0x01, 0x0}}, 0xFFFC}, //AWB_CCM_RL_9
-	{{{0x30, 0x03, 0x01, 0x0}}, 0xFFF4}, //AWB_CCM_RL_10
-	{{{0x2E, 0x03, 0x01, 0x0}}, 0x0004}, //AWB_CCM_RL_9
-	{{{0x30, 0x03, 0x01, 0x0}}, 0xFFF4}, //AWB_CCM_RL_10
+// AWB_CCM_L_0..10 and AWB_CCM_RL_0..10, VAR(0x03,0x06..0x30); loaded through sysfs
+static u16 mt9d115_ccm[MT9D115_CCM_COEFS] = {
+	0x01D6, 0xFF89, 0xFFA1, 0xFF73, 0x019C, 0xFFF1, 0xFFB0, 0xFF2D, // AWB_CCM_L_0..7
+	0x0223, 0x0024, 0x0038,											// AWB_CCM_L_8..10
+	0xFFCD, 0x0023, 0x0010, 0x0026, 0xFFE9, 0xFFF1, 0x003A, 0x005D, // AWB_CCM_RL_0..7
+	0xFF69, 0x0004, 0xFFF4											// AWB_CCM_RL_8..10
 };
 
-typedef struct mt9d115_patch_t {
-	unsigned short u16RegAddr;
-	unsigned short u16Val;
-} MT9D115_PATCH_T;
-
-static MT9D115_PATCH_T mt9d115_patch_data[] = {
-	{MT9D115_MCU_ADDRESS, 0x415},
-	{MT9D115_MCU_DATA_0, 0xF601}, 
-	{MT9D115_MCU_DATA_1, 0x42C1}, 
-	{MT9D115_MCU_DATA_2, 0x326}, 
-	{MT9D115_MCU_DATA_3, 0x11F6}, 
-	{MT9D115_MCU_DATA_4, 0x143},
-	{MT9D115_MCU_DATA_5, 0xC104}, 
-	{MT9D115_MCU_DATA_6, 0x260A}, 
-	{MT9D115_MCU_DATA_7, 0xCC04},
-	
-	{MT9D115_MCU_ADDRESS, 0x425},
-	{MT9D115_MCU_DATA_0, 0x33BD}, 
-	{MT9D115_MCU_DATA_1, 0xA362}, 
-	{MT9D115_MCU_DATA_2, 0xBD04}, 
-	{MT9D115_MCU_DATA_3, 0x3339}, 
-	{MT9D115_MCU_DATA_4, 0xC6FF},
-	{MT9D115_MCU_DATA_5, 0xF701}, 
-	{MT9D115_MCU_DATA_6, 0x6439}, 
-	{MT9D115_MCU_DATA_7, 0xDE5D},
-
-	{MT9D115_MCU_ADDRESS, 0x435},
-	{MT9D115_MCU_DATA_0, 0x18CE}, 
-	{MT9D115_MCU_DATA_1, 0x325}, 
-	{MT9D115_MCU_DATA_2, 0xCC00}, 
-	{MT9D115_MCU_DATA_3, 0x27BD}, 
-	{MT9D115_MCU_DATA_4, 0xC2B8},
-	{MT9D115_MCU_DATA_5, 0xCC04}, 
-	{MT9D115_MCU_DATA_6, 0xBDFD}, 
-	{MT9D115_MCU_DATA_7, 0x33B},
-
-	{MT9D115_MCU_ADDRESS, 0x445},
-	{MT9D115_MCU_DATA_0, 0xCC06}, 
-	{MT9D115_MCU_DATA_1, 0x6BFD}, 
-	{MT9D115_MCU_DATA_2, 0x32F}, 
-	{MT9D115_MCU_DATA_3, 0xCC03},
-	{MT9D115_MCU_DATA_4, 0x25DD},
-	{MT9D115_MCU_DATA_5, 0x5DC6}, 
-	{MT9D115_MCU_DATA_6, 0x1ED7}, 
-	{MT9D115_MCU_DATA_7, 0x6CD7},
-
-	{MT9D115_MCU_ADDRESS, 0x455},
-	{MT9D115_MCU_DATA_0, 0x6D5F}, 
-	{MT9D115_MCU_DATA_1, 0xD76E}, 
-	{MT9D115_MCU_DATA_2, 0xD78D}, 
-	{MT9D115_MCU_DATA_3, 0x8620}, 
-	{MT9D115_MCU_DATA_4, 0x977A},
-	{MT9D115_MCU_DATA_5, 0xD77B}, 
-	{MT9D115_MCU_DATA_6, 0x979A}, 
-	{MT9D115_MCU_DATA_7, 0xC621},
-
-	{MT9D115_MCU_ADDRESS, 0x465},
-	{MT9D115_MCU_DATA_0, 0xD79B}, 
-	{MT9D115_MCU_DATA_1, 0xFE01}, 
-	{MT9D115_MCU_DATA_2, 0x6918}, 
-	{MT9D115_MCU_DATA_3, 0xCE03}, 
-	{MT9D115_MCU_DATA_4, 0x4DCC},
-	{MT9D115_MCU_DATA_5, 0x13}, 
-	{MT9D115_MCU_DATA_6, 0xBDC2}, 
-	{MT9D115_MCU_DATA_7, 0xB8CC},
-
-	{MT9D115_MCU_ADDRESS, 0x475},
-	{MT9D115_MCU_DATA_0, 0x5E9}, 
-	{MT9D115_MCU_DATA_1, 0xFD03}, 
-	{MT9D115_MCU_DATA_2, 0x4FCC}, 
-	{MT9D115_MCU_DATA_3, 0x34D}, 
-	{MT9D115_MCU_DATA_4, 0xFD01},
-	{MT9D115_MCU_DATA_5, 0x69FE}, 
-	{MT9D115_MCU_DATA_6, 0x2BD}, 
-	{MT9D115_MCU_DATA_7, 0x18CE},
-
-	{MT9D115_MCU_ADDRESS, 0x485},
-	{MT9D115_MCU_DATA_0, 0x361}, 
-	{MT9D115_MCU_DATA_1, 0xCC00}, 
-	{MT9D115_MCU_DATA_2, 0x11BD}, 
-	{MT9D115_MCU_DATA_3, 0xC2B8}, 
-	{MT9D115_MCU_DATA_4, 0xCC06},
-	{MT9D115_MCU_DATA_5, 0x28FD}, 
-	{MT9D115_MCU_DATA_6, 0x36F}, 
-	{MT9D115_MCU_DATA_7, 0xCC03},
-
-	{MT9D115_MCU_ADDRESS, 0x495},
-	{MT9D115_MCU_DATA_0, 0x61FD}, 
-	{MT9D115_MCU_DATA_1, 0x2BD}, 
-	{MT9D115_MCU_DATA_2, 0xDE00}, 
-	{MT9D115_MCU_DATA_3, 0x18CE}, 
-	{MT9D115_MCU_DATA_4, 0xC2},
-	{MT9D115_MCU_DATA_5, 0xCC00}, 
-	{MT9D115_MCU_DATA_6, 0x37BD}, 
-	{MT9D115_MCU_DATA_7, 0xC2B8},
-
-	{MT9D115_MCU_ADDRESS, 0x4A5},
-	{MT9D115_MCU_DATA_0, 0xCC06}, 
-	{MT9D115_MCU_DATA_1, 0x4FDD}, 
-	{MT9D115_MCU_DATA_2, 0xE6CC}, 
-	{MT9D115_MCU_DATA_3, 0xC2}, 
-	{MT9D115_MCU_DATA_4, 0xDD00},
-	{MT9D115_MCU_DATA_5, 0xC601}, 
-	{MT9D115_MCU_DATA_6, 0xF701}, 
-	{MT9D115_MCU_DATA_7, 0x64C6},
-
-	{MT9D115_MCU_ADDRESS, 0x4B5},
-	{MT9D115_MCU_DATA_0, 0x5F7}, 
-	{MT9D115_MCU_DATA_1, 0x165}, 
-	{MT9D115_MCU_DATA_2, 0x7F01}, 
-	{MT9D115_MCU_DATA_3, 0x6639}, 
-	{MT9D115_MCU_DATA_4, 0x373C},
-	{MT9D115_MCU_DATA_5, 0x3C3C}, 
-	{MT9D115_MCU_DATA_6, 0x3C3C}, 
-	{MT9D115_MCU_DATA_7, 0x30EC},
-
-	{MT9D115_MCU_ADDRESS, 0x4C5},
-	{MT9D115_MCU_DATA_0, 0x11ED}, 
-	{MT9D115_MCU_DATA_1, 0x2EC}, 
-	{MT9D115_MCU_DATA_2, 0xFED}, 
-	{MT9D115_MCU_DATA_3, 0x8F}, 
-	{MT9D115_MCU_DATA_4, 0x30ED},
-	{MT9D115_MCU_DATA_5, 0x4EC}, 
-	{MT9D115_MCU_DATA_6, 0xDEE}, 
-	{MT9D115_MCU_DATA_7, 0x4BD},
-
-	{MT9D115_MCU_ADDRESS, 0x4D5},
-	{MT9D115_MCU_DATA_0, 0xA406}, 
-	{MT9D115_MCU_DATA_1, 0x30EC}, 
-	{MT9D115_MCU_DATA_2, 0x2ED}, 
-	{MT9D115_MCU_DATA_3, 0x6FC}, 
-	{MT9D115_MCU_DATA_4, 0x10C0},
-	{MT9D115_MCU_DATA_5, 0x2705}, 
-	{MT9D115_MCU_DATA_6, 0xCCFF}, 
-	{MT9D115_MCU_DATA_7, 0xFFED},
-
-	{MT9D115_MCU_ADDRESS, 0x4E5},
-	{MT9D115_MCU_DATA_0, 0x6F6}, 
-	{MT9D115_MCU_DATA_1, 0x256}, 
-	{MT9D115_MCU_DATA_2, 0x8616}, 
-	{MT9D115_MCU_DATA_3, 0x3DC3}, 
-	{MT9D115_MCU_DATA_4, 0x261},
-	{MT9D115_MCU_DATA_5, 0x8FE6}, 
-	{MT9D115_MCU_DATA_6, 0x9C4}, 
-	{MT9D115_MCU_DATA_7, 0x7C1},
-
-	{MT9D115_MCU_ADDRESS, 0x4F5},
-	{MT9D115_MCU_DATA_0, 0x226}, 
-	{MT9D115_MCU_DATA_1, 0x1DFC}, 
-	{MT9D115_MCU_DATA_2, 0x10C2}, 
-	{MT9D115_MCU_DATA_3, 0x30ED}, 
-	{MT9D115_MCU_DATA_4, 0x2FC},
-	{MT9D115_MCU_DATA_5, 0x10C0}, 
-	{MT9D115_MCU_DATA_6, 0xED00}, 
-	{MT9D115_MCU_DATA_7, 0xC602},
-
-	{MT9D115_MCU_ADDRESS, 0x505},
-	{MT9D115_MCU_DATA_0, 0xBDC2}, 
-	{MT9D115_MCU_DATA_1, 0x5330}, 
-	{MT9D115_MCU_DATA_2, 0xEC00}, 
-	{MT9D115_MCU_DATA_3, 0xFD10}, 
-	{MT9D115_MCU_DATA_4, 0xC0EC},
-	{MT9D115_MCU_DATA_5, 0x2FD}, 
-	{MT9D115_MCU_DATA_6, 0x10C2}, 
-	{MT9D115_MCU_DATA_7, 0x201B},
-
-	{MT9D115_MCU_ADDRESS, 0x515},
-	{MT9D115_MCU_DATA_0, 0xFC10}, 
-	{MT9D115_MCU_DATA_1, 0xC230}, 
-	{MT9D115_MCU_DATA_2, 0xED02}, 
-	{MT9D115_MCU_DATA_3, 0xFC10}, 
-	{MT9D115_MCU_DATA_4, 0xC0ED},
-	{MT9D115_MCU_DATA_5, 0xC6}, 
-	{MT9D115_MCU_DATA_6, 0x1BD}, 
-	{MT9D115_MCU_DATA_7, 0xC253},
-
-	{MT9D115_MCU_ADDRESS, 0x525},
-	{MT9D115_MCU_DATA_0, 0x30EC}, 
-	{MT9D115_MCU_DATA_1, 0xFD}, 
-	{MT9D115_MCU_DATA_2, 0x10C0}, 
-	{MT9D115_MCU_DATA_3, 0xEC02}, 
-	{MT9D115_MCU_DATA_4, 0xFD10},
-	{MT9D115_MCU_DATA_5, 0xC2C6}, 
-	{MT9D115_MCU_DATA_6, 0x80D7}, 
-	{MT9D115_MCU_DATA_7, 0x85C6},
-
-	{MT9D115_MCU_ADDRESS, 0x535},
-	{MT9D115_MCU_DATA_0, 0x40F7}, 
-	{MT9D115_MCU_DATA_1, 0x10C4}, 
-	{MT9D115_MCU_DATA_2, 0xF602}, 
-	{MT9D115_MCU_DATA_3, 0x5686}, 
-	{MT9D115_MCU_DATA_4, 0x163D},
-	{MT9D115_MCU_DATA_5, 0xC302}, 
-	{MT9D115_MCU_DATA_6, 0x618F}, 
-	{MT9D115_MCU_DATA_7, 0xEC14},
-
-	{MT9D115_MCU_ADDRESS, 0x545},
-	{MT9D115_MCU_DATA_0, 0xFD10}, 
-	{MT9D115_MCU_DATA_1, 0xC501}, 
-	{MT9D115_MCU_DATA_2, 0x101}, 
-	{MT9D115_MCU_DATA_3, 0x101}, 
-	{MT9D115_MCU_DATA_4, 0xFC10},
-	{MT9D115_MCU_DATA_5, 0xC2DD}, 
-	{MT9D115_MCU_DATA_6, 0x7FFC}, 
-	{MT9D115_MCU_DATA_7, 0x10C7},
-
-	{MT9D115_MCU_ADDRESS, 0x555},
-	{MT9D115_MCU_DATA_0, 0xDD76}, 
-	{MT9D115_MCU_DATA_1, 0xF602}, 
-	{MT9D115_MCU_DATA_2, 0x5686}, 
-	{MT9D115_MCU_DATA_3, 0x163D}, 
-	{MT9D115_MCU_DATA_4, 0xC302},
-	{MT9D115_MCU_DATA_5, 0x618F}, 
-	{MT9D115_MCU_DATA_6, 0xEC14}, 
-	{MT9D115_MCU_DATA_7, 0x939F},
-
-	{MT9D115_MCU_ADDRESS, 0x565},
-	{MT9D115_MCU_DATA_0, 0x30ED}, 
-	{MT9D115_MCU_DATA_1, 0x8DC}, 
-	{MT9D115_MCU_DATA_2, 0x7693}, 
-	{MT9D115_MCU_DATA_3, 0x9D25}, 
-	{MT9D115_MCU_DATA_4, 0x8F6},
-	{MT9D115_MCU_DATA_5, 0x2BC}, 
-	{MT9D115_MCU_DATA_6, 0x4F93}, 
-	{MT9D115_MCU_DATA_7, 0x7F23},
-
-	{MT9D115_MCU_ADDRESS, 0x575},
-	{MT9D115_MCU_DATA_0, 0x3DF6}, 
-	{MT9D115_MCU_DATA_1, 0x2BC}, 
-	{MT9D115_MCU_DATA_2, 0x4F93}, 
-	{MT9D115_MCU_DATA_3, 0x7F23}, 
-	{MT9D115_MCU_DATA_4, 0x6F6},
-	{MT9D115_MCU_DATA_5, 0x2BC}, 
-	{MT9D115_MCU_DATA_6, 0x4FDD}, 
-	{MT9D115_MCU_DATA_7, 0x7FDC},
-
-	{MT9D115_MCU_ADDRESS, 0x585},
-	{MT9D115_MCU_DATA_0, 0x9DDD}, 
-	{MT9D115_MCU_DATA_1, 0x76F6}, 
-	{MT9D115_MCU_DATA_2, 0x2BC}, 
-	{MT9D115_MCU_DATA_3, 0x4F93}, 
-	{MT9D115_MCU_DATA_4, 0x7F26},
-	{MT9D115_MCU_DATA_5, 0xFE6}, 
-	{MT9D115_MCU_DATA_6, 0xAC1}, 
-	{MT9D115_MCU_DATA_7, 0x226},
-
-	{MT9D115_MCU_ADDRESS, 0x595},
-	{MT9D115_MCU_DATA_0, 0x9D6}, 
-	{MT9D115_MCU_DATA_1, 0x85C1}, 
-	{MT9D115_MCU_DATA_2, 0x8026}, 
-	{MT9D115_MCU_DATA_3, 0x314}, 
-	{MT9D115_MCU_DATA_4, 0x7401},
-	{MT9D115_MCU_DATA_5, 0xF602}, 
-	{MT9D115_MCU_DATA_6, 0xBC4F}, 
-	{MT9D115_MCU_DATA_7, 0x937F},
-
-	{MT9D115_MCU_ADDRESS, 0x5A5},
-	{MT9D115_MCU_DATA_0, 0x2416}, 
-	{MT9D115_MCU_DATA_1, 0xDE7F}, 
-	{MT9D115_MCU_DATA_2, 0x9DF}, 
-	{MT9D115_MCU_DATA_3, 0x7F30}, 
-	{MT9D115_MCU_DATA_4, 0xEC08},
-	{MT9D115_MCU_DATA_5, 0xDD76}, 
-	{MT9D115_MCU_DATA_6, 0x200A}, 
-	{MT9D115_MCU_DATA_7, 0xDC76},
-
-	{MT9D115_MCU_ADDRESS, 0x5B5},
-	{MT9D115_MCU_DATA_0, 0xA308}, 
-	{MT9D115_MCU_DATA_1, 0x2304}, 
-	{MT9D115_MCU_DATA_2, 0xEC08}, 
-	{MT9D115_MCU_DATA_3, 0xDD76}, 
-	{MT9D115_MCU_DATA_4, 0x1274},
-	{MT9D115_MCU_DATA_5, 0x122}, 
-	{MT9D115_MCU_DATA_6, 0xDE5D}, 
-	{MT9D115_MCU_DATA_7, 0xEE14},
-
-	{MT9D115_MCU_ADDRESS, 0x5C5},
-	{MT9D115_MCU_DATA_0, 0xAD00}, 
-	{MT9D115_MCU_DATA_1, 0x30ED}, 
-	{MT9D115_MCU_DATA_2, 0x11EC}, 
-	{MT9D115_MCU_DATA_3, 0x6ED}, 
-	{MT9D115_MCU_DATA_4, 0x2CC},
-	{MT9D115_MCU_DATA_5, 0x80}, 
-	{MT9D115_MCU_DATA_6, 0xED00}, 
-	{MT9D115_MCU_DATA_7, 0x8F30},
-
-	{MT9D115_MCU_ADDRESS, 0x5D5},
-	{MT9D115_MCU_DATA_0, 0xED04}, 
-	{MT9D115_MCU_DATA_1, 0xEC11}, 
-	{MT9D115_MCU_DATA_2, 0xEE04}, 
-	{MT9D115_MCU_DATA_3, 0xBDA4}, 
-	{MT9D115_MCU_DATA_4, 0x630},
-	{MT9D115_MCU_DATA_5, 0xE603}, 
-	{MT9D115_MCU_DATA_6, 0xD785}, 
-	{MT9D115_MCU_DATA_7, 0x30C6},
-
-	{MT9D115_MCU_ADDRESS, 0x5E5},
-	{MT9D115_MCU_DATA_0, 0xB3A}, 
-	{MT9D115_MCU_DATA_1, 0x3539}, 
-	{MT9D115_MCU_DATA_2, 0x3C3C}, 
-	{MT9D115_MCU_DATA_3, 0x3C34}, 
-	{MT9D115_MCU_DATA_4, 0xCC32},
-	{MT9D115_MCU_DATA_5, 0x3EBD}, 
-	{MT9D115_MCU_DATA_6, 0xA558}, 
-	{MT9D115_MCU_DATA_7, 0x30ED},
-
-	{MT9D115_MCU_ADDRESS, 0x5F5},
-	{MT9D115_MCU_DATA_0, 0x4BD}, 
-	{MT9D115_MCU_DATA_1, 0xB2D7}, 
-	{MT9D115_MCU_DATA_2, 0x30E7}, 
-	{MT9D115_MCU_DATA_3, 0x6CC}, 
-	{MT9D115_MCU_DATA_4, 0x323E},
-	{MT9D115_MCU_DATA_5, 0xED00}, 
-	{MT9D115_MCU_DATA_6, 0xEC04}, 
-	{MT9D115_MCU_DATA_7, 0xBDA5},
-
-	{MT9D115_MCU_ADDRESS, 0x605},
-	{MT9D115_MCU_DATA_0, 0x44CC}, 
-	{MT9D115_MCU_DATA_1, 0x3244}, 
-	{MT9D115_MCU_DATA_2, 0xBDA5}, 
-	{MT9D115_MCU_DATA_3, 0x585F}, 
-	{MT9D115_MCU_DATA_4, 0x30ED},
-	{MT9D115_MCU_DATA_5, 0x2CC}, 
-	{MT9D115_MCU_DATA_6, 0x3244}, 
-	{MT9D115_MCU_DATA_7, 0xED00},
-
-	{MT9D115_MCU_ADDRESS, 0x615},
-	{MT9D115_MCU_DATA_0, 0xF601}, 
-	{MT9D115_MCU_DATA_1, 0xD54F}, 
-	{MT9D115_MCU_DATA_2, 0xEA03}, 
-	{MT9D115_MCU_DATA_3, 0xAA02}, 
-	{MT9D115_MCU_DATA_4, 0xBDA5},
-	{MT9D115_MCU_DATA_5, 0x4430}, 
-	{MT9D115_MCU_DATA_6, 0xE606}, 
-	{MT9D115_MCU_DATA_7, 0x3838},
-
-	{MT9D115_MCU_ADDRESS, 0x625},
-	{MT9D115_MCU_DATA_0, 0x3831}, 
-	{MT9D115_MCU_DATA_1, 0x39BD}, 
-	{MT9D115_MCU_DATA_2, 0xD661}, 
-	{MT9D115_MCU_DATA_3, 0xF602}, 
-	{MT9D115_MCU_DATA_4, 0xF4C1},
-	{MT9D115_MCU_DATA_5, 0x126}, 
-	{MT9D115_MCU_DATA_6, 0xBFE}, 
-	{MT9D115_MCU_DATA_7, 0x2BD},
-
-	{MT9D115_MCU_ADDRESS, 0x635},
-	{MT9D115_MCU_DATA_0, 0xEE10}, 
-	{MT9D115_MCU_DATA_1, 0xFC02}, 
-	{MT9D115_MCU_DATA_2, 0xF5AD}, 
-	{MT9D115_MCU_DATA_3, 0x39}, 
-	{MT9D115_MCU_DATA_4, 0xF602},
-	{MT9D115_MCU_DATA_5, 0xF4C1}, 
-	{MT9D115_MCU_DATA_6, 0x226}, 
-	{MT9D115_MCU_DATA_7, 0xAFE},
-
-	{MT9D115_MCU_ADDRESS, 0x645},
-	{MT9D115_MCU_DATA_0, 0x2BD}, 
-	{MT9D115_MCU_DATA_1, 0xEE10}, 
-	{MT9D115_MCU_DATA_2, 0xFC02}, 
-	{MT9D115_MCU_DATA_3, 0xF7AD}, 
-	{MT9D115_MCU_DATA_4, 0x39},
-	{MT9D115_MCU_DATA_5, 0x3CBD}, 
-	{MT9D115_MCU_DATA_6, 0xB059}, 
-	{MT9D115_MCU_DATA_7, 0xCC00},
-
-	{MT9D115_MCU_ADDRESS, 0x655},
-	{MT9D115_MCU_DATA_0, 0x28BD}, 
-	{MT9D115_MCU_DATA_1, 0xA558}, 
-	{MT9D115_MCU_DATA_2, 0x8300}, 
-	{MT9D115_MCU_DATA_3, 0x27}, 
-	{MT9D115_MCU_DATA_4, 0xBCC},
-	{MT9D115_MCU_DATA_5, 0x26}, 
-	{MT9D115_MCU_DATA_6, 0x30ED}, 
-	{MT9D115_MCU_DATA_7, 0xC6},
-
-	{MT9D115_MCU_ADDRESS, 0x665},
-	{MT9D115_MCU_DATA_0, 0x3BD}, 
-	{MT9D115_MCU_DATA_1, 0xA544}, 
-	{MT9D115_MCU_DATA_2, 0x3839}, 
-	{MT9D115_MCU_DATA_3, 0xBDD9}, 
-	{MT9D115_MCU_DATA_4, 0x42D6},
-	{MT9D115_MCU_DATA_5, 0x9ACB}, 
-	{MT9D115_MCU_DATA_6, 0x1D7}, 
-	{MT9D115_MCU_DATA_7, 0x9B39}
+// tables loaded at runtime, MT9D115_TUNING_*; they are reapplied on every init
+static int mt9d115_tuning_loaded;
+static DEFINE_MUTEX(mt9d115_tuning_lock);
+
+// tuning variables of the last cold init, sorted by MCU address
+typedef struct mt9d115_snapshot_t {
+	u16 au16Var[MT9D115_SNAPSHOT_VARS];
+	u16 au16Val[MT9D115_SNAPSHOT_VARS];
+	int count;
+	bool bRecording;
+	bool bValid;
+	u16 u16PatchId;		// MON_PATCH_ID_0 after the cold init
+	u16 u16PllControl;	// PLL_CONTROL after the cold init
+} MT9D115_SNAPSHOT_T;
+
+// output formats, selected through VIDIOC_S_FMT
+typedef struct mt9d115_format_t {
+	u32 u32PixelFormat;		// format of the capture buffers
+	u32 u32BusFormat;		// format the CSI receives, from g_fmt_cap
+	const char *description;
+	PLL_SETTING_T pll;
+	int mipiDataType;		// MIPI_DT_*
+	int ifMode;				// V4L2_IF_TYPE_BT656_MODE_*
+	int fps;				// preview frame rate
+	int captureFps;			// capture frame rate
+	const MT9D115_SCRIPT_T *pScript;	// run after mt9d115_init_script, may be NULL
+	int scriptLen;
+} MT9D115_FORMAT_T;
+
+static const MT9D115_FORMAT_T mt9d115_formats[] = {
+	{
+		.u32PixelFormat = V4L2_PIX_FMT_YUYV,
+		.u32BusFormat = V4L2_PIX_FMT_YUYV,
+		.description = "YUV 4:2:2",
+		.pll = MT9D115_PLL_MIPI_YUV422,
+		.mipiDataType = MIPI_DT_YUV422,
+		.ifMode = V4L2_IF_TYPE_BT656_MODE_NOBT_8BIT,
+		.fps = DEFAULT_FPS,
+		.captureFps = 15,
+	},
+	{
+		// 10 bit Bayer samples in 16 bit words, frame rates 42 (800x600) and 22 (1600x1200)
+		.u32PixelFormat = V4L2_PIX_FMT_SGRBG10,
+		.u32BusFormat = IPU_PIX_FMT_GENERIC_16,
+		.description = "Bayer RAW10",
+		.pll = MT9D115_PLL_MIPI_BAYER10,
+		.mipiDataType = MIPI_DT_RAW10,
+		.ifMode = V4L2_IF_TYPE_BT656_MODE_NOBT_10BIT,
+		.fps = 42,
+		.captureFps = 22,
+		.pScript = mt9d115_bayer10_script,
+		.scriptLen = ARRAY_SIZE(mt9d115_bayer10_script),
+	},
 };
 
 
@@ -566,15 +175,38 @@ static MT9D115_PATCH_T mt9d115_patch_data[] = {
 static struct sensor_data mt9d115_data;
 static struct fsl_mxc_camera_platform_data *camera_plat;
 
+static MT9D115_SNAPSHOT_T mt9d115_snapshot;
+
+// output format of the next init, changed under mt9d115_tuning_lock
+static const MT9D115_FORMAT_T *mt9d115_format = &mt9d115_formats[0];
+
+// sensor configuration queued by dev_init, see mt9d115_init_work_func()
+static struct work_struct mt9d115_init_work;
+static struct completion mt9d115_init_done;
+static DEFINE_MUTEX(mt9d115_init_lock);
+static int mt9d115_init_pending;
+static int mt9d115_init_ret;
+
+// bus time per call site and phase, see sensor_i2c_prof.h; the accessors
+// taking _RET_IP_ are noinline so that the site is their caller
+static struct sensor_i2c_prof mt9d115_prof;
+
+// messages of mt9d115_run_script() and mt9d115_write_vars(), too large
+// for the stack
+static struct sensor_i2c_batch mt9d115_batch;
+static DEFINE_MUTEX(mt9d115_batch_lock);
+
 /**
  * mt9d115_reg_read - read resgiter value
  * @client: pointer to i2c client
  * @command: register address
  */
-static inline int mt9d115_read_reg(u16 u16Reg, u16 *u16Val)
+static noinline int mt9d115_read_reg(u16 u16Reg, u16 *u16Val)
 {
 	u8  u8RegBuf[2] = {0, 0};
 	u16 u16RdVal = 0;
+	ktime_t start;
+	int ret;
 #ifdef I2C_FUNCTION_DEBUG
 	LOG_FUNCTION_NAME;
 #endif
@@ -582,12 +214,17 @@ static inline int mt9d115_read_reg(u16 u16Reg, u16 *u16Val)
 	u8RegBuf[0] = u16Reg >> 8;
 	u8RegBuf[1] = u16Reg & 0xff;
 
-	if (I2C_BYTE_ACCESS != i2c_master_send(mt9d115_data.i2c_client, u8RegBuf, I2C_BYTE_ACCESS)) {
+	start = ktime_get();
+	ret = i2c_master_send(mt9d115_data.i2c_client, u8RegBuf, I2C_BYTE_ACCESS);
+	if (I2C_BYTE_ACCESS != ret) {
+		sensor_i2c_prof_record(&mt9d115_prof, _RET_IP_, start, true);
 		pr_err("%s:write reg error at %x\n", __func__, u16Reg);
 		return -1;
 	}
 
-	if (I2C_BYTE_ACCESS != i2c_master_recv(mt9d115_data.i2c_client, (char *)&u16RdVal, I2C_BYTE_ACCESS)) {
+	ret = i2c_master_recv(mt9d115_data.i2c_client, (char *)&u16RdVal, I2C_BYTE_ACCESS);
+	sensor_i2c_prof_record(&mt9d115_prof, _RET_IP_, start, I2C_BYTE_ACCESS != ret);
+	if (I2C_BYTE_ACCESS != ret) {
 		pr_err("%s:read reg error at %x : %x\n", __func__, u16Reg, u16RdVal);
 		return -1;
 	}
@@ -607,9 +244,11 @@ static inline int mt9d115_read_reg(u16 u16Reg, u16 *u16Val)
  * @command: register address
  * @data: value to be written 
  */
-static inline int mt9d115_write_reg(u16 u16Reg, u16 u16Val)
+static noinline int mt9d115_write_reg(u16 u16Reg, u16 u16Val)
 {
 	u8 u8Buf[4] = {0, 0, 0, 0};
+	ktime_t start;
+	int ret;
 
 #ifdef I2C_FUNCTION_DEBUG
 	LOG_FUNCTION_NAME;
@@ -620,7 +259,10 @@ static inline int mt9d115_write_reg(u16 u16Reg, u16 u16Val)
 	u8Buf[2] = u16Val >> 8;
 	u8Buf[3] = u16Val & 0xff;
 
-	if (i2c_master_send(mt9d115_data.i2c_client, u8Buf, 4) < 0) {
+	start = ktime_get();
+	ret = i2c_master_send(mt9d115_data.i2c_client, u8Buf, 4);
+	sensor_i2c_prof_record(&mt9d115_prof, _RET_IP_, start, ret < 0);
+	if (ret < 0) {
 		pr_err("%s:write reg error at %x : %x\n", __func__, u16Reg, u16Val);
 		return -1;
 	}
@@ -632,6 +274,234 @@ static inline int mt9d115_write_reg(u16 u16Reg, u16 u16Val)
 }
 
 
+/**
+ * mt9d115_snapshot_tuning - check if a variable belongs in the snapshot
+ * @u16Var: MCU_ADDRESS of the variable
+ *
+ * Only logical variables holding settings are kept. Physical RAM accesses
+ * such as the patch upload are not, neither are the monitor variables
+ * (patch start and execute) and the sequencer command and state: writing
+ * them acts on the firmware, so a warm init must not write them back.
+ */
+static bool mt9d115_snapshot_tuning(u16 u16Var)
+{
+	if (!MT9D115_VAR_IS_LOGICAL(u16Var))
+		return false;
+	if (MT9D115_VAR_DRIVER(u16Var) == MT9D115_DRV_MON)
+		return false;
+
+	switch (MT9D115_VAR_ID(u16Var)) {
+	case MT9D115_VAR_ID(MT9D115_VAR_SEQ_CMD):
+	case MT9D115_VAR_ID(MT9D115_VAR_SEQ_STATE):
+	case MT9D115_VAR_ID(MT9D115_VAR_SEQ_CAP_MODE):
+	case MT9D115_VAR_ID(MT9D115_VAR_SEQ_CAP_NUMFRAMES):
+		return false;
+	}
+	return true;
+}
+
+
+/**
+ * mt9d115_snapshot_record - remember the value written to an MCU variable
+ * @u16Var: MCU_ADDRESS of the variable
+ * @u16Val: value
+ *
+ * Only tuning variables are kept while recording is on, see
+ * mt9d115_snapshot_tuning().
+ */
+static void mt9d115_snapshot_record(u16 u16Var, u16 u16Val)
+{
+	MT9D115_SNAPSHOT_T *snap = &mt9d115_snapshot;
+	int i, j;
+
+	if (!snap->bRecording || !mt9d115_snapshot_tuning(u16Var))
+		return;
+
+	for (i = 0; i < snap->count && snap->au16Var[i] < u16Var; i++)
+		;
+	if (i < snap->count && snap->au16Var[i] == u16Var) {
+		snap->au16Val[i] = u16Val;
+		return;
+	}
+	if (snap->count == MT9D115_SNAPSHOT_VARS) {
+		pr_warning("%s:snapshot full, dropping %x\n", __func__, u16Var);
+		snap->bRecording = false;
+		snap->count = -1;
+		return;
+	}
+	for (j = snap->count; j > i; j--) {
+		snap->au16Var[j] = snap->au16Var[j - 1];
+		snap->au16Val[j] = snap->au16Val[j - 1];
+	}
+	snap->au16Var[i] = u16Var;
+	snap->au16Val[i] = u16Val;
+	snap->count++;
+}
+
+
+/**
+ * mt9d115_script_poll - execute a poll command of a register script
+ * @cmd: MT9D115_OP_POLL, MT9D115_OP_POLL_VAR or MT9D115_OP_POLL_VAR_NOT
+ *
+ * Like the POLL_FIELD of the Aptina scripts a timeout is not an error,
+ * initialization simply goes on.
+ */
+static int mt9d115_script_poll(const MT9D115_SCRIPT_T *cmd)
+{
+	unsigned long timeout = jiffies + msecs_to_jiffies(MT9D115_POLL_TIMEOUT_MS);
+	u16 u16Reg = cmd->u16Reg;
+	u16 readVal = 0;
+	bool match;
+
+	if (cmd->u8Op != MT9D115_OP_POLL) {
+		if (mt9d115_write_reg(MT9D115_MCU_ADDRESS, cmd->u16Reg) < 0)
+			return -1;
+		u16Reg = MT9D115_MCU_DATA_0;
+	}
+
+	for (;;) {
+		if (mt9d115_read_reg(u16Reg, &readVal) < 0)
+			return -1;
+		match = (readVal & cmd->u16Mask) == cmd->u16Val;
+		if (cmd->u8Op == MT9D115_OP_POLL_VAR_NOT)
+			match = !match;
+		if (match)
+			return 0;
+		if (time_after(jiffies, timeout)) {
+			pr_warning("%s:timeout at %x : %x\n", __func__, cmd->u16Reg, readVal);
+			return 0;
+		}
+		usleep_range(MT9D115_POLL_US, 2 * MT9D115_POLL_US);
+	}
+}
+
+
+/**
+ * mt9d115_run_script - execute a register script
+ * @script: commands
+ * @len: number of commands
+ *
+ * Consecutive register and MCU variable writes are coalesced into
+ * multi-message i2c_transfer() batches. Reads, polls and delays flush
+ * the batch first, so the order of the bus accesses is kept.
+ */
+static noinline int mt9d115_run_script(const MT9D115_SCRIPT_T *script, int len)
+{
+	struct sensor_i2c_batch *batch = &mt9d115_batch;
+	const MT9D115_SCRIPT_T *cmd;
+	u16 readVal = 0;
+	int count, retVal = -1;
+
+	mutex_lock(&mt9d115_batch_lock);
+	sensor_i2c_batch_init(batch, mt9d115_data.i2c_client, &mt9d115_prof, _RET_IP_);
+
+	for (count = 0; count < len; count++) {
+		cmd = &script[count];
+		switch (cmd->u8Op) {
+		case MT9D115_OP_WRITE:
+			if (sensor_i2c_batch_write(batch, cmd->u16Reg, cmd->u16Val, 2) < 0)
+				goto out;
+			break;
+		case MT9D115_OP_VAR:
+			if (sensor_i2c_batch_write(batch, MT9D115_MCU_ADDRESS, cmd->u16Reg, 2) < 0 ||
+			    sensor_i2c_batch_write(batch, MT9D115_MCU_DATA_0, cmd->u16Val, 2) < 0)
+				goto out;
+			mt9d115_snapshot_record(cmd->u16Reg, cmd->u16Val);
+			break;
+		case MT9D115_OP_RMW:
+			if (sensor_i2c_batch_flush(batch) < 0)
+				goto out;
+			if (mt9d115_read_reg(cmd->u16Reg, &readVal) < 0)
+				goto out;
+			readVal = (readVal & ~cmd->u16Mask) | cmd->u16Val;
+			if (mt9d115_write_reg(cmd->u16Reg, readVal) < 0)
+				goto out;
+			break;
+		case MT9D115_OP_POLL:
+		case MT9D115_OP_POLL_VAR:
+		case MT9D115_OP_POLL_VAR_NOT:
+			if (sensor_i2c_batch_flush(batch) < 0)
+				goto out;
+			if (mt9d115_script_poll(cmd) < 0)
+				goto out;
+			break;
+		case MT9D115_OP_DELAY:
+			if (sensor_i2c_batch_flush(batch) < 0)
+				goto out;
+			if (cmd->u16Val < 20)
+				usleep_range(cmd->u16Val * 1000, cmd->u16Val * 1000 + 1000);
+			else
+				msleep(cmd->u16Val);
+			break;
+		}
+	}
+	if (sensor_i2c_batch_flush(batch) < 0)
+		goto out;
+
+	mt9d115_dbg("%s: %d commands, %d batched transfers\n", __func__, len, batch->transfers);
+	retVal = 0;
+out:
+	mutex_unlock(&mt9d115_batch_lock);
+	return retVal;
+}
+
+
+/**
+ * mt9d115_write_vars - upload consecutive MCU variables
+ * @u16Var: MCU_ADDRESS of the first variable
+ * @pu16Val: values
+ * @count: number of variables
+ *
+ * MCU_ADDRESS is set once per MT9D115_MCU_DATA_PORTS variables and the
+ * values are streamed into the auto-incrementing MCU_DATA_0..7 ports, so
+ * eight variables cost two messages instead of sixteen. All messages of
+ * the upload go out in as few i2c_transfer() calls as possible.
+ */
+static noinline int mt9d115_write_vars(u16 u16Var, const u16 *pu16Val, int count)
+{
+	struct sensor_i2c_batch *batch = &mt9d115_batch;
+	// 8-bit variables are one byte apart, 16-bit variables and RAM words two
+	int step = (u16Var & 0x8000) ? 1 : 2;
+	int len, i, retVal = -1;
+
+	for (i = 0; i < count; i++)
+		mt9d115_snapshot_record(u16Var + step * i, pu16Val[i]);
+
+	mutex_lock(&mt9d115_batch_lock);
+	sensor_i2c_batch_init(batch, mt9d115_data.i2c_client, &mt9d115_prof, _RET_IP_);
+	while (count > 0) {
+		len = min(count, MT9D115_MCU_DATA_PORTS);
+		if (sensor_i2c_batch_write(batch, MT9D115_MCU_ADDRESS, u16Var, 2) < 0 ||
+		    sensor_i2c_batch_write_words(batch, MT9D115_MCU_DATA_0, pu16Val, len, false) < 0)
+			goto out;
+		u16Var += step * len;
+		pu16Val += len;
+		count -= len;
+	}
+	if (sensor_i2c_batch_flush(batch) < 0)
+		goto out;
+	retVal = 0;
+out:
+	mutex_unlock(&mt9d115_batch_lock);
+	if (retVal < 0)
+		pr_err("%s:block write error at %x\n", __func__, u16Var);
+	return retVal;
+}
+
+
+/**
+ * mt9d115_read_var - read an MCU variable
+ * @u16Var: MCU_ADDRESS of the variable
+ * @pu16Val: value read
+ */
+static int mt9d115_read_var(u16 u16Var, u16 *pu16Val)
+{
+	if (mt9d115_write_reg(MT9D115_MCU_ADDRESS, u16Var) < 0)
+		return -1;
+	return mt9d115_read_reg(MT9D115_MCU_DATA_0, pu16Val);
+}
+
+
 /**
  * mt9d115_detect - Detect if an mt9d115 is present, and if so which revision
  * @client: pointer to the i2c client driver structure
@@ -661,26 +531,14 @@ static int mt9d115_detect(struct i2c_client *client)
 
 static int mt9d115_reset(void) 
 {
-	int retVal = 0;  
-	u16 readVal = 0;
 	LOG_FUNCTION_NAME;
-	
-	retVal = mt9d115_read_reg(MT9D115_RST_CTRL_REG, &readVal);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
-	retVal = mt9d115_write_reg(MT9D115_RST_CTRL_REG, readVal | 0x0001);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
-	mt9d115_dbg("Reset Reg 0x%x : 0x%x\n",MT9D115_RST_CTRL_REG, readVal);
-	
-	mdelay(10);
-	
-	retVal = mt9d115_read_reg(MT9D115_RST_CTRL_REG, &readVal);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
-	retVal = mt9d115_write_reg(MT9D115_RST_CTRL_REG, readVal & 0xFFFE);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
-	mt9d115_dbg("Reset Reg 0x%x : 0x%x\n",MT9D115_RST_CTRL_REG, readVal);
-	
+
+	if (mt9d115_run_script(mt9d115_reset_script, ARRAY_SIZE(mt9d115_reset_script)) < 0) {
+		MT9D115_ERR; return -1;
+	}
+
 	LOG_FUNCTION_NAME_EXIT;
-	return retVal;
+	return 0;
 }
 
 
@@ -718,41 +576,14 @@ static int mt9d115_pllSetting(PLL_SETTING_T type)
 	// program the on-chip PLL
 	switch (type) {
 		case MT9D115_PLL_MIPI_YUV422:
-			//PLL Control: BYPASS PLL = 8697
-			retVal = mt9d115_write_reg(MT9D115_PLL_CONTROL, 0x21F9);
-			if (retVal < 0) { MT9D115_ERR; return -1; }
-			
-			// mipi timing for YUV422 (clk_txfifo_wr = 85/42.5Mhz; clk_txfifo_rd = 63.75Mhz)
-			// PLL Dividers = 277
-			retVal = mt9d115_write_reg(MT9D115_PLL_DIVIDERS, 0x0115);
-			if (retVal < 0) { MT9D115_ERR; return -1; }
-			// wcd = 8
-			retVal = mt9d115_write_reg(MT9D115_PLL_P_DIVIDERS, 0x00F5);
-			if (retVal < 0) { MT9D115_ERR; return -1; }
-			
-			// PLL Control: TEST_BYPASS on = 9541
-			retVal = mt9d115_write_reg(MT9D115_PLL_CONTROL, 0x2545);
-			if (retVal < 0) { MT9D115_ERR; return -1; }
-			
-			// PLL Control: PLL_ENABLE on = 9543
-			retVal = mt9d115_write_reg(MT9D115_PLL_CONTROL, 0x2547);
-			if (retVal < 0) { MT9D115_ERR; return -1; }
-			
-			// PLL Control: SEL_LOCK_DET on
-			retVal = mt9d115_write_reg(MT9D115_PLL_CONTROL, 0x2447);
-			if (retVal < 0) { MT9D115_ERR; return -1; }
-			
-			mdelay(10);
-			
-			// PLL Control: PLL_BYPASS off
-			retVal = mt9d115_write_reg(MT9D115_PLL_CONTROL, 0x2047);
-			if (retVal < 0) { MT9D115_ERR; return -1; }
-			
-			// PLL Control: TEST_BYPASS off
-			retVal = mt9d115_write_reg(MT9D115_PLL_CONTROL, 0x2046);
+			retVal = mt9d115_run_script(mt9d115_pll_yuv422_script,
+						    ARRAY_SIZE(mt9d115_pll_yuv422_script));
 			if (retVal < 0) { MT9D115_ERR; return -1; }
 			break;
 		case MT9D115_PLL_MIPI_BAYER10:
+			retVal = mt9d115_run_script(mt9d115_pll_bayer10_script,
+						    ARRAY_SIZE(mt9d115_pll_bayer10_script));
+			if (retVal < 0) { MT9D115_ERR; return -1; }
 			break;
 	}	
 	LOG_FUNCTION_NAME_EXIT;
@@ -760,551 +591,433 @@ static int mt9d115_pllSetting(PLL_SETTING_T type)
 }
 
 
-static int mt9d115_Gamma(void) 
+/**
+ * mt9d115_seqMode - move the sequencer between preview and capture
+ * @u32Mode: MT9D115_MODE_PREVIEW or MT9D115_MODE_CAPTURE
+ *
+ * Capture always uses the video capture mode, the sequencer stays in
+ * context B until it is moved back to preview here. The still mode would
+ * return to preview after SEQ_CAP_NUMFRAMES on its own, behind the back
+ * of the CSI that is still set up for the capture size. Returns once the
+ * sequencer has left its previous state, so the next frame is from the
+ * new context.
+ */
+static int mt9d115_seqMode(u32 u32Mode)
 {
-	int retVal = 0;
-	int count = 0;
+	int retVal;
 
-	// Set to automatic mode VAR(0x0B,0x0037)
-	retVal = mt9d115_write_reg(MT9D115_MCU_ADDRESS, 0XAB37);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
-	retVal = mt9d115_write_reg(MT9D115_MCU_DATA_0, 3);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
+	LOG_FUNCTION_NAME;
 
-	// HG_GAMMASTARTMORPH @ 100 lux VAR(0x0B,0x0038)
-	retVal = mt9d115_write_reg(MT9D115_MCU_ADDRESS, 0X2B38);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
-	retVal = mt9d115_write_reg(MT9D115_MCU_DATA_0, 10600);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
-	
-	// HG_GAMMASTOPMORPH @ 20 lux VAR(0x0B,0x003A)
-	retVal = mt9d115_write_reg(MT9D115_MCU_ADDRESS, 0X2B3A);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
-	retVal = mt9d115_write_reg(MT9D115_MCU_DATA_0, 11600);
+	if (u32Mode == MT9D115_MODE_PREVIEW)
+		retVal = mt9d115_run_script(mt9d115_seq_preview_script,
+					    ARRAY_SIZE(mt9d115_seq_preview_script));
+	else
+		retVal = mt9d115_run_script(mt9d115_seq_video_script,
+					    ARRAY_SIZE(mt9d115_seq_video_script));
 	if (retVal < 0) { MT9D115_ERR; return -1; }
 
-	// Fade-To-Black: disabled VAR(0x0B,0x0062)
-	retVal = mt9d115_write_reg(MT9D115_MCU_ADDRESS, 0X2B62);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
-	retVal = mt9d115_write_reg(MT9D115_MCU_DATA_0, 0xFFFE);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
-	
-	// Disable FTB VAR(0x0B,0x0064)
-	retVal = mt9d115_write_reg(MT9D115_MCU_ADDRESS, 0X2B64);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
-	retVal = mt9d115_write_reg(MT9D115_MCU_DATA_0, 0xFFFF);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
+	LOG_FUNCTION_NAME_EXIT;
+	return 0;
+}
 
-	for(count = 0; count < ARRAY_SIZE(mt9d115_gamma_data); count++) {
-		//mt9d115_dbg("Reg: 0x%X :: Val: %d\n", mt9d115_gamma_data[count].stAddr.u16RegAddr, mt9d115_gamma_data[count].u16Val);
-		retVal = mt9d115_write_reg(MT9D115_MCU_ADDRESS, mt9d115_gamma_data[count].stAddr.u16RegAddr);
-		if (retVal < 0) { MT9D115_ERR; return -1; }
-		retVal = mt9d115_write_reg(MT9D115_MCU_DATA_0, mt9d115_gamma_data[count].u16Val);
-		if (retVal < 0) { MT9D115_ERR; return -1; }
-	}
 
-	LOG_FUNCTION_NAME_EXIT;
-	return retVal;
+/**
+ * mt9d115_modeFormat - output size and frame rate of a sequencer mode
+ * @u32Mode: MT9D115_MODE_PREVIEW or MT9D115_MODE_CAPTURE
+ */
+static void mt9d115_modeFormat(u32 u32Mode)
+{
+	const MT9D115_FORMAT_T *pFormat = mt9d115_format;
+
+	mt9d115_data.streamcap.capturemode = u32Mode;
+	mt9d115_data.streamcap.timeperframe.numerator = 1;
+	if (u32Mode == MT9D115_MODE_CAPTURE) {
+		mt9d115_data.pix.width = MT9D115_CAPTURE_WIDTH;
+		mt9d115_data.pix.height = MT9D115_CAPTURE_HEIGHT;
+		mt9d115_data.streamcap.timeperframe.denominator = pFormat->captureFps;
+	} else {
+		mt9d115_data.pix.width = MT9D115_PREVIEW_WIDTH;
+		mt9d115_data.pix.height = MT9D115_PREVIEW_HEIGHT;
+		mt9d115_data.streamcap.timeperframe.denominator = pFormat->fps;
+	}
 }
 
 
-static int mt9d115_CCM(void) 
+static int mt9d115_Gamma(void) 
 {
-	int retVal = 0;
-	int count = 0;
-	
 	LOG_FUNCTION_NAME;
-	
-	for(count = 0; count < ARRAY_SIZE(mt9d115_CCM_data); count++) {
-		//mt9d115_dbg("Reg: 0x%X :: Val: 0x%X\n", mt9d115_CCM_data[count].stAddr.u16RegAddr, mt9d115_CCM_data[count].u16Val);
-		retVal = mt9d115_write_reg(MT9D115_MCU_ADDRESS, (unsigned short)mt9d115_CCM_data[count].stAddr.u16RegAddr);
-		if (retVal < 0) { MT9D115_ERR; return -1; }
-		retVal = mt9d115_write_reg(MT9D115_MCU_DATA_0, mt9d115_CCM_data[count].u16Val);
-		if (retVal < 0) { MT9D115_ERR; return -1; }
+
+	if (mt9d115_run_script(mt9d115_gamma_script, ARRAY_SIZE(mt9d115_gamma_script)) < 0) {
+		MT9D115_ERR; return -1;
+	}
+	if (mt9d115_write_vars(MT9D115_VAR_GAMMA_KNEE_0, mt9d115_gamma_knees, MT9D115_GAMMA_KNEES) < 0) {
+		MT9D115_ERR; return -1;
 	}
 
 	LOG_FUNCTION_NAME_EXIT;
-	return retVal;
+	return 0;
 }
 
 
-static int mt9d115_patch(void) 
+static int mt9d115_CCM(void) 
 {
-	int retVal = 0;
-	int count = 0;
-	u16 readVal = 0;
-	
 	LOG_FUNCTION_NAME;
-	// SOC2031_patch
-	for(count = 0; count < ARRAY_SIZE(mt9d115_patch_data); count++) {
-		retVal = mt9d115_write_reg(mt9d115_patch_data[count].u16RegAddr, mt9d115_patch_data[count].u16Val);
-		if (retVal < 0) { MT9D115_ERR; return -1; }
+
+	if (mt9d115_write_vars(MT9D115_VAR_AWB_CCM_L_0, mt9d115_ccm, MT9D115_CCM_COEFS) < 0) {
+		MT9D115_ERR; return -1;
 	}
-	
-	// hard coded start address of the patch at "patchSetup" 
-	retVal = mt9d115_write_reg(MT9D115_MCU_ADDRESS, 0x2006);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
-	retVal = mt9d115_write_reg(MT9D115_MCU_DATA_0, 0x415);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
-	
-	// execute the patch
-	retVal = mt9d115_write_reg(MT9D115_MCU_ADDRESS, 0xA005);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
-	retVal = mt9d115_write_reg(MT9D115_MCU_DATA_0, 0x1);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
-	
-	// wait for the patch to complete initialization
-	// POLL_FIELD=MON_PATCH_ID_0,==0,DELAY=10,TIMEOUT=100
-	count = 0;
-	readVal = 0;
-	retVal = mt9d115_write_reg(MT9D115_MCU_ADDRESS, 0xA024);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
-	do
-	{
-		retVal = mt9d115_read_reg(MT9D115_MCU_DATA_0, &readVal);
-		if (retVal < 0) { MT9D115_ERR; return -1; }
-		mdelay(10);
-		count++;
-		//mt9d115_dbg("count : %d readVal = 0x%x\n", count, readVal);
-	} while (count < 10 && readVal == 0x0000);
 
 	LOG_FUNCTION_NAME_EXIT;
-	return retVal;
+	return 0;
 }
 
 
-static int mt9d115_basicInit(void) 
+static int mt9d115_patch(void) 
 {
-	int retVal = 0;
-	int count = 0;
-	u16 readVal = 0;
-	
 	LOG_FUNCTION_NAME;
-	
-	// MCU Powerup Stop Enable
-	// set powerup stop bit
-	// MCU Powerup Stop Enable
-	retVal = mt9d115_read_reg(MT9D115_CTRL_STATUS, &readVal);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
-	retVal = mt9d115_write_reg(MT9D115_CTRL_STATUS, readVal | 0x0004);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
-	 
-	// start MCU, includes wait for standby_done to clear
-	// release MCU from standby
-	// GO
-	retVal = mt9d115_read_reg(MT9D115_CTRL_STATUS, &readVal);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
-	retVal = mt9d115_write_reg(MT9D115_CTRL_STATUS, readVal & 0xFFFE);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
-	// wait for R20B to come out of standby
-	do
-	{
-		retVal = mt9d115_read_reg(MT9D115_CTRL_STATUS, &readVal);
-		if (retVal < 0) { MT9D115_ERR; return -1; }
-		readVal &= 0x4000;
-		mdelay(10);
-		count++;
-		//mt9d115_dbg("count : %d\n", count);
-	} while (count < 10 && readVal != 0x0000);
-	
-	
-	// sensor core & flicker timings
-	// MT9D115 (SOC2031) Register Wizard Defaults: Sensor Core Timing 4 MIPI
-	// Preview : Output width VAR(7,0x03)
-	retVal = mt9d115_write_reg(MT9D115_MCU_ADDRESS, 0x2703);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
-	retVal = mt9d115_write_reg(MT9D115_MCU_DATA_0, MT9D115_PREVIEW_WIDTH);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
-	
-	// Preview : Output height VAR(7,0x05)
-	retVal = mt9d115_write_reg(MT9D115_MCU_ADDRESS, 0x2705);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
-	retVal = mt9d115_write_reg(MT9D115_MCU_DATA_0, MT9D115_PREVIEW_HEIGHT);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
 
-	// Capture : Output width VAR(7,0x07)
-	retVal = mt9d115_write_reg(MT9D115_MCU_ADDRESS, 0x2707);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
-	retVal = mt9d115_write_reg(MT9D115_MCU_DATA_0, MT9D115_CAPTURE_WIDTH);
-	
-	// Capture : Output height VAR(7,0x09)
-	retVal = mt9d115_write_reg(MT9D115_MCU_ADDRESS, 0x2709);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
-	retVal = mt9d115_write_reg(MT9D115_MCU_DATA_0, MT9D115_CAPTURE_HEIGHT);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
-	
-	// Row Start (A) = 0, VAR(7,0xD)
-	retVal = mt9d115_write_reg(MT9D115_MCU_ADDRESS, 0x270D);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
-	retVal = mt9d115_write_reg(MT9D115_MCU_DATA_0, 0x0000);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
-
-	// Column Start (A) = 0, VAR(7,0xF)
-	retVal = mt9d115_write_reg(MT9D115_MCU_ADDRESS, 0x270F);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
-	retVal = mt9d115_write_reg(MT9D115_MCU_DATA_0, 0x0000);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
+	if (mt9d115_write_vars(MT9D115_PATCH_ADDRESS, mt9d115_patch_code, ARRAY_SIZE(mt9d115_patch_code)) < 0) {
+		MT9D115_ERR; return -1;
+	}
+	if (mt9d115_run_script(mt9d115_patch_script, ARRAY_SIZE(mt9d115_patch_script)) < 0) {
+		MT9D115_ERR; return -1;
+	}
 
-	// Row End (A) = 1213, VAR(7,0x11)
-	retVal = mt9d115_write_reg(MT9D115_MCU_ADDRESS, 0x2711);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
-	retVal = mt9d115_write_reg(MT9D115_MCU_DATA_0, 0x4BD);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
+	LOG_FUNCTION_NAME_EXIT;
+	return 0;
+}
 
-	// Column End (A) = 1613, VAR(7,0x13)
-	retVal = mt9d115_write_reg(MT9D115_MCU_ADDRESS, 0x2713);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
-	retVal = mt9d115_write_reg(MT9D115_MCU_DATA_0, 0x64D);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
 
-	// Row Speed (A) = 273, VAR(7,0x15)
-	retVal = mt9d115_write_reg(MT9D115_MCU_ADDRESS, 0x2715);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
-	retVal = mt9d115_write_reg(MT9D115_MCU_DATA_0, 0x0111);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
+static int mt9d115_basicInit(const MT9D115_FORMAT_T *pFormat) 
+{
+	LOG_FUNCTION_NAME;
 
-	// Read Mode (A) = 1132, VAR(7,0x17)
-	retVal = mt9d115_write_reg(MT9D115_MCU_ADDRESS, 0x2717);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
-	retVal = mt9d115_write_reg(MT9D115_MCU_DATA_0, 0x046C);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
+	if (mt9d115_run_script(mt9d115_init_script, ARRAY_SIZE(mt9d115_init_script)) < 0) {
+		MT9D115_ERR; return -1;
+	}
+	if (pFormat->pScript && mt9d115_run_script(pFormat->pScript, pFormat->scriptLen) < 0) {
+		MT9D115_ERR; return -1;
+	}
 
-	// Sensor_fine_correction (A) = 90, VAR(7,0x19)
-	retVal = mt9d115_write_reg(MT9D115_MCU_ADDRESS, 0x2719);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
-	retVal = mt9d115_write_reg(MT9D115_MCU_DATA_0, 0x005A);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
+	if ((mt9d115_tuning_loaded & MT9D115_TUNING_GAMMA) && mt9d115_Gamma() < 0) {
+		MT9D115_ERR; return -1;
+	}
+	
+	if ((mt9d115_tuning_loaded & MT9D115_TUNING_CCM) && mt9d115_CCM() < 0) {
+		MT9D115_ERR; return -1;
+	}
+	if (mt9d115_patch() < 0) {
+		MT9D115_ERR; return -1;
+	}
 
-	// Sensor_fine_IT_min (A) = 446, VAR(7,0x1B)
-	retVal = mt9d115_write_reg(MT9D115_MCU_ADDRESS, 0x271B);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
-	retVal = mt9d115_write_reg(MT9D115_MCU_DATA_0, 0x01BE);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
+	if (mt9d115_run_script(mt9d115_preview_script, ARRAY_SIZE(mt9d115_preview_script)) < 0) {
+		MT9D115_ERR; return -1;
+	}
 
-	// sensor_fine_IT_max_margin (A) = 305, VAR(7,0x1D)
-	retVal = mt9d115_write_reg(MT9D115_MCU_ADDRESS, 0x271D);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
-	retVal = mt9d115_write_reg(MT9D115_MCU_DATA_0, 0x0131);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
+	LOG_FUNCTION_NAME_EXIT;
+	return 0;
+}
 
-	// mipi timing
-	// Frame Lines (A) = 699, VAR(7,0x1F)
-	retVal = mt9d115_write_reg(MT9D115_MCU_ADDRESS, 0x271F);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
-	retVal = mt9d115_write_reg(MT9D115_MCU_DATA_0, 0x02BB);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
 
-	// Line Length (A) = 2184, VAR(7,0x21)
-	retVal = mt9d115_write_reg(MT9D115_MCU_ADDRESS, 0x2721);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
-	retVal = mt9d115_write_reg(MT9D115_MCU_DATA_0, 0x0888);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
+/**
+ * mt9d115_warmInit - bring the sensor back from hardware standby
+ *
+ * The sensor keeps its registers, the firmware patch and the MCU
+ * variables in standby. If PLL_CONTROL and MON_PATCH_ID_0 still read as
+ * after the last cold init, reset, PLL setup, patch upload and the init
+ * scripts are skipped; the tuning snapshot is written back in blocks of
+ * consecutive variables and the firmware is told to refresh.
+ *
+ * Returns 1 if the sensor has lost its state and needs a cold init.
+ */
+static int mt9d115_warmInit(void)
+{
+	MT9D115_SNAPSHOT_T *snap = &mt9d115_snapshot;
+	u16 readVal = 0;
+	int i, len, step, blocks = 0;
 
-	// Row Start (B) = 4, VAR(7,0x23)
-	retVal = mt9d115_write_reg(MT9D115_MCU_ADDRESS, 0x2723);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
-	retVal = mt9d115_write_reg(MT9D115_MCU_DATA_0, 0x004);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
+	LOG_FUNCTION_NAME;
 
-	// Column Start (B) = 4, VAR(7,0x25)
-	retVal = mt9d115_write_reg(MT9D115_MCU_ADDRESS, 0x2725);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
-	retVal = mt9d115_write_reg(MT9D115_MCU_DATA_0, 0x004);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
+	if (mt9d115_run_script(mt9d115_standby_exit_script,
+			       ARRAY_SIZE(mt9d115_standby_exit_script)) < 0) {
+		MT9D115_ERR; return -1;
+	}
+	if (mt9d115_read_reg(MT9D115_PLL_CONTROL, &readVal) < 0) {
+		MT9D115_ERR; return -1;
+	}
+	if (readVal != snap->u16PllControl)
+		return 1;
+	if (mt9d115_read_var(MT9D115_VAR_MON_PATCH_ID_0, &readVal) < 0) {
+		MT9D115_ERR; return -1;
+	}
+	if (readVal != snap->u16PatchId)
+		return 1;
+
+	for (i = 0; i < snap->count; i += len) {
+		step = (snap->au16Var[i] & 0x8000) ? 1 : 2;
+		for (len = 1; i + len < snap->count &&
+		     snap->au16Var[i + len] == snap->au16Var[i] + step * len; len++)
+			;
+		if (mt9d115_write_vars(snap->au16Var[i], &snap->au16Val[i], len) < 0) {
+			MT9D115_ERR; return -1;
+		}
+		blocks++;
+	}
+	if (mt9d115_run_script(mt9d115_refresh_script, ARRAY_SIZE(mt9d115_refresh_script)) < 0) {
+		MT9D115_ERR; return -1;
+	}
+	// the sequencer may have been left in capture
+	if (mt9d115_seqMode(MT9D115_MODE_PREVIEW) < 0) {
+		MT9D115_ERR; return -1;
+	}
+	mt9d115_dbg("%s: %d variables in %d blocks\n", __func__, snap->count, blocks);
 
-	// Row End (B) = 1211, VAR(7,0x27)
-	retVal = mt9d115_write_reg(MT9D115_MCU_ADDRESS, 0x2727);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
-	retVal = mt9d115_write_reg(MT9D115_MCU_DATA_0, 0x4BB);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
+	LOG_FUNCTION_NAME_EXIT;
+	return 0;
+}
 
-	// Column End (B) = 1611, VAR(7,0x29)
-	retVal = mt9d115_write_reg(MT9D115_MCU_ADDRESS, 0x2729);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
-	retVal = mt9d115_write_reg(MT9D115_MCU_DATA_0, 0x64B);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
 
-	// Row Speed (B) = 273, VAR(7,0x2B)
-	retVal = mt9d115_write_reg(MT9D115_MCU_ADDRESS, 0x272B);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
-	retVal = mt9d115_write_reg(MT9D115_MCU_DATA_0, 0x0111);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
+/**
+ * mt9d115_coldInit - full sensor configuration
+ *
+ * Records the tuning variables written by the init scripts as the
+ * snapshot for mt9d115_warmInit().
+ */
+static int mt9d115_coldInit(void)
+{
+	MT9D115_SNAPSHOT_T *snap = &mt9d115_snapshot;
+	const MT9D115_FORMAT_T *pFormat = mt9d115_format;
+	int retVal;
 
-	// Read Mode (B) = 36, VAR(7,0x2D)
-	retVal = mt9d115_write_reg(MT9D115_MCU_ADDRESS, 0x272D);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
-	retVal = mt9d115_write_reg(MT9D115_MCU_DATA_0, 0x0024);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
+	LOG_FUNCTION_NAME;
 
-	// sensor_fine_correction (B) = 58, VAR(7,0x2F)
-	retVal = mt9d115_write_reg(MT9D115_MCU_ADDRESS, 0x272F);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
-	retVal = mt9d115_write_reg(MT9D115_MCU_DATA_0, 0x003A);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
+	if (mt9d115_reset() < 0) {
+		MT9D115_ERR; return -1;
+	}  
+	
+	if (mt9d115_interfaceMode(MT9D115_MIPI_MODE) < 0) {
+		MT9D115_ERR; return -1;
+	}
+	
+	if (mt9d115_pllSetting(pFormat->pll) < 0) {
+		MT9D115_ERR; return -1;
+	}
+	mutex_lock(&mt9d115_tuning_lock);
+	snap->bValid = false;
+	snap->count = 0;
+	snap->bRecording = true;
+	retVal = mt9d115_basicInit(pFormat);
+	snap->bRecording = false;
+	mutex_unlock(&mt9d115_tuning_lock);
+	if (retVal < 0) {
+		MT9D115_ERR; return -1;
+	}
 
-	// sensor_fine_IT_min (B) = 246, VAR(7,0x31)
-	retVal = mt9d115_write_reg(MT9D115_MCU_ADDRESS, 0x2731);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
-	retVal = mt9d115_write_reg(MT9D115_MCU_DATA_0, 0x00F6);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
+	if (snap->count >= 0 &&
+	    mt9d115_read_reg(MT9D115_PLL_CONTROL, &snap->u16PllControl) == 0 &&
+	    mt9d115_read_var(MT9D115_VAR_MON_PATCH_ID_0, &snap->u16PatchId) == 0)
+		snap->bValid = true;
 
-	// sensor_fine_IT_max_margin (B) = 139, VAR(7,0x33)
-	retVal = mt9d115_write_reg(MT9D115_MCU_ADDRESS, 0x2733);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
-	retVal = mt9d115_write_reg(MT9D115_MCU_DATA_0, 0x008B);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
+	LOG_FUNCTION_NAME_EXIT;
+	return 0;
+}
 
-	// mipi timing
-	// Frame Lines (B) = 1313, VAR(7,0x35)
-	retVal = mt9d115_write_reg(MT9D115_MCU_ADDRESS, 0x2735);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
-	retVal = mt9d115_write_reg(MT9D115_MCU_DATA_0, 0x0521);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
 
-	// Sensor Lines Length (B) = 0x0888, VAR(7,0x37)
-	retVal = mt9d115_write_reg(MT9D115_MCU_ADDRESS, 0x2737);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
-	retVal = mt9d115_write_reg(MT9D115_MCU_DATA_0, 0x0888);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
+/**
+ * mt9d115_sensorInit - configure the sensor and wait for the MIPI link
+ * @mipi_csi2_info: MIPI CSI2 host prepared by mt9d115_v4l2_dev_init()
+ */
+static int mt9d115_sensorInit(struct mipi_csi2_info *mipi_csi2_info)
+{
+	int retVal;
+	u32 mipi_reg;
+	unsigned int i = 0;
 
-	// Crop_X0 (A) = 0, VAR(7,0x39)
-	retVal = mt9d115_write_reg(MT9D115_MCU_ADDRESS, 0x2739);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
-	retVal = mt9d115_write_reg(MT9D115_MCU_DATA_0, 0x0000);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
+	LOG_FUNCTION_NAME;
 
-	// Crop_X1 (A) = 799, VAR(7,0x3B)
-	retVal = mt9d115_write_reg(MT9D115_MCU_ADDRESS, 0x273B);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
-	retVal = mt9d115_write_reg(MT9D115_MCU_DATA_0, 0x031F);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
+	// sensor configuration, from the snapshot if it is still valid
+	retVal = 1;
+	mutex_lock(&mt9d115_tuning_lock);
+	if (mt9d115_snapshot.bValid)
+		retVal = mt9d115_warmInit();
+	mutex_unlock(&mt9d115_tuning_lock);
+	if (retVal > 0)
+		retVal = mt9d115_coldInit();
+	if (retVal < 0) {
+		MT9D115_ERR; return -1;
+	}
 
-	// Crop_Y0 (A) = 0, VAR(7,0x3D)
-	retVal = mt9d115_write_reg(MT9D115_MCU_ADDRESS, 0x273D);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
-	retVal = mt9d115_write_reg(MT9D115_MCU_DATA_0, 0x0000);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
+	/* wait for mipi sensor ready */
+	mipi_reg = mipi_csi2_dphy_status(mipi_csi2_info);
+	while ((mipi_reg == 0x200) && (i < 10)) {
+		mipi_reg = mipi_csi2_dphy_status(mipi_csi2_info);
+		i++;
+		msleep(10);
+	}
 
-	// Crop_Y1 (A) = 599, VAR(7,0x3F)
-	retVal = mt9d115_write_reg(MT9D115_MCU_ADDRESS, 0x273F);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
-	retVal = mt9d115_write_reg(MT9D115_MCU_DATA_0, 0x0257);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
+	if (i >= 10) {
+		pr_err("mipi csi2 can not receive sensor clk!\n");
+		return -1;
+	}
 
-	// Crop_X0 (B) = 0, VAR(7,0x47)
-	retVal = mt9d115_write_reg(MT9D115_MCU_ADDRESS, 0x2747);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
-	retVal = mt9d115_write_reg(MT9D115_MCU_DATA_0, 0x0000);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
+	i = 0;
 
-	// Crop_X1 (B) = 1599, VAR(7,0x49)
-	retVal = mt9d115_write_reg(MT9D115_MCU_ADDRESS, 0x2749);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
-	retVal = mt9d115_write_reg(MT9D115_MCU_DATA_0, 0x063F);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
+	/* wait for mipi stable */
+	mipi_reg = mipi_csi2_get_error1(mipi_csi2_info);
+	while ((mipi_reg != 0x0) && (i < 10)) {
+		mipi_reg = mipi_csi2_get_error1(mipi_csi2_info);
+		i++;
+		msleep(10);
+	}
 
-	// Crop_Y0 (B) = 0, VAR(7,0x4B)
-	retVal = mt9d115_write_reg(MT9D115_MCU_ADDRESS, 0x274B);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
-	retVal = mt9d115_write_reg(MT9D115_MCU_DATA_0, 0x0000);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
+	if (i >= 10) {
+		pr_err("mipi csi2 can not reveive data correctly!\n");
+		return -1;
+	}
 
-	// Crop_Y1 (B) = 1199, VAR(7,0x4D)
-	retVal = mt9d115_write_reg(MT9D115_MCU_ADDRESS, 0x274D);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
-	retVal = mt9d115_write_reg(MT9D115_MCU_DATA_0, 0x04AF);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
+	LOG_FUNCTION_NAME_EXIT;
+	return 0;
+}
 
-	// mipi timing
-	// R9 Step = 160, VAR(2,0x2D)
-	retVal = mt9d115_write_reg(MT9D115_MCU_ADDRESS, 0x222D);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
-	retVal = mt9d115_write_reg(MT9D115_MCU_DATA_0, 0x00A0);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
 
-	// search_f1_50 = 38, VAR(4,0x08)
-	retVal = mt9d115_write_reg(MT9D115_MCU_ADDRESS, 0xA408);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
-	retVal = mt9d115_write_reg(MT9D115_MCU_DATA_0, 0x26);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
+/**
+ * mt9d115_init_work_func - sensor configuration running in the background
+ * @work: mt9d115_init_work
+ *
+ * Waiters on mt9d115_init_done are released once no further
+ * configuration has been queued in the meantime.
+ */
+static void mt9d115_init_work_func(struct work_struct *work)
+{
+	enum sensor_i2c_phase phase;
+	int retVal;
+
+	mutex_lock(&mt9d115_init_lock);
+	mt9d115_init_pending = 0;
+	mutex_unlock(&mt9d115_init_lock);
+
+	phase = sensor_i2c_prof_enter(&mt9d115_prof, SENSOR_I2C_PHASE_DEV_INIT);
+	retVal = mt9d115_sensorInit(mipi_csi2_get_info());
+	sensor_i2c_prof_leave(&mt9d115_prof, phase);
+
+	mutex_lock(&mt9d115_init_lock);
+	mt9d115_init_ret = retVal;
+	if (!mt9d115_init_pending)
+		complete_all(&mt9d115_init_done);
+	mutex_unlock(&mt9d115_init_lock);
+}
 
-	// search_f2_50 = 41, VAR(4,0x09)
-	retVal = mt9d115_write_reg(MT9D115_MCU_ADDRESS, 0xA409);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
-	retVal = mt9d115_write_reg(MT9D115_MCU_DATA_0, 0x29);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
 
-	// search_f1_60 = 46, VAR(4,0x0A)
-	retVal = mt9d115_write_reg(MT9D115_MCU_ADDRESS, 0xA40A);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
-	retVal = mt9d115_write_reg(MT9D115_MCU_DATA_0, 0x2E);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
+/**
+ * mt9d115_wait_init - wait for the queued sensor configuration
+ *
+ * Returns the result of the last configuration run.
+ */
+static int mt9d115_wait_init(void)
+{
+	wait_for_completion(&mt9d115_init_done);
+	return mt9d115_init_ret;
+}
 
-	// search_f2_60 = 49, VAR(4,0x0B)
-	retVal = mt9d115_write_reg(MT9D115_MCU_ADDRESS, 0xA40B);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
-	retVal = mt9d115_write_reg(MT9D115_MCU_DATA_0, 0x31);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
 
-	// R9_Step_60 (A) = 160, VAR(4,0x11)
-	retVal = mt9d115_write_reg(MT9D115_MCU_ADDRESS, 0x2411);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
-	retVal = mt9d115_write_reg(MT9D115_MCU_DATA_0, 0x00A0);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
+/************************************************************************
+			sysfs tuning tables
+************************************************************************/
 
-	// R9_Step_50 (A) = 192, VAR(4,0x13)
-	retVal = mt9d115_write_reg(MT9D115_MCU_ADDRESS, 0x2413);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
-	retVal = mt9d115_write_reg(MT9D115_MCU_DATA_0, 0x00C0);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
+/**
+ * mt9d115_show_table - print a tuning table
+ */
+static ssize_t mt9d115_show_table(char *buf, const u16 *pu16Table, int count, bool bSigned)
+{
+	ssize_t len = 0;
+	int i;
+
+	mutex_lock(&mt9d115_tuning_lock);
+	for (i = 0; i < count; i++)
+		len += sprintf(buf + len, "%d%c", bSigned ? (s16)pu16Table[i] : pu16Table[i],
+			       i == count - 1 ? '\n' : ' ');
+	mutex_unlock(&mt9d115_tuning_lock);
+	return len;
+}
 
-	// R9_Step_60 (B) = 160, VAR(4,0x15)
-	retVal = mt9d115_write_reg(MT9D115_MCU_ADDRESS, 0x2415);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
-	retVal = mt9d115_write_reg(MT9D115_MCU_DATA_0, 0x00A0);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
+/**
+ * mt9d115_store_table - parse a tuning table and apply it
+ * @pu16Table: table to be replaced
+ * @count: number of values expected
+ * @flag: MT9D115_TUNING_GAMMA or MT9D115_TUNING_CCM
+ *
+ * A running sensor gets the new table right away through block writes
+ * and a refresh command, otherwise it is applied by the next init.
+ */
+static ssize_t mt9d115_store_table(const char *buf, size_t size, u16 *pu16Table, int count, int flag)
+{
+	u16 u16Val[MT9D115_CCM_COEFS];
+	const char *p = buf;
+	char *end;
+	int i, retVal = 0;
+
+	for (i = 0; i < count; i++) {
+		while (isspace(*p))
+			p++;
+		u16Val[i] = simple_strtol(p, &end, 0);
+		if (end == p)
+			return -EINVAL;
+		p = end;
+	}
 
-	// R9_Step_50 (B) = 192, VAR(4,0x17)
-	retVal = mt9d115_write_reg(MT9D115_MCU_ADDRESS, 0x2417);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
-	retVal = mt9d115_write_reg(MT9D115_MCU_DATA_0, 0x00C0);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
+	mutex_lock(&mt9d115_tuning_lock);
+	memcpy(pu16Table, u16Val, count * sizeof(u16));
+	mt9d115_tuning_loaded |= flag;
+	if (mt9d115_data.on) {
+		// keep the snapshot in step with the running sensor
+		mt9d115_snapshot.bRecording = mt9d115_snapshot.bValid;
+		if (flag == MT9D115_TUNING_GAMMA)
+			retVal = mt9d115_Gamma();
+		else
+			retVal = mt9d115_CCM();
+		if (mt9d115_snapshot.count < 0)
+			mt9d115_snapshot.bValid = false;
+		mt9d115_snapshot.bRecording = false;
+		if (retVal >= 0)
+			retVal = mt9d115_run_script(mt9d115_refresh_script,
+						    ARRAY_SIZE(mt9d115_refresh_script));
+	} else {
+		// the table is not in the snapshot, the next init has to be a cold one
+		mt9d115_snapshot.bValid = false;
+	}
+	mutex_unlock(&mt9d115_tuning_lock);
 
-	// FD Mode = 16, VAR(4,0x04)
-	retVal = mt9d115_write_reg(MT9D115_MCU_ADDRESS, 0xA404);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
-	retVal = mt9d115_write_reg(MT9D115_MCU_DATA_0, 0x10);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
+	return retVal < 0 ? -EIO : size;
+}
 
-	// Stat_min = 2, VAR(4,0x0D)
-	retVal = mt9d115_write_reg(MT9D115_MCU_ADDRESS, 0xA40D);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
-	retVal = mt9d115_write_reg(MT9D115_MCU_DATA_0, 0x02);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
+static ssize_t show_gamma(struct device *dev, struct device_attribute *attr, char *buf)
+{
+	return mt9d115_show_table(buf, mt9d115_gamma_knees, MT9D115_GAMMA_KNEES, false);
+}
 
-	// Stat_max = 3, VAR(4,0x0E)
-	retVal = mt9d115_write_reg(MT9D115_MCU_ADDRESS, 0xA40E);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
-	retVal = mt9d115_write_reg(MT9D115_MCU_DATA_0, 0x03);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
+static ssize_t store_gamma(struct device *dev, struct device_attribute *attr,
+			   const char *buf, size_t size)
+{
+	return mt9d115_store_table(buf, size, mt9d115_gamma_knees, MT9D115_GAMMA_KNEES,
+				   MT9D115_TUNING_GAMMA);
+}
 
-	// Min_amplitude = 10, VAR(4,0x10)
-	retVal = mt9d115_write_reg(MT9D115_MCU_ADDRESS, 0xA410);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
-	retVal = mt9d115_write_reg(MT9D115_MCU_DATA_0, 0x0A);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
-	
-	
-	// AE settings
-	// Do the rest of the basic initialization.
-	// preview ENTER: average luma = 2, VAR(1,0x17)
-	retVal = mt9d115_write_reg(MT9D115_MCU_ADDRESS, 0xA117);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
-	retVal = mt9d115_write_reg(MT9D115_MCU_DATA_0, 0x02);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
-	
-	// preview: average luma = 2 VAR(1,0x001D)
-	retVal = mt9d115_write_reg(MT9D115_MCU_ADDRESS, 0xA11D);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
-	retVal = mt9d115_write_reg(MT9D115_MCU_DATA_0, 0x02);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
-	
-	// capture: average luma = 2, VAR(1,0x0029)
-	retVal = mt9d115_write_reg(MT9D115_MCU_ADDRESS, 0xA129);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
-	retVal = mt9d115_write_reg(MT9D115_MCU_DATA_0, 0x02);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
-	
-	// AE_BASETARGET = 50, VAR(2, 0x004F)
-	retVal = mt9d115_write_reg(MT9D115_MCU_ADDRESS, 0xA24F);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
-	retVal = mt9d115_write_reg(MT9D115_MCU_DATA_0, 0x32);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
-	// AE_MAX_INDEX = 16, VAR(2, 0x000C)
-	retVal = mt9d115_write_reg(MT9D115_MCU_ADDRESS, 0xA20C);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
-	retVal = mt9d115_write_reg(MT9D115_MCU_DATA_0, 0x10);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
-	
-	// MCU_ADDRESS [AE_MAXGAIN23]
-	retVal = mt9d115_write_reg(MT9D115_MCU_ADDRESS, 0xA216);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
-	// ae_max_gain23 has to be less than or equal to ae_max_virtgain
-	retVal = mt9d115_write_reg(MT9D115_MCU_DATA_0, 0x0091);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
-	
-	// ae.maxvirtgain = 255 is the max. analog green gain
-	// ae.maxvirtgain * (B/G) <= 255 in order to prevent the analog blue gain from overflow
-	// under A light WB tuning, the max. (B/G) is 1.750, hence, ae.maxvirtgain <= 145
-	// figure out the max. analog green gain to get WB in virtual units (16 virtual units = 1 analog unit)
-	// VAR(2,0x000E), 0x91
-	retVal = mt9d115_write_reg(MT9D115_MCU_ADDRESS, 0xA20E);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
-	retVal = mt9d115_write_reg(MT9D115_MCU_DATA_0, 0x91);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
-	
-	//ae_max_dgain_ae1 = (494 -> 174 -> 164) in order to reduce CFPN
-	// VAR(2,0x0012)
-	retVal = mt9d115_write_reg(MT9D115_MCU_ADDRESS, 0x2212);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
-	retVal = mt9d115_write_reg(MT9D115_MCU_DATA_0, 0x00A4);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
-	
-	// Lens Correction
-	// Note: this LSC is generated manually for this part - DO NOT USE the "FACTORY" label
-	// LOAD_PROM=0xA8, PGA   // load the PGA from the Demo2 on-board EEPROM
-	// PGA_ENABLE
-	retVal = mt9d115_read_reg(0x3210, &readVal);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
-	retVal = mt9d115_write_reg(0x3210, readVal | 0x00008);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
+static DEVICE_ATTR(gamma, S_IRUGO | S_IWUSR, show_gamma, store_gamma);
 
-#if 0	
-	if (mt9d115_Gamma() < 0) {
-		MT9D115_ERR; return -1;
-	}
-	
-	if (mt9d115_CCM() < 0) {
-		MT9D115_ERR; return -1;
-	}
-#endif
-	if (mt9d115_patch() < 0) {
-		MT9D115_ERR; return -1;
-	}
-	
-	// continue after powerup stop
-	// clear powerup stop bit
-	retVal = mt9d115_read_reg(0x0018, &readVal);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
-	retVal = mt9d115_write_reg(0x0018, readVal & 0xFFFB);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
+static ssize_t show_ccm(struct device *dev, struct device_attribute *attr, char *buf)
+{
+	return mt9d115_show_table(buf, mt9d115_ccm, MT9D115_CCM_COEFS, true);
+}
 
-	// wait for sequencer to enter preview state
-	// POLL_FIELD=SEQ_STATE,!=3,DELAY=10,TIMEOUT=100
-	readVal = 0;
-	count = 0;
-	retVal = mt9d115_write_reg(MT9D115_MCU_ADDRESS, 0xA104);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
-	
-	do
-	{
-		retVal = mt9d115_read_reg(MT9D115_MCU_DATA_0, &readVal);
-		if (retVal < 0) { MT9D115_ERR; return -1; }
-		mdelay(10);
-		count++;
-		//mt9d115_dbg("count : %d\n", count);
-	} while (count < 10 && readVal != 3);
-
-	// syncronize the FW with the sensor
-	retVal = mt9d115_write_reg(MT9D115_MCU_ADDRESS, 0xA103);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
-	retVal = mt9d115_write_reg(MT9D115_MCU_DATA_0, 0x06);
-	if (retVal < 0) { MT9D115_ERR; return -1; }
-	
-	LOG_FUNCTION_NAME_EXIT;
-	return retVal;
+static ssize_t store_ccm(struct device *dev, struct device_attribute *attr,
+			 const char *buf, size_t size)
+{
+	return mt9d115_store_table(buf, size, mt9d115_ccm, MT9D115_CCM_COEFS,
+				   MT9D115_TUNING_CCM);
 }
 
+static DEVICE_ATTR(ccm, S_IRUGO | S_IWUSR, show_ccm, store_ccm);
+
 
 /************************************************************************
 			v4l2_ioctls
@@ -1366,8 +1079,11 @@ mt9d115_v4l2_int_s_power(struct v4l2_int_device *s, int on)
 
 	} else if (!on && sensor->on) {
 		mt9d115_dbg("Power off!\n");
+		mt9d115_wait_init();
 		if (camera_plat->pwdn)
 			camera_plat->pwdn(1);
+		// the next init starts in preview
+		mt9d115_modeFormat(MT9D115_MODE_PREVIEW);
 	}
 	sensor->on = on;
 	LOG_FUNCTION_NAME_EXIT;
@@ -1411,7 +1127,7 @@ static int mt9d115_v4l2_int_g_ifparm(struct v4l2_int_device *s, struct v4l2_ifpa
 	p->u.bt656.clock_curr = mt9d115_data.mclk;
 	pr_debug("   clock_curr=mclk=%d\n", mt9d115_data.mclk);
 	p->if_type = V4L2_IF_TYPE_BT656;
-	p->u.bt656.mode = V4L2_IF_TYPE_BT656_MODE_NOBT_8BIT;
+	p->u.bt656.mode = mt9d115_format->ifMode;
 	p->u.bt656.clock_min = MT9D115_XCLK_MIN;
 	p->u.bt656.clock_max = MT9D115_XCLK_MAX;
 	p->u.bt656.bt_sync_correct = 1;  /* Indicate external vsync */
@@ -1433,7 +1149,11 @@ static int
 mt9d115_v4l2_int_enum_fmt_cap(struct v4l2_int_device *s,struct v4l2_fmtdesc *fmt)
 {
 	LOG_FUNCTION_NAME;
-	fmt->pixelformat = mt9d115_data.pix.pixelformat;
+	if (fmt->index >= ARRAY_SIZE(mt9d115_formats))
+		return -EINVAL;
+	fmt->pixelformat = mt9d115_formats[fmt->index].u32PixelFormat;
+	strlcpy(fmt->description, mt9d115_formats[fmt->index].description,
+		sizeof(fmt->description));
 	LOG_FUNCTION_NAME_EXIT;
 	return 0;
 }
@@ -1475,19 +1195,77 @@ mt9d115_v4l2_int_g_fmt_cap(struct v4l2_int_device *s, struct v4l2_format *f)
 }
 
 
+/**
+ * mt9d115_isBayer - check if a pixel format is raw Bayer data
+ * @u32PixelFormat: V4L2 fourcc
+ *
+ * The IPU can not convert the YUV output of the sensor to such a format.
+ */
+static bool mt9d115_isBayer(u32 u32PixelFormat)
+{
+	switch (u32PixelFormat) {
+	case V4L2_PIX_FMT_SBGGR8:
+	case V4L2_PIX_FMT_SGBRG8:
+	case V4L2_PIX_FMT_SGRBG8:
+	case V4L2_PIX_FMT_SRGGB8:
+	case V4L2_PIX_FMT_SBGGR10:
+	case V4L2_PIX_FMT_SGBRG10:
+	case V4L2_PIX_FMT_SGRBG10:
+	case V4L2_PIX_FMT_SRGGB10:
+	case V4L2_PIX_FMT_SBGGR12:
+	case V4L2_PIX_FMT_SGBRG12:
+	case V4L2_PIX_FMT_SGRBG12:
+	case V4L2_PIX_FMT_SRGGB12:
+	case V4L2_PIX_FMT_SBGGR16:
+		return true;
+	}
+	return false;
+}
+
 /**
  * mt9d115_v4l2_int_s_fmt_cap - V4L2 sensor interface handler for VIDIOC_S_FMT ioctl
  * @s: pointer to standard V4L2 device structure
  * @f: pointer to standard V4L2 VIDIOC_S_FMT ioctl structure
  *
- * If the requested format is supported, configures the HW to use that
- * format, returns error code if format not supported or HW can't be
- * correctly configured.
+ * SGRBG10 selects the Bayer RAW10 output. Other Bayer formats are refused
+ * with -EINVAL, every other format selects the YUV output the IPU
+ * converts from. The chosen sensor output is returned in f. The sensor
+ * is reprogrammed by the next dev_init; a format change always takes a
+ * cold init.
  */
 static int 
 mt9d115_v4l2_int_s_fmt_cap(struct v4l2_int_device *s, struct v4l2_format *f)
 {
+	const MT9D115_FORMAT_T *pFormat = NULL;
+	int i;
+
 	LOG_FUNCTION_NAME;
+
+	for (i = 0; i < ARRAY_SIZE(mt9d115_formats); i++)
+		if (mt9d115_formats[i].u32PixelFormat == f->fmt.pix.pixelformat)
+			pFormat = &mt9d115_formats[i];
+	if (!pFormat) {
+		if (mt9d115_isBayer(f->fmt.pix.pixelformat)) {
+			mt9d115_dbg("%s: unsupported Bayer format %08x\n", __func__, f->fmt.pix.pixelformat);
+			return -EINVAL;
+		}
+		pFormat = &mt9d115_formats[0];
+	}
+	f->fmt.pix.pixelformat = pFormat->u32PixelFormat;
+	if (pFormat == mt9d115_format)
+		return 0;
+
+	// a queued configuration still runs with the old format
+	mt9d115_wait_init();
+	mutex_lock(&mt9d115_tuning_lock);
+	mt9d115_format = pFormat;
+	mt9d115_snapshot.bValid = false;
+	mutex_unlock(&mt9d115_tuning_lock);
+
+	mt9d115_data.pix.pixelformat = pFormat->u32BusFormat;
+	mt9d115_modeFormat(mt9d115_data.streamcap.capturemode);
+	mt9d115_dbg("%s: %s\n", __func__, pFormat->description);
+
 	LOG_FUNCTION_NAME_EXIT;
 	return 0;
 }
@@ -1504,6 +1282,9 @@ static int
 mt9d115_v4l2_int_g_parm(struct v4l2_int_device *s, struct v4l2_streamparm *a)
 {
 	LOG_FUNCTION_NAME;
+	if (a->type != V4L2_BUF_TYPE_VIDEO_CAPTURE)
+		return -EINVAL;
+	a->parm.capture = mt9d115_data.streamcap;
 	LOG_FUNCTION_NAME_EXIT;
 	return 0;
 }
@@ -1514,14 +1295,37 @@ mt9d115_v4l2_int_g_parm(struct v4l2_int_device *s, struct v4l2_streamparm *a)
  * @s: pointer to standard V4L2 device structure
  * @a: pointer to standard V4L2 VIDIOC_S_PARM ioctl structure
  *
- * Configures the sensor to use the input parameters, if possible.  If
- * not possible, reverts to the old parameters and returns the
- * appropriate error code.
- * ----->Note, this function is not active in this release.<------
+ * capturemode selects the sequencer context: MT9D115_MODE_PREVIEW for
+ * 800x600 out of context A, MT9D115_MODE_CAPTURE for 1600x1200 out of
+ * context B. A snapshot is a switch to capture and back to preview with
+ * the next S_PARM once its frames are dequeued, the sensor stays in
+ * context B in between, matching the CSI. extendedmode is not used.
  */
 static int mt9d115_v4l2_int_s_parm(struct v4l2_int_device *s, struct v4l2_streamparm *a)
 {
+	u32 u32Mode = a->parm.capture.capturemode;
+	int retVal;
+
 	LOG_FUNCTION_NAME;
+
+	if (a->type != V4L2_BUF_TYPE_VIDEO_CAPTURE)
+		return -EINVAL;
+	if (u32Mode > MT9D115_MODE_CAPTURE)
+		return -EINVAL;
+
+	// the sequencer only takes commands once the init has finished
+	if (mt9d115_wait_init() < 0)
+		return -EIO;
+	// MCU_ADDRESS/MCU_DATA pairs, not to be split by the sysfs tuning
+	mutex_lock(&mt9d115_tuning_lock);
+	retVal = mt9d115_seqMode(u32Mode);
+	mutex_unlock(&mt9d115_tuning_lock);
+	if (retVal < 0) {
+		MT9D115_ERR; return -EIO;
+	}
+	mt9d115_modeFormat(u32Mode);
+	mt9d115_dbg("%s: mode %u\n", __func__, u32Mode);
+
 	LOG_FUNCTION_NAME_EXIT;
 	return 0;
 }
@@ -1586,15 +1390,14 @@ mt9d115_v4l2_queryctrl(struct v4l2_int_device *s, struct v4l2_queryctrl *qc)
  * mt9d115_v4l2_dev_init - V4L2 sensor interface handler for vidioc_int_dev_init_num
  * @s: pointer to standard V4L2 device structure
  *
- * Initialise the device when slave attaches to the master.
+ * Initialise the device when slave attaches to the master. Only the MIPI
+ * CSI2 host is set up here, the sensor itself is configured by
+ * mt9d115_init_work while the capture driver continues; STREAMON waits
+ * for it through vidioc_int_wait_init.
  */
 static int mt9d115_v4l2_dev_init(struct v4l2_int_device *s)
 {
-	int retval = 0;
-	//struct i2c_client *client = mt9d115_data.i2c_client;
-	//void *mipi_csi2_info;
 	struct mipi_csi2_info *mipi_csi2_info = NULL;
-	u32 mipi_reg;
 	
 	LOG_FUNCTION_NAME;
 
@@ -1610,7 +1413,7 @@ static int mt9d115_v4l2_dev_init(struct v4l2_int_device *s)
 		return -EPERM;
 	}
 
-    mdelay(10);
+    msleep(10);
 
 	mipi_csi2_info = mipi_csi2_get_info();
 
@@ -1623,10 +1426,7 @@ static int mt9d115_v4l2_dev_init(struct v4l2_int_device *s)
 			mipi_csi2_set_lanes(mipi_csi2_info);
 			mipi_csi2_reset(mipi_csi2_info);
 
-			if (mt9d115_data.pix.pixelformat == V4L2_PIX_FMT_YUYV)
-				mipi_csi2_set_datatype(mipi_csi2_info, MIPI_DT_YUV422);
-			else
-				pr_err("currently this sensor format can not be supported!\n");
+			mipi_csi2_set_datatype(mipi_csi2_info, mt9d115_format->mipiDataType);
 		} else {
 			pr_err("Can not enable mipi csi2 driver!\n");
 			return -1;
@@ -1636,54 +1436,29 @@ static int mt9d115_v4l2_dev_init(struct v4l2_int_device *s)
 		return -1;
 	}
 	
-	// sensor configuration
-	if (mt9d115_reset() < 0) {
-		MT9D115_ERR; return -1;
-	}  
-	
-	if (mt9d115_interfaceMode(MT9D115_MIPI_MODE) < 0) {
-		MT9D115_ERR; return -1;
-	}
-	
-	if (mt9d115_pllSetting(MT9D115_PLL_MIPI_YUV422) < 0) {
-		MT9D115_ERR; return -1;
-	}
-	if (mt9d115_basicInit() < 0) {
-		MT9D115_ERR; return -1;
-	}
-	if (mipi_csi2_info) {
-		unsigned int i = 0;
-		/* wait for mipi sensor ready */
-		mipi_reg = mipi_csi2_dphy_status(mipi_csi2_info);
-		while ((mipi_reg == 0x200) && (i < 10)) {
-			mipi_reg = mipi_csi2_dphy_status(mipi_csi2_info);
-			i++;
-			msleep(10);
-		}
+	// every init ends in preview
+	mt9d115_modeFormat(MT9D115_MODE_PREVIEW);
 
-		if (i >= 10) {
-			pr_err("mipi csi2 can not receive sensor clk!\n");
-			return -1;
-		}
+	mutex_lock(&mt9d115_init_lock);
+	INIT_COMPLETION(mt9d115_init_done);
+	mt9d115_init_pending = 1;
+	mutex_unlock(&mt9d115_init_lock);
+	schedule_work(&mt9d115_init_work);
 
-		i = 0;
+	LOG_FUNCTION_NAME_EXIT;
+	return 0;
+}
 
-		/* wait for mipi stable */
-		mipi_reg = mipi_csi2_get_error1(mipi_csi2_info);
-		while ((mipi_reg != 0x0) && (i < 10)) {
-			mipi_reg = mipi_csi2_get_error1(mipi_csi2_info);
-			i++;
-			msleep(10);
-		}
 
-		if (i >= 10) {
-			pr_err("mipi csi2 can not reveive data correctly!\n");
-			return -1;
-		}
-	}
-	
-	LOG_FUNCTION_NAME_EXIT;
-	return retval;
+/*!
+ * mt9d115_v4l2_wait_init - V4L2 sensor interface handler for vidioc_int_wait_init_num
+ * @s: pointer to standard V4L2 device structure
+ *
+ * Blocks until the sensor configuration queued by dev_init has finished.
+ */
+static int mt9d115_v4l2_wait_init(struct v4l2_int_device *s)
+{
+	return mt9d115_wait_init();
 }
 
 
@@ -1735,6 +1510,11 @@ static int mt9d115_v4l2_g_chip_ident(struct v4l2_int_device *s, int *id)
 }
 
 
+// private slave ioctl, numbered as in mxc_v4l2_capture.c
+enum {
+	vidioc_int_wait_init_num = vidioc_int_priv_start_num,
+};
+
 static struct v4l2_int_ioctl_desc mt9d115_ioctl_desc[] = {
 	{ .num = vidioc_int_enum_framesizes_num,
 	  .func = (v4l2_int_ioctl_func *)mt9d115_v4l2_int_enum_framesizes },
@@ -1772,6 +1552,8 @@ static struct v4l2_int_ioctl_desc mt9d115_ioctl_desc[] = {
 	  .func = (v4l2_int_ioctl_func *)mt9d115_v4l2_init_num },
 	{ .num = vidioc_int_g_chip_ident_num,
 	  .func = (v4l2_int_ioctl_func *)mt9d115_v4l2_g_chip_ident },
+	{ .num = vidioc_int_wait_init_num,
+	  .func = (v4l2_int_ioctl_func *)mt9d115_v4l2_wait_init },
 };
 
 
@@ -1802,6 +1584,7 @@ static int mt9d115_probe(struct i2c_client *client, const struct i2c_device_id *
 {
 	int retval;
 	struct fsl_mxc_camera_platform_data *plat_data = client->dev.platform_data;
+	enum sensor_i2c_phase phase;
 
 	LOG_FUNCTION_NAME;
 
@@ -1819,13 +1602,13 @@ static int mt9d115_probe(struct i2c_client *client, const struct i2c_device_id *
 	mt9d115_data.io_init = plat_data->io_init;
 
 	mt9d115_data.i2c_client = client;
-	mt9d115_data.pix.pixelformat = V4L2_PIX_FMT_YUYV;
+	mt9d115_data.pix.pixelformat = mt9d115_format->u32BusFormat;
 	mt9d115_data.pix.width = MT9D115_PREVIEW_WIDTH;
 	mt9d115_data.pix.height = MT9D115_PREVIEW_HEIGHT;
 	mt9d115_data.streamcap.capability = V4L2_MODE_HIGHQUALITY |
 					   V4L2_CAP_TIMEPERFRAME;
 	mt9d115_data.streamcap.capturemode = 0;
-	mt9d115_data.streamcap.timeperframe.denominator = DEFAULT_FPS;
+	mt9d115_data.streamcap.timeperframe.denominator = mt9d115_format->fps;
 	mt9d115_data.streamcap.timeperframe.numerator = 1;
 
 	if (plat_data->io_init)
@@ -1835,7 +1618,9 @@ static int mt9d115_probe(struct i2c_client *client, const struct i2c_device_id *
 		plat_data->pwdn(0);
 	
 	// detecting I2C sensor
+	phase = sensor_i2c_prof_enter(&mt9d115_prof, SENSOR_I2C_PHASE_PROBE);
 	retval = mt9d115_detect(mt9d115_data.i2c_client);
+	sensor_i2c_prof_leave(&mt9d115_prof, phase);
 	if (retval < 0 ) {
 		pr_err("Cannot detect camera!\n");
 		retval = -ENODEV;
@@ -1847,8 +1632,18 @@ static int mt9d115_probe(struct i2c_client *client, const struct i2c_device_id *
 
 	// Keeping copy of plat_data
 	camera_plat = plat_data;
+
+	// nothing queued until the first dev_init
+	INIT_WORK(&mt9d115_init_work, mt9d115_init_work_func);
+	init_completion(&mt9d115_init_done);
+	complete_all(&mt9d115_init_done);
 	mt9d115_int_device.priv = &mt9d115_data;
 
+	if (device_create_file(&client->dev, &dev_attr_gamma))
+		dev_err(&client->dev, "Error on creating sysfs file for gamma\n");
+	if (device_create_file(&client->dev, &dev_attr_ccm))
+		dev_err(&client->dev, "Error on creating sysfs file for ccm\n");
+
 	// registering with v4l2 int device
 	retval = v4l2_int_device_register(&mt9d115_int_device);
 
@@ -1866,6 +1661,9 @@ static int mt9d115_probe(struct i2c_client *client, const struct i2c_device_id *
 static int mt9d115_remove(struct i2c_client *client)
 {
 	LOG_FUNCTION_NAME;
+	cancel_work_sync(&mt9d115_init_work);
+	device_remove_file(&client->dev, &dev_attr_ccm);
+	device_remove_file(&client->dev, &dev_attr_gamma);
 	v4l2_int_device_unregister(&mt9d115_int_device);
 	LOG_FUNCTION_NAME_EXIT;
 	return 0;
@@ -1894,9 +1692,15 @@ static struct i2c_driver mt9d115_i2c_driver = {
 ************************************************************************/
 static int __init mt9d115_module_init(void)
 {
+	int retval;
+
 	LOG_FUNCTION_NAME;
-	return i2c_add_driver(&mt9d115_i2c_driver);
+	sensor_i2c_prof_init(&mt9d115_prof, "mt9d115");
+	retval = i2c_add_driver(&mt9d115_i2c_driver);
+	if (retval)
+		sensor_i2c_prof_exit(&mt9d115_prof);
 	LOG_FUNCTION_NAME_EXIT;
+	return retval;
 }
 
 
@@ -1904,6 +1708,7 @@ static void __exit mt9d115_module_exit(void)
 {
 	LOG_FUNCTION_NAME;
 	i2c_del_driver(&mt9d115_i2c_driver);
+	sensor_i2c_prof_exit(&mt9d115_prof);
 	LOG_FUNCTION_NAME_EXIT;
 }
 
@@ -27,6 +27,40 @@
 #define MT9D115_MCU_DATA_6				0x099C
 #define MT9D115_MCU_DATA_7				0x099E
 
+#define MT9D115_PREVIEW_WIDTH			800
+#define MT9D115_PREVIEW_HEIGHT			600
+#define MT9D115_CAPTURE_WIDTH			1600
+#define MT9D115_CAPTURE_HEIGHT			1200
+
+#define MT9D115_VAR_AWB_CCM_L_0			0x2306
+#define MT9D115_VAR_GAMMA_KNEE_0		0xAB4F
+#define MT9D115_VAR_MON_PATCH_ID_0		0xA024
+#define MT9D115_VAR_OUTPUT_FORMAT_A		0x2755
+#define MT9D115_VAR_OUTPUT_FORMAT_B		0x2757
+#define MT9D115_VAR_SEQ_CMD				0xA103
+#define MT9D115_VAR_SEQ_STATE			0xA104
+#define MT9D115_VAR_SEQ_CAP_MODE		0xA115
+#define MT9D115_VAR_SEQ_CAP_NUMFRAMES	0xA116
+
+// logical MCU variable address: bit 15 byte access, bits 14:13 access type,
+// bits 12:8 firmware driver, bits 7:0 offset
+#define MT9D115_VAR_IS_LOGICAL(var)		(((var) & 0x6000) == 0x2000)
+#define MT9D115_VAR_DRIVER(var)			(((var) >> 8) & 0x1F)
+#define MT9D115_VAR_ID(var)				((var) & 0x1FFF)
+#define MT9D115_DRV_MON					0		// monitor, patch loader
+
+// mode_output_format_A/B
+#define MT9D115_OUTPUT_FORMAT_BAYER		0x0100	// bypass the IFP, raw Bayer out
+#define MT9D115_OUTPUT_FORMAT_BAYER_10	0x0200	// 10 bit Bayer instead of 8
+
+// sequencer commands and states
+#define MT9D115_SEQ_CMD_PREVIEW			1		// go to preview, context A
+#define MT9D115_SEQ_CMD_CAPTURE			2		// go to capture, context B
+#define MT9D115_SEQ_STATE_PREVIEW		3
+#define MT9D115_SEQ_STATE_CAPTURE		7
+#define MT9D115_SEQ_CAP_MODE_STILL		0x00	// back to preview after NUMFRAMES
+#define MT9D115_SEQ_CAP_MODE_VIDEO		0x02	// stay in capture
+
 #define V4L2_CID_TEST_PATTERN           (V4L2_CID_USER_BASE | 0x1001)
 #define V4L2_CID_GAIN_RED				(V4L2_CID_USER_BASE | 0x1002)
 #define V4L2_CID_GAIN_GREEN1			(V4L2_CID_USER_BASE | 0x1003)
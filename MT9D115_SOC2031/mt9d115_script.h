@@ -0,0 +1,361 @@
+/* mt9d115_mipi Camera, register scripts
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+// Bring-up and mode scripts of the MT9D115, executed by mt9d115_run_script().
+// Kept apart from the driver so that the executor can be benchmarked on a
+// host, see test_app/mt9d115_script_test.c of the A1000ERS_MT9M024 release.
+
+#ifndef __MT9D115_SCRIPT_H__
+#define __MT9D115_SCRIPT_H__
+
+#include "mt9d115_mipi.h"
+
+#define MT9D115_POLL_US					1000	// interval of register polls
+#define MT9D115_POLL_TIMEOUT_MS			100		// TIMEOUT=100 of the POLL_FIELD scripts
+#define MT9D115_MCU_DATA_PORTS			8		// MCU_DATA_0 .. MCU_DATA_7
+
+typedef enum mt9d115_script_op_t {
+		MT9D115_OP_WRITE	= 0,	// register = val
+		MT9D115_OP_VAR		= 1,	// MCU variable = val
+		MT9D115_OP_RMW		= 2,	// register = (register & ~mask) | val
+		MT9D115_OP_POLL		= 3,	// until (register & mask) == val
+		MT9D115_OP_POLL_VAR	= 4,	// until (MCU variable & mask) == val
+		MT9D115_OP_POLL_VAR_NOT	= 5,	// until (MCU variable & mask) != val
+		MT9D115_OP_DELAY	= 6		// sleep for val ms
+} MT9D115_SCRIPT_OP_T;
+
+typedef struct mt9d115_script_t {
+	unsigned char u8Op;
+	unsigned short u16Reg;
+	unsigned short u16Val;
+	unsigned short u16Mask;
+} MT9D115_SCRIPT_T;
+
+#define MT9D115_WRITE(reg, val)			{MT9D115_OP_WRITE, reg, val, 0xFFFF}
+#define MT9D115_VAR(var, val)			{MT9D115_OP_VAR, var, val, 0xFFFF}
+#define MT9D115_SET_BITS(reg, bits)		{MT9D115_OP_RMW, reg, bits, bits}
+#define MT9D115_CLEAR_BITS(reg, bits)	{MT9D115_OP_RMW, reg, 0, bits}
+#define MT9D115_POLL(reg, mask, val)	{MT9D115_OP_POLL, reg, val, mask}
+#define MT9D115_POLL_VAR(var, val)		{MT9D115_OP_POLL_VAR, var, val, 0xFFFF}
+#define MT9D115_POLL_VAR_NOT(var, val)	{MT9D115_OP_POLL_VAR_NOT, var, val, 0xFFFF}
+#define MT9D115_DELAY(ms)				{MT9D115_OP_DELAY, 0, ms, 0}
+
+#define MT9D115_PATCH_ADDRESS			0x0415	// physical access, 16 bit
+
+static const MT9D115_SCRIPT_T mt9d115_reset_script[] = {
+	MT9D115_SET_BITS(MT9D115_RST_CTRL_REG, 0x0001),
+	MT9D115_DELAY(10),
+	MT9D115_CLEAR_BITS(MT9D115_RST_CTRL_REG, 0x0001),
+};
+
+static const MT9D115_SCRIPT_T mt9d115_pll_yuv422_script[] = {
+	//PLL Control: BYPASS PLL = 8697
+	MT9D115_WRITE(MT9D115_PLL_CONTROL, 0x21F9),
+	// mipi timing for YUV422 (clk_txfifo_wr = 85/42.5Mhz; clk_txfifo_rd = 63.75Mhz)
+	// PLL Dividers = 277
+	MT9D115_WRITE(MT9D115_PLL_DIVIDERS, 0x0115),
+	// wcd = 8
+	MT9D115_WRITE(MT9D115_PLL_P_DIVIDERS, 0x00F5),
+	// PLL Control: TEST_BYPASS on = 9541
+	MT9D115_WRITE(MT9D115_PLL_CONTROL, 0x2545),
+	// PLL Control: PLL_ENABLE on = 9543
+	MT9D115_WRITE(MT9D115_PLL_CONTROL, 0x2547),
+	// PLL Control: SEL_LOCK_DET on
+	MT9D115_WRITE(MT9D115_PLL_CONTROL, 0x2447),
+	MT9D115_DELAY(10),
+	// PLL Control: PLL_BYPASS off
+	MT9D115_WRITE(MT9D115_PLL_CONTROL, 0x2047),
+	// PLL Control: TEST_BYPASS off
+	MT9D115_WRITE(MT9D115_PLL_CONTROL, 0x2046),
+};
+
+// RAW10 carries 10 instead of 16 bits per pixel over the single MIPI lane:
+// M = 32 raises the pixel clock from 42 to 64 MHz at 640 instead of 672 Mbps.
+// The receiver D-PHY keeps the fixed hsfreqrange of mipi_csi2_reset() (0x14,
+// the 800-850 Mbps band), which the YUV output at 672 Mbps already runs with.
+// RAW10 is 5% slower still; if mt9d115_sensorInit() reports D-PHY errors,
+// mxc_mipi_csi2.c needs the 600-650 Mbps band (0x10) for it.
+static const MT9D115_SCRIPT_T mt9d115_pll_bayer10_script[] = {
+	//PLL Control: BYPASS PLL = 8697
+	MT9D115_WRITE(MT9D115_PLL_CONTROL, 0x21F9),
+	// PLL Dividers = 288
+	MT9D115_WRITE(MT9D115_PLL_DIVIDERS, 0x0120),
+	// PLL P Dividers = 245
+	MT9D115_WRITE(MT9D115_PLL_P_DIVIDERS, 0x00F5),
+	// PLL Control: TEST_BYPASS on = 9541
+	MT9D115_WRITE(MT9D115_PLL_CONTROL, 0x2545),
+	// PLL Control: PLL_ENABLE on = 9543
+	MT9D115_WRITE(MT9D115_PLL_CONTROL, 0x2547),
+	// PLL Control: SEL_LOCK_DET on
+	MT9D115_WRITE(MT9D115_PLL_CONTROL, 0x2447),
+	MT9D115_DELAY(10),
+	// PLL Control: PLL_BYPASS off
+	MT9D115_WRITE(MT9D115_PLL_CONTROL, 0x2047),
+	// PLL Control: TEST_BYPASS off
+	MT9D115_WRITE(MT9D115_PLL_CONTROL, 0x2046),
+};
+
+// SOC2031_patch, uploaded to RAM address MT9D115_PATCH_ADDRESS
+static const u16 mt9d115_patch_code[] = {
+	0xF601, 0x42C1, 0x0326, 0x11F6, 0x0143, 0xC104, 0x260A, 0xCC04,
+	0x33BD, 0xA362, 0xBD04, 0x3339, 0xC6FF, 0xF701, 0x6439, 0xDE5D,
+	0x18CE, 0x0325, 0xCC00, 0x27BD, 0xC2B8, 0xCC04, 0xBDFD, 0x033B,
+	0xCC06, 0x6BFD, 0x032F, 0xCC03, 0x25DD, 0x5DC6, 0x1ED7, 0x6CD7,
+	0x6D5F, 0xD76E, 0xD78D, 0x8620, 0x977A, 0xD77B, 0x979A, 0xC621,
+	0xD79B, 0xFE01, 0x6918, 0xCE03, 0x4DCC, 0x0013, 0xBDC2, 0xB8CC,
+	0x05E9, 0xFD03, 0x4FCC, 0x034D, 0xFD01, 0x69FE, 0x02BD, 0x18CE,
+	0x0361, 0xCC00, 0x11BD, 0xC2B8, 0xCC06, 0x28FD, 0x036F, 0xCC03,
+	0x61FD, 0x02BD, 0xDE00, 0x18CE, 0x00C2, 0xCC00, 0x37BD, 0xC2B8,
+	0xCC06, 0x4FDD, 0xE6CC, 0x00C2, 0xDD00, 0xC601, 0xF701, 0x64C6,
+	0x05F7, 0x0165, 0x7F01, 0x6639, 0x373C, 0x3C3C, 0x3C3C, 0x30EC,
+	0x11ED, 0x02EC, 0x0FED, 0x008F, 0x30ED, 0x04EC, 0x0DEE, 0x04BD,
+	0xA406, 0x30EC, 0x02ED, 0x06FC, 0x10C0, 0x2705, 0xCCFF, 0xFFED,
+	0x06F6, 0x0256, 0x8616, 0x3DC3, 0x0261, 0x8FE6, 0x09C4, 0x07C1,
+	0x0226, 0x1DFC, 0x10C2, 0x30ED, 0x02FC, 0x10C0, 0xED00, 0xC602,
+	0xBDC2, 0x5330, 0xEC00, 0xFD10, 0xC0EC, 0x02FD, 0x10C2, 0x201B,
+	0xFC10, 0xC230, 0xED02, 0xFC10, 0xC0ED, 0x00C6, 0x01BD, 0xC253,
+	0x30EC, 0x00FD, 0x10C0, 0xEC02, 0xFD10, 0xC2C6, 0x80D7, 0x85C6,
+	0x40F7, 0x10C4, 0xF602, 0x5686, 0x163D, 0xC302, 0x618F, 0xEC14,
+	0xFD10, 0xC501, 0x0101, 0x0101, 0xFC10, 0xC2DD, 0x7FFC, 0x10C7,
+	0xDD76, 0xF602, 0x5686, 0x163D, 0xC302, 0x618F, 0xEC14, 0x939F,
+	0x30ED, 0x08DC, 0x7693, 0x9D25, 0x08F6, 0x02BC, 0x4F93, 0x7F23,
+	0x3DF6, 0x02BC, 0x4F93, 0x7F23, 0x06F6, 0x02BC, 0x4FDD, 0x7FDC,
+	0x9DDD, 0x76F6, 0x02BC, 0x4F93, 0x7F26, 0x0FE6, 0x0AC1, 0x0226,
+	0x09D6, 0x85C1, 0x8026, 0x0314, 0x7401, 0xF602, 0xBC4F, 0x937F,
+	0x2416, 0xDE7F, 0x09DF, 0x7F30, 0xEC08, 0xDD76, 0x200A, 0xDC76,
+	0xA308, 0x2304, 0xEC08, 0xDD76, 0x1274, 0x0122, 0xDE5D, 0xEE14,
+	0xAD00, 0x30ED, 0x11EC, 0x06ED, 0x02CC, 0x0080, 0xED00, 0x8F30,
+	0xED04, 0xEC11, 0xEE04, 0xBDA4, 0x0630, 0xE603, 0xD785, 0x30C6,
+	0x0B3A, 0x3539, 0x3C3C, 0x3C34, 0xCC32, 0x3EBD, 0xA558, 0x30ED,
+	0x04BD, 0xB2D7, 0x30E7, 0x06CC, 0x323E, 0xED00, 0xEC04, 0xBDA5,
+	0x44CC, 0x3244, 0xBDA5, 0x585F, 0x30ED, 0x02CC, 0x3244, 0xED00,
+	0xF601, 0xD54F, 0xEA03, 0xAA02, 0xBDA5, 0x4430, 0xE606, 0x3838,
+	0x3831, 0x39BD, 0xD661, 0xF602, 0xF4C1, 0x0126, 0x0BFE, 0x02BD,
+	0xEE10, 0xFC02, 0xF5AD, 0x0039, 0xF602, 0xF4C1, 0x0226, 0x0AFE,
+	0x02BD, 0xEE10, 0xFC02, 0xF7AD, 0x0039, 0x3CBD, 0xB059, 0xCC00,
+	0x28BD, 0xA558, 0x8300, 0x0027, 0x0BCC, 0x0026, 0x30ED, 0x00C6,
+	0x03BD, 0xA544, 0x3839, 0xBDD9, 0x42D6, 0x9ACB, 0x01D7, 0x9B39,
+};
+
+static const MT9D115_SCRIPT_T mt9d115_patch_script[] = {
+	// hard coded start address of the patch at "patchSetup"
+	MT9D115_VAR(0x2006, MT9D115_PATCH_ADDRESS),
+	// execute the patch
+	MT9D115_VAR(0xA005, 0x1),
+	// wait for the patch to complete initialization
+	// POLL_FIELD=MON_PATCH_ID_0,==0,DELAY=10,TIMEOUT=100
+	MT9D115_POLL_VAR_NOT(0xA024, 0x0000),
+};
+
+static const MT9D115_SCRIPT_T mt9d115_gamma_script[] = {
+	// Set to automatic mode VAR(0x0B,0x0037)
+	MT9D115_VAR(0xAB37, 3),
+	// HG_GAMMASTARTMORPH @ 100 lux VAR(0x0B,0x0038)
+	MT9D115_VAR(0x2B38, 10600),
+	// HG_GAMMASTOPMORPH @ 20 lux VAR(0x0B,0x003A)
+	MT9D115_VAR(0x2B3A, 11600),
+	// Fade-To-Black: disabled VAR(0x0B,0x0062)
+	MT9D115_VAR(0x2B62, 0xFFFE),
+	// Disable FTB VAR(0x0B,0x0064)
+	MT9D115_VAR(0x2B64, 0xFFFF),
+};
+
+static const MT9D115_SCRIPT_T mt9d115_standby_exit_script[] = {
+	// wait for R20B to come out of standby
+	MT9D115_POLL(MT9D115_CTRL_STATUS, 0x4000, 0x0000),
+};
+
+static const MT9D115_SCRIPT_T mt9d115_refresh_script[] = {
+	// SEQ_CMD: refresh, picks up new gamma and CCM values
+	MT9D115_VAR(0xA103, 0x05),
+};
+
+static const MT9D115_SCRIPT_T mt9d115_init_script[] = {
+	// MCU Powerup Stop Enable
+	// set powerup stop bit
+	MT9D115_SET_BITS(MT9D115_CTRL_STATUS, 0x0004),
+	// start MCU, includes wait for standby_done to clear
+	// release MCU from standby
+	// GO
+	MT9D115_CLEAR_BITS(MT9D115_CTRL_STATUS, 0x0001),
+	// wait for R20B to come out of standby
+	MT9D115_POLL(MT9D115_CTRL_STATUS, 0x4000, 0x0000),
+
+	// sensor core & flicker timings
+	// MT9D115 (SOC2031) Register Wizard Defaults: Sensor Core Timing 4 MIPI
+	// Preview : Output width VAR(7,0x03)
+	MT9D115_VAR(0x2703, MT9D115_PREVIEW_WIDTH),
+	// Preview : Output height VAR(7,0x05)
+	MT9D115_VAR(0x2705, MT9D115_PREVIEW_HEIGHT),
+	// Capture : Output width VAR(7,0x07)
+	MT9D115_VAR(0x2707, MT9D115_CAPTURE_WIDTH),
+	// Capture : Output height VAR(7,0x09)
+	MT9D115_VAR(0x2709, MT9D115_CAPTURE_HEIGHT),
+	// Row Start (A) = 0, VAR(7,0xD)
+	MT9D115_VAR(0x270D, 0x0000),
+	// Column Start (A) = 0, VAR(7,0xF)
+	MT9D115_VAR(0x270F, 0x0000),
+	// Row End (A) = 1213, VAR(7,0x11)
+	MT9D115_VAR(0x2711, 0x4BD),
+	// Column End (A) = 1613, VAR(7,0x13)
+	MT9D115_VAR(0x2713, 0x64D),
+	// Row Speed (A) = 273, VAR(7,0x15)
+	MT9D115_VAR(0x2715, 0x0111),
+	// Read Mode (A) = 1132, VAR(7,0x17)
+	MT9D115_VAR(0x2717, 0x046C),
+	// Sensor_fine_correction (A) = 90, VAR(7,0x19)
+	MT9D115_VAR(0x2719, 0x005A),
+	// Sensor_fine_IT_min (A) = 446, VAR(7,0x1B)
+	MT9D115_VAR(0x271B, 0x01BE),
+	// sensor_fine_IT_max_margin (A) = 305, VAR(7,0x1D)
+	MT9D115_VAR(0x271D, 0x0131),
+	// mipi timing
+	// Frame Lines (A) = 699, VAR(7,0x1F)
+	MT9D115_VAR(0x271F, 0x02BB),
+	// Line Length (A) = 2184, VAR(7,0x21)
+	MT9D115_VAR(0x2721, 0x0888),
+	// Row Start (B) = 4, VAR(7,0x23)
+	MT9D115_VAR(0x2723, 0x004),
+	// Column Start (B) = 4, VAR(7,0x25)
+	MT9D115_VAR(0x2725, 0x004),
+	// Row End (B) = 1211, VAR(7,0x27)
+	MT9D115_VAR(0x2727, 0x4BB),
+	// Column End (B) = 1611, VAR(7,0x29)
+	MT9D115_VAR(0x2729, 0x64B),
+	// Row Speed (B) = 273, VAR(7,0x2B)
+	MT9D115_VAR(0x272B, 0x0111),
+	// Read Mode (B) = 36, VAR(7,0x2D)
+	MT9D115_VAR(0x272D, 0x0024),
+	// sensor_fine_correction (B) = 58, VAR(7,0x2F)
+	MT9D115_VAR(0x272F, 0x003A),
+	// sensor_fine_IT_min (B) = 246, VAR(7,0x31)
+	MT9D115_VAR(0x2731, 0x00F6),
+	// sensor_fine_IT_max_margin (B) = 139, VAR(7,0x33)
+	MT9D115_VAR(0x2733, 0x008B),
+	// mipi timing
+	// Frame Lines (B) = 1313, VAR(7,0x35)
+	MT9D115_VAR(0x2735, 0x0521),
+	// Sensor Lines Length (B) = 0x0888, VAR(7,0x37)
+	MT9D115_VAR(0x2737, 0x0888),
+	// Crop_X0 (A) = 0, VAR(7,0x39)
+	MT9D115_VAR(0x2739, 0x0000),
+	// Crop_X1 (A) = 799, VAR(7,0x3B)
+	MT9D115_VAR(0x273B, 0x031F),
+	// Crop_Y0 (A) = 0, VAR(7,0x3D)
+	MT9D115_VAR(0x273D, 0x0000),
+	// Crop_Y1 (A) = 599, VAR(7,0x3F)
+	MT9D115_VAR(0x273F, 0x0257),
+	// Crop_X0 (B) = 0, VAR(7,0x47)
+	MT9D115_VAR(0x2747, 0x0000),
+	// Crop_X1 (B) = 1599, VAR(7,0x49)
+	MT9D115_VAR(0x2749, 0x063F),
+	// Crop_Y0 (B) = 0, VAR(7,0x4B)
+	MT9D115_VAR(0x274B, 0x0000),
+	// Crop_Y1 (B) = 1199, VAR(7,0x4D)
+	MT9D115_VAR(0x274D, 0x04AF),
+	// mipi timing
+	// R9 Step = 160, VAR(2,0x2D)
+	MT9D115_VAR(0x222D, 0x00A0),
+	// search_f1_50 = 38, VAR(4,0x08)
+	MT9D115_VAR(0xA408, 0x26),
+	// search_f2_50 = 41, VAR(4,0x09)
+	MT9D115_VAR(0xA409, 0x29),
+	// search_f1_60 = 46, VAR(4,0x0A)
+	MT9D115_VAR(0xA40A, 0x2E),
+	// search_f2_60 = 49, VAR(4,0x0B)
+	MT9D115_VAR(0xA40B, 0x31),
+	// R9_Step_60 (A) = 160, VAR(4,0x11)
+	MT9D115_VAR(0x2411, 0x00A0),
+	// R9_Step_50 (A) = 192, VAR(4,0x13)
+	MT9D115_VAR(0x2413, 0x00C0),
+	// R9_Step_60 (B) = 160, VAR(4,0x15)
+	MT9D115_VAR(0x2415, 0x00A0),
+	// R9_Step_50 (B) = 192, VAR(4,0x17)
+	MT9D115_VAR(0x2417, 0x00C0),
+	// FD Mode = 16, VAR(4,0x04)
+	MT9D115_VAR(0xA404, 0x10),
+	// Stat_min = 2, VAR(4,0x0D)
+	MT9D115_VAR(0xA40D, 0x02),
+	// Stat_max = 3, VAR(4,0x0E)
+	MT9D115_VAR(0xA40E, 0x03),
+	// Min_amplitude = 10, VAR(4,0x10)
+	MT9D115_VAR(0xA410, 0x0A),
+	// AE settings
+	// Do the rest of the basic initialization.
+	// preview ENTER: average luma = 2, VAR(1,0x17)
+	MT9D115_VAR(0xA117, 0x02),
+	// preview: average luma = 2 VAR(1,0x001D)
+	MT9D115_VAR(0xA11D, 0x02),
+	// capture: average luma = 2, VAR(1,0x0029)
+	MT9D115_VAR(0xA129, 0x02),
+	// AE_BASETARGET = 50, VAR(2, 0x004F)
+	MT9D115_VAR(0xA24F, 0x32),
+	// AE_MAX_INDEX = 16, VAR(2, 0x000C)
+	MT9D115_VAR(0xA20C, 0x10),
+	// MCU_ADDRESS [AE_MAXGAIN23]
+	// ae_max_gain23 has to be less than or equal to ae_max_virtgain
+	MT9D115_VAR(0xA216, 0x0091),
+	// ae.maxvirtgain = 255 is the max. analog green gain
+	// ae.maxvirtgain * (B/G) <= 255 in order to prevent the analog blue gain from overflow
+	// under A light WB tuning, the max. (B/G) is 1.750, hence, ae.maxvirtgain <= 145
+	// figure out the max. analog green gain to get WB in virtual units (16 virtual units = 1 analog unit)
+	// VAR(2,0x000E), 0x91
+	MT9D115_VAR(0xA20E, 0x91),
+	//ae_max_dgain_ae1 = (494 -> 174 -> 164) in order to reduce CFPN
+	// VAR(2,0x0012)
+	MT9D115_VAR(0x2212, 0x00A4),
+
+	// Lens Correction
+	// Note: this LSC is generated manually for this part - DO NOT USE the "FACTORY" label
+	// LOAD_PROM=0xA8, PGA   // load the PGA from the Demo2 on-board EEPROM
+	// PGA_ENABLE
+	MT9D115_SET_BITS(0x3210, 0x0008),
+};
+
+static const MT9D115_SCRIPT_T mt9d115_preview_script[] = {
+	// continue after powerup stop
+	// clear powerup stop bit
+	MT9D115_CLEAR_BITS(MT9D115_CTRL_STATUS, 0x0004),
+	// wait for sequencer to enter preview state
+	// POLL_FIELD=SEQ_STATE,!=3,DELAY=10,TIMEOUT=100
+	MT9D115_POLL_VAR(0xA104, 3),
+	// syncronize the FW with the sensor
+	MT9D115_VAR(0xA103, 0x06),
+};
+
+static const MT9D115_SCRIPT_T mt9d115_seq_preview_script[] = {
+	// SEQ_CMD: go to preview
+	MT9D115_VAR(MT9D115_VAR_SEQ_CMD, MT9D115_SEQ_CMD_PREVIEW),
+	MT9D115_POLL_VAR(MT9D115_VAR_SEQ_STATE, MT9D115_SEQ_STATE_PREVIEW),
+};
+
+static const MT9D115_SCRIPT_T mt9d115_seq_video_script[] = {
+	// SEQ_CAP_MODE: stay in capture until the next preview command
+	MT9D115_VAR(MT9D115_VAR_SEQ_CAP_MODE, MT9D115_SEQ_CAP_MODE_VIDEO),
+	// SEQ_CMD: go to capture
+	MT9D115_VAR(MT9D115_VAR_SEQ_CMD, MT9D115_SEQ_CMD_CAPTURE),
+	MT9D115_POLL_VAR(MT9D115_VAR_SEQ_STATE, MT9D115_SEQ_STATE_CAPTURE),
+};
+
+static const MT9D115_SCRIPT_T mt9d115_bayer10_script[] = {
+	// raw Bayer, 10 bit, out of both contexts
+	MT9D115_VAR(MT9D115_VAR_OUTPUT_FORMAT_A, MT9D115_OUTPUT_FORMAT_BAYER | MT9D115_OUTPUT_FORMAT_BAYER_10),
+	MT9D115_VAR(MT9D115_VAR_OUTPUT_FORMAT_B, MT9D115_OUTPUT_FORMAT_BAYER | MT9D115_OUTPUT_FORMAT_BAYER_10),
+	// flicker steps for the 64 MHz pixel clock, rows per 1/120 s and 1/100 s
+	// R9 Step = 244, VAR(2,0x2D)
+	MT9D115_VAR(0x222D, 0x00F4),
+	// R9_Step_60 (A) = 244, VAR(4,0x11)
+	MT9D115_VAR(0x2411, 0x00F4),
+	// R9_Step_50 (A) = 293, VAR(4,0x13)
+	MT9D115_VAR(0x2413, 0x0125),
+	// R9_Step_60 (B) = 244, VAR(4,0x15)
+	MT9D115_VAR(0x2415, 0x00F4),
+	// R9_Step_50 (B) = 293, VAR(4,0x17)
+	MT9D115_VAR(0x2417, 0x0125),
+};
+
+#endif
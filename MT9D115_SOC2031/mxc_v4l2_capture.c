@@ -44,6 +44,17 @@
 #define init_MUTEX(sem)         sema_init(sem, 1)
 #define MXC_SENSOR_NUM 2
 
+/*!
+ * Private slave ioctl: blocks until the sensor configuration that the
+ * slave runs asynchronously from probe or dev_init has finished and
+ * returns its result. Slaves that configure synchronously do not
+ * implement it.
+ */
+enum {
+	vidioc_int_wait_init_num = vidioc_int_priv_start_num,
+};
+V4L2_INT_WRAPPER_0(wait_init);
+
 static int video_nr = -1;
 
 /*! This data is used for the output to the display. */
@@ -389,35 +400,88 @@ static inline int valid_mode(u32 palette)
 		(palette == V4L2_PIX_FMT_UYVY) ||
 		(palette == V4L2_PIX_FMT_YUYV) ||
 		(palette == V4L2_PIX_FMT_YUV420) ||
-		(palette == V4L2_PIX_FMT_NV12));
+		(palette == V4L2_PIX_FMT_NV12) ||
+		(palette == V4L2_PIX_FMT_SGRBG10));
 }
 
 /*!
- * Start the encoder job
+ * Bytes per line and size of a capture buffer
+ *
+ * @param pix            structure v4l2_pix_format *, format and size
+ * @param bytesperline   returns the bytes per line
+ *
+ * @return size of the image, 0 for an unknown format
+ */
+static int mxc_v4l2_image_size(struct v4l2_pix_format *pix, int *bytesperline)
+{
+	int size = 0;
+
+	*bytesperline = 0;
+
+	switch (pix->pixelformat) {
+	case V4L2_PIX_FMT_RGB565:
+		size = pix->width * pix->height * 2;
+		*bytesperline = pix->width * 2;
+		break;
+	case V4L2_PIX_FMT_BGR24:
+		size = pix->width * pix->height * 3;
+		*bytesperline = pix->width * 3;
+		break;
+	case V4L2_PIX_FMT_RGB24:
+		size = pix->width * pix->height * 3;
+		*bytesperline = pix->width * 3;
+		break;
+	case V4L2_PIX_FMT_BGR32:
+		size = pix->width * pix->height * 4;
+		*bytesperline = pix->width * 4;
+		break;
+	case V4L2_PIX_FMT_RGB32:
+		size = pix->width * pix->height * 4;
+		*bytesperline = pix->width * 4;
+		break;
+	case V4L2_PIX_FMT_YUV422P:
+		size = pix->width * pix->height * 2;
+		*bytesperline = pix->width;
+		break;
+	case V4L2_PIX_FMT_UYVY:
+	case V4L2_PIX_FMT_YUYV:
+		size = pix->width * pix->height * 2;
+		*bytesperline = pix->width * 2;
+		break;
+	case V4L2_PIX_FMT_YUV420:
+		size = pix->width * pix->height * 3 / 2;
+		*bytesperline = pix->width;
+		break;
+	case V4L2_PIX_FMT_NV12:
+		size = pix->width * pix->height * 3 / 2;
+		*bytesperline = pix->width;
+		break;
+	case V4L2_PIX_FMT_SGRBG10:
+		/* 10 bit samples in 16 bit words, IPU_PIX_FMT_GENERIC_16 */
+		size = pix->width * pix->height * 2;
+		*bytesperline = pix->width * 2;
+		break;
+	default:
+		break;
+	}
+
+	return size;
+}
+
+/*!
+ * Start the encoder job on the queued buffers, for STREAMON and after
+ * mxc_capture_pause()
  *
  * @param cam      structure cam_data *
  *
  * @return status  0 Success
  */
-static int mxc_streamon(cam_data *cam)
+static int mxc_capture_start(cam_data *cam)
 {
 	struct mxc_v4l_frame *frame;
 	unsigned long lock_flags;
 	int err = 0;
 
-	pr_debug("In MVC:mxc_streamon\n");
-
-	if (NULL == cam) {
-		pr_err("ERROR! cam parameter is NULL\n");
-		return -1;
-	}
-
-	if (cam->capture_on) {
-		pr_err("ERROR: v4l2 capture: Capture stream has been turned "
-		       " on\n");
-		return -1;
-	}
-
 	if (list_empty(&cam->ready_q)) {
 		pr_err("ERROR: v4l2 capture: mxc_streamon buffer has not been "
 			"queued yet\n");
@@ -481,6 +545,40 @@ static int mxc_streamon(cam_data *cam)
 	return err;
 }
 
+/*!
+ * Start the encoder job
+ *
+ * @param cam      structure cam_data *
+ *
+ * @return status  0 Success
+ */
+static int mxc_streamon(cam_data *cam)
+{
+	int err = 0;
+
+	pr_debug("In MVC:mxc_streamon\n");
+
+	if (NULL == cam) {
+		pr_err("ERROR! cam parameter is NULL\n");
+		return -1;
+	}
+
+	if (cam->capture_on) {
+		pr_err("ERROR: v4l2 capture: Capture stream has been turned "
+		       " on\n");
+		return -1;
+	}
+
+	/* the sensor may still be running its initialization */
+	err = vidioc_int_wait_init(cam->sensor);
+	if (err && err != -ENOIOCTLCMD) {
+		pr_err("ERROR: v4l2 capture: sensor initialization failed\n");
+		return err;
+	}
+
+	return mxc_capture_start(cam);
+}
+
 /*!
  * Shut down the encoder job
  *
@@ -519,9 +617,103 @@ static int mxc_streamoff(cam_data *cam)
 	mxc_free_frames(cam);
 	mxc_capture_inputs[cam->current_input].status |= V4L2_IN_ST_NO_POWER;
 	cam->capture_on = false;
+
+	/* pollers see the stream going off */
+	wake_up_interruptible(&cam->enc_queue);
 	return err;
 }
 
+/*!
+ * Stop the encoder job but keep the buffers, for a sensor mode switch
+ * while streaming. The buffers held by the IPU and the frames completed
+ * in the old mode go back to the front of the ready queue, so the first
+ * frame dequeued after mxc_capture_start() is one of the new mode. The
+ * stream stays on for poll() meanwhile.
+ *
+ * @param cam      structure cam_data *
+ *
+ * @return status  0 Success
+ */
+static int mxc_capture_pause(cam_data *cam)
+{
+	struct mxc_v4l_frame *frame;
+	unsigned long lock_flags;
+	int err = 0;
+
+	pr_debug("In MVC:mxc_capture_pause\n");
+
+	if (cam->enc_disable_csi) {
+		err = cam->enc_disable_csi(cam);
+		if (err != 0)
+			return err;
+	}
+	if (cam->enc_disable) {
+		err = cam->enc_disable(cam);
+		if (err != 0)
+			return err;
+	}
+
+	spin_lock_irqsave(&cam->queue_int_lock, lock_flags);
+	spin_lock(&cam->dqueue_int_lock);
+	while (!list_empty(&cam->done_q)) {
+		frame = list_entry(cam->done_q.prev, struct mxc_v4l_frame,
+				   queue);
+		frame->buffer.flags &= ~V4L2_BUF_FLAG_DONE;
+		frame->buffer.flags |= V4L2_BUF_FLAG_QUEUED;
+		list_move(&frame->queue, &cam->ready_q);
+	}
+	list_splice_init(&cam->working_q, &cam->ready_q);
+	cam->enc_counter = 0;
+	spin_unlock(&cam->dqueue_int_lock);
+	spin_unlock_irqrestore(&cam->queue_int_lock, lock_flags);
+
+	return err;
+}
+
+/*!
+ * Fit the capture format to a new sensor output before the stream goes
+ * on again. The CSI MEM input stores the sensor frame as it is, so its
+ * size follows the crop rectangle and has to fit into the buffers that
+ * are already mapped. The IC of the CSI IC MEM input keeps the output
+ * size and only has to stay within its downscaling limit.
+ *
+ * @param cam      structure cam_data *
+ *
+ * @return status  0 Success, EINVAL the buffers do not fit
+ */
+static int mxc_capture_resize(cam_data *cam)
+{
+	struct v4l2_pix_format pix = cam->v2f.fmt.pix;
+	int size, bytesperline;
+
+	if (strcmp(mxc_capture_inputs[cam->current_input].name,
+		   "CSI MEM") != 0) {
+		if (cam->crop_current.width > 8 * pix.width ||
+		    cam->crop_current.height > 8 * pix.height) {
+			pr_err("ERROR: v4l2 capture: %dx%d can not be "
+			       "resized to %dx%d\n",
+			       cam->crop_current.width,
+			       cam->crop_current.height,
+			       pix.width, pix.height);
+			return -EINVAL;
+		}
+		return 0;
+	}
+
+	pix.width = cam->crop_current.width;
+	pix.height = cam->crop_current.height;
+	size = mxc_v4l2_image_size(&pix, &bytesperline);
+	if (size > cam->frame[0].buffer.length) {
+		pr_err("ERROR: v4l2 capture: %dx%d needs buffers of %d "
+		       "bytes\n", pix.width, pix.height, size);
+		return -EINVAL;
+	}
+	pix.bytesperline = bytesperline;
+	pix.sizeimage = size;
+	cam->v2f.fmt.pix = pix;
+	return 0;
+}
+
 /*!
  * Valid and adjust the overlay window size, position
  *
@@ -796,6 +988,100 @@ static int mxc_v4l2_g_fmt(cam_data *cam, struct v4l2_format *f)
 	return retval;
 }
 
+/*!
+ * Programs the CSI for the current output of the sensor: data width,
+ * sync polarities, pixel format and size. The current crop size follows
+ * the new bounds.
+ *
+ * @param cam      structure cam_data *
+ */
+static void mxc_v4l2_csi_update(cam_data *cam)
+{
+	struct v4l2_ifparm ifparm;
+	struct v4l2_format cam_fmt;
+	ipu_csi_signal_cfg_t csi_param;
+
+	/* Get new values. */
+	vidioc_int_g_ifparm(cam->sensor, &ifparm);
+
+	csi_param.data_width = 0;
+	csi_param.clk_mode = 0;
+	csi_param.ext_vsync = 0;
+	csi_param.Vsync_pol = 0;
+	csi_param.Hsync_pol = 0;
+	csi_param.pixclk_pol = 0;
+	csi_param.data_pol = 0;
+	csi_param.sens_clksrc = 0;
+	csi_param.pack_tight = 0;
+	csi_param.force_eof = 0;
+	csi_param.data_en_pol = 0;
+	csi_param.data_fmt = 0;
+	csi_param.csi = cam->csi;
+	csi_param.mclk = 0;
+
+	/*This may not work on other platforms. Check when adding a new one.*/
+	/*The mclk clock was never set correclty in the ipu register*/
+	/*for now we are going to use this mclk as pixel clock*/
+	/*to set csi0_data_dest register.*/
+	/*This is a workaround which should be fixed*/
+	pr_debug("   clock_curr=mclk=%d\n", ifparm.u.bt656.clock_curr);
+	if (ifparm.u.bt656.clock_curr == 0) {
+		csi_param.clk_mode = IPU_CSI_CLK_MODE_CCIR656_INTERLACED;
+		/*protocol bt656 use 27Mhz pixel clock */
+		csi_param.mclk = 27000000;
+	} else {
+		csi_param.clk_mode = IPU_CSI_CLK_MODE_GATED_CLK;
+	}
+
+	csi_param.pixclk_pol = ifparm.u.bt656.latch_clk_inv;
+
+	if (ifparm.u.bt656.mode == V4L2_IF_TYPE_BT656_MODE_NOBT_8BIT) {
+		csi_param.data_width = IPU_CSI_DATA_WIDTH_8;
+	} else if (ifparm.u.bt656.mode
+				== V4L2_IF_TYPE_BT656_MODE_NOBT_10BIT) {
+		csi_param.data_width = IPU_CSI_DATA_WIDTH_10;
+	} else {
+		csi_param.data_width = IPU_CSI_DATA_WIDTH_8;
+	}
+
+	csi_param.Vsync_pol = ifparm.u.bt656.nobt_vs_inv;
+	csi_param.Hsync_pol = ifparm.u.bt656.nobt_hs_inv;
+	csi_param.ext_vsync = ifparm.u.bt656.bt_sync_correct;
+
+	/* if the capturemode changed, the size bounds will have changed. */
+	cam_fmt.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+	vidioc_int_g_fmt_cap(cam->sensor, &cam_fmt);
+	pr_debug("   g_fmt_cap returns widthxheight of input as %d x %d\n",
+			cam_fmt.fmt.pix.width, cam_fmt.fmt.pix.height);
+
+	csi_param.data_fmt = cam_fmt.fmt.pix.pixelformat;
+
+	cam->crop_bounds.top = cam->crop_bounds.left = 0;
+	cam->crop_bounds.width = cam_fmt.fmt.pix.width;
+	cam->crop_bounds.height = cam_fmt.fmt.pix.height;
+
+	/*
+	 * Set the default current cropped resolution to be the same with
+	 * the cropping boundary(except for tvin module).
+	 */
+	if (cam->device_type != 1) {
+		cam->crop_current.width = cam->crop_bounds.width;
+		cam->crop_current.height = cam->crop_bounds.height;
+	}
+
+	/* This essentially loses the data at the left and bottom of the image
+	 * giving a digital zoom image, if crop_current is less than the full
+	 * size of the image. */
+	ipu_csi_set_window_size(cam->ipu, cam->crop_current.width,
+				cam->crop_current.height, cam->csi);
+	ipu_csi_set_window_pos(cam->ipu, cam->crop_current.left,
+			       cam->crop_current.top,
+			       cam->csi);
+	ipu_csi_init_interface(cam->ipu, cam->crop_bounds.width,
+			       cam->crop_bounds.height,
+			       cam_fmt.fmt.pix.pixelformat, csi_param);
+}
+
 /*!
  * V4L2 - mxc_v4l2_s_fmt function
  *
@@ -823,6 +1109,35 @@ static int mxc_v4l2_s_fmt(cam_data *cam, struct v4l2_format *f)
 			return -EINVAL;
 		}
 
+		/*
+		 * The pixel format selects the output of the sensor, e.g.
+		 * Bayer RAW10 for V4L2_PIX_FMT_SGRBG10. If it changes, the
+		 * MIPI host and the sensor are set up again and the CSI
+		 * follows.
+		 */
+		if (!cam->capture_on) {
+			struct v4l2_format cam_fmt;
+			u32 bus_fmt;
+
+			cam_fmt.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+			vidioc_int_g_fmt_cap(cam->sensor, &cam_fmt);
+			bus_fmt = cam_fmt.fmt.pix.pixelformat;
+
+			cam_fmt = *f;
+			retval = vidioc_int_s_fmt_cap(cam->sensor, &cam_fmt);
+			if (retval && retval != -ENOIOCTLCMD)
+				return retval;
+			retval = 0;
+
+			vidioc_int_g_fmt_cap(cam->sensor, &cam_fmt);
+			if (cam_fmt.fmt.pix.pixelformat != bus_fmt) {
+				vidioc_int_dev_init(cam->sensor);
+				cam->crop_current.top = 0;
+				cam->crop_current.left = 0;
+				mxc_v4l2_csi_update(cam);
+			}
+		}
+
 		/*
 		 * Force the capture window resolution to be crop bounds
 		 * for CSI MEM input mode.
@@ -873,47 +1188,7 @@ static int mxc_v4l2_s_fmt(cam_data *cam, struct v4l2_format *f)
 			       *height);
 		}
 
-		switch (f->fmt.pix.pixelformat) {
-		case V4L2_PIX_FMT_RGB565:
-			size = f->fmt.pix.width * f->fmt.pix.height * 2;
-			bytesperline = f->fmt.pix.width * 2;
-			break;
-		case V4L2_PIX_FMT_BGR24:
-			size = f->fmt.pix.width * f->fmt.pix.height * 3;
-			bytesperline = f->fmt.pix.width * 3;
-			break;
-		case V4L2_PIX_FMT_RGB24:
-			size = f->fmt.pix.width * f->fmt.pix.height * 3;
-			bytesperline = f->fmt.pix.width * 3;
-			break;
-		case V4L2_PIX_FMT_BGR32:
-			size = f->fmt.pix.width * f->fmt.pix.height * 4;
-			bytesperline = f->fmt.pix.width * 4;
-			break;
-		case V4L2_PIX_FMT_RGB32:
-			size = f->fmt.pix.width * f->fmt.pix.height * 4;
-			bytesperline = f->fmt.pix.width * 4;
-			break;
-		case V4L2_PIX_FMT_YUV422P:
-			size = f->fmt.pix.width * f->fmt.pix.height * 2;
-			bytesperline = f->fmt.pix.width;
-			break;
-		case V4L2_PIX_FMT_UYVY:
-		case V4L2_PIX_FMT_YUYV:
-			size = f->fmt.pix.width * f->fmt.pix.height * 2;
-			bytesperline = f->fmt.pix.width * 2;
-			break;
-		case V4L2_PIX_FMT_YUV420:
-			size = f->fmt.pix.width * f->fmt.pix.height * 3 / 2;
-			bytesperline = f->fmt.pix.width;
-			break;
-		case V4L2_PIX_FMT_NV12:
-			size = f->fmt.pix.width * f->fmt.pix.height * 3 / 2;
-			bytesperline = f->fmt.pix.width;
-			break;
-		default:
-			break;
-		}
+		size = mxc_v4l2_image_size(&f->fmt.pix, &bytesperline);
 
 		if (f->fmt.pix.bytesperline < bytesperline) {
 			f->fmt.pix.bytesperline = bytesperline;
@@ -1303,11 +1578,9 @@ static int mxc_v4l2_s_ctrl(cam_data *cam, struct v4l2_control *c)
  */
 static int mxc_v4l2_s_param(cam_data *cam, struct v4l2_streamparm *parm)
 {
-	struct v4l2_ifparm ifparm;
-	struct v4l2_format cam_fmt;
 	struct v4l2_streamparm currentparm;
-	ipu_csi_signal_cfg_t csi_param;
 	u32 current_fps, parm_fps;
+	bool paused = false;
 	int err = 0;
 
 	pr_debug("In mxc_v4l2_s_param\n");
@@ -1345,96 +1618,49 @@ static int mxc_v4l2_s_param(cam_data *cam, struct v4l2_streamparm *parm)
 	pr_debug("   Current framerate is %d  change to %d\n",
 			current_fps, parm_fps);
 
+	/*
+	 * A running capture is only paused around the mode switch, e.g.
+	 * from preview to a snapshot. The buffers stay mapped and queued.
+	 */
+	if (cam->capture_on) {
+		err = mxc_capture_pause(cam);
+		if (err)
+			goto exit;
+		paused = true;
+	}
+
 	/* This will change any camera settings needed. */
 	err = vidioc_int_s_parm(cam->sensor, parm);
 	if (err) {
 		pr_err("%s: vidioc_int_s_parm returned an error %d\n",
 			__func__, err);
-		goto exit;
+		goto resume;
 	}
 
 	/* If resolution changed, need to re-program the CSI */
-	/* Get new values. */
-	vidioc_int_g_ifparm(cam->sensor, &ifparm);
-
-	csi_param.data_width = 0;
-	csi_param.clk_mode = 0;
-	csi_param.ext_vsync = 0;
-	csi_param.Vsync_pol = 0;
-	csi_param.Hsync_pol = 0;
-	csi_param.pixclk_pol = 0;
-	csi_param.data_pol = 0;
-	csi_param.sens_clksrc = 0;
-	csi_param.pack_tight = 0;
-	csi_param.force_eof = 0;
-	csi_param.data_en_pol = 0;
-	csi_param.data_fmt = 0;
-	csi_param.csi = cam->csi;
-	csi_param.mclk = 0;
-
-	/*This may not work on other platforms. Check when adding a new one.*/
-	/*The mclk clock was never set correclty in the ipu register*/
-	/*for now we are going to use this mclk as pixel clock*/
-	/*to set csi0_data_dest register.*/
-	/*This is a workaround which should be fixed*/
-	pr_debug("   clock_curr=mclk=%d\n", ifparm.u.bt656.clock_curr);
-	if (ifparm.u.bt656.clock_curr == 0) {
-		csi_param.clk_mode = IPU_CSI_CLK_MODE_CCIR656_INTERLACED;
-		/*protocol bt656 use 27Mhz pixel clock */
-		csi_param.mclk = 27000000;
-	} else {
-		csi_param.clk_mode = IPU_CSI_CLK_MODE_GATED_CLK;
-	}
-
-	csi_param.pixclk_pol = ifparm.u.bt656.latch_clk_inv;
+	mxc_v4l2_csi_update(cam);
 
-	if (ifparm.u.bt656.mode == V4L2_IF_TYPE_BT656_MODE_NOBT_8BIT) {
-		csi_param.data_width = IPU_CSI_DATA_WIDTH_8;
-	} else if (ifparm.u.bt656.mode
-				== V4L2_IF_TYPE_BT656_MODE_NOBT_10BIT) {
-		csi_param.data_width = IPU_CSI_DATA_WIDTH_10;
-	} else {
-		csi_param.data_width = IPU_CSI_DATA_WIDTH_8;
+	if (paused) {
+		err = mxc_capture_resize(cam);
+		if (err) {
+			/* the buffers do not fit, back to the old mode */
+			vidioc_int_s_parm(cam->sensor, &currentparm);
+			mxc_v4l2_csi_update(cam);
+		}
 	}
 
-	csi_param.Vsync_pol = ifparm.u.bt656.nobt_vs_inv;
-	csi_param.Hsync_pol = ifparm.u.bt656.nobt_hs_inv;
-	csi_param.ext_vsync = ifparm.u.bt656.bt_sync_correct;
-
-	/* if the capturemode changed, the size bounds will have changed. */
-	cam_fmt.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-	vidioc_int_g_fmt_cap(cam->sensor, &cam_fmt);
-	pr_debug("   g_fmt_cap returns widthxheight of input as %d x %d\n",
-			cam_fmt.fmt.pix.width, cam_fmt.fmt.pix.height);
-
-	csi_param.data_fmt = cam_fmt.fmt.pix.pixelformat;
-
-	cam->crop_bounds.top = cam->crop_bounds.left = 0;
-	cam->crop_bounds.width = cam_fmt.fmt.pix.width;
-	cam->crop_bounds.height = cam_fmt.fmt.pix.height;
-
-	/*
-	 * Set the default current cropped resolution to be the same with
-	 * the cropping boundary(except for tvin module).
-	 */
-	if (cam->device_type != 1) {
-		cam->crop_current.width = cam->crop_bounds.width;
-		cam->crop_current.height = cam->crop_bounds.height;
+resume:
+	/* If this fails, the stream stays off until the next STREAMON */
+	if (paused) {
+		int ret = mxc_capture_start(cam);
+		if (ret) {
+			cam->capture_on = false;
+			wake_up_interruptible(&cam->enc_queue);
+		}
+		if (!err)
+			err = ret;
 	}
 
-	/* This essentially loses the data at the left and bottom of the image
-	 * giving a digital zoom image, if crop_current is less than the full
-	 * size of the image. */
-	ipu_csi_set_window_size(cam->ipu, cam->crop_current.width,
-				cam->crop_current.height, cam->csi);
-	ipu_csi_set_window_pos(cam->ipu, cam->crop_current.left,
-			       cam->crop_current.top,
-			       cam->csi);
-	ipu_csi_init_interface(cam->ipu, cam->crop_bounds.width,
-			       cam->crop_bounds.height,
-			       cam_fmt.fmt.pix.pixelformat, csi_param);
-
-
 exit:
 	if (cam->overlay_on == true)
 		start_preview(cam);
@@ -2486,24 +2712,29 @@ static int mxc_mmap(struct file *file, struct vm_area_struct *vma)
  *
  * @param wait       structure poll_table_struct *
  *
- * @return  status   POLLIN | POLLRDNORM
+ * Readable once a frame has completed, POLLERR while the stream is off.
+ * The camera callback wakes the queue once per completed frame. Does not
+ * take busy_lock, so a poll never waits for an ioctl in progress.
+ *
+ * @return  status   POLLIN | POLLRDNORM, POLLERR or 0
  */
 static unsigned int mxc_poll(struct file *file, struct poll_table_struct *wait)
 {
 	struct video_device *dev = video_devdata(file);
 	cam_data *cam = video_get_drvdata(dev);
-	wait_queue_head_t *queue = NULL;
-	int res = POLLIN | POLLRDNORM;
+	unsigned long lock_flags;
+	unsigned int res = 0;
 
 	pr_debug("In MVC:mxc_poll\n");
 
-	if (down_interruptible(&cam->busy_lock))
-		return -EINTR;
-
-	queue = &cam->enc_queue;
-	poll_wait(file, queue, wait);
+	poll_wait(file, &cam->enc_queue, wait);
 
-	up(&cam->busy_lock);
+	spin_lock_irqsave(&cam->dqueue_int_lock, lock_flags);
+	if (cam->enc_counter > 0)
+		res = POLLIN | POLLRDNORM;
+	else if (!cam->capture_on)
+		res = POLLERR;
+	spin_unlock_irqrestore(&cam->dqueue_int_lock, lock_flags);
 
 	return res;
 }
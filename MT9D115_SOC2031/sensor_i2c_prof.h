@@ -0,0 +1,299 @@
+/*
+ * drivers/media/video/mxc/capture/sensor_i2c_prof.h
+ *
+ * I2C transaction profiling for the Aptina sensor drivers
+ *
+ * Copyright (C) 2013 Aptina Imaging
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+/*
+ * The register accessors of a driver time every bus transaction and account
+ * it to the calling function and the current phase of the driver (probe,
+ * dev_init, s_parm, s_ctrl). The driver marks the phases with
+ * sensor_i2c_prof_enter() and sensor_i2c_prof_leave(). The counters are
+ * read from <debugfs>/<driver>/i2c_profile, writing to the file clears them.
+ *
+ * The phase is kept per task, so a transaction of the init work that
+ * overlaps an ioctl is accounted to the phase of the work. Up to
+ * SENSOR_I2C_PROF_TASKS tasks can be inside a phase at the same time, the
+ * transactions of further tasks go to "other".
+ */
+
+#ifndef __SENSOR_I2C_PROF_H__
+#define __SENSOR_I2C_PROF_H__
+
+#include <linux/ktime.h>
+#include <linux/spinlock.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/math64.h>
+#include <linux/sched.h>
+
+#define SENSOR_I2C_PROF_SITES		48	/* call site and phase pairs */
+#define SENSOR_I2C_PROF_BUCKETS		8	/* latency histogram buckets */
+#define SENSOR_I2C_PROF_BUCKET0_US	64	/* upper bound of the first bucket */
+#define SENSOR_I2C_PROF_TASKS		4	/* tasks inside a phase at once */
+
+enum sensor_i2c_phase {
+	SENSOR_I2C_PHASE_OTHER = 0,
+	SENSOR_I2C_PHASE_PROBE,
+	SENSOR_I2C_PHASE_DEV_INIT,
+	SENSOR_I2C_PHASE_S_PARM,
+	SENSOR_I2C_PHASE_S_CTRL,
+	SENSOR_I2C_PHASE_NUM
+};
+
+static const char * const sensor_i2c_phase_names[SENSOR_I2C_PHASE_NUM] = {
+	[SENSOR_I2C_PHASE_OTHER]	= "other",
+	[SENSOR_I2C_PHASE_PROBE]	= "probe",
+	[SENSOR_I2C_PHASE_DEV_INIT]	= "dev_init",
+	[SENSOR_I2C_PHASE_S_PARM]	= "s_parm",
+	[SENSOR_I2C_PHASE_S_CTRL]	= "s_ctrl",
+};
+
+struct sensor_i2c_prof_site {
+	unsigned long ip;	/* caller of the register accessor */
+	enum sensor_i2c_phase phase;
+	unsigned int count;
+	unsigned int errors;
+	u64 total_ns;
+	u64 max_ns;
+	unsigned int hist[SENSOR_I2C_PROF_BUCKETS];
+};
+
+struct sensor_i2c_prof_task {
+	struct task_struct *task;	/* NULL if the slot is free */
+	enum sensor_i2c_phase phase;
+};
+
+struct sensor_i2c_prof {
+	spinlock_t lock;
+	struct sensor_i2c_prof_task tasks[SENSOR_I2C_PROF_TASKS];
+	struct sensor_i2c_prof_site sites[SENSOR_I2C_PROF_SITES];
+	int nsites;
+	unsigned int dropped;	/* transactions without a free site */
+	struct dentry *dir;
+};
+
+/* slot of the current task, called with the lock held */
+static inline struct sensor_i2c_prof_task *__sensor_i2c_prof_task(
+		struct sensor_i2c_prof *prof, struct task_struct *task)
+{
+	int i;
+
+	for (i = 0; i < SENSOR_I2C_PROF_TASKS; i++)
+		if (prof->tasks[i].task == task)
+			return &prof->tasks[i];
+	return NULL;
+}
+
+/**
+ * sensor_i2c_prof_enter - enter a phase in the current task
+ * @prof: profile of the driver
+ * @phase: new phase
+ *
+ * Returns the previous phase of the task for sensor_i2c_prof_leave().
+ */
+static inline enum sensor_i2c_phase sensor_i2c_prof_enter(
+		struct sensor_i2c_prof *prof, enum sensor_i2c_phase phase)
+{
+	enum sensor_i2c_phase old = SENSOR_I2C_PHASE_OTHER;
+	struct sensor_i2c_prof_task *t;
+
+	spin_lock(&prof->lock);
+	t = __sensor_i2c_prof_task(prof, current);
+	if (t)
+		old = t->phase;
+	else
+		t = __sensor_i2c_prof_task(prof, NULL);
+	if (t) {
+		t->task = current;
+		t->phase = phase;
+	}
+	spin_unlock(&prof->lock);
+
+	return old;
+}
+
+/**
+ * sensor_i2c_prof_leave - return to the phase before sensor_i2c_prof_enter()
+ * @prof: profile of the driver
+ * @old: value returned by sensor_i2c_prof_enter()
+ */
+static inline void sensor_i2c_prof_leave(struct sensor_i2c_prof *prof,
+		enum sensor_i2c_phase old)
+{
+	struct sensor_i2c_prof_task *t;
+
+	spin_lock(&prof->lock);
+	t = __sensor_i2c_prof_task(prof, current);
+	if (t) {
+		t->phase = old;
+		if (old == SENSOR_I2C_PHASE_OTHER)
+			t->task = NULL;
+	}
+	spin_unlock(&prof->lock);
+}
+
+/**
+ * sensor_i2c_prof_record - account a finished transaction
+ * @prof: profile of the driver
+ * @ip: call site, usually _RET_IP_ of a noinline register accessor; in an
+ *      inlined function _RET_IP_ is the return address of its caller
+ * @start: ktime_get() before the transaction
+ * @error: the transaction failed
+ */
+static inline void sensor_i2c_prof_record(struct sensor_i2c_prof *prof,
+		unsigned long ip, ktime_t start, bool error)
+{
+	s64 delta = ktime_to_ns(ktime_sub(ktime_get(), start));
+	u64 ns = delta > 0 ? delta : 0;
+	struct sensor_i2c_prof_site *site = NULL;
+	enum sensor_i2c_phase phase = SENSOR_I2C_PHASE_OTHER;
+	struct sensor_i2c_prof_task *t;
+	int i, bucket;
+
+	/* 4.29 s at most, far into the last bucket */
+	bucket = fls((u32)min_t(u64, ns, UINT_MAX) /
+		     (SENSOR_I2C_PROF_BUCKET0_US * 1000));
+	if (bucket >= SENSOR_I2C_PROF_BUCKETS)
+		bucket = SENSOR_I2C_PROF_BUCKETS - 1;
+
+	spin_lock(&prof->lock);
+	t = __sensor_i2c_prof_task(prof, current);
+	if (t)
+		phase = t->phase;
+	for (i = 0; i < prof->nsites; i++) {
+		if (prof->sites[i].ip == ip &&
+		    prof->sites[i].phase == phase) {
+			site = &prof->sites[i];
+			break;
+		}
+	}
+	if (!site && prof->nsites < SENSOR_I2C_PROF_SITES) {
+		site = &prof->sites[prof->nsites++];
+		memset(site, 0, sizeof(*site));
+		site->ip = ip;
+		site->phase = phase;
+	}
+	if (site) {
+		site->count++;
+		if (error)
+			site->errors++;
+		site->total_ns += ns;
+		if (ns > site->max_ns)
+			site->max_ns = ns;
+		site->hist[bucket]++;
+	} else {
+		prof->dropped++;
+	}
+	spin_unlock(&prof->lock);
+}
+
+static int sensor_i2c_prof_show(struct seq_file *m, void *v)
+{
+	struct sensor_i2c_prof *prof = m->private;
+	const struct sensor_i2c_prof_site *site;
+	int i, j;
+
+	seq_printf(m, "%-8s %7s %6s %7s %7s  histogram <%dus x2^n\n",
+			"phase", "count", "errors", "avg_us", "max_us",
+			SENSOR_I2C_PROF_BUCKET0_US);
+
+	spin_lock(&prof->lock);
+	for (i = 0; i < prof->nsites; i++) {
+		site = &prof->sites[i];
+		seq_printf(m, "%-8s %7u %6u %7u %7u ",
+				sensor_i2c_phase_names[site->phase],
+				site->count, site->errors,
+				(u32)div_u64(div_u64(site->total_ns, site->count),
+					     1000),
+				(u32)div_u64(site->max_ns, 1000));
+		for (j = 0; j < SENSOR_I2C_PROF_BUCKETS; j++)
+			seq_printf(m, " %u", site->hist[j]);
+		seq_printf(m, "  %pS\n", (void *)site->ip);
+	}
+	if (prof->dropped)
+		seq_printf(m, "%u transactions not accounted\n", prof->dropped);
+	spin_unlock(&prof->lock);
+
+	return 0;
+}
+
+static int sensor_i2c_prof_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, sensor_i2c_prof_show, inode->i_private);
+}
+
+static ssize_t sensor_i2c_prof_clear(struct file *file,
+		const char __user *buf, size_t count, loff_t *ppos)
+{
+	struct sensor_i2c_prof *prof =
+		((struct seq_file *)file->private_data)->private;
+
+	spin_lock(&prof->lock);
+	prof->nsites = 0;
+	prof->dropped = 0;
+	spin_unlock(&prof->lock);
+
+	return count;
+}
+
+static const struct file_operations sensor_i2c_prof_fops = {
+	.owner		= THIS_MODULE,
+	.open		= sensor_i2c_prof_open,
+	.read		= seq_read,
+	.write		= sensor_i2c_prof_clear,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+/**
+ * sensor_i2c_prof_init - set up a profile and its debugfs file
+ * @prof: profile of the driver
+ * @name: debugfs directory
+ *
+ * Profiling works without debugfs, the counters are just not visible.
+ */
+static inline void sensor_i2c_prof_init(struct sensor_i2c_prof *prof,
+		const char *name)
+{
+	spin_lock_init(&prof->lock);
+	memset(prof->tasks, 0, sizeof(prof->tasks));
+	prof->nsites = 0;
+	prof->dropped = 0;
+
+	prof->dir = debugfs_create_dir(name, NULL);
+	if (IS_ERR_OR_NULL(prof->dir)) {
+		prof->dir = NULL;
+		return;
+	}
+	debugfs_create_file("i2c_profile", S_IRUGO | S_IWUSR, prof->dir,
+			prof, &sensor_i2c_prof_fops);
+}
+
+/**
+ * sensor_i2c_prof_exit - remove the debugfs file of a profile
+ * @prof: profile of the driver
+ */
+static inline void sensor_i2c_prof_exit(struct sensor_i2c_prof *prof)
+{
+	debugfs_remove_recursive(prof->dir);
+	prof->dir = NULL;
+}
+
+#endif /* __SENSOR_I2C_PROF_H__ */
@@ -572,10 +572,36 @@ static struct platform_device mx6_sabrelite_audio_device = {
 	.name = "imx-sgtl5000",
 };
 
-static struct imxi2c_platform_data mx6q_sabrelite_i2c_data = {
-	.bitrate = 100000,
+/*
+ * I2C bus speeds. A bus runs in fast mode only if every device on it allows
+ * it. The limits of the camera bus (I2C2) are listed in mxc_i2c1_speeds[]
+ * and can be overridden with cam_i2c_speed=<Hz>. The speed is fixed when
+ * the adapter is added: i2c-imx binds through platform_driver_probe() and
+ * cannot be probed again later. The sensor is read back at boot to catch a
+ * board that does not keep up, cam_i2c_speed=100000 is the way out then.
+ */
+#define MX6Q_SABRELITE_I2C_STD_SPEED	100000
+#define MX6Q_SABRELITE_I2C_FAST_SPEED	400000
+#define MX6Q_SABRELITE_I2C_SELFTEST_READS	16
+
+static struct imxi2c_platform_data mx6q_sabrelite_i2c_data[] = {
+	{ .bitrate = MX6Q_SABRELITE_I2C_STD_SPEED, },
+	{ .bitrate = MX6Q_SABRELITE_I2C_STD_SPEED, },
+	{ .bitrate = MX6Q_SABRELITE_I2C_STD_SPEED, },
+};
+
+struct mx6q_sabrelite_i2c_speed {
+	u32 max_speed;		/* fastest SCL the device allows */
+	unsigned short addr;	/* device checked by the self-test, 0: none */
+	u16 id_reg;		/* 16-bit register holding id */
+	u16 id;
+	/* powered and clocked for the self-test, NULL: always on */
+	struct fsl_mxc_camera_platform_data *cam;
 };
 
+static u32 cam_i2c_speed;
+static struct platform_device *mx6q_sabrelite_cam_i2c;
+
 static struct i2c_board_info mxc_i2c0_board_info[] __initdata = {
 	{
 		I2C_BOARD_INFO("sgtl5000", 0x0a),
@@ -651,6 +677,26 @@ static struct i2c_board_info mxc_i2c1_board_info[] __initdata = {
 #endif
 };
 
+/* one entry per device in mxc_i2c1_board_info[] that limits the bus */
+static struct mx6q_sabrelite_i2c_speed mxc_i2c1_speeds[] __initdata = {
+#ifdef CONFIG_FB_MXC_HDMI
+	/* HDMI DDC, E-DDC is specified for standard mode only */
+	{ .max_speed = MX6Q_SABRELITE_I2C_STD_SPEED, },
+#endif
+#ifdef CONFIG_MXC_CAMERA_MT9V129
+	{
+		.max_speed = MX6Q_SABRELITE_I2C_FAST_SPEED,
+		.addr = 0x48,
+		.id_reg = 0x0000,	/* chip id */
+		.id = 0x2285,
+		.cam = &camera_data,
+	},
+#else
+	/* ov564x, not validated in fast mode */
+	{ .max_speed = MX6Q_SABRELITE_I2C_STD_SPEED, },
+#endif
+};
+
 static struct i2c_board_info mxc_i2c2_board_info[] __initdata = {
 	{
 		I2C_BOARD_INFO("egalax_ts", 0x4),
@@ -1210,6 +1256,118 @@ static int __init imx6x_add_ram_console(void)
 #define imx6x_add_ram_console() do {} while (0)
 #endif
 
+static int __init cam_i2c_speed_setup(char *str)
+{
+	cam_i2c_speed = simple_strtoul(str, NULL, 0);
+	return 1;
+}
+early_param("cam_i2c_speed", cam_i2c_speed_setup);
+
+/*!
+ * Slowest speed of the devices on a bus, or the cam_i2c_speed= override.
+ */
+static u32 __init mx6q_sabrelite_i2c_bus_speed(
+		const struct mx6q_sabrelite_i2c_speed *speeds, int count)
+{
+	u32 speed = MX6Q_SABRELITE_I2C_FAST_SPEED;
+	int i;
+
+	if (cam_i2c_speed)
+		return clamp_t(u32, cam_i2c_speed,
+			       MX6Q_SABRELITE_I2C_STD_SPEED,
+			       MX6Q_SABRELITE_I2C_FAST_SPEED);
+
+	for (i = 0; i < count; i++)
+		speed = min(speed, speeds[i].max_speed);
+	return speed;
+}
+
+/*!
+ * Reads the id register of a device a few times.
+ */
+static int __init mx6q_sabrelite_i2c_check_id(struct i2c_adapter *adap,
+		const struct mx6q_sabrelite_i2c_speed *dev)
+{
+	u8 reg[2] = { dev->id_reg >> 8, dev->id_reg & 0xff };
+	u8 val[2];
+	struct i2c_msg msgs[] = {
+		{ .addr = dev->addr, .len = 2, .buf = reg, },
+		{ .addr = dev->addr, .flags = I2C_M_RD, .len = 2, .buf = val, },
+	};
+	int i, ret;
+
+	for (i = 0; i < MX6Q_SABRELITE_I2C_SELFTEST_READS; i++) {
+		ret = i2c_transfer(adap, msgs, ARRAY_SIZE(msgs));
+		if (ret != ARRAY_SIZE(msgs))
+			return ret < 0 ? ret : -EIO;
+		if (((val[0] << 8) | val[1]) != dev->id)
+			return -EIO;
+	}
+	return 0;
+}
+
+/*!
+ * Checks the camera bus in fast mode before the sensor drivers bind. Runs
+ * after the i2c-imx adapters have been registered, only reports a failure.
+ */
+static int __init mx6q_sabrelite_cam_i2c_selftest(void)
+{
+	const struct mx6q_sabrelite_i2c_speed *dev;
+	struct imxi2c_platform_data *pdata;
+	struct i2c_adapter *adap;
+	struct clk *mclk;
+	int i, ret = 0;
+
+	if (!mx6q_sabrelite_cam_i2c)
+		return 0;
+	pdata = mx6q_sabrelite_cam_i2c->dev.platform_data;
+	if (pdata->bitrate <= MX6Q_SABRELITE_I2C_STD_SPEED)
+		return 0;
+
+	adap = i2c_get_adapter(1);
+	if (!adap)
+		return 0;
+	/* sensor MCLK, the capture driver enables it only at open */
+	mclk = clk_get(NULL, "clko2_clk");
+	if (IS_ERR(mclk)) {
+		i2c_put_adapter(adap);
+		return 0;
+	}
+
+	for (i = 0; i < ARRAY_SIZE(mxc_i2c1_speeds) && !ret; i++) {
+		dev = &mxc_i2c1_speeds[i];
+		if (!dev->addr)
+			continue;
+		if (dev->cam) {
+			clk_set_rate(mclk, clk_round_rate(mclk, dev->cam->mclk));
+			clk_enable(mclk);
+			if (dev->cam->io_init)
+				dev->cam->io_init();
+			if (dev->cam->pwdn)
+				dev->cam->pwdn(0);
+		}
+		ret = mx6q_sabrelite_i2c_check_id(adap, dev);
+		if (dev->cam) {
+			if (dev->cam->pwdn)
+				dev->cam->pwdn(1);
+			clk_disable(mclk);
+		}
+	}
+	clk_put(mclk);
+	i2c_put_adapter(adap);
+
+	if (!ret) {
+		pr_info("I2C2 running at %u Hz\n", pdata->bitrate);
+		return 0;
+	}
+
+	pr_err("I2C2 self-test at %u Hz failed (%d), boot with "
+	       "cam_i2c_speed=%u\n", pdata->bitrate, ret,
+	       MX6Q_SABRELITE_I2C_STD_SPEED);
+	return 0;
+}
+subsys_initcall_sync(mx6q_sabrelite_cam_i2c_selftest);
+
 static int __init caam_setup(char *__unused)
 {
 	caam_enabled = 1;
@@ -1286,9 +1444,12 @@ static void __init mx6_sabrelite_board_init(void)
 	if (1 == caam_enabled)
 		imx6q_add_imx_caam();
 
-	imx6q_add_imx_i2c(0, &mx6q_sabrelite_i2c_data);
-	imx6q_add_imx_i2c(1, &mx6q_sabrelite_i2c_data);
-	imx6q_add_imx_i2c(2, &mx6q_sabrelite_i2c_data);
+	mx6q_sabrelite_i2c_data[1].bitrate = mx6q_sabrelite_i2c_bus_speed(
+			mxc_i2c1_speeds, ARRAY_SIZE(mxc_i2c1_speeds));
+	imx6q_add_imx_i2c(0, &mx6q_sabrelite_i2c_data[0]);
+	mx6q_sabrelite_cam_i2c =
+		imx6q_add_imx_i2c(1, &mx6q_sabrelite_i2c_data[1]);
+	imx6q_add_imx_i2c(2, &mx6q_sabrelite_i2c_data[2]);
 	i2c_register_board_info(0, mxc_i2c0_board_info,
 			ARRAY_SIZE(mxc_i2c0_board_info));
 	i2c_register_board_info(1, mxc_i2c1_board_info,
@@ -27,12 +27,20 @@
 #include <linux/kernel.h>
 #include <linux/videodev2.h>
 #include <linux/sysfs.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/workqueue.h>
+#include <linux/completion.h>
+#include <linux/mutex.h>
 
 #include <linux/fsl_devices.h>
 #include <mach/mipi_csi2.h>
 #include <media/v4l2-int-device.h>
 #include <media/v4l2-chip-ident.h>
 #include "mxc_v4l2_capture.h"
+#include "sensor_i2c_batch.h"
+#include "sensor_i2c_prof.h"
+#include "mt9v129_doorbell.h"
 
 static int debug;
 module_param(debug, int, 0644);
@@ -61,36 +69,11 @@ MODULE_PARM_DESC(debug, "debug level (0-2)");
 #define MT9V129_PIXEL_ARRAY_WIDTH				640
 #define MT9V129_PIXEL_ARRAY_HEIGHT				480
 
-// Result Status codes
-#define MT9V129_ENOERR		0x00 // No error - command was successful
-#define MT9V129_ENOENT		0x01 // No such entity
-#define MT9V129_EINTR		0x02 // Operation interrupted
-#define MT9V129_EIO			0x03 // I/O failure
-#define MT9V129_E2BIG		0x04 // Too big
-#define MT9V129_EBADF		0x05 // Bad file/handle
-#define MT9V129_EAGAIN		0x06 // Would-block, try again
-#define MT9V129_ENOMEM		0x07 // Not enough memory/resource
-#define MT9V129_EACCES		0x08 // Permission denied
-#define MT9V129_EBUSY		0x09 // Entity busy, cannot support operation
-#define MT9V129_EEXIST		0x0A // Entity exists
-#define MT9V129_ENODEV		0x0B // Device not found
-#define MT9V129_EINVAL		0x0C // Invalid argument
-#define MT9V129_ENOSPC		0x0D // No space/resource to complete
-#define MT9V129_ERANGE		0x0E // Parameter out of range
-#define MT9V129_ENOSYS		0x0F // Operation not supported
-#define MT9V129_EALREADY	0x10 // Already requested/exists
-
 /* Sysctl registers */
 #define MT9V129_CHIP_ID						0x0000
-#define MT9V129_COMMAND_REGISTER			0x40
-#define MT9V129_COMMAND_REGISTER_SET_STATE	0x8100
-#define MT9V129_COMMAND_REGISTER_GET_STATE	0x8101
 #define MT9V129_PAD_SLEW					0x1E
 #define MT9V129_SOFT_RESET					0x001a
 
-/* Mask */
-#define MT9V129_COMMAND_REGISTER_DOORBELL_MASK	(1 << 15)
-
 /* Command parameters */
 #define MT9V129_COMMAND_PARAMS_0	0xFC00
 #define MT9V129_COMMAND_PARAMS_1	0xFC02
@@ -187,6 +170,21 @@ static int mt9v129_framerates[] = {
 static struct sensor_data mt9v129_data;
 static struct fsl_mxc_camera_platform_data *camera_plat;
 
+/* sensor configuration started by probe, see mt9v129_init_work_func() */
+static struct work_struct mt9v129_init_work;
+static DECLARE_COMPLETION(mt9v129_init_done);
+static int mt9v129_init_ret;
+
+/*
+ * bus time per call site and phase, see sensor_i2c_prof.h; the accessors
+ * taking _RET_IP_ are noinline so that the site is their caller
+ */
+static struct sensor_i2c_prof mt9v129_prof;
+
+/* messages of mt9v129_writeregs(), too large for the stack */
+static struct sensor_i2c_batch mt9v129_batch;
+static DEFINE_MUTEX(mt9v129_batch_lock);
+
 struct mt9v129_reg {
 	u16 reg;
 	u32 val;
@@ -337,8 +335,9 @@ static const struct mt9v129_reg mt9v129_init[] = {
 	{0xC987, 0x3E, 1},
 };
 
-static int mt9v129_read8(struct i2c_client *client, u16 reg, u8 *val)
+static noinline int mt9v129_read8(struct i2c_client *client, u16 reg, u8 *val)
 {
+	ktime_t start;
 	int ret;
 	u8 rval;
 	struct i2c_msg msg[] = {
@@ -358,7 +357,9 @@ static int mt9v129_read8(struct i2c_client *client, u16 reg, u8 *val)
 
 	reg = swab16(reg);
 
+	start = ktime_get();
 	ret = i2c_transfer(client->adapter, msg, 2);
+	sensor_i2c_prof_record(&mt9v129_prof, _RET_IP_, start, ret < 0);
 	if (ret < 0) {
 		v4l_err(client, "Failed to read register 0x%04x!\n", reg);
 		return ret;
@@ -368,8 +369,9 @@ static int mt9v129_read8(struct i2c_client *client, u16 reg, u8 *val)
 	return 0;
 }
 
-static int mt9v129_write8(struct i2c_client *client, u16 reg, u8 val)
+static noinline int mt9v129_write8(struct i2c_client *client, u16 reg, u8 val)
 {
+	ktime_t start;
 	int ret;
 	struct {
 		u16 reg;
@@ -384,7 +386,9 @@ static int mt9v129_write8(struct i2c_client *client, u16 reg, u8 val)
 	buf.reg = swab16(reg);
 	buf.val = val;
 
+	start = ktime_get();
 	ret = i2c_transfer(client->adapter, &msg, 1);
+	sensor_i2c_prof_record(&mt9v129_prof, _RET_IP_, start, ret < 0);
 	if (ret < 0) {
 		v4l_err(client, "Failed to write register 0x%04x!\n", reg);
 		return ret;
@@ -393,8 +397,9 @@ static int mt9v129_write8(struct i2c_client *client, u16 reg, u8 val)
 	return 0;
 }
 
-static int mt9v129_read16(struct i2c_client *client, u16 reg, u16 *val)
+static noinline int mt9v129_read16(struct i2c_client *client, u16 reg, u16 *val)
 {
+	ktime_t start;
 	int ret;
 	u16 rval;
 	struct i2c_msg msg[] = {
@@ -414,7 +419,9 @@ static int mt9v129_read16(struct i2c_client *client, u16 reg, u16 *val)
 
 	reg = swab16(reg);
 
+	start = ktime_get();
 	ret = i2c_transfer(client->adapter, msg, 2);
+	sensor_i2c_prof_record(&mt9v129_prof, _RET_IP_, start, ret < 0);
 	if (ret < 0) {
 		v4l_err(client, "Failed to read register 0x%04x!\n", reg);
 		return ret;
@@ -424,8 +431,9 @@ static int mt9v129_read16(struct i2c_client *client, u16 reg, u16 *val)
 	return 0;
 }
 
-static int mt9v129_write16(struct i2c_client *client, u16 reg, u16 val)
+static noinline int mt9v129_write16(struct i2c_client *client, u16 reg, u16 val)
 {
+	ktime_t start;
 	int ret;
 	struct {
 		u16 reg;
@@ -440,7 +448,9 @@ static int mt9v129_write16(struct i2c_client *client, u16 reg, u16 val)
 	buf.reg = swab16(reg);
 	buf.val = swab16(val);
 
+	start = ktime_get();
 	ret = i2c_transfer(client->adapter, &msg, 1);
+	sensor_i2c_prof_record(&mt9v129_prof, _RET_IP_, start, ret < 0);
 	if (ret < 0) {
 		v4l_err(client, "Failed to write register 0x%04x!\n", reg);
 		return ret;
@@ -449,33 +459,9 @@ static int mt9v129_write16(struct i2c_client *client, u16 reg, u16 val)
 	return 0;
 }
 
-static int mt9v129_write32(struct i2c_client *client, u16 reg, u32 val)
-{
-	int ret;
-	struct {
-		u16 reg;
-		u32 val;
-	} __packed buf;
-	struct i2c_msg msg = {
-		.addr   = client->addr,
-		.flags  = 0,
-		.len    = 6,
-		.buf    = (u8 *)&buf,
-	};
-	buf.reg = swab16(reg);
-	buf.val = swab32(val);
-
-	ret = i2c_transfer(client->adapter, &msg, 1);
-	if (ret < 0) {
-		v4l_err(client, "Failed to write register 0x%04x!\n", reg);
-		return ret;
-	}
-
-	return 0;
-}
-
-static int mt9v129_read32(struct i2c_client *client, u16 reg, u32 *val)
+static noinline int mt9v129_read32(struct i2c_client *client, u16 reg, u32 *val)
 {
+	ktime_t start;
 	int ret;
 	u32 rval;
 	struct i2c_msg msg[] = {
@@ -495,7 +481,9 @@ static int mt9v129_read32(struct i2c_client *client, u16 reg, u32 *val)
 
 	reg = swab16(reg);
 
+	start = ktime_get();
 	ret = i2c_transfer(client->adapter, msg, 2);
+	sensor_i2c_prof_record(&mt9v129_prof, _RET_IP_, start, ret < 0);
 	if (ret < 0) {
 		v4l_err(client, "Failed to read register 0x%04x!\n", reg);
 		return ret;
@@ -505,146 +493,102 @@ static int mt9v129_read32(struct i2c_client *client, u16 reg, u32 *val)
 	return 0;
 }
 
-static int mt9v129_writeregs(struct i2c_client *client,
+/**
+ * mt9v129_writeregs - write a register table
+ * @client: i2c client driver structure
+ * @regs: registers
+ * @len: number of registers
+ *
+ * The table goes out in as few i2c_transfer() calls as possible, runs of
+ * consecutive registers as single auto-increment messages.
+ */
+static noinline int mt9v129_writeregs(struct i2c_client *client,
 		const struct mt9v129_reg *regs, int len)
 {
-	int i, ret;
-
-	for (i = 0; i < len; i++) {
-		switch (regs[i].width) {
-			case 1:
-				ret = mt9v129_write8(client,
-						regs[i].reg, regs[i].val);
-				break;
-			case 2:
-				ret = mt9v129_write16(client,
-						regs[i].reg, regs[i].val);
-				break;
-			case 4:
-				ret = mt9v129_write32(client,
-						regs[i].reg, regs[i].val);
-				break;
-			default:
-				ret = -EINVAL;
-				break;
-		}
-		if (ret < 0)
-			return ret;
-	}
-	return 0;
+	struct sensor_i2c_batch *batch = &mt9v129_batch;
+	int i, ret = 0;
+
+	mutex_lock(&mt9v129_batch_lock);
+	sensor_i2c_batch_init(batch, client, &mt9v129_prof, _RET_IP_);
+	for (i = 0; i < len && ret >= 0; i++)
+		ret = sensor_i2c_batch_write(batch, regs[i].reg,
+				regs[i].val, regs[i].width);
+	if (ret >= 0)
+		ret = sensor_i2c_batch_flush(batch);
+	if (ret >= 0)
+		v4l_dbg(1, debug, client, "%d registers in %d transfers\n",
+				len, batch->transfers);
+	mutex_unlock(&mt9v129_batch_lock);
+
+	return ret < 0 ? ret : 0;
 }
 
 static int mt9v129_set_state(struct i2c_client *client, u8 next_state)
 {
-	int timeout = 100, ret;
-	u16 command;
+	int ret;
 
 	/* set the next desired state */
 	ret = mt9v129_write8(client, MT9V129_SYSMGR_NEXT_STATE, next_state);
 	if (ret < 0)
 		return ret;
 
-	/* check door bell status */
-	ret = mt9v129_read16(client,
-			MT9V129_COMMAND_REGISTER, &command);
-	if (ret < 0)
-		return ret;
-	if (command & MT9V129_COMMAND_REGISTER_DOORBELL_MASK) {
-		v4l_err(client, "Firmware busy. Cant Set State!!\n");
-		return -EAGAIN;
-	}
-
 	/* start state transition */
-	ret = mt9v129_write16(client, MT9V129_COMMAND_REGISTER,
-			MT9V129_COMMAND_REGISTER_SET_STATE);
+	ret = mt9v129_doorbell(client, MT9V129_CMD_SET_STATE);
 	if (ret < 0)
 		return ret;
 
-	/* wait for the state transition to complete */
-	while (timeout) {
-		ret = mt9v129_read16(client,
-				MT9V129_COMMAND_REGISTER, &command);
-		if (ret < 0)
-			return ret;
-		if (!(command & MT9V129_COMMAND_REGISTER_DOORBELL_MASK))
-			break;
-		msleep(10);
-		timeout--;
-	}
-	if (!timeout) {
-		v4l_err(client, "Failed to poll command register\n");
-		return -ETIMEDOUT;
-	}
-
 	/* check if the command is successful */
-	ret = mt9v129_read16(client,
-			MT9V129_COMMAND_REGISTER, &command);
-	if (ret < 0)
-		return ret;
-	if (!(command & ~(MT9V129_COMMAND_REGISTER_DOORBELL_MASK))) {
-		return 0;
-	} else {
-		v4l_err(client, "Failed to set state, Response = %x\n", command);
+	if (ret) {
+		v4l_err(client, "Failed to set state, Response = %x\n", ret);
 		return -EFAULT;
 	}
+	return 0;
 }
 
 static int mt9v129_get_state(struct i2c_client *client)
 {
-	int timeout = 1000, ret;
-	u16 command;
+	int ret;
 	u8 state;
 
-	/* check door bell status */
-	ret = mt9v129_read16(client,
-			MT9V129_COMMAND_REGISTER, &command);
-	if (ret < 0)
-		return ret;
-	if ((command & MT9V129_COMMAND_REGISTER_DOORBELL_MASK)) {
-		v4l_err(client, "Firmware busy. Cant get state!!\n");
-		return -EAGAIN;
-	}
-
-	/* start state transition */
-	ret = mt9v129_write16(client, MT9V129_COMMAND_REGISTER,
-			MT9V129_COMMAND_REGISTER_GET_STATE);
+	ret = mt9v129_doorbell(client, MT9V129_CMD_GET_STATE);
 	if (ret < 0)
 		return ret;
 
-	/* wait for the state transition to complete */
-	while (timeout) {
-		ret = mt9v129_read16(client,
-				MT9V129_COMMAND_REGISTER, &command);
-		if (ret < 0)
-			return ret;
-		if (!(command & MT9V129_COMMAND_REGISTER_DOORBELL_MASK))
-			break;
-		msleep(10);
-		timeout--;
-	}
-	if (!timeout) {
-		v4l_err(client, "Failed to poll command register\n");
-		return -ETIMEDOUT;
-	}
-
 	/* check if the command is successful */
-	ret = mt9v129_read16(client,
-			MT9V129_COMMAND_REGISTER, &command);
-	if (ret < 0)
-		return ret;
+	if (ret) {
+		v4l_err(client, "Failed to get state, Response = %x\n", ret);
+		return -EFAULT;
+	}
 
 	/* get the state */
 	ret = mt9v129_read8(client, MT9V129_SYSMGR_NEXT_STATE, &state);
 	if (ret < 0)
 		return ret;
-	if (!(command & ~(MT9V129_COMMAND_REGISTER_DOORBELL_MASK))) {
-		return state;
-	} else {
-		v4l_err(client, "Failed to get state, Response = %x\n", command);
-		return -EFAULT;
+	return state;
+}
+
+static ssize_t mt9v129_show_doorbell_stats(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	const struct mt9v129_cmd_stats *stats;
+	ssize_t len = 0;
+	int i;
+
+	for (i = 0; i < MT9V129_CMD_NUM; i++) {
+		stats = &mt9v129_stats[i];
+		len += sprintf(buf + len, "%s: count %u timeouts %u polls %u "
+				"last %u us max %u us avg %u us\n",
+				mt9v129_cmds[i].name, stats->count,
+				stats->timeouts, stats->polls, stats->last_us,
+				stats->max_us, stats->count ?
+				(u32)div_u64(stats->total_us, stats->count) : 0);
 	}
+	return len;
 }
 
+static DEVICE_ATTR(doorbell_stats, S_IRUGO, mt9v129_show_doorbell_stats,
+		NULL);
+
 static int mt9v129_change_mode(struct i2c_client *client,
 		u32 mode)
 {
@@ -739,6 +683,61 @@ static int ioctl_enum_frameintervals(struct v4l2_int_device *s,
 }
 
 
+/**
+ * mt9v129_init_work_func - configure the sensor after probe
+ * @work: mt9v129_init_work
+ *
+ * Resets the sensor, loads the Devware defaults and the default streaming
+ * mode and powers the sensor down again. Runs in the background so that
+ * probe returns as soon as the chip id has been verified.
+ */
+static void mt9v129_init_work_func(struct work_struct *work)
+{
+	struct i2c_client *client = mt9v129_data.i2c_client;
+	enum sensor_i2c_phase phase;
+	int ret;
+	int state;
+
+	phase = sensor_i2c_prof_enter(&mt9v129_prof, SENSOR_I2C_PHASE_DEV_INIT);
+
+	/* reset the sensor */
+	ret = mt9v129_write16(client, MT9V129_SOFT_RESET, 0x0001);
+	if (ret < 0) {
+		v4l_err(client, "Failed to reset the sensor\n");
+		goto out;
+	}
+	mt9v129_write16(client, MT9V129_SOFT_RESET, 0x0000);
+	msleep(500);
+	/* TODO - Check Software Reset is Done!! */
+	state = mt9v129_get_state(client);
+	v4l_dbg(1, debug, client, "state = %x\n", state);
+	/* Write Initial Values to sensor AE, AWB, LDC etc. from devware */
+	ret = mt9v129_writeregs(client, mt9v129_init,
+			ARRAY_SIZE(mt9v129_init));
+	/* Write the PAD Slew register in SOC with value from Devware */
+	ret = mt9v129_write16(client, MT9V129_PAD_SLEW, 0x302);
+	/* Set Default Streaming Mode */
+	mt9v129_change_mode(client, DEFAULT_MODE);
+	ret = 0;
+out:
+	if (camera_plat->pwdn)
+		camera_plat->pwdn(1);
+	sensor_i2c_prof_leave(&mt9v129_prof, phase);
+	mt9v129_init_ret = ret;
+	complete_all(&mt9v129_init_done);
+}
+
+/**
+ * mt9v129_wait_init - wait for the configuration started by probe
+ *
+ * Returns the result of the configuration.
+ */
+static int mt9v129_wait_init(void)
+{
+	wait_for_completion(&mt9v129_init_done);
+	return mt9v129_init_ret;
+}
+
 /**
  * ioctl_s_power - V4L2 sensor interface handler for vidioc_int_s_power_num
  * @s: pointer to standard V4L2 device structure
@@ -753,6 +752,17 @@ static int ioctl_s_power(struct v4l2_int_device *s, int on)
 
 	LOG_FUNCTION_NAME;
 
+	/*
+	 * The init work powers the sensor down when it is done, so a power
+	 * off request (master attach during probe) need not wait for it.
+	 */
+	if (!on && !completion_done(&mt9v129_init_done)) {
+		sensor->on = on;
+		LOG_FUNCTION_NAME_EXIT;
+		return 0;
+	}
+	mt9v129_wait_init();
+
 	if (on && !sensor->on) {
 		mt9v129_dbg("Power on!\n");
 		// Make sure power on
@@ -944,17 +954,8 @@ static int ioctl_g_parm(struct v4l2_int_device *s,
 	return ret;
 }
 
-/**
- * ioctl_s_parm - V4L2 sensor interface handler for VIDIOC_S_PARM ioctl
- * @s: pointer to standard V4L2 device structure
- * @a: pointer to standard V4L2 VIDIOC_S_PARM ioctl structure
- *
- * Configures the sensor to use the input parameters, if possible.  If
- * not possible, reverts to the old parameters and returns the
- * appropriate error code.
- * ----->Note, this function is not active in this release.<------
- */
-static int ioctl_s_parm(struct v4l2_int_device *s,
+/* VIDIOC_S_PARM, see ioctl_s_parm() */
+static int mt9v129_s_parm(struct v4l2_int_device *s,
 		struct v4l2_streamparm *a)
 {
 	struct sensor_data *sensor = s->priv;
@@ -964,6 +965,10 @@ static int ioctl_s_parm(struct v4l2_int_device *s,
 	enum mt9v129_frame_rate new_frame_rate;
 	int ret = 0;
 
+	ret = mt9v129_wait_init();
+	if (ret < 0)
+		return ret;
+
 	/* Make sure power on */
 	if (camera_plat->pwdn)
 		camera_plat->pwdn(0);
@@ -1030,6 +1035,28 @@ static int ioctl_s_parm(struct v4l2_int_device *s,
 	return ret;
 }
 
+/**
+ * ioctl_s_parm - V4L2 sensor interface handler for VIDIOC_S_PARM ioctl
+ * @s: pointer to standard V4L2 device structure
+ * @a: pointer to standard V4L2 VIDIOC_S_PARM ioctl structure
+ *
+ * Configures the sensor to use the input parameters, if possible.  If
+ * not possible, reverts to the old parameters and returns the
+ * appropriate error code.
+ * ----->Note, this function is not active in this release.<------
+ */
+static int ioctl_s_parm(struct v4l2_int_device *s,
+		struct v4l2_streamparm *a)
+{
+	enum sensor_i2c_phase phase;
+	int ret;
+
+	phase = sensor_i2c_prof_enter(&mt9v129_prof, SENSOR_I2C_PHASE_S_PARM);
+	ret = mt9v129_s_parm(s, a);
+	sensor_i2c_prof_leave(&mt9v129_prof, phase);
+	return ret;
+}
+
 /**
  * ioctl_g_ctrl - V4L2 sensor interface handler for VIDIOC_G_CTRL ioctl
  * @s: pointer to standard V4L2 device structure
@@ -1102,6 +1129,18 @@ static int ioctl_dev_init(struct v4l2_int_device *s)
 }
 
 
+/*!
+ * ioctl_wait_init - V4L2 sensor interface handler for vidioc_int_wait_init_num
+ * @s: pointer to standard V4L2 device structure
+ *
+ * Blocks until the sensor configuration started by probe has finished.
+ */
+static int ioctl_wait_init(struct v4l2_int_device *s)
+{
+	return mt9v129_wait_init();
+}
+
+
 /*!
  * ioctl_dev_exit - V4L2 sensor interface handler for vidioc_int_dev_exit_num
  * @s: pointer to standard V4L2 device structure
@@ -1148,6 +1187,11 @@ static int ioctl_g_chip_ident(struct v4l2_int_device *s, int *id)
 }
 
 
+/* private slave ioctl, numbered as in mxc_v4l2_capture.c */
+enum {
+	vidioc_int_wait_init_num = vidioc_int_priv_start_num,
+};
+
 static struct v4l2_int_ioctl_desc mt9v129_ioctl_desc[] = {
 	{ .num = vidioc_int_enum_framesizes_num,
 		.func = (v4l2_int_ioctl_func *)ioctl_enum_framesizes },
@@ -1185,6 +1229,8 @@ static struct v4l2_int_ioctl_desc mt9v129_ioctl_desc[] = {
 		.func = (v4l2_int_ioctl_func *)ioctl_init_num },
 	{ .num = vidioc_int_g_chip_ident_num,
 		.func = (v4l2_int_ioctl_func *)ioctl_g_chip_ident },
+	{ .num = vidioc_int_wait_init_num,
+		.func = (v4l2_int_ioctl_func *)ioctl_wait_init },
 };
 
 
@@ -1208,9 +1254,9 @@ static int mt9v129_probe(struct i2c_client *client,
 {
 	int retval;
 	struct fsl_mxc_camera_platform_data *plat_data = client->dev.platform_data;
+	enum sensor_i2c_phase phase;
 	int ret;
 	u16 chip_id;
-	int state;
 
 	LOG_FUNCTION_NAME;
 
@@ -1246,7 +1292,9 @@ static int mt9v129_probe(struct i2c_client *client,
 		plat_data->pwdn(0);
 
 	/* Verify Chip ID */
+	phase = sensor_i2c_prof_enter(&mt9v129_prof, SENSOR_I2C_PHASE_PROBE);
 	ret = mt9v129_read16(client, MT9V129_CHIP_ID, &chip_id);
+	sensor_i2c_prof_leave(&mt9v129_prof, phase);
 	if (ret < 0) {
 		v4l_err(client, "Failed to get chip id\n");
 		return -ENODEV;
@@ -1256,33 +1304,25 @@ static int mt9v129_probe(struct i2c_client *client,
 		return -ENODEV;
 	}
 
-	/* reset the sensor */
-	ret = mt9v129_write16(client, MT9V129_SOFT_RESET, 0x0001);
-	if (ret < 0) {
-		v4l_err(client, "Failed to reset the sensor\n");
-		return ret;
-	}
-	mt9v129_write16(client, MT9V129_SOFT_RESET, 0x0000);
-	mdelay(500);
-	/* TODO - Check Software Reset is Done!! */
-	state = mt9v129_get_state(client);
-	v4l_dbg(1, debug, client, "state = %x\n", state);
-	/* Write Initial Values to sensor AE, AWB, LDC etc. from devware */
-	ret = mt9v129_writeregs(client, mt9v129_init,
-			ARRAY_SIZE(mt9v129_init));
-	/* Write the PAD Slew register in SOC with value from Devware */
-	ret = mt9v129_write16(client, MT9V129_PAD_SLEW, 0x302);
-	/* Set Default Streaming Mode */
-	mt9v129_change_mode(client, DEFAULT_MODE);
-	if (plat_data->pwdn)
-		plat_data->pwdn(1);
+	if (device_create_file(&client->dev, &dev_attr_doorbell_stats))
+		dev_err(&client->dev, "Error on creating sysfs file"
+				" for doorbell stats\n");
 
 	// Keeping copy of plat_data
 	camera_plat = plat_data;
 	mt9v129_int_device.priv = &mt9v129_data;
 
+	/* the rest of the bring-up runs in the background */
+	INIT_COMPLETION(mt9v129_init_done);
+	INIT_WORK(&mt9v129_init_work, mt9v129_init_work_func);
+	schedule_work(&mt9v129_init_work);
+
 	// registering with v4l2 int device
 	retval = v4l2_int_device_register(&mt9v129_int_device);
+	if (retval) {
+		cancel_work_sync(&mt9v129_init_work);
+		device_remove_file(&client->dev, &dev_attr_doorbell_stats);
+	}
 
 	LOG_FUNCTION_NAME_EXIT;
 	return retval;
@@ -1296,7 +1336,9 @@ static int mt9v129_probe(struct i2c_client *client,
  */
 static int mt9v129_remove(struct i2c_client *client)
 {
+	cancel_work_sync(&mt9v129_init_work);
 	v4l2_int_device_unregister(&mt9v129_int_device);
+	device_remove_file(&client->dev, &dev_attr_doorbell_stats);
 	return 0;
 }
 
@@ -1320,12 +1362,19 @@ static struct i2c_driver mt9v129_i2c_driver = {
  ************************************************************************/
 static int __init mt9v129_module_init(void)
 {
-	return i2c_add_driver(&mt9v129_i2c_driver);
+	int ret;
+
+	sensor_i2c_prof_init(&mt9v129_prof, "mt9v129");
+	ret = i2c_add_driver(&mt9v129_i2c_driver);
+	if (ret)
+		sensor_i2c_prof_exit(&mt9v129_prof);
+	return ret;
 }
 
 static void __exit mt9v129_module_exit(void)
 {
 	i2c_del_driver(&mt9v129_i2c_driver);
+	sensor_i2c_prof_exit(&mt9v129_prof);
 }
 
 
@@ -0,0 +1,168 @@
+/*
+ * drivers/media/video/mxc/capture/mt9v129_doorbell.h
+ *
+ * Aptina MT9V129 host command interface
+ *
+ * Copyright (C) 2013 Aptina Imaging
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * Host commands go through the command register: the driver writes the
+ * command with the doorbell bit set and the firmware clears the bit when
+ * it is done, leaving the result status in the register. Kept apart from
+ * mt9v129.c so that test_app/mt9v129_doorbell_test.c of the
+ * A1000ERS_MT9M024 release can run the state machine on a host. The
+ * register accessors are those of mt9v129.c.
+ */
+#ifndef __MT9V129_DOORBELL_H__
+#define __MT9V129_DOORBELL_H__
+
+#include <linux/delay.h>
+#include <linux/i2c.h>
+#include <linux/kernel.h>
+#include <linux/ktime.h>
+#include <media/v4l2-common.h>
+
+// Result Status codes
+#define MT9V129_ENOERR		0x00 // No error - command was successful
+#define MT9V129_ENOENT		0x01 // No such entity
+#define MT9V129_EINTR		0x02 // Operation interrupted
+#define MT9V129_EIO			0x03 // I/O failure
+#define MT9V129_E2BIG		0x04 // Too big
+#define MT9V129_EBADF		0x05 // Bad file/handle
+#define MT9V129_EAGAIN		0x06 // Would-block, try again
+#define MT9V129_ENOMEM		0x07 // Not enough memory/resource
+#define MT9V129_EACCES		0x08 // Permission denied
+#define MT9V129_EBUSY		0x09 // Entity busy, cannot support operation
+#define MT9V129_EEXIST		0x0A // Entity exists
+#define MT9V129_ENODEV		0x0B // Device not found
+#define MT9V129_EINVAL		0x0C // Invalid argument
+#define MT9V129_ENOSPC		0x0D // No space/resource to complete
+#define MT9V129_ERANGE		0x0E // Parameter out of range
+#define MT9V129_ENOSYS		0x0F // Operation not supported
+#define MT9V129_EALREADY	0x10 // Already requested/exists
+
+/* Command register */
+#define MT9V129_COMMAND_REGISTER			0x40
+#define MT9V129_COMMAND_REGISTER_SET_STATE	0x8100
+#define MT9V129_COMMAND_REGISTER_GET_STATE	0x8101
+
+/* Mask */
+#define MT9V129_COMMAND_REGISTER_DOORBELL_MASK	(1 << 15)
+
+/* Doorbell poll interval, doubled after every poll */
+#define MT9V129_DOORBELL_POLL_MIN_US	50
+#define MT9V129_DOORBELL_POLL_MAX_US	5000
+
+/* host commands issued through the doorbell, see mt9v129_doorbell() */
+enum mt9v129_cmd {
+	MT9V129_CMD_SET_STATE = 0,
+	MT9V129_CMD_GET_STATE,
+	MT9V129_CMD_NUM
+};
+
+static const struct {
+	u16 command;
+	const char *name;
+	unsigned int timeout_ms;
+} mt9v129_cmds[MT9V129_CMD_NUM] = {
+	[MT9V129_CMD_SET_STATE] = {
+		MT9V129_COMMAND_REGISTER_SET_STATE, "set_state", 1000
+	},
+	[MT9V129_CMD_GET_STATE] = {
+		MT9V129_COMMAND_REGISTER_GET_STATE, "get_state", 10000
+	},
+};
+
+/* host command latency */
+struct mt9v129_cmd_stats {
+	unsigned int count;
+	unsigned int timeouts;
+	unsigned int polls;
+	u32 last_us;
+	u32 max_us;
+	u64 total_us;
+};
+
+static struct mt9v129_cmd_stats mt9v129_stats[MT9V129_CMD_NUM];
+
+static int mt9v129_read16(struct i2c_client *client, u16 reg, u16 *val);
+static int mt9v129_write16(struct i2c_client *client, u16 reg, u16 val);
+
+/**
+ * mt9v129_doorbell - issue a host command and wait for the firmware
+ * @client: i2c client driver structure
+ * @cmd: host command
+ *
+ * Writes the command and polls the doorbell bit until the firmware clears
+ * it. The poll interval starts at MT9V129_DOORBELL_POLL_MIN_US and doubles
+ * up to MT9V129_DOORBELL_POLL_MAX_US, so short commands are seen within
+ * microseconds and long ones do not flood the bus. The latency is
+ * accounted in mt9v129_stats.
+ *
+ * Returns the firmware response code or a negative error code.
+ */
+static int mt9v129_doorbell(struct i2c_client *client, enum mt9v129_cmd cmd)
+{
+	struct mt9v129_cmd_stats *stats = &mt9v129_stats[cmd];
+	unsigned long delay = MT9V129_DOORBELL_POLL_MIN_US;
+	ktime_t start;
+	s64 elapsed;
+	u16 command;
+	int ret;
+
+	/* check door bell status */
+	ret = mt9v129_read16(client,
+			MT9V129_COMMAND_REGISTER, &command);
+	if (ret < 0)
+		return ret;
+	if (command & MT9V129_COMMAND_REGISTER_DOORBELL_MASK) {
+		v4l_err(client, "Firmware busy. Cant %s!!\n",
+				mt9v129_cmds[cmd].name);
+		return -EAGAIN;
+	}
+
+	start = ktime_get();
+	ret = mt9v129_write16(client, MT9V129_COMMAND_REGISTER,
+			mt9v129_cmds[cmd].command);
+	if (ret < 0)
+		return ret;
+
+	/* wait for the command to complete */
+	for (;;) {
+		ret = mt9v129_read16(client,
+				MT9V129_COMMAND_REGISTER, &command);
+		if (ret < 0)
+			return ret;
+		stats->polls++;
+		elapsed = ktime_us_delta(ktime_get(), start);
+		if (!(command & MT9V129_COMMAND_REGISTER_DOORBELL_MASK))
+			break;
+		if (elapsed > mt9v129_cmds[cmd].timeout_ms * 1000LL) {
+			stats->timeouts++;
+			v4l_err(client, "Failed to poll command register\n");
+			return -ETIMEDOUT;
+		}
+		usleep_range(delay, delay * 2);
+		delay = min(delay * 2, (unsigned long)MT9V129_DOORBELL_POLL_MAX_US);
+	}
+
+	stats->count++;
+	stats->last_us = elapsed;
+	stats->total_us += elapsed;
+	if (elapsed > stats->max_us)
+		stats->max_us = elapsed;
+	dev_dbg(&client->dev, "%s took %lld us\n",
+			mt9v129_cmds[cmd].name, elapsed);
+
+	return command & ~MT9V129_COMMAND_REGISTER_DOORBELL_MASK;
+}
+
+#endif /* __MT9V129_DOORBELL_H__ */
@@ -44,6 +44,17 @@
 #define init_MUTEX(sem)         sema_init(sem, 1)
 #define MXC_SENSOR_NUM 2
 
+/*!
+ * Private slave ioctl: blocks until the sensor configuration that the
+ * slave runs asynchronously from probe or dev_init has finished and
+ * returns its result. Slaves that configure synchronously do not
+ * implement it.
+ */
+enum {
+	vidioc_int_wait_init_num = vidioc_int_priv_start_num,
+};
+V4L2_INT_WRAPPER_0(wait_init);
+
 static int video_nr = -1;
 
 /*! This data is used for the output to the display. */
@@ -396,6 +407,14 @@ static int mxc_streamon(cam_data *cam)
 		return -1;
 	}
 
+	/* the sensor may still be running its initialization */
+	err = vidioc_int_wait_init(cam->sensor);
+	if (err && err != -ENOIOCTLCMD) {
+		pr_err("ERROR: v4l2 capture: sensor initialization failed\n");
+		return err;
+	}
+	err = 0;
+
 	if (list_empty(&cam->ready_q)) {
 		pr_err("ERROR: v4l2 capture: mxc_streamon buffer has not been "
 			"queued yet\n");
@@ -497,6 +516,9 @@ static int mxc_streamoff(cam_data *cam)
 	mxc_free_frames(cam);
 	mxc_capture_inputs[cam->current_input].status |= V4L2_IN_ST_NO_POWER;
 	cam->capture_on = false;
+
+	/* pollers see the stream going off */
+	wake_up_interruptible(&cam->enc_queue);
 	return err;
 }
 
@@ -2545,24 +2567,29 @@ static int mxc_mmap(struct file *file, struct vm_area_struct *vma)
  *
  * @param wait       structure poll_table_struct *
  *
- * @return  status   POLLIN | POLLRDNORM
+ * Readable once a frame has completed, POLLERR while the stream is off.
+ * The camera callback wakes the queue once per completed frame. Does not
+ * take busy_lock, so a poll never waits for an ioctl in progress.
+ *
+ * @return  status   POLLIN | POLLRDNORM, POLLERR or 0
  */
 static unsigned int mxc_poll(struct file *file, struct poll_table_struct *wait)
 {
 	struct video_device *dev = video_devdata(file);
 	cam_data *cam = video_get_drvdata(dev);
-	wait_queue_head_t *queue = NULL;
-	int res = POLLIN | POLLRDNORM;
+	unsigned long lock_flags;
+	unsigned int res = 0;
 
 	pr_debug("In MVC:mxc_poll\n");
 
-	if (down_interruptible(&cam->busy_lock))
-		return -EINTR;
-
-	queue = &cam->enc_queue;
-	poll_wait(file, queue, wait);
+	poll_wait(file, &cam->enc_queue, wait);
 
-	up(&cam->busy_lock);
+	spin_lock_irqsave(&cam->dqueue_int_lock, lock_flags);
+	if (cam->enc_counter > 0)
+		res = POLLIN | POLLRDNORM;
+	else if (!cam->capture_on)
+		res = POLLERR;
+	spin_unlock_irqrestore(&cam->dqueue_int_lock, lock_flags);
 
 	return res;
 }
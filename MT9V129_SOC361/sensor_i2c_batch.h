@@ -0,0 +1,216 @@
+/*
+ * drivers/media/video/mxc/capture/sensor_i2c_batch.h
+ *
+ * Batched register writes for the Aptina sensor drivers
+ *
+ * Copyright (C) 2013 Aptina Imaging
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+/*
+ * Register writes are queued as the messages of one i2c_transfer(), so a
+ * whole table costs one adapter wakeup instead of one per register. A write
+ * to the register following the previous message is appended to that
+ * message and relies on the address auto-increment of the sensor. All
+ * sensors using this have 16-bit big-endian register addresses.
+ *
+ * The functions are static inline, every driver gets its own copy and the
+ * drivers can be built into the same kernel.
+ */
+
+#ifndef __SENSOR_I2C_BATCH_H__
+#define __SENSOR_I2C_BATCH_H__
+
+#include <linux/i2c.h>
+#include "sensor_i2c_prof.h"
+
+#define SENSOR_I2C_BATCH_MSGS		16	/* messages per i2c_transfer() */
+#define SENSOR_I2C_BATCH_BYTES		512	/* payload per i2c_transfer() */
+
+/* some 700 bytes, a driver keeps one under a mutex instead of on the stack */
+struct sensor_i2c_batch {
+	struct i2c_client *client;
+	struct i2c_msg msgs[SENSOR_I2C_BATCH_MSGS];
+	u8 buf[SENSOR_I2C_BATCH_BYTES];
+	int count;		/* queued messages */
+	int len;		/* used bytes of buf */
+	u16 next_reg;		/* register following the last message */
+	bool merge;		/* last message may be extended */
+	int transfers;		/* i2c_transfer() calls so far */
+	struct sensor_i2c_prof *prof;	/* may be NULL */
+	unsigned long ip;	/* call site the transfers are accounted to */
+};
+
+/**
+ * sensor_i2c_batch_init - start an empty batch
+ * @batch: batch
+ * @client: i2c client the writes go to
+ * @prof: profile the transfers are accounted in, or NULL
+ * @ip: call site for the profile, usually _RET_IP_
+ */
+static inline void sensor_i2c_batch_init(struct sensor_i2c_batch *batch,
+		struct i2c_client *client, struct sensor_i2c_prof *prof,
+		unsigned long ip)
+{
+	batch->client = client;
+	batch->prof = prof;
+	batch->ip = ip;
+	batch->count = 0;
+	batch->len = 0;
+	batch->merge = false;
+	batch->transfers = 0;
+}
+
+/**
+ * sensor_i2c_batch_flush - write out the queued messages
+ * @batch: batch
+ *
+ * Returns 0 or a negative error code. The batch is empty afterwards in
+ * either case.
+ */
+static inline int sensor_i2c_batch_flush(struct sensor_i2c_batch *batch)
+{
+	int count = batch->count;
+	ktime_t start;
+	int ret;
+
+	if (!count)
+		return 0;
+
+	batch->count = 0;
+	batch->len = 0;
+	batch->merge = false;
+
+	start = ktime_get();
+	ret = i2c_transfer(batch->client->adapter, batch->msgs, count);
+	if (batch->prof)
+		sensor_i2c_prof_record(batch->prof, batch->ip, start,
+				ret != count);
+	if (ret != count) {
+		dev_err(&batch->client->dev, "batch write error at 0x%04x: %d\n",
+				(batch->buf[0] << 8) | batch->buf[1], ret);
+		return ret < 0 ? ret : -EIO;
+	}
+	batch->transfers++;
+	return 0;
+}
+
+/**
+ * sensor_i2c_batch_reserve - make room for a write
+ * @batch: batch
+ * @reg: register address
+ * @bytes: data bytes
+ * @merge: the data may extend the last message
+ *
+ * Returns where the data goes, or NULL on error. With a new message the
+ * register address is already in place.
+ */
+static inline u8 *sensor_i2c_batch_reserve(struct sensor_i2c_batch *batch,
+		u16 reg, int bytes, bool merge)
+{
+	struct i2c_msg *msg;
+	u8 *buf;
+
+	if (2 + bytes > SENSOR_I2C_BATCH_BYTES)
+		return NULL;
+
+	merge = merge && batch->merge && reg == batch->next_reg;
+	if (batch->len + bytes + (merge ? 0 : 2) > SENSOR_I2C_BATCH_BYTES ||
+	    (!merge && batch->count == SENSOR_I2C_BATCH_MSGS)) {
+		if (sensor_i2c_batch_flush(batch) < 0)
+			return NULL;
+		merge = false;
+	}
+
+	buf = batch->buf + batch->len;
+	if (merge) {
+		batch->msgs[batch->count - 1].len += bytes;
+		batch->len += bytes;
+		return buf;
+	}
+
+	buf[0] = reg >> 8;
+	buf[1] = reg & 0xff;
+	msg = &batch->msgs[batch->count++];
+	msg->addr = batch->client->addr;
+	msg->flags = batch->client->flags & I2C_M_TEN;
+	msg->len = 2 + bytes;
+	msg->buf = buf;
+	batch->len += 2 + bytes;
+	return buf + 2;
+}
+
+/**
+ * sensor_i2c_batch_write - queue a register write
+ * @batch: batch
+ * @reg: register address
+ * @val: value
+ * @width: register width in bytes, 1, 2 or 4
+ *
+ * A write to the register right after the previous one is merged into its
+ * message. Returns 0 or a negative error code.
+ */
+static inline int sensor_i2c_batch_write(struct sensor_i2c_batch *batch,
+		u16 reg, u32 val, int width)
+{
+	u8 *buf;
+	int i;
+
+	if (width != 1 && width != 2 && width != 4)
+		return -EINVAL;
+
+	buf = sensor_i2c_batch_reserve(batch, reg, width, true);
+	if (!buf)
+		return -EIO;
+	for (i = 0; i < width; i++)
+		buf[i] = val >> (8 * (width - 1 - i));
+
+	batch->next_reg = reg + width;
+	batch->merge = true;
+	return 0;
+}
+
+/**
+ * sensor_i2c_batch_write_words - queue a block of 16-bit words
+ * @batch: batch
+ * @reg: register address
+ * @vals: words
+ * @count: number of words, at most (SENSOR_I2C_BATCH_BYTES - 2) / 2
+ * @port: reg is a data port that keeps its address
+ *
+ * The block goes out as one message. Writes to a port are never merged
+ * with other messages. Returns 0 or a negative error code.
+ */
+static inline int sensor_i2c_batch_write_words(struct sensor_i2c_batch *batch,
+		u16 reg, const u16 *vals, int count, bool port)
+{
+	u8 *buf;
+	int i;
+
+	buf = sensor_i2c_batch_reserve(batch, reg, 2 * count, false);
+	if (!buf)
+		return -EIO;
+	for (i = 0; i < count; i++) {
+		buf[2 * i] = vals[i] >> 8;
+		buf[2 * i + 1] = vals[i] & 0xff;
+	}
+
+	batch->next_reg = reg + 2 * count;
+	batch->merge = !port;
+	return 0;
+}
+
+#endif /* __SENSOR_I2C_BATCH_H__ */